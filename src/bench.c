@@ -0,0 +1,1566 @@
+/*
+ * VARCem	Virtual ARchaeological Computer EMulator.
+ *		An emulator of (mostly) x86-based PC systems and devices,
+ *		using the ISA,EISA,VLB,MCA  and PCI system buses, roughly
+ *		spanning the era between 1981 and 1995.
+ *
+ *		This file is part of the VARCem Project.
+ *
+ *		Implementation of the CPU benchmark suite.
+ *
+ *		A number of small, fixed guest workloads are run on a set
+ *		of reference processors, using each of the CPU backends
+ *		available for them (the 808x core, the 286/386 interpreter
+ *		and the dynamic recompiler with its timing models.) For
+ *		each run, the host time used per guest instruction and the
+ *		emulated speed are written to a JSON file.
+ *
+ *		The workloads run without a machine, BIOS or devices; they
+ *		are loaded into RAM at 0000:1000 and report completion by
+ *		writing to I/O port E9h. Since runs are timed in emulated
+ *		time slices, the results do not depend on the host speed
+ *		other than in the reported host times.
+ *
+ *		The results file is rewritten after each completed run,
+ *		and runs already present in it are skipped, so that an
+ *		interrupted suite can be resumed by just restarting it.
+ *
+ *		Before the timed runs, the faster execution paths of the
+ *		CPU cores are checked against their exact (but slower)
+ *		counterparts, and the MMX instructions against a simple
+ *		reference. The EMU8000 idle-voice shortcut is checked in
+ *		the same way. The outcome is noted in the results file,
+ *		and any failed check makes the entire run fail.
+ *
+ * Version:	@(#)bench.c	1.0.1	2019/07/03
+ *
+ * Author:	Fred N. van Kempen, <decwiz@yahoo.com>
+ *
+ *		Copyright 2019 Fred N. van Kempen.
+ *
+ *		Redistribution and  use  in source  and binary forms, with
+ *		or  without modification, are permitted  provided that the
+ *		following conditions are met:
+ *
+ *		1. Redistributions of  source  code must retain the entire
+ *		   above notice, this list of conditions and the following
+ *		   disclaimer.
+ *
+ *		2. Redistributions in binary form must reproduce the above
+ *		   copyright  notice,  this list  of  conditions  and  the
+ *		   following disclaimer in  the documentation and/or other
+ *		   materials provided with the distribution.
+ *
+ *		3. Neither the  name of the copyright holder nor the names
+ *		   of  its  contributors may be used to endorse or promote
+ *		   products  derived from  this  software without specific
+ *		   prior written permission.
+ *
+ * THIS SOFTWARE  IS  PROVIDED BY THE  COPYRIGHT  HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND  ANY EXPRESS  OR  IMPLIED  WARRANTIES,  INCLUDING, BUT  NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE  ARE  DISCLAIMED. IN  NO  EVENT  SHALL THE COPYRIGHT
+ * HOLDER OR  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL,  EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON  ANY
+ * THEORY OF  LIABILITY, WHETHER IN  CONTRACT, STRICT  LIABILITY, OR  TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING  IN ANY  WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include "emu.h"
+#include "config.h"
+#include "cpu/cpu.h"
+#ifdef USE_DYNAREC
+# include "cpu/x86.h"
+# include "cpu/codegen.h"
+#endif
+#include "io.h"
+#include "mem.h"
+#include "timer.h"
+#include "plat.h"
+#include "devices/sound/sound.h"
+#include "devices/sound/snd_emu8k.h"
+#include "bench.h"
+
+
+#define BENCH_MEMSIZE	8192			/* RAM size, in KB */
+#define BENCH_ORG	0x1000			/* load address of workloads */
+#define BENCH_DATA	0x0800			/* workload data area */
+#define BENCH_PORT	0x00e9			/* "done" port */
+#define BENCH_MAXMS	120000			/* max emulated time per run */
+#define BENCH_MAXRES	256			/* max number of results */
+#define CHECK_SLICES	200			/* time slices per check run */
+#define CHECK_STATE	17			/* values per state snapshot */
+#define CHECK_MMXOP	0x0014			/* offset of checked instruction */
+#define CHECK_MMXDATA	0x20000			/* MMX check records */
+#define CHECK_MMXRECS	4096			/* max records per MMX check run */
+#define CHECK_EMUSTEPS	10			/* updates per EMU8000 buffer */
+#define CHECK_EMUBUFS	4			/* buffers per EMU8000 check */
+#define CHECK_EMUNOTES	6			/* register changes per update */
+
+/* EMU8000 ports (at the usual 620h base.) */
+#define EMU_DATA0	0x0620
+#define EMU_DATA1	0x0a20
+#define EMU_DATA2	0x0a22
+#define EMU_DATA3	0x0e20
+#define EMU_PTR		0x0e22
+
+/* Test data for the MMX checks. */
+#define CHECK_BYTES	0			/* all pairs of byte values */
+#define CHECK_LANES	1			/* edge values, then random */
+#define CHECK_COUNT	2			/* shift counts, by register */
+#define CHECK_IMM	3			/* shift counts, immediate */
+
+/* Requirements for a workload. */
+#define BENCH_FPU	0x01			/* needs an x87 FPU */
+#define BENCH_MMX	0x02			/* needs MMX */
+#define BENCH_386	0x04			/* needs a 386 or better */
+
+
+typedef struct {
+    const char	*name;				/* workload name */
+    const uint8_t *code;			/* workload code */
+    int		size;
+    int		flags;
+} bench_test_t;
+
+typedef struct {
+    const char	*name;				/* instruction name */
+    uint8_t	op;				/* opcode (after 0F) */
+    uint8_t	modrm;				/* ModR/M byte */
+    int8_t	width;				/* lane width, in bits */
+    int8_t	data;				/* kind of test data */
+} check_mmx_t;
+
+typedef struct {
+    const char	*name;				/* CPU name (in table) */
+    const CPU	*list;				/* CPU table */
+    const char	*timing;			/* timing model */
+} bench_cpu_t;
+
+
+/*
+ * The workloads.
+ *
+ * All are assembled for address 0000:1000, and run in real mode
+ * with interrupts disabled, except for the paging test, which
+ * switches to flat protected mode with paging first. Each ends
+ * by writing to the "done" port, and then loops forever.
+ */
+static const uint8_t bench_integer[] = {
+    0xfa,				/* cli */
+    0xba,0x64,0x00,			/* mov dx,0x64 */
+    0xb9,0x10,0x27,			/* mov cx,0x2710 */
+    0x01,0xd8,				/* add ax,bx */
+    0x31,0xc3,				/* xor bx,ax */
+    0x46,				/* inc si */
+    0x29,0xf7,				/* sub di,si */
+    0xd1,0xe0,				/* shl ax,1 */
+    0x11,0xc5,				/* adc bp,ax */
+    0xe2,0xf3,				/* loop 0x1007 */
+    0x4a,				/* dec dx */
+    0x75,0xed,				/* jne 0x1004 */
+    0xe6,0xe9,				/* out 0xe9,al */
+    0xeb,0xfe,				/* jmp 0x1019 */
+};
+
+static const uint8_t bench_string[] = {
+    0xfa,				/* cli */
+    0xfc,				/* cld */
+    0xb8,0x00,0x20,			/* mov ax,0x2000 */
+    0x8e,0xd8,				/* mov ds,ax */
+    0xb8,0x00,0x30,			/* mov ax,0x3000 */
+    0x8e,0xc0,				/* mov es,ax */
+    0xba,0x64,0x00,			/* mov dx,0x64 */
+    0x31,0xf6,				/* xor si,si */
+    0x31,0xff,				/* xor di,di */
+    0xb9,0x00,0x40,			/* mov cx,0x4000 */
+    0xf3,0xa5,				/* rep movs word es:[di],word [si] */
+    0x31,0xff,				/* xor di,di */
+    0xb9,0x00,0x40,			/* mov cx,0x4000 */
+    0x89,0xd0,				/* mov ax,dx */
+    0xf3,0xab,				/* rep stos word es:[di],ax */
+    0x31,0xf6,				/* xor si,si */
+    0xb9,0x00,0x10,			/* mov cx,0x1000 */
+    0xac,				/* lods al,byte [si] */
+    0x00,0xc3,				/* add bl,al */
+    0xe2,0xfb,				/* loop 0x1026 */
+    0x4a,				/* dec dx */
+    0x75,0xe1,				/* jne 0x100f */
+    0xe6,0xe9,				/* out 0xe9,al */
+    0xeb,0xfe,				/* jmp 0x1030 */
+};
+
+static const uint8_t bench_x87[] = {
+    0xfa,				/* cli */
+    0xdb,0xe3,				/* fninit */
+    0xd9,0xe8,				/* fld1 */
+    0xd9,0xeb,				/* fldpi */
+    0xba,0x64,0x00,			/* mov dx,0x64 */
+    0xb9,0xe8,0x03,			/* mov cx,0x3e8 */
+    0xd8,0xc1,				/* fadd st,st(1) */
+    0xd9,0xfa,				/* fsqrt */
+    0xd9,0xc0,				/* fld st(0) */
+    0xd8,0xc8,				/* fmul st,st(0) */
+    0xdd,0xd8,				/* fstp st(0) */
+    0xe2,0xf4,				/* loop 0x100d */
+    0x4a,				/* dec dx */
+    0x75,0xee,				/* jne 0x100a */
+    0xd9,0x1e,0x00,0x08,		/* fstp dword 0x800 */
+    0xe6,0xe9,				/* out 0xe9,al */
+    0xeb,0xfe,				/* jmp 0x1022 */
+};
+
+static const uint8_t bench_mmx[] = {
+    0xfa,				/* cli */
+    0x0f,0xef,0xc0,			/* pxor mm0,mm0 */
+    0x0f,0x6f,0x0e,0x00,0x08,		/* movq mm1,qword 0x800 */
+    0xba,0x64,0x00,			/* mov dx,0x64 */
+    0xb9,0xe8,0x03,			/* mov cx,0x3e8 */
+    0x0f,0xfd,0xc1,			/* paddw mm0,mm1 */
+    0x0f,0xd5,0xc8,			/* pmullw mm1,mm0 */
+    0x0f,0x73,0xd1,0x01,		/* psrlq mm1,0x1 */
+    0x0f,0x60,0xd0,			/* punpcklbw mm2,mm0 */
+    0x0f,0x74,0xda,			/* pcmpeqb mm3,mm2 */
+    0x0f,0xef,0xd3,			/* pxor mm2,mm3 */
+    0x0f,0x7f,0x06,0x08,0x08,		/* movq qword 0x808,mm0 */
+    0xe2,0xe6,				/* loop 0x100f */
+    0x4a,				/* dec dx */
+    0x75,0xe0,				/* jne 0x100c */
+    0x0f,0x77,				/* emms */
+    0xe6,0xe9,				/* out 0xe9,al */
+    0xeb,0xfe,				/* jmp 0x1030 */
+};
+
+static const uint8_t bench_smc[] = {
+    0xfa,				/* cli */
+    0xba,0x64,0x00,			/* mov dx,0x64 */
+    0xb9,0xe8,0x03,			/* mov cx,0x3e8 */
+    0x88,0x0e,0x0c,0x10,		/* mov byte 0x100c,cl */
+    0xb0,0x00,				/* mov al,0x0 */
+    0x00,0xc3,				/* add bl,al */
+    0xe2,0xf6,				/* loop 0x1007 */
+    0x4a,				/* dec dx */
+    0x75,0xf0,				/* jne 0x1004 */
+    0xe6,0xe9,				/* out 0xe9,al */
+    0xeb,0xfe,				/* jmp 0x1016 */
+};
+
+static const uint8_t bench_xt[] = {
+    0xfa,				/* cli */
+    0xfc,				/* cld */
+    0xb8,0x00,0x20,			/* mov ax,0x2000 */
+    0x8e,0xd8,				/* mov ds,ax */
+    0x8e,0xc0,				/* mov es,ax */
+    0xb8,0x34,0x12,			/* mov ax,0x1234 */
+    0xbb,0x65,0x87,			/* mov bx,0x8765 */
+    0xb9,0xdc,0xfe,			/* mov cx,0xfedc */
+    0xba,0x0f,0x0f,			/* mov dx,0xf0f */
+    0xbe,0x00,0x01,			/* mov si,0x100 */
+    0xbf,0x00,0x02,			/* mov di,0x200 */
+    0xbd,0x5a,0x5a,			/* mov bp,0x5a5a */
+    0x36,0xc7,0x06,0x00,0x0f,0x20,0x4e,	/* mov word ss:0xf00,0x4e20 */
+    0x01,0xd8,				/* add ax,bx */
+    0x10,0xf1,				/* adc cl,dh */
+    0x29,0xca,				/* sub dx,cx */
+    0x18,0xc7,				/* sbb bh,al */
+    0x81,0xe6,0xfe,0x0f,		/* and si,0xffe */
+    0x09,0xd5,				/* or bp,dx */
+    0x31,0xeb,				/* xor bx,bp */
+    0x39,0xd0,				/* cmp ax,dx */
+    0x00,0xeb,				/* add bl,ch */
+    0x29,0xc1,				/* sub cx,ax */
+    0x85,0xf0,				/* test ax,si */
+    0x84,0xf3,				/* test bl,dh */
+    0x87,0xfe,				/* xchg si,di */
+    0x86,0xe1,				/* xchg cl,ah */
+    0x89,0xc3,				/* mov bx,ax */
+    0x88,0xea,				/* mov dl,ch */
+    0x8b,0xc3,				/* mov ax,bx */
+    0x8a,0xd5,				/* mov dl,ch */
+    0x03,0xca,				/* add cx,dx */
+    0x2a,0xe3,				/* sub ah,bl */
+    0x3b,0xd0,				/* cmp dx,ax */
+    0x33,0xfe,				/* xor di,si */
+    0x45,				/* inc bp */
+    0x4e,				/* dec si */
+    0x91,				/* xchg cx,ax */
+    0x98,				/* cbw */
+    0x99,				/* cwd */
+    0x9f,				/* lahf */
+    0x80,0xf4,0x55,			/* xor ah,0x55 */
+    0x9e,				/* sahf */
+    0xf5,				/* cmc */
+    0xf9,				/* stc */
+    0xf8,				/* clc */
+    0xfd,				/* std */
+    0xfc,				/* cld */
+    0x81,0xe7,0xfe,0x0f,		/* and di,0xffe */
+    0x01,0x04,				/* add word [si],ax */
+    0x33,0x45,0x02,			/* xor ax,word [di+0x2] */
+    0x88,0x10,				/* mov byte [bx+si],dl */
+    0x8b,0x0b,				/* mov cx,word [bp+di] */
+    0xf6,0xe3,				/* mul bl */
+    0x50,				/* push ax */
+    0x52,				/* push dx */
+    0x5b,				/* pop bx */
+    0x59,				/* pop cx */
+    0x73,0x01,				/* jae 0x1078 */
+    0x40,				/* inc ax */
+    0xd1,0xcb,				/* ror bx,1 */
+    0xd1,0xe2,				/* shl dx,1 */
+    0x81,0xe6,0xfe,0x0f,		/* and si,0xffe */
+    0xad,				/* lods ax,word [si] */
+    0xaa,				/* stos byte es:[di],al */
+    0xb9,0x03,0x00,			/* mov cx,0x3 */
+    0xf3,0xa4,				/* rep movs byte es:[di],byte [si] */
+    0xc6,0x06,0x00,0x03,0x07,		/* mov byte 0x300,0x7 */
+    0x30,0xe4,				/* xor ah,ah */
+    0xf6,0x36,0x00,0x03,		/* div byte 0x300 */
+    0x80,0x0e,0x01,0x03,0x01,		/* or byte 0x301,0x1 */
+    0x90,				/* nop */
+    0x95,				/* xchg bp,ax */
+    0xf7,0xd8,				/* neg ax */
+    0xf7,0xd2,				/* not dx */
+    0x36,0xff,0x0e,0x00,0x0f,		/* dec word ss:0xf00 */
+    0x75,0x81,				/* jne 0x1025 */
+    0xe6,0xe9,				/* out 0xe9,al */
+    0xeb,0xfe,				/* jmp 0x10a6 */
+};
+
+static const uint8_t bench_paging[] = {
+    0xfa,				/* cli */
+    0x66,0x0f,0x01,0x16,0x00,0x06,	/* lgdtd 0x600 */
+    0x66,0xb8,0x00,0x00,0x01,0x00,	/* mov eax,0x10000 */
+    0x0f,0x22,0xd8,			/* mov cr3,eax */
+    0x0f,0x20,0xc0,			/* mov eax,cr0 */
+    0x66,0x0d,0x01,0x00,0x00,0x80,	/* or eax,0x80000001 */
+    0x0f,0x22,0xc0,			/* mov cr0,eax */
+    0xea,0x21,0x10,0x08,0x00,		/* jmp 0x8:0x1021 */
+    0x66,0xb8,0x10,0x00,		/* mov ax,0x10 */
+    0x8e,0xd8,				/* mov ds,eax */
+    0x8e,0xc0,				/* mov es,eax */
+    0x8e,0xd0,				/* mov ss,eax */
+    0xbc,0x00,0x90,0x00,0x00,		/* mov esp,0x9000 */
+    0xba,0xf4,0x01,0x00,0x00,		/* mov edx,0x1f4 */
+    0xbb,0x00,0x00,0x10,0x00,		/* mov ebx,0x100000 */
+    0xb9,0x00,0x03,0x00,0x00,		/* mov ecx,0x300 */
+    0x03,0x03,				/* add eax,dword [ebx] */
+    0x89,0x43,0x04,			/* mov dword [ebx+0x4],eax */
+    0x81,0xc3,0x00,0x10,0x00,0x00,	/* add ebx,0x1000 */
+    0xe2,0xf3,				/* loop 0x103f */
+    0x0f,0x20,0xd8,			/* mov eax,cr3 */
+    0x0f,0x22,0xd8,			/* mov cr3,eax */
+    0x4a,				/* dec edx */
+    0x75,0xe0,				/* jne 0x1035 */
+    0xe6,0xe9,				/* out 0xe9,al */
+    0xeb,0xfe,				/* jmp 0x1057 */
+};
+
+static const bench_test_t bench_tests[] = {
+    { "integer",	bench_integer,	sizeof(bench_integer),	0		},
+    { "string",		bench_string,	sizeof(bench_string),	0		},
+    { "x87",		bench_x87,	sizeof(bench_x87),	BENCH_FPU	},
+    { "mmx",		bench_mmx,	sizeof(bench_mmx),	BENCH_MMX	},
+    { "paging",		bench_paging,	sizeof(bench_paging),	BENCH_386	},
+    { "smc",		bench_smc,	sizeof(bench_smc),	0		},
+    { "xt",		bench_xt,	sizeof(bench_xt),	0		},
+    { NULL								}
+};
+
+/* Reference processors, one for each core and timing model. */
+static const bench_cpu_t bench_cpus[] = {
+    { "8088/4.77",	cpus_8088,		"808x"		},
+    { "286/12",		cpus_286,		"286"		},
+    { "i386DX/33",	cpus_i386DX,		"386"		},
+    { "i486DX2/66",	cpus_i486,		"486"		},
+    { "WinChip 200",	cpus_WinChip,		"winchip"	},
+    { "Pentium MMX 233", cpus_Pentium,		"pentium"	},
+    { "6x86MX-PR233",	cpus_6x86,		"686"		},
+    { "Pentium Pro 200", cpus_PentiumPro,	"686"		},
+    { NULL							}
+};
+
+/*
+ * The MMX check loop.
+ *
+ * Each 16-byte record at 2000:0000 holds two operands, and the
+ * result of the checked instruction (patched in at CHECK_MMXOP,
+ * as "op mm0,mm1" or "op mm0,[si+8]") replaces the first one.
+ * The number of records is at 0000:0800.
+ */
+static const uint8_t check_mmx_code[] = {
+    0xfa,				/* cli */
+    0xb8,0x00,0x20,			/* mov ax,0x2000 */
+    0x8e,0xd8,				/* mov ds,ax */
+    0x31,0xf6,				/* xor si,si */
+    0x36,0x8b,0x0e,0x00,0x08,		/* mov cx,word ss:0x800 */
+    0x0f,0x6f,0x04,			/* movq mm0,qword [si] */
+    0x0f,0x6f,0x4c,0x08,		/* movq mm1,qword [si+0x8] */
+    0x0f,0xfc,0xc1,			/* paddb mm0,mm1 */
+    0x90,				/* nop */
+    0x0f,0x7f,0x04,			/* movq qword [si],mm0 */
+    0x83,0xc6,0x10,			/* add si,0x10 */
+    0xe2,0xed,				/* loop 0x100d */
+    0x0f,0x77,				/* emms */
+    0xe6,0xe9,				/* out 0xe9,al */
+    0xeb,0xfe,				/* jmp 0x1024 */
+};
+
+/* The MMX instructions to check. */
+static const check_mmx_t check_mmx_ops[] = {
+    { "paddb",		0xfc, 0xc1,  8, CHECK_BYTES	},
+    { "paddw",		0xfd, 0xc1, 16, CHECK_LANES	},
+    { "paddd",		0xfe, 0xc1, 32, CHECK_LANES	},
+    { "paddsb",		0xec, 0xc1,  8, CHECK_BYTES	},
+    { "paddsw",		0xed, 0xc1, 16, CHECK_LANES	},
+    { "paddusb",	0xdc, 0xc1,  8, CHECK_BYTES	},
+    { "paddusw",	0xdd, 0xc1, 16, CHECK_LANES	},
+    { "psubb",		0xf8, 0xc1,  8, CHECK_BYTES	},
+    { "psubw",		0xf9, 0xc1, 16, CHECK_LANES	},
+    { "psubd",		0xfa, 0xc1, 32, CHECK_LANES	},
+    { "psubsb",		0xe8, 0xc1,  8, CHECK_BYTES	},
+    { "psubsw",		0xe9, 0xc1, 16, CHECK_LANES	},
+    { "psubusb",	0xd8, 0xc1,  8, CHECK_BYTES	},
+    { "psubusw",	0xd9, 0xc1, 16, CHECK_LANES	},
+    { "pmaddwd",	0xf5, 0xc1, 16, CHECK_LANES	},
+    { "pmulhw",		0xe5, 0xc1, 16, CHECK_LANES	},
+    { "pmullw",		0xd5, 0xc1, 16, CHECK_LANES	},
+    { "pcmpeqb",	0x74, 0xc1,  8, CHECK_BYTES	},
+    { "pcmpeqw",	0x75, 0xc1, 16, CHECK_LANES	},
+    { "pcmpeqd",	0x76, 0xc1, 32, CHECK_LANES	},
+    { "pcmpgtb",	0x64, 0xc1,  8, CHECK_BYTES	},
+    { "pcmpgtw",	0x65, 0xc1, 16, CHECK_LANES	},
+    { "pcmpgtd",	0x66, 0xc1, 32, CHECK_LANES	},
+    { "packsswb",	0x63, 0xc1, 16, CHECK_LANES	},
+    { "packuswb",	0x67, 0xc1, 16, CHECK_LANES	},
+    { "packssdw",	0x6b, 0xc1, 32, CHECK_LANES	},
+    { "punpcklbw",	0x60, 0xc1,  8, CHECK_LANES	},
+    { "punpcklwd",	0x61, 0xc1, 16, CHECK_LANES	},
+    { "punpckldq",	0x62, 0xc1, 32, CHECK_LANES	},
+    { "punpckhbw",	0x68, 0xc1,  8, CHECK_LANES	},
+    { "punpckhwd",	0x69, 0xc1, 16, CHECK_LANES	},
+    { "punpckhdq",	0x6a, 0xc1, 32, CHECK_LANES	},
+    { "pand",		0xdb, 0xc1, 32, CHECK_LANES	},
+    { "pandn",		0xdf, 0xc1, 32, CHECK_LANES	},
+    { "por",		0xeb, 0xc1, 32, CHECK_LANES	},
+    { "pxor",		0xef, 0xc1, 32, CHECK_LANES	},
+    { "psrlw",		0xd1, 0xc1, 16, CHECK_COUNT	},
+    { "psrld",		0xd2, 0xc1, 32, CHECK_COUNT	},
+    { "psrlq",		0xd3, 0xc1, 64, CHECK_COUNT	},
+    { "psraw",		0xe1, 0xc1, 16, CHECK_COUNT	},
+    { "psrad",		0xe2, 0xc1, 32, CHECK_COUNT	},
+    { "psllw",		0xf1, 0xc1, 16, CHECK_COUNT	},
+    { "pslld",		0xf2, 0xc1, 32, CHECK_COUNT	},
+    { "psllq",		0xf3, 0xc1, 64, CHECK_COUNT	},
+    { "psrlw imm",	0x71, 0xd0, 16, CHECK_IMM	},
+    { "psraw imm",	0x71, 0xe0, 16, CHECK_IMM	},
+    { "psllw imm",	0x71, 0xf0, 16, CHECK_IMM	},
+    { "psrld imm",	0x72, 0xd0, 32, CHECK_IMM	},
+    { "psrad imm",	0x72, 0xe0, 32, CHECK_IMM	},
+    { "pslld imm",	0x72, 0xf0, 32, CHECK_IMM	},
+    { "psrlq imm",	0x73, 0xd0, 64, CHECK_IMM	},
+    { "psllq imm",	0x73, 0xf0, 64, CHECK_IMM	},
+    { NULL						}
+};
+
+/* Edge values for the MMX checks, cut down to the lane width. */
+static const uint32_t check_edges[] = {
+    0x00000000, 0x00000001, 0x00000002, 0x0000007f, 0x00000080,
+    0x000000ff, 0x00000100, 0x00007ffe, 0x00007fff, 0x00008000,
+    0x00008001, 0x0000ffff, 0x00010000, 0x7fffffff, 0x80000000,
+    0x80000001, 0xffff7fff, 0xffff8000, 0xfffffffe, 0xffffffff
+};
+#define CHECK_NEDGES	(sizeof(check_edges) / sizeof(uint32_t))
+
+/* Names of the values in a state snapshot, for the checks. */
+static const char *const check_names[CHECK_STATE] = {
+    "ins", "cycles", "AX", "CX", "DX", "BX", "SP", "BP", "SI", "DI",
+    "flags", "CS", "IP", "DS", "ES", "SS", "memory"
+};
+
+/* Flat code and data segments for the paging test. */
+static const uint8_t bench_gdt[] = {
+    0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+    0xff,0xff,0x00,0x00,0x00,0x9a,0xcf,0x00,
+    0xff,0xff,0x00,0x00,0x00,0x92,0xcf,0x00
+};
+
+
+static volatile int bench_state;
+static tmrval_t	bench_time;
+static uint64_t	bench_end;
+static int	bench_ins;
+static char	*bench_res[BENCH_MAXRES];
+static int	bench_nres;
+static int	bench_checks;
+
+
+/* The guest reports it is done. */
+static void
+bench_write(uint16_t port, uint8_t val, priv_t priv)
+{
+    if (bench_state != 1) return;
+
+    bench_end = plat_timer_read();
+    bench_ins = ins + cpu_state.cpu_recomp_ins;
+    bench_state = 2;
+}
+
+
+/*
+ * Without a machine, we have no timers at all, so the CPU would
+ * not return to us for a long time. Keep a 1ms tick running.
+ */
+static void
+bench_tick(priv_t priv)
+{
+    bench_time += (1000LL * TIMER_USEC);
+}
+
+
+/* Load the results of an earlier (possibly interrupted) run. */
+static void
+bench_load(const wchar_t *fn)
+{
+    char temp[512];
+    char *sp;
+    FILE *fp;
+
+    fp = plat_fopen(fn, L"r");
+    if (fp == NULL) return;
+
+    while (fgets(temp, sizeof(temp), fp) != NULL) {
+	if (strstr(temp, "\"cpu\":") == NULL) continue;
+	if (bench_nres == BENCH_MAXRES) break;
+
+	/* Strip leading whitespace and the trailing comma. */
+	sp = temp;
+	while (*sp == ' ' || *sp == '\t')
+		sp++;
+	sp[strcspn(sp, "\r\n")] = '\0';
+	if (sp[strlen(sp) - 1] == ',')
+		sp[strlen(sp) - 1] = '\0';
+
+	bench_res[bench_nres] = (char *)mem_alloc(strlen(sp) + 1);
+	strcpy(bench_res[bench_nres++], sp);
+    }
+
+    (void)fclose(fp);
+
+    if (bench_nres > 0)
+	INFO("BENCH: resuming, %i results loaded\n", bench_nres);
+}
+
+
+/* (Re-)write the results file. */
+static int
+bench_save(const wchar_t *fn)
+{
+    FILE *fp;
+    int i;
+
+    fp = plat_fopen(fn, L"w");
+    if (fp == NULL) {
+	ERRLOG("BENCH: unable to create '%ls'\n", fn);
+	return(0);
+    }
+
+    fprintf(fp, "{\n  \"emulator\": \"%s %s\",\n  \"checks\": \"%s\",\n  \"results\": [\n",
+	    emu_title, emu_fullversion, bench_checks ? "passed" : "FAILED");
+    for (i = 0; i < bench_nres; i++)
+	fprintf(fp, "    %s%s\n", bench_res[i], (i < bench_nres-1) ? "," : "");
+    fprintf(fp, "  ]\n}\n");
+
+    (void)fclose(fp);
+
+    return(1);
+}
+
+
+/* Do we already have a result for this run? */
+static int
+bench_done(const char *cpu, const char *backend, const char *test)
+{
+    char temp[256];
+    int i;
+
+    sprintf(temp, "{ \"cpu\": \"%s\", \"backend\": \"%s\", \"workload\": \"%s\",",
+	    cpu, backend, test);
+
+    for (i = 0; i < bench_nres; i++) {
+	if (! strncmp(bench_res[i], temp, strlen(temp)))
+		return(1);
+    }
+
+    return(0);
+}
+
+
+/* Run a slice of emulated time on the selected backend. */
+static void
+bench_exec(int dyna, int cycs)
+{
+    if (is386) {
+#ifdef USE_DYNAREC
+	if (dyna)
+		exec386_dynarec(cycs);
+	  else
+#endif
+		exec386(cycs);
+    } else if (cpu_get_type() >= CPU_286) {
+	exec386(cycs);
+    } else {
+	execx86(cycs);
+    }
+}
+
+
+/* Set up a flat GDT, and page tables mapping the first 4MB 1:1. */
+static void
+bench_setup_paging(void)
+{
+    uint32_t *pd = (uint32_t *)&ram[0x10000];
+    uint32_t *pt = (uint32_t *)&ram[0x11000];
+    int i;
+
+    memcpy(&ram[0x0500], bench_gdt, sizeof(bench_gdt));
+    *(uint16_t *)&ram[0x0600] = sizeof(bench_gdt) - 1;
+    *(uint32_t *)&ram[0x0602] = 0x00000500;
+
+    pd[0] = 0x00011000 | 0x03;
+    for (i = 0; i < 1024; i++)
+	pt[i] = (i << 12) | 0x03;
+}
+
+
+/* Reset the processor, and point it at the loaded code. */
+static void
+bench_reset(void)
+{
+    int i;
+
+    cpu_reset(1);
+    cr0 &= ~(1 << 30);		/* enable the cache, as the BIOS would */
+    cpu_state.cpu_recomp_ins = 0;
+    loadcs(0x0000);
+    cpu_state.pc = BENCH_ORG;
+    loadseg(0x0000, &_ds);
+    loadseg(0x0000, &_es);
+    loadseg(0x0000, &_ss);
+    for (i = 0; i < 8; i++)
+	cpu_state.regs[i].l = 0;
+    SP = BENCH_ORG;
+    flags = 0x0002;
+
+    timer_reset();
+    bench_time = (1000LL * TIMER_USEC);
+    timer_add(bench_tick, NULL, &bench_time, TIMER_ALWAYS_ENABLED);
+}
+
+
+/* Load a workload, and reset the processor to run it. */
+static void
+bench_prepare(const bench_test_t *bt)
+{
+    int i;
+
+    /* Load the workload and its data. */
+    memset(ram, 0x00, 1024UL * mem_size);
+    memcpy(&ram[BENCH_ORG], bt->code, bt->size);
+    for (i = 0; i < 16; i++)
+	ram[BENCH_DATA + i] = (uint8_t)(0x11 * (i + 1));
+    if (bt->flags & BENCH_386)
+	bench_setup_paging();
+
+    bench_reset();
+}
+
+
+/* Perform a single run. */
+static int
+bench_test(const bench_cpu_t *bc, const char *backend, int dyna, const bench_test_t *bt)
+{
+    char temp[512];
+    uint64_t start;
+    double ns, secs;
+    int slice, ms;
+
+    bench_prepare(bt);
+
+    /* Run in 1ms slices until the guest tells us it is done. */
+    slice = cpu_get_speed() / 1000;
+    bench_state = 1;
+    start = plat_timer_read();
+    for (ms = 0; ms < BENCH_MAXMS; ms++) {
+	bench_exec(dyna, slice);
+	if (bench_state == 2) break;
+    }
+
+    if (bench_state != 2) {
+	bench_state = 0;
+	ERRLOG("BENCH: %s/%s/%s did not complete, skipped\n",
+	       bc->name, backend, bt->name);
+	return(0);
+    }
+    bench_state = 0;
+    ms++;
+
+    ns = (double)(bench_end - start) * 1000000000.0 / (double)plat_timer_freq();
+    secs = (double)ms / 1000.0;
+
+    sprintf(temp, "{ \"cpu\": \"%s\", \"backend\": \"%s\", \"workload\": \"%s\", \"timing\": \"%s\", \"instructions\": %i, \"host_ns\": %.0f, \"ns_per_ins\": %.3f, \"emulated_ms\": %i, \"emulated_mips\": %.3f }",
+	    bc->name, backend, bt->name, bc->timing, bench_ins, ns,
+	    (bench_ins > 0) ? (ns / (double)bench_ins) : 0.0,
+	    ms, (double)bench_ins / secs / 1000000.0);
+
+    INFO("BENCH: %-16s %-12s %-8s %10i ins, %8.3f ns/ins\n",
+	 bc->name, backend, bt->name, bench_ins,
+	 (bench_ins > 0) ? (ns / (double)bench_ins) : 0.0);
+
+    if (bench_nres < BENCH_MAXRES) {
+	bench_res[bench_nres] = (char *)mem_alloc(strlen(temp) + 1);
+	strcpy(bench_res[bench_nres++], temp);
+    }
+
+    return(1);
+}
+
+
+/* Look up a processor in its table. */
+static int
+bench_find(const bench_cpu_t *bc)
+{
+    int c;
+
+    for (c = 0; bc->list[c].name != NULL; c++) {
+	if (! strcmp(bc->list[c].name, bc->name))
+		return(c);
+    }
+
+    ERRLOG("BENCH: CPU '%s' not found, skipped\n", bc->name);
+
+    return(-1);
+}
+
+
+/* Select the processor, with FPU, and reset memory. */
+static void
+bench_select(const bench_cpu_t *bc, int c, int dyna)
+{
+    cpu_set_type(bc->list, 0, c, 1, dyna);
+    AT = (cpu_get_type() >= CPU_286);
+    pc_set_speed(1);
+    mem_reset();
+}
+
+
+/* Take a snapshot of the processor state (and memory, if asked.) */
+static void
+check_snap(uint32_t *st, int memory)
+{
+    uint32_t h = 2166136261UL;
+    uint32_t a;
+    int i;
+
+    st[0] = ins;
+    st[1] = cycles;
+    for (i = 0; i < 8; i++)
+	st[2 + i] = cpu_state.regs[i].w;
+    st[10] = flags;
+    st[11] = CS;
+    st[12] = cpu_state.pc;
+    st[13] = DS;
+    st[14] = ES;
+    st[15] = SS;
+
+    /* FNV-1a hash of the first megabyte. */
+    if (memory) {
+	for (a = 0; a < 0x100000; a++)
+		h = (h ^ ram[a]) * 16777619UL;
+    }
+    st[16] = memory ? h : 0;
+}
+
+
+/* Run a workload for a fixed time, taking a snapshot after each slice. */
+static void
+check_trace(const bench_test_t *bt, uint32_t *st)
+{
+    int slice, i;
+
+    bench_prepare(bt);
+    cycles = 0;
+
+    slice = cpu_get_speed() / 1000;
+    for (i = 0; i < CHECK_SLICES; i++) {
+	execx86(slice);
+	check_snap(&st[i * CHECK_STATE], (i == CHECK_SLICES - 1));
+    }
+}
+
+
+/*
+ * Check the 808x fast path against the full decoder.
+ *
+ * Both must give exactly the same timing, so each of the real-mode
+ * workloads is run for a fixed amount of emulated time with and
+ * without the fast path, and the state after each slice must be
+ * the same. This includes the instruction count and the cycles
+ * left over, which show any difference in the prefetch queue.
+ */
+static int
+check_808x(void)
+{
+    static const bench_cpu_t cpus[] = {
+	{ "8088/4.77",	cpus_8088,	"808x"	},
+	{ "8086/8",	cpus_8086,	"808x"	},
+	{ NULL					}
+    };
+    static uint32_t st[2][CHECK_SLICES * CHECK_STATE];
+    const bench_cpu_t *bc;
+    const bench_test_t *bt;
+    int c, i, fast, ret = 1;
+
+    fast = cpu_808x_fast;
+
+    for (bc = cpus; bc->name != NULL; bc++) {
+	c = bench_find(bc);
+	if (c < 0) continue;
+
+	bench_select(bc, c, 0);
+
+	for (bt = bench_tests; bt->name != NULL; bt++) {
+		if (bt->flags != 0) continue;
+
+		for (i = 0; i < 2; i++) {
+			cpu_808x_fast = i;
+			check_trace(bt, st[i]);
+		}
+
+		for (i = 0; i < CHECK_SLICES * CHECK_STATE; i++) {
+			if (st[0][i] != st[1][i]) break;
+		}
+
+		if (i < CHECK_SLICES * CHECK_STATE) {
+			ERRLOG("BENCH: check 808x %s/%s FAILED, %s is %08x after %ims, should be %08x\n",
+			       bc->name, bt->name, check_names[i % CHECK_STATE],
+			       st[1][i], (i / CHECK_STATE) + 1, st[0][i]);
+			ret = 0;
+		} else
+			INFO("BENCH: check 808x %s/%s passed, %u ins\n",
+			     bc->name, bt->name, st[1][i - CHECK_STATE]);
+	}
+    }
+
+    cpu_808x_fast = fast;
+
+    return(ret);
+}
+
+
+/* Get a lane of an MMX value, zero- or sign-extended. */
+static int64_t
+check_lane(uint64_t v, int i, int w, int sgn)
+{
+    uint64_t m = (w == 64) ? ~0ULL : ((1ULL << w) - 1);
+
+    v = (v >> (i * w)) & m;
+    if (sgn && ((v >> (w - 1)) & 1))
+	v |= ~m;
+
+    return((int64_t)v);
+}
+
+
+/* Saturate a value to a signed or unsigned lane. */
+static int64_t
+check_sat(int64_t v, int w, int sgn)
+{
+    int64_t lo = sgn ? -(1LL << (w - 1)) : 0;
+    int64_t hi = sgn ? ((1LL << (w - 1)) - 1) : ((1LL << w) - 1);
+
+    if (v < lo)
+	return(lo);
+    if (v > hi)
+	return(hi);
+
+    return(v);
+}
+
+
+/* Work out the result of an MMX instruction, one lane at a time. */
+static uint64_t
+check_mmx_ref(const check_mmx_t *t, const uint8_t *op, uint64_t a, uint64_t b)
+{
+    uint64_t m, r = 0, cnt = 0;
+    int64_t x, y, v;
+    int w = t->width;
+    int n = 64 / w;
+    int i, sgn, sh = 0;
+
+    m = (w == 64) ? ~0ULL : ((1ULL << w) - 1);
+
+    switch (t->op) {
+	case 0x63:	/* PACKSSWB */
+	case 0x67:	/* PACKUSWB */
+	case 0x6b:	/* PACKSSDW */
+		sgn = (t->op != 0x67);
+		for (i = 0; i < n; i++) {
+			v = check_sat(check_lane(a, i, w, 1), w / 2, sgn);
+			r |= ((uint64_t)v & (m >> (w / 2))) << (i * w / 2);
+			v = check_sat(check_lane(b, i, w, 1), w / 2, sgn);
+			r |= ((uint64_t)v & (m >> (w / 2))) << ((i + n) * w / 2);
+		}
+		return(r);
+
+	case 0x60:	/* PUNPCKLxx */
+	case 0x61:
+	case 0x62:
+	case 0x68:	/* PUNPCKHxx */
+	case 0x69:
+	case 0x6a:
+		for (i = 0; i < (n / 2); i++) {
+			x = check_lane(a, i + ((t->op & 8) ? (n / 2) : 0), w, 0);
+			y = check_lane(b, i + ((t->op & 8) ? (n / 2) : 0), w, 0);
+			r |= (uint64_t)x << (2 * i * w);
+			r |= (uint64_t)y << ((2 * i + 1) * w);
+		}
+		return(r);
+
+	case 0xdb:	/* PAND */
+		return(a & b);
+
+	case 0xdf:	/* PANDN */
+		return(~a & b);
+
+	case 0xeb:	/* POR */
+		return(a | b);
+
+	case 0xef:	/* PXOR */
+		return(a ^ b);
+
+	case 0xf5:	/* PMADDWD */
+		for (i = 0; i < 2; i++) {
+			v = (check_lane(a, 2*i, 16, 1) * check_lane(b, 2*i, 16, 1)) +
+			    (check_lane(a, 2*i+1, 16, 1) * check_lane(b, 2*i+1, 16, 1));
+			r |= ((uint64_t)v & 0xffffffff) << (i * 32);
+		}
+		return(r);
+
+	case 0xd1:	/* PSRLx */
+	case 0xd2:
+	case 0xd3:
+		sh = 2;
+		cnt = b;
+		break;
+
+	case 0xe1:	/* PSRAx */
+	case 0xe2:
+		sh = 4;
+		cnt = b;
+		break;
+
+	case 0xf1:	/* PSLLx */
+	case 0xf2:
+	case 0xf3:
+		sh = 6;
+		cnt = b;
+		break;
+
+	case 0x71:	/* PSxxx imm */
+	case 0x72:
+	case 0x73:
+		sh = (op[2] >> 3) & 7;
+		cnt = op[3];
+		break;
+    }
+
+    /* Signed lanes? */
+    switch (t->op) {
+	case 0xec: case 0xed: case 0xe8: case 0xe9:
+	case 0xe5: case 0xd5:
+	case 0x64: case 0x65: case 0x66:
+	case 0xe1: case 0xe2:
+		sgn = 1;
+		break;
+
+	default:
+		sgn = (sh == 4);
+		break;
+    }
+
+    for (i = 0; i < n; i++) {
+	x = check_lane(a, i, w, sgn);
+	y = check_lane(b, i, w, sgn);
+
+	switch (t->op) {
+		case 0xfc: case 0xfd: case 0xfe:	/* PADDx */
+			v = x + y;
+			break;
+
+		case 0xf8: case 0xf9: case 0xfa:	/* PSUBx */
+			v = x - y;
+			break;
+
+		case 0xec: case 0xed:			/* PADDSx */
+		case 0xdc: case 0xdd:			/* PADDUSx */
+			v = check_sat(x + y, w, sgn);
+			break;
+
+		case 0xe8: case 0xe9:			/* PSUBSx */
+		case 0xd8: case 0xd9:			/* PSUBUSx */
+			v = check_sat(x - y, w, sgn);
+			break;
+
+		case 0xd5:				/* PMULLW */
+			v = x * y;
+			break;
+
+		case 0xe5:				/* PMULHW */
+			v = (x * y) >> 16;
+			break;
+
+		case 0x74: case 0x75: case 0x76:	/* PCMPEQx */
+			v = (x == y) ? -1 : 0;
+			break;
+
+		case 0x64: case 0x65: case 0x66:	/* PCMPGTx */
+			v = (x > y) ? -1 : 0;
+			break;
+
+		default:				/* shifts */
+			if (sh == 4)
+				v = x >> ((cnt >= (uint64_t)w) ? (w - 1) : (int)cnt);
+			else if (cnt >= (uint64_t)w)
+				v = 0;
+			else if (sh == 2)
+				v = (int64_t)((uint64_t)x >> cnt);
+			else
+				v = (int64_t)((uint64_t)x << cnt);
+			break;
+	}
+
+	r |= ((uint64_t)v & m) << (i * w);
+    }
+
+    return(r);
+}
+
+
+/* Get a 32-bit random number. */
+static uint32_t
+check_rand(uint64_t *seed)
+{
+    *seed = (*seed * 6364136223846793005ULL) + 1442695040888963407ULL;
+
+    return((uint32_t)(*seed >> 32));
+}
+
+
+/* Make the operands for a record of an MMX check. */
+static void
+check_mmx_data(const check_mmx_t *t, int k, uint64_t *a, uint64_t *b, uint64_t *seed)
+{
+    uint64_t x, y;
+    int i, n, p, w;
+
+    *a = *b = 0;
+
+    /* All pairs of byte values, eight at a time. */
+    if (t->data == CHECK_BYTES) {
+	for (i = 0; i < 8; i++) {
+		p = (k * 8) + i;
+		*a |= (uint64_t)(p & 0xff) << (i * 8);
+		*b |= (uint64_t)((p >> 8) & 0xff) << (i * 8);
+	}
+	return;
+    }
+
+    /* All pairs of edge values first, then random values. */
+    w = (t->width == 64) ? 32 : t->width;
+    n = 64 / w;
+    for (i = 0; i < n; i++) {
+	p = (k * n) + i;
+	if (p < (int)(CHECK_NEDGES * CHECK_NEDGES)) {
+		x = check_edges[p % CHECK_NEDGES];
+		y = check_edges[p / CHECK_NEDGES];
+	} else {
+		x = check_rand(seed);
+		y = check_rand(seed);
+	}
+	if (w < 32) {
+		x &= ((1UL << w) - 1);
+		y &= ((1UL << w) - 1);
+	}
+	*a |= x << (i * w);
+	*b |= y << (i * w);
+    }
+
+    /* Shift counts around the lane width, then huge ones. */
+    if (t->data == CHECK_COUNT) {
+	if (k < 80)
+		*b = k;
+	else if (k & 1)
+		*b = ((uint64_t)check_rand(seed) << 32) | check_rand(seed);
+	else
+		*b = (uint64_t)(check_rand(seed) & 0xff);
+    }
+}
+
+
+/* Run an MMX instruction over a set of records, and check the results. */
+static int
+check_mmx_run(const bench_cpu_t *bc, const char *backend, int dyna,
+	      const check_mmx_t *t, const uint8_t *op, int base, int recs)
+{
+    static uint64_t a[CHECK_MMXRECS], b[CHECK_MMXRECS];
+    uint64_t seed = 1;
+    uint64_t r, v;
+    int k, ms, slice;
+
+    /* Load the loop with the instruction, and the records. */
+    memcpy(&ram[BENCH_ORG], check_mmx_code, sizeof(check_mmx_code));
+    memcpy(&ram[BENCH_ORG + CHECK_MMXOP], op, 4);
+    for (k = 0; k < recs; k++) {
+	check_mmx_data(t, base + k, &a[k], &b[k], &seed);
+	*(uint64_t *)&ram[CHECK_MMXDATA + (k * 16)] = a[k];
+	*(uint64_t *)&ram[CHECK_MMXDATA + (k * 16) + 8] = b[k];
+    }
+    *(uint16_t *)&ram[BENCH_DATA] = recs;
+
+    bench_reset();
+
+    slice = cpu_get_speed() / 1000;
+    bench_state = 1;
+    for (ms = 0; ms < 1000; ms++) {
+	bench_exec(dyna, slice);
+	if (bench_state == 2) break;
+    }
+
+    if (bench_state != 2) {
+	bench_state = 0;
+	ERRLOG("BENCH: check MMX %s/%s/%s did not complete\n",
+	       bc->name, backend, t->name);
+	return(0);
+    }
+    bench_state = 0;
+
+    for (k = 0; k < recs; k++) {
+	r = *(uint64_t *)&ram[CHECK_MMXDATA + (k * 16)];
+	v = check_mmx_ref(t, op, a[k], b[k]);
+	if (r != v) {
+		ERRLOG("BENCH: check MMX %s/%s/%s FAILED, %016llx,%016llx gives %016llx, should be %016llx\n",
+		       bc->name, backend, t->name, a[k], b[k], r, v);
+		return(0);
+	}
+    }
+
+    return(1);
+}
+
+
+/* Check one MMX instruction, in its register and memory forms. */
+static int
+check_mmx_op(const bench_cpu_t *bc, const char *backend, int dyna, const check_mmx_t *t)
+{
+    uint8_t op[4];
+    int i;
+
+    op[0] = 0x0f;
+    op[1] = t->op;
+
+    /* Shifts by an immediate, for all counts up to 65, and 255. */
+    if (t->data == CHECK_IMM) {
+	op[2] = t->modrm;
+	for (i = 0; i < 67; i++) {
+		op[3] = (i < 66) ? i : 0xff;
+		if (! check_mmx_run(bc, backend, dyna, t, op, 0, 128))
+			return(0);
+	}
+	return(1);
+    }
+
+    for (i = 0; i < 2; i++) {
+	if (i == 0) {
+		op[2] = 0xc1;	/* mm0,mm1 */
+		op[3] = 0x90;	/* nop */
+	} else {
+		op[2] = 0x44;	/* mm0,[si+8] */
+		op[3] = 0x08;
+	}
+
+	if (! check_mmx_run(bc, backend, dyna, t, op, 0, CHECK_MMXRECS))
+		return(0);
+
+	/* The byte pairs take two runs. */
+	if ((t->data == CHECK_BYTES) &&
+	    !check_mmx_run(bc, backend, dyna, t, op, CHECK_MMXRECS, CHECK_MMXRECS))
+		return(0);
+    }
+
+    return(1);
+}
+
+
+/*
+ * Check the MMX instructions against a portable reference.
+ *
+ * The interpreter uses host SSE2 for most of these where it can,
+ * and the recompiler always does, so each backend of each of the
+ * MMX processors runs every instruction over all pairs of byte
+ * values, or over edge and random values for the wider lanes.
+ */
+static int
+check_mmx(void)
+{
+    const bench_cpu_t *bc;
+    const check_mmx_t *t;
+    const char *backend;
+    int c, dyna, ok, ret = 1;
+
+    for (bc = bench_cpus; bc->name != NULL; bc++) {
+	c = bench_find(bc);
+	if (c < 0) continue;
+
+	for (dyna = 0; dyna < 2; dyna++) {
+		if (dyna) {
+#ifdef USE_DYNAREC
+			if (! (bc->list[c].flags & CPU_SUPPORTS_DYNAREC))
+				continue;
+			backend = "dynarec";
+#else
+			continue;
+#endif
+		} else {
+			if (bc->list[c].flags & CPU_REQUIRES_DYNAREC)
+				continue;
+			backend = "interpreter";
+		}
+
+		bench_select(bc, c, dyna);
+		if (! cpu_hasMMX) continue;
+
+		ok = 1;
+		for (t = check_mmx_ops; t->name != NULL; t++) {
+			if (! check_mmx_op(bc, backend, dyna, t))
+				ok = 0;
+		}
+
+		if (ok)
+			INFO("BENCH: check MMX %s/%s passed\n", bc->name, backend);
+		  else
+			ret = 0;
+	}
+    }
+
+    return(ret);
+}
+
+
+/* Write an EMU8000 register. */
+static void
+check_emu8k_w(emu8k_t *emu, uint16_t port, int reg, int voice, uint16_t val)
+{
+    emu8k_outw(EMU_PTR, (reg << 5) | voice, emu);
+    emu8k_outw(port, val, emu);
+}
+
+
+/* Write a 32-bit EMU8000 register, low word first. */
+static void
+check_emu8k_dw(emu8k_t *emu, uint16_t port, int reg, int voice, uint32_t val)
+{
+    check_emu8k_w(emu, port, reg, voice, val & 0xffff);
+    check_emu8k_w(emu, port + 2, reg, voice, val >> 16);
+}
+
+
+/* Program one voice of the EMU8000, as some driver would. */
+static void
+check_emu8k_voice(emu8k_t *emu, int v, int kind, uint64_t *seed)
+{
+    uint32_t start, end, addr, vol, val;
+    int k;
+
+    start = check_rand(seed) % 0x7e000;
+    end = start + 0x10 + (check_rand(seed) % 0x1000);
+    addr = start + (check_rand(seed) % (2 * (end - start)));
+
+    switch (kind) {
+	case 0:		/* note on */
+		check_emu8k_w(emu, EMU_DATA1, 5, v, 0x0080);
+		check_emu8k_dw(emu, EMU_DATA0, 3, v, 0x0000ffff);
+		check_emu8k_dw(emu, EMU_DATA0, 2, v, 0x0000ffff);
+		check_emu8k_dw(emu, EMU_DATA0, 1, v, 0);
+		check_emu8k_dw(emu, EMU_DATA0, 0, v, 0);
+		check_emu8k_w(emu, EMU_DATA1, 4, v, 0x8000);
+		check_emu8k_w(emu, EMU_DATA1, 6, v, 0x8000);
+		check_emu8k_w(emu, EMU_DATA1, 7, v, check_rand(seed) & 0x7f7f);
+		check_emu8k_w(emu, EMU_DATA2, 4, v, check_rand(seed) & 0x7f7f);
+		check_emu8k_w(emu, EMU_DATA2, 5, v, check_rand(seed) & 0xffff);
+		check_emu8k_w(emu, EMU_DATA2, 6, v, check_rand(seed) & 0x7f7f);
+		check_emu8k_w(emu, EMU_DATA2, 7, v, check_rand(seed) & 0xffff);
+		check_emu8k_w(emu, EMU_DATA3, 0, v, 0xd000 + (check_rand(seed) & 0x1fff));
+		check_emu8k_w(emu, EMU_DATA3, 1, v, check_rand(seed) & 0xffff);
+		check_emu8k_w(emu, EMU_DATA3, 2, v, check_rand(seed) & 0xffff);
+		check_emu8k_w(emu, EMU_DATA3, 3, v, check_rand(seed) & 0xffff);
+		check_emu8k_w(emu, EMU_DATA3, 4, v, check_rand(seed) & 0xffff);
+		check_emu8k_w(emu, EMU_DATA3, 5, v, check_rand(seed) & 0xffff);
+		check_emu8k_dw(emu, EMU_DATA0, 6, v, (check_rand(seed) << 24) | start);
+		check_emu8k_dw(emu, EMU_DATA0, 7, v, (check_rand(seed) << 24) | end);
+		check_emu8k_dw(emu, EMU_DATA1, 0, v, (check_rand(seed) << 28) | start);
+		check_emu8k_dw(emu, EMU_DATA0, 1, v, 0x40000000 | (check_rand(seed) & 0xffff));
+		check_emu8k_dw(emu, EMU_DATA0, 0, v, 0x40000000);
+		check_emu8k_w(emu, EMU_DATA1, 5, v, check_rand(seed) & 0x7f7f);
+		break;
+
+	case 1:		/* note off */
+		check_emu8k_w(emu, EMU_DATA1, 5, v, 0x8000 | (check_rand(seed) & 0x7f));
+		break;
+
+	case 2:		/* stopped and silent */
+	case 3:		/* stopped, volume held */
+		/* Now and then, leave one thing running in it. */
+		k = check_rand(seed) % 8;
+		vol = (kind == 3) ? (check_rand(seed) << 16) : 0;
+
+		check_emu8k_w(emu, EMU_DATA1, 5, v, 0x0080);
+		val = (k == 0) ? (check_rand(seed) << 16) : 0;
+		check_emu8k_dw(emu, EMU_DATA0, 1, v, val);
+		val = (k == 1) ? (check_rand(seed) << 16) : 0;
+		check_emu8k_dw(emu, EMU_DATA0, 0, v, val | (check_rand(seed) & 0xffff));
+		val = (k == 2) ? (check_rand(seed) & 0xffff) : 0xffff;
+		check_emu8k_dw(emu, EMU_DATA0, 3, v, vol | val);
+		val = (k == 3) ? (check_rand(seed) & 0xffff) : 0xffff;
+		if (k == 4)
+			vol = check_rand(seed) << 16;
+		check_emu8k_dw(emu, EMU_DATA0, 2, v, vol | val);
+		check_emu8k_dw(emu, EMU_DATA0, 6, v, start);
+		check_emu8k_dw(emu, EMU_DATA0, 7, v, end);
+
+		/* Sometimes with the DMA bit, which also mutes the voice. */
+		val = (k == 5) ? (check_rand(seed) << 28) : 0;
+		check_emu8k_dw(emu, EMU_DATA1, 0, v,
+			       val | (check_rand(seed) & 0x04000000) | addr);
+		break;
+
+	case 4:		/* output on or off */
+		check_emu8k_w(emu, EMU_DATA1, 1, 31, check_rand(seed) & 0x0004);
+		break;
+    }
+}
+
+
+/* Make a few random register changes, and return the new seed. */
+static uint64_t
+check_emu8k_notes(emu8k_t *emu, uint64_t seed)
+{
+    int k, v, kind;
+
+    for (k = 0; k < CHECK_EMUNOTES; k++) {
+	v = check_rand(&seed) & 31;
+	kind = check_rand(&seed) % 5;
+	check_emu8k_voice(emu, v, kind, &seed);
+    }
+
+    return(seed);
+}
+
+
+/* Compare two EMU8000 states, including the CCCA registers as read. */
+static int
+check_emu8k_cmp(emu8k_t *emu, emu8k_t *ref, int bufs, int step)
+{
+    uint32_t a, b;
+    int c;
+
+    for (c = 0; c < 32; c++) {
+	emu8k_outw(EMU_PTR, c, emu);
+	a = emu8k_inw(EMU_DATA1, emu) | ((uint32_t)emu8k_inw(EMU_DATA2, emu) << 16);
+	emu8k_outw(EMU_PTR, c, ref);
+	b = emu8k_inw(EMU_DATA1, ref) | ((uint32_t)emu8k_inw(EMU_DATA2, ref) << 16);
+	if (a != b) {
+		ERRLOG("BENCH: check EMU8K FAILED, CCCA of voice %i differs after %i/%i\n",
+		       c, bufs, step);
+		return(0);
+	}
+
+	if (memcmp(&emu->voice[c], &ref->voice[c], sizeof(emu8k_voice_t))) {
+		ERRLOG("BENCH: check EMU8K FAILED, voice %i differs after %i/%i\n",
+		       c, bufs, step);
+		return(0);
+	}
+    }
+
+    if (memcmp(emu->buffer, ref->buffer, sizeof(emu->buffer))) {
+	ERRLOG("BENCH: check EMU8K FAILED, output differs after %i/%i\n",
+	       bufs, step);
+	return(0);
+    }
+
+    if (memcmp(emu, ref, sizeof(emu8k_t))) {
+	ERRLOG("BENCH: check EMU8K FAILED, state differs after %i/%i\n",
+	       bufs, step);
+	return(0);
+    }
+
+    return(1);
+}
+
+
+/*
+ * Check the EMU8000 idle-voice shortcut against the full mixer.
+ *
+ * Two copies of the chip, on a random sound ROM, get the same
+ * register writes: notes started and released, and voices left
+ * stopped with and without a held volume, all while the output
+ * is turned on and off. One copy skips its idle voices and the
+ * other does not, and after each update all of their state must
+ * be the same, as must the CCCA registers read back from them.
+ */
+static int
+check_emu8k(void)
+{
+    emu8k_t *emu, *ref;
+    uint64_t seed;
+    int pos, skip;
+    int b, i, k, ret = 1;
+
+    pos = sound_pos_global;
+    skip = emu8k_idle_skip;
+    sound_pos_global = 0;
+
+    emu = (emu8k_t *)mem_alloc(sizeof(emu8k_t));
+    memset(emu, 0x00, sizeof(emu8k_t));
+    emu->rom = (int16_t *)mem_alloc(1024 * 1024);
+    seed = 1;
+    for (i = 0; i < 512 * 1024; i++)
+	emu->rom[i] = (int16_t)check_rand(&seed);
+    emu8k_setup(emu, 0);
+
+    /* Set up all voices, a few of each kind. */
+    for (k = 0; k < 32; k++)
+	check_emu8k_voice(emu, k, k % 4, &seed);
+
+    ref = (emu8k_t *)mem_alloc(sizeof(emu8k_t));
+    memcpy(ref, emu, sizeof(emu8k_t));
+
+    for (b = 0; b < CHECK_EMUBUFS && ret; b++) {
+	/* Start each buffer the way the sound card does. */
+	emu->pos = ref->pos = 0;
+	sound_pos_global = 0;
+
+	for (i = 0; i < CHECK_EMUSTEPS; i++) {
+		if (b != 0 || i != 0) {
+			check_emu8k_notes(emu, seed);
+			seed = check_emu8k_notes(ref, seed);
+		}
+
+		sound_pos_global = ((i + 1) * SOUNDBUFLEN) / CHECK_EMUSTEPS;
+
+		emu8k_idle_skip = 1;
+		emu8k_update(emu);
+		emu8k_idle_skip = 0;
+		emu8k_update(ref);
+
+		if (! check_emu8k_cmp(emu, ref, b, i)) {
+			ret = 0;
+			break;
+		}
+	}
+    }
+
+    if (ret)
+	INFO("BENCH: check EMU8K passed, %i updates\n", CHECK_EMUBUFS * CHECK_EMUSTEPS);
+
+    /* The copy shares its tables and memory with the chip. */
+    free(ref);
+    emu8k_close(emu);
+    free(emu);
+
+    emu8k_idle_skip = skip;
+    sound_pos_global = pos;
+
+    return(ret);
+}
+
+
+/* Run the entire suite, and write the results to the given file. */
+int
+bench_run(const wchar_t *fn)
+{
+    const bench_cpu_t *bc;
+    const bench_test_t *bt;
+    const char *backend;
+    int c, dyna;
+
+    INFO("BENCH: running CPU benchmarks, results in '%ls'\n", fn);
+
+    bench_load(fn);
+
+    /* Set up a minimal environment, without any machine. */
+    config.mem_size = BENCH_MEMSIZE;
+    io_reset();
+    mem_init();
+#ifdef USE_DYNAREC
+    codegen_init();
+#endif
+    io_sethandler(BENCH_PORT, 1,
+		  NULL,NULL,NULL, bench_write,NULL,NULL, NULL);
+
+    /* First make sure the faster paths give the right results. */
+    bench_checks = check_808x();
+    if (! check_mmx())
+	bench_checks = 0;
+    if (! check_emu8k())
+	bench_checks = 0;
+
+    for (bc = bench_cpus; bc->name != NULL; bc++) {
+	c = bench_find(bc);
+	if (c < 0) continue;
+
+	for (dyna = 0; dyna < 2; dyna++) {
+		if (dyna) {
+#ifdef USE_DYNAREC
+			if (! (bc->list[c].flags & CPU_SUPPORTS_DYNAREC))
+				continue;
+			backend = "dynarec";
+#else
+			continue;
+#endif
+		} else {
+			if (bc->list[c].flags & CPU_REQUIRES_DYNAREC)
+				continue;
+			backend = (bc->list[c].type >= CPU_286) ? "interpreter" : "808x";
+		}
+
+		bench_select(bc, c, dyna);
+
+		for (bt = bench_tests; bt->name != NULL; bt++) {
+			if ((bt->flags & BENCH_FPU) && !AT) continue;
+			if ((bt->flags & BENCH_MMX) && !cpu_hasMMX) continue;
+			if ((bt->flags & BENCH_386) && !is386) continue;
+
+			if (bench_done(bc->name, backend, bt->name)) continue;
+
+			if (bench_test(bc, backend, dyna, bt)) {
+				if (! bench_save(fn))
+					return(0);
+			}
+		}
+	}
+    }
+
+    /* Always leave a (valid) results file. */
+    if (! bench_save(fn))
+	return(0);
+
+    return(bench_checks);
+}
@@ -0,0 +1,900 @@
+/*
+ * VARCem	Virtual ARchaeological Computer EMulator.
+ *		An emulator of (mostly) x86-based PC systems and devices,
+ *		using the ISA,EISA,VLB,MCA  and PCI system buses, roughly
+ *		spanning the era between 1981 and 1995.
+ *
+ *		This file is part of the VARCem Project.
+ *
+ *		Record the emulated screen and sound to an AVI file.
+ *
+ *		The video is stored with the ZMBV ("Zip Motion Blocks
+ *		Video") codec, which is lossless and compresses the mostly
+ *		static screens of a PC very well, using the bundled zlib.
+ *		The sound is stored as 16-bit stereo PCM at 48 kHz.
+ *
+ *		The emulator only hands us copies of the finished frames
+ *		and sound blocks; all the encoding and file I/O is done on
+ *		a thread of our own. If that thread cannot keep up, we
+ *		drop frames (and, if it really has to, sound blocks) rather
+ *		than holding up the emulator.
+ *
+ *		The sound sample clock is the master clock. Every frame
+ *		is stamped with it when the card finishes it, and the
+ *		encoder builds a fixed-rate video stream from that, by
+ *		using the most recent frame for every video frame period.
+ *		A change in screen size starts a new file, as does getting
+ *		close to the 2GB limit of the AVI format.
+ *
+ * Version:	@(#)capture.c	1.0.1	2019/07/03
+ *
+ * Author:	Fred N. van Kempen, <decwiz@yahoo.com>
+ *
+ *		Copyright 2019 Fred N. van Kempen.
+ *
+ *		Redistribution and  use  in source  and binary forms, with
+ *		or  without modification, are permitted  provided that the
+ *		following conditions are met:
+ *
+ *		1. Redistributions of  source  code must retain the entire
+ *		   above notice, this list of conditions and the following
+ *		   disclaimer.
+ *
+ *		2. Redistributions in binary form must reproduce the above
+ *		   copyright  notice,  this list  of  conditions  and  the
+ *		   following disclaimer in  the documentation and/or other
+ *		   materials provided with the distribution.
+ *
+ *		3. Neither the  name of the copyright holder nor the names
+ *		   of  its  contributors may be used to endorse or promote
+ *		   products  derived from  this  software without specific
+ *		   prior written permission.
+ *
+ * THIS SOFTWARE  IS  PROVIDED BY THE  COPYRIGHT  HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND  ANY EXPRESS  OR  IMPLIED  WARRANTIES,  INCLUDING, BUT  NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE  ARE  DISCLAIMED. IN  NO  EVENT  SHALL THE COPYRIGHT
+ * HOLDER OR  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL,  EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON  ANY
+ * THEORY OF  LIABILITY, WHETHER IN  CONTRACT, STRICT  LIABILITY, OR  TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING  IN ANY  WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include <time.h>
+#include "emu.h"
+#include "plat.h"
+#include "devices/video/video.h"
+#include "zlib/zlib.h"
+#include "capture.h"
+
+
+#define CAP_RATE	48000			/* sound sample rate */
+#define CAP_FPS		60			/* video frame rate */
+#define CAP_PERIOD	(CAP_RATE / CAP_FPS)	/* samples per frame */
+#define CAP_LAG		(CAP_RATE / 20)		/* how far video lags */
+#define CAP_KEYINT	300			/* frames between keyframes */
+#define CAP_MAXSIZE	0x7f000000		/* start new file near 2GB */
+
+#define CAP_BLOCKS	32			/* queued sound blocks */
+#define CAP_BLOCKLEN	1024			/* frames per sound block */
+#define CAP_FRAMES	8			/* queued video frames */
+
+#define ZMBV_BLKW	16			/* ZMBV block size */
+#define ZMBV_BLKH	16
+
+#define AVI_HDRSIZE	324			/* size of our AVI header */
+#define AVIF_HASINDEX	0x00000010
+#define AVIF_ISINTERLEAVED 0x00000100
+#define AVIIF_KEYFRAME	0x00000010
+
+#define FOURCC(a,b,c,d)	((uint32_t)(a) | ((uint32_t)(b) << 8) | \
+			 ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+
+typedef struct {
+    uint64_t	clock;				/* sample clock at start */
+    int		frames;
+    int16_t	data[CAP_BLOCKLEN * 2];
+} capblk_t;
+
+enum {
+    SLOT_FREE = 0,
+    SLOT_BUSY,					/* being filled */
+    SLOT_READY					/* waiting for encoder */
+};
+
+typedef struct {
+    volatile int state;
+    uint64_t	stamp;				/* sample clock of frame */
+    int		w, h;
+    int		size;				/* allocated pels */
+    uint32_t	*pels;
+} capframe_t;
+
+typedef struct {
+    uint32_t	fcc,
+		flags,
+		offset,
+		size;
+} capidx_t;
+
+static struct {
+    volatile int run;
+    mutex_t	*lock;
+    event_t	*wake_ev;
+    thread_t	*thread;
+
+    /* Sound blocks, filled by the CPU thread. */
+    capblk_t	blk[CAP_BLOCKS];
+    volatile int blk_rd,
+		blk_wr;
+    uint32_t	blk_lost;
+
+    /* Video frames, filled by the blitter thread. */
+    capframe_t	frame[CAP_FRAMES];
+    uint32_t	frame_lost;
+
+    /* Everything below is only used by the encoder thread. */
+    wchar_t	path[1024];			/* base name of the files */
+    int		part;
+    FILE	*fp;
+    int		failed;
+
+    uint64_t	clock;				/* sample clock of sound */
+    uint64_t	t0;				/* sample clock at start */
+    uint32_t	vframes,
+		aframes;
+    uint32_t	vmax,				/* largest chunks */
+		amax;
+    uint32_t	movi;				/* size of 'movi' data */
+    capidx_t	*idx;
+    int		idx_len,
+		idx_size;
+
+    int		w, h;
+    uint32_t	*prev;				/* frame last encoded */
+    uint8_t	*work;				/* uncompressed frame data */
+    uint8_t	*out;				/* compressed frame data */
+    uLong	out_size;
+    z_stream	zs;
+    int		zs_init;
+}		cap;
+
+volatile int	capture_active = 0;
+uint64_t	capture_clock = 0;
+
+
+static void
+put16(uint8_t *p, uint16_t val)
+{
+    p[0] = (uint8_t)val;
+    p[1] = (uint8_t)(val >> 8);
+}
+
+
+static void
+put32(uint8_t *p, uint32_t val)
+{
+    p[0] = (uint8_t)val;
+    p[1] = (uint8_t)(val >> 8);
+    p[2] = (uint8_t)(val >> 16);
+    p[3] = (uint8_t)(val >> 24);
+}
+
+
+/* Write (or re-write) the header of the current file. */
+static int
+avi_header(void)
+{
+    uint8_t hdr[AVI_HDRSIZE];
+    uint32_t idx = cap.idx_len * sizeof(capidx_t);
+    uint8_t *p = hdr;
+
+    memset(hdr, 0x00, sizeof(hdr));
+
+    put32(p, FOURCC('R','I','F','F'));
+    put32(p+4, AVI_HDRSIZE - 8 + cap.movi + 8 + idx);
+    put32(p+8, FOURCC('A','V','I',' '));
+    p += 12;
+
+    put32(p, FOURCC('L','I','S','T'));
+    put32(p+4, 292);
+    put32(p+8, FOURCC('h','d','r','l'));
+    p += 12;
+
+    /* Main header. */
+    put32(p, FOURCC('a','v','i','h'));
+    put32(p+4, 56);
+    put32(p+8, 1000000 / CAP_FPS);
+    put32(p+12, (cap.vmax * CAP_FPS) + (CAP_RATE * 4));
+    put32(p+20, AVIF_HASINDEX | AVIF_ISINTERLEAVED);
+    put32(p+24, cap.vframes);
+    put32(p+32, 2);
+    put32(p+36, cap.vmax);
+    put32(p+40, cap.w);
+    put32(p+44, cap.h);
+    p += 64;
+
+    /* Video stream. */
+    put32(p, FOURCC('L','I','S','T'));
+    put32(p+4, 116);
+    put32(p+8, FOURCC('s','t','r','l'));
+    p += 12;
+
+    put32(p, FOURCC('s','t','r','h'));
+    put32(p+4, 56);
+    put32(p+8, FOURCC('v','i','d','s'));
+    put32(p+12, FOURCC('Z','M','B','V'));
+    put32(p+28, 1);
+    put32(p+32, CAP_FPS);
+    put32(p+40, cap.vframes);
+    put32(p+44, cap.vmax);
+    put32(p+48, 0xffffffff);
+    put16(p+60, cap.w);
+    put16(p+62, cap.h);
+    p += 64;
+
+    put32(p, FOURCC('s','t','r','f'));
+    put32(p+4, 40);
+    put32(p+8, 40);
+    put32(p+12, cap.w);
+    put32(p+16, cap.h);
+    put16(p+20, 1);
+    put16(p+22, 32);
+    put32(p+24, FOURCC('Z','M','B','V'));
+    put32(p+28, cap.w * cap.h * 4);
+    p += 48;
+
+    /* Sound stream. */
+    put32(p, FOURCC('L','I','S','T'));
+    put32(p+4, 92);
+    put32(p+8, FOURCC('s','t','r','l'));
+    p += 12;
+
+    put32(p, FOURCC('s','t','r','h'));
+    put32(p+4, 56);
+    put32(p+8, FOURCC('a','u','d','s'));
+    put32(p+28, 1);
+    put32(p+32, CAP_RATE);
+    put32(p+40, cap.aframes);
+    put32(p+44, cap.amax);
+    put32(p+48, 0xffffffff);
+    put32(p+52, 4);
+    p += 64;
+
+    put32(p, FOURCC('s','t','r','f'));
+    put32(p+4, 16);
+    put16(p+8, 1);				/* WAVE_FORMAT_PCM */
+    put16(p+10, 2);
+    put32(p+12, CAP_RATE);
+    put32(p+16, CAP_RATE * 4);
+    put16(p+20, 4);
+    put16(p+22, 16);
+    p += 24;
+
+    put32(p, FOURCC('L','I','S','T'));
+    put32(p+4, 4 + cap.movi);
+    put32(p+8, FOURCC('m','o','v','i'));
+
+    if (fseek(cap.fp, 0, SEEK_SET) != 0) return(0);
+
+    return(fwrite(hdr, 1, sizeof(hdr), cap.fp) == sizeof(hdr));
+}
+
+
+/* Add a chunk to the 'movi' list, and to the index. */
+static void
+avi_chunk(uint32_t fcc, uint32_t flags, const uint8_t *data, uint32_t len)
+{
+    static const uint8_t pad = 0x00;
+    uint8_t hdr[8];
+    capidx_t *idx;
+
+    if (cap.failed) return;
+
+    if (cap.idx_len == cap.idx_size) {
+	cap.idx_size = (cap.idx_size == 0) ? 4096 : (cap.idx_size * 2);
+	idx = (capidx_t *)realloc(cap.idx, cap.idx_size * sizeof(capidx_t));
+	if (idx == NULL) {
+		ERRLOG("CAPTURE: out of memory for index!\n");
+		cap.failed = 1;
+		return;
+	}
+	cap.idx = idx;
+    }
+    idx = &cap.idx[cap.idx_len++];
+    idx->fcc = fcc;
+    idx->flags = flags;
+    idx->offset = 4 + cap.movi;
+    idx->size = len;
+
+    put32(hdr, fcc);
+    put32(hdr+4, len);
+    if ((fwrite(hdr, 1, 8, cap.fp) != 8) ||
+	(fwrite(data, 1, len, cap.fp) != len) ||
+	((len & 1) && (fwrite(&pad, 1, 1, cap.fp) != 1))) {
+	ERRLOG("CAPTURE: error writing file!\n");
+	cap.failed = 1;
+	return;
+    }
+
+    cap.movi += 8 + ((len + 1) & ~1);
+}
+
+
+/* Finish the current file. */
+static void
+avi_close(void)
+{
+    capidx_t *idx;
+    uint8_t hdr[16];
+    int i;
+
+    if (cap.fp == NULL) return;
+
+    if (! cap.failed) {
+	put32(hdr, FOURCC('i','d','x','1'));
+	put32(hdr+4, cap.idx_len * sizeof(capidx_t));
+	(void)fwrite(hdr, 1, 8, cap.fp);
+
+	for (i = 0; i < cap.idx_len; i++) {
+		idx = &cap.idx[i];
+		put32(hdr, idx->fcc);
+		put32(hdr+4, idx->flags);
+		put32(hdr+8, idx->offset);
+		put32(hdr+12, idx->size);
+		(void)fwrite(hdr, 1, 16, cap.fp);
+	}
+
+	(void)avi_header();
+    }
+
+    (void)fclose(cap.fp);
+    cap.fp = NULL;
+
+    INFO("CAPTURE: part %i closed, %u frames, %u samples\n",
+	 cap.part, cap.vframes, cap.aframes);
+}
+
+
+/* Start a new file for a screen of the given size. */
+static int
+avi_open(int w, int h)
+{
+    wchar_t fn[1024];
+    uLong len;
+
+    cap.part++;
+    swprintf(fn, sizeof_w(fn), L"%ls_%03i.avi", cap.path, cap.part);
+
+    cap.fp = plat_fopen(fn, L"wb");
+    if (cap.fp == NULL) {
+	ERRLOG("CAPTURE: file %ls could not be opened for writing!\n", fn);
+	cap.failed = 1;
+	return(0);
+    }
+
+    cap.vframes = cap.aframes = 0;
+    cap.vmax = cap.amax = 0;
+    cap.movi = 0;
+    cap.idx_len = 0;
+
+    /* Set up the buffers for this screen size. */
+    if ((w != cap.w) || (h != cap.h)) {
+	cap.w = w;
+	cap.h = h;
+
+	len = (((w + ZMBV_BLKW - 1) / ZMBV_BLKW) *
+	       ((h + ZMBV_BLKH - 1) / ZMBV_BLKH) * 2 + 3) & ~3;
+	len += w * h * 4;
+
+	free(cap.prev);
+	free(cap.work);
+	free(cap.out);
+	cap.prev = (uint32_t *)mem_alloc(w * h * 4);
+	cap.work = (uint8_t *)mem_alloc(len);
+	cap.out_size = deflateBound(&cap.zs, len) + 1024;
+	cap.out = (uint8_t *)mem_alloc(cap.out_size);
+    }
+
+    if (! avi_header()) {
+	ERRLOG("CAPTURE: error writing file!\n");
+	cap.failed = 1;
+	return(0);
+    }
+
+    INFO("CAPTURE: recording %ix%i to %ls\n", w, h, fn);
+
+    return(1);
+}
+
+
+/* Compress the data in the work buffer. */
+static uint32_t
+zmbv_deflate(uint8_t *out, uint32_t len)
+{
+    uInt avail = (uInt)(cap.out_size - (out - cap.out));
+
+    cap.zs.next_in = cap.work;
+    cap.zs.avail_in = len;
+    cap.zs.next_out = out;
+    cap.zs.avail_out = avail;
+
+    if (deflate(&cap.zs, Z_SYNC_FLUSH) != Z_OK) {
+	ERRLOG("CAPTURE: deflate error '%s'\n",
+	       (cap.zs.msg != NULL) ? cap.zs.msg : "?");
+	cap.failed = 1;
+	return(0);
+    }
+
+    return((uint32_t)(avail - cap.zs.avail_out));
+}
+
+
+/* Encode a frame, and write it to the file. */
+static void
+zmbv_frame(const uint32_t *pels)
+{
+    const uint32_t *src, *old;
+    uint32_t *xp, len;
+    uint8_t *info;
+    int x, y, bw, bh, i, j;
+    int key;
+
+    key = ((cap.vframes % CAP_KEYINT) == 0);
+
+    if (key) {
+	/* Keyframe: header, and the raw pels. */
+	cap.out[0] = 0x01;			/* ZMBV_KEYFRAME */
+	cap.out[1] = 0;				/* version 0.1 */
+	cap.out[2] = 1;
+	cap.out[3] = 1;				/* zlib compression */
+	cap.out[4] = 8;				/* 32bpp */
+	cap.out[5] = ZMBV_BLKW;
+	cap.out[6] = ZMBV_BLKH;
+
+	len = cap.w * cap.h * 4;
+	memcpy(cap.work, pels, len);
+
+	(void)deflateReset(&cap.zs);
+	len = zmbv_deflate(cap.out + 7, len);
+	len += 7;
+    } else {
+	/*
+	 * Inter frame: a vector for every block, and the XOR of
+	 * the blocks that changed. We do not look for motion, as
+	 * on a PC screen things rarely move by less than a block.
+	 */
+	info = cap.work;
+	len = (((cap.w + ZMBV_BLKW - 1) / ZMBV_BLKW) *
+	       ((cap.h + ZMBV_BLKH - 1) / ZMBV_BLKH) * 2 + 3) & ~3;
+	memset(info, 0x00, len);
+	xp = (uint32_t *)(cap.work + len);
+
+	for (y = 0; y < cap.h; y += ZMBV_BLKH) {
+		bh = cap.h - y;
+		if (bh > ZMBV_BLKH)
+			bh = ZMBV_BLKH;
+
+		for (x = 0; x < cap.w; x += ZMBV_BLKW, info += 2) {
+			bw = cap.w - x;
+			if (bw > ZMBV_BLKW)
+				bw = ZMBV_BLKW;
+
+			/* Did anything in this block change? */
+			for (j = 0; j < bh; j++) {
+				i = (y + j) * cap.w + x;
+				if (memcmp(&pels[i], &cap.prev[i], bw * 4))
+					break;
+			}
+			if (j == bh) continue;
+
+			info[0] = 1;
+			for (j = 0; j < bh; j++) {
+				src = &pels[(y + j) * cap.w + x];
+				old = &cap.prev[(y + j) * cap.w + x];
+				for (i = 0; i < bw; i++)
+					*xp++ = src[i] ^ old[i];
+			}
+		}
+	}
+
+	cap.out[0] = 0x00;
+	len = zmbv_deflate(cap.out + 1, (uint32_t)((uint8_t *)xp - cap.work));
+	len += 1;
+    }
+
+    if (pels != cap.prev)
+	memcpy(cap.prev, pels, cap.w * cap.h * 4);
+
+    avi_chunk(FOURCC('0','0','d','c'), key ? AVIIF_KEYFRAME : 0, cap.out, len);
+
+    if (len > cap.vmax)
+	cap.vmax = len;
+    cap.vframes++;
+}
+
+
+/* Write sound, or silence if data is NULL. */
+static void
+write_audio(const int16_t *data, uint32_t frames)
+{
+    int16_t zero[CAP_BLOCKLEN * 2];
+    uint32_t n;
+
+    if (data != NULL) {
+	avi_chunk(FOURCC('0','1','w','b'), AVIIF_KEYFRAME,
+		  (const uint8_t *)data, frames * 4);
+	if (frames * 4 > cap.amax)
+		cap.amax = frames * 4;
+	cap.aframes += frames;
+	return;
+    }
+
+    memset(zero, 0x00, sizeof(zero));
+    while (frames > 0) {
+	n = (frames > CAP_BLOCKLEN) ? CAP_BLOCKLEN : frames;
+	write_audio(zero, n);
+	frames -= n;
+    }
+}
+
+
+/*
+ * Take the most recent frame finished before the given time, and
+ * throw away the ones it replaces. Returns the slot, or NULL if
+ * no new frame was finished since the last one we took.
+ */
+static capframe_t *
+frame_get(uint64_t when)
+{
+    capframe_t *f, *best = NULL;
+    int i;
+
+    thread_wait_mutex(cap.lock);
+    for (i = 0; i < CAP_FRAMES; i++) {
+	f = &cap.frame[i];
+	if ((f->state != SLOT_READY) || (f->stamp > when)) continue;
+
+	if (best == NULL) {
+		best = f;
+	} else if (f->stamp >= best->stamp) {
+		best->state = SLOT_FREE;
+		best = f;
+	} else
+		f->state = SLOT_FREE;
+    }
+    thread_release_mutex(cap.lock);
+
+    return(best);
+}
+
+
+static void
+frame_put(capframe_t *f)
+{
+    thread_wait_mutex(cap.lock);
+    f->state = SLOT_FREE;
+    thread_release_mutex(cap.lock);
+}
+
+
+/* Write all video frames due up to the given sample clock. */
+static void
+video_flush(uint64_t until)
+{
+    capframe_t *f;
+    uint64_t when;
+
+    while (cap.fp != NULL) {
+	when = cap.t0 + (uint64_t)cap.vframes * CAP_PERIOD;
+	if (when >= until) break;
+
+	f = frame_get(when);
+	if (f == NULL) {
+		/* Nothing new, so repeat the last one. */
+		zmbv_frame(cap.prev);
+	} else if ((f->w == cap.w) && (f->h == cap.h) &&
+		   ((cap.movi + cap.idx_len * sizeof(capidx_t)) < CAP_MAXSIZE)) {
+		zmbv_frame(f->pels);
+		frame_put(f);
+	} else {
+		/*
+		 * The screen size changed, or the file is full, so we
+		 * have to start a new one. This frame is the first one
+		 * in there, and the sound it has already missed is made
+		 * up with silence, so the two stay in sync.
+		 */
+		avi_close();
+		if (avi_open(f->w, f->h)) {
+			cap.t0 = when;
+			write_audio(NULL, (uint32_t)(cap.clock - when));
+			zmbv_frame(f->pels);
+		}
+		frame_put(f);
+	}
+
+	if (cap.failed) {
+		avi_close();
+		break;
+	}
+    }
+}
+
+
+/* Process one block of sound. */
+static void
+audio_block(const capblk_t *blk)
+{
+    capframe_t *f;
+
+    if (cap.failed) return;
+
+    if (cap.fp == NULL) {
+	/*
+	 * We start the file with the first frame we get, so
+	 * until then, throw the sound away.
+	 */
+	cap.clock = blk->clock;
+	f = frame_get(blk->clock);
+	if (f != NULL) {
+		if (avi_open(f->w, f->h)) {
+			cap.t0 = blk->clock;
+			zmbv_frame(f->pels);
+		}
+		frame_put(f);
+	}
+	if (cap.fp == NULL) {
+		cap.clock += blk->frames;
+		return;
+	}
+    }
+
+    /* Sound blocks we lost are replaced by silence. */
+    if (blk->clock > cap.clock)
+	write_audio(NULL, (uint32_t)(blk->clock - cap.clock));
+    write_audio(blk->data, blk->frames);
+    cap.clock = blk->clock + blk->frames;
+
+    /* Video lags a little, so the blitter can catch up with us. */
+    if (cap.clock > CAP_LAG)
+	video_flush(cap.clock - CAP_LAG);
+}
+
+
+static void
+capture_thread(void *param)
+{
+    int run, wr;
+
+    do {
+	thread_wait_event(cap.wake_ev, 100);
+	thread_reset_event(cap.wake_ev);
+
+	for (;;) {
+		thread_wait_mutex(cap.lock);
+		run = cap.run;
+		wr = cap.blk_wr;
+		thread_release_mutex(cap.lock);
+		if (cap.blk_rd == wr) break;
+
+		audio_block(&cap.blk[cap.blk_rd]);
+
+		thread_wait_mutex(cap.lock);
+		cap.blk_rd = (cap.blk_rd + 1) % CAP_BLOCKS;
+		thread_release_mutex(cap.lock);
+	}
+    } while (run);
+
+    /* Write what is left, and close the file. */
+    video_flush(cap.clock);
+    avi_close();
+}
+
+
+/* Start recording. */
+int
+capture_start(void)
+{
+    wchar_t fn[128];
+    struct tm *info;
+    time_t now;
+    int i;
+
+    if (capture_active) return(1);
+
+    (void)time(&now);
+    info = localtime(&now);
+
+    memset(cap.path, 0x00, sizeof(cap.path));
+    plat_append_filename(cap.path, usr_path, CAPTURE_PATH);
+
+    if (! plat_dir_check(cap.path))
+	plat_dir_create(cap.path);
+
+    plat_append_slash(cap.path);
+
+    wcsftime(fn, sizeof_w(fn), L"%Y%m%d_%H%M%S", info);
+    wcscat(cap.path, fn);
+
+    memset(&cap.zs, 0x00, sizeof(cap.zs));
+    if (deflateInit(&cap.zs, 4) != Z_OK) {
+	ERRLOG("CAPTURE: unable to initialize zlib!\n");
+	return(0);
+    }
+    cap.zs_init = 1;
+
+    cap.part = 0;
+    cap.fp = NULL;
+    cap.failed = 0;
+    cap.w = cap.h = 0;
+    cap.blk_rd = cap.blk_wr = 0;
+    cap.blk_lost = cap.frame_lost = 0;
+    for (i = 0; i < CAP_FRAMES; i++)
+	cap.frame[i].state = SLOT_FREE;
+
+    /* The lock lives on, as the taps may still be using it. */
+    if (cap.lock == NULL)
+	cap.lock = thread_create_mutex(NULL);
+    cap.wake_ev = thread_create_event();
+
+    cap.run = 1;
+    cap.thread = thread_create(capture_thread, NULL);
+
+    capture_active = 1;
+
+    INFO("CAPTURE: started (%ls)\n", cap.path);
+
+    return(1);
+}
+
+
+/* Stop recording. */
+void
+capture_stop(void)
+{
+    int i;
+
+    if (! capture_active) return;
+
+    /* No more data from the taps. */
+    thread_wait_mutex(cap.lock);
+    capture_active = 0;
+    cap.run = 0;
+    thread_release_mutex(cap.lock);
+
+    DEBUG("CAPTURE: waiting for encoder to terminate...\n");
+
+    thread_set_event(cap.wake_ev);
+    thread_wait(cap.thread, -1);
+    cap.thread = NULL;
+
+    thread_destroy_event(cap.wake_ev);
+    cap.wake_ev = NULL;
+
+    /* Wait for a frame that is still being copied. */
+    for (i = 0; i < CAP_FRAMES; i++) {
+	while (cap.frame[i].state == SLOT_BUSY)
+		plat_delay_ms(1);
+	free(cap.frame[i].pels);
+	cap.frame[i].pels = NULL;
+	cap.frame[i].size = 0;
+    }
+
+    if (cap.zs_init) {
+	(void)deflateEnd(&cap.zs);
+	cap.zs_init = 0;
+    }
+
+    free(cap.idx);
+    cap.idx = NULL;
+    cap.idx_len = cap.idx_size = 0;
+    free(cap.prev);
+    free(cap.work);
+    free(cap.out);
+    cap.prev = NULL;
+    cap.work = cap.out = NULL;
+
+    INFO("CAPTURE: stopped (%u frames and %u sound blocks dropped.)\n",
+	 cap.frame_lost, cap.blk_lost);
+}
+
+
+/* Tap for the mixed sound (CPU thread.) */
+void
+capture_audio(const int32_t *buf, int frames)
+{
+    capblk_t *blk;
+    int32_t val;
+    int c, n;
+
+    while (frames > 0) {
+	n = (frames > CAP_BLOCKLEN) ? CAP_BLOCKLEN : frames;
+
+	thread_wait_mutex(cap.lock);
+	if (! cap.run) {
+		thread_release_mutex(cap.lock);
+		return;
+	}
+
+	if (((cap.blk_wr + 1) % CAP_BLOCKS) == cap.blk_rd) {
+		/* The encoder is not keeping up, drop this block. */
+		cap.blk_lost++;
+	} else {
+		blk = &cap.blk[cap.blk_wr];
+		blk->clock = capture_clock;
+		blk->frames = n;
+		for (c = 0; c < n * 2; c++) {
+			val = buf[c];
+			if (val < -32768)
+				val = -32768;
+			else if (val > 32767)
+				val = 32767;
+			blk->data[c] = (int16_t)val;
+		}
+		cap.blk_wr = (cap.blk_wr + 1) % CAP_BLOCKS;
+		thread_set_event(cap.wake_ev);
+	}
+	thread_release_mutex(cap.lock);
+
+	capture_clock += n;
+	buf += n * 2;
+	frames -= n;
+    }
+}
+
+
+/* Tap for the finished frames (blitter thread.) */
+void
+capture_video(const bitmap_t *bmp, int x, int y, int w, int h, uint64_t stamp)
+{
+    capframe_t *f = NULL;
+    uint32_t *dst;
+    int i, xx, yy;
+
+    if ((w <= 0) || (h <= 0) || (x + w > bmp->w) || (y + h > bmp->h)) return;
+
+    thread_wait_mutex(cap.lock);
+    if (cap.run) {
+	for (i = 0; i < CAP_FRAMES; i++) {
+		if (cap.frame[i].state == SLOT_FREE) {
+			f = &cap.frame[i];
+			f->state = SLOT_BUSY;
+			break;
+		}
+	}
+	if (f == NULL) {
+		/* The encoder is not keeping up, drop this frame. */
+		cap.frame_lost++;
+	}
+    }
+    thread_release_mutex(cap.lock);
+
+    if (f == NULL) return;
+
+    if (f->size < (w * h)) {
+	free(f->pels);
+	f->pels = (uint32_t *)mem_alloc(w * h * 4);
+	f->size = w * h;
+    }
+    f->stamp = stamp;
+    f->w = w;
+    f->h = h;
+
+    dst = f->pels;
+    for (yy = 0; yy < h; yy++) {
+	for (xx = 0; xx < w; xx++)
+		*dst++ = bmp->line[y + yy][x + xx].val & 0x00ffffff;
+    }
+
+    thread_wait_mutex(cap.lock);
+    f->state = SLOT_READY;
+    thread_release_mutex(cap.lock);
+}
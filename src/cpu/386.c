@@ -8,7 +8,7 @@
  *
  *		Implementation of 80286+ CPU interpreter.
  *
- * Version:	@(#)386.c	1.0.10	2019/05/17
+ * Version:	@(#)386.c	1.0.11	2019/06/14
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Sarah Walker, <tommowalker@tommowalker.co.uk>
@@ -224,50 +224,56 @@ exec386(int cycs)
 
 		cycdiff = oldcyc - cycles;
 
-		if (trap) {
-			flags_rebuild();
-
-			if (msw & 1) {
-				pmodeint(1, 0);
-			} else {
-				writememw(ss, (SP-2) & 0xFFFF, flags);
-				writememw(ss, (SP-4) & 0xFFFF, CS);
-				writememw(ss, (SP-6) & 0xFFFF, cpu_state.pc);
-				SP -= 6;
-				addr = (1 << 2) + idt.base;
-				flags &= ~I_FLAG;
-				flags &= ~T_FLAG;
-				cpu_state.pc = readmemw(0, addr);
-				loadcs(readmemw(0, addr+2));
-			}
-		} else if (nmi && nmi_enable) {
-			cpu_state.oldpc = cpu_state.pc;
-			oldcs = CS;
-			x86_int(2);
-			nmi_enable = 0;
-			if (nmi_auto_clear) {
-				nmi_auto_clear = 0;
-				nmi = 0;
-			}
-		} else if (flags & I_FLAG) {
-			temp = pic_interrupt();
-			if (temp != 0xFF) {
+		/*
+		 * Only go looking for traps and interrupts when there
+		 * actually is something to deliver.
+		 */
+		if (trap || cpu_events) {
+			if (trap) {
 				flags_rebuild();
 
 				if (msw & 1) {
-					pmodeint(temp, 0);
+					pmodeint(1, 0);
 				} else {
 					writememw(ss, (SP-2) & 0xFFFF, flags);
 					writememw(ss, (SP-4) & 0xFFFF, CS);
 					writememw(ss, (SP-6) & 0xFFFF, cpu_state.pc);
 					SP -= 6;
-					addr = (temp << 2) + idt.base;
+					addr = (1 << 2) + idt.base;
 					flags &= ~I_FLAG;
 					flags &= ~T_FLAG;
-					oxpc = cpu_state.pc;
 					cpu_state.pc = readmemw(0, addr);
 					loadcs(readmemw(0, addr+2));
 				}
+			} else if (nmi && nmi_enable) {
+				cpu_state.oldpc = cpu_state.pc;
+				oldcs = CS;
+				x86_int(2);
+				nmi_enable = 0;
+				if (nmi_auto_clear) {
+					nmi_auto_clear = 0;
+					nmi_set(0);
+				}
+			} else if ((cpu_events & CPU_EVENT_IRQ) && (flags & I_FLAG)) {
+				temp = pic_interrupt();
+				if (temp != 0xFF) {
+					flags_rebuild();
+
+					if (msw & 1) {
+						pmodeint(temp, 0);
+					} else {
+						writememw(ss, (SP-2) & 0xFFFF, flags);
+						writememw(ss, (SP-4) & 0xFFFF, CS);
+						writememw(ss, (SP-6) & 0xFFFF, cpu_state.pc);
+						SP -= 6;
+						addr = (temp << 2) + idt.base;
+						flags &= ~I_FLAG;
+						flags &= ~T_FLAG;
+						oxpc = cpu_state.pc;
+						cpu_state.pc = readmemw(0, addr);
+						loadcs(readmemw(0, addr+2));
+					}
+				}
 			}
 		}
 
@@ -8,7 +8,7 @@
  *
  *		Implementation of the CPU's dynamic recompiler.
  *
- * Version:	@(#)386_dynarec.c	1.0.11	2019/05/17
+ * Version:	@(#)386_dynarec.c	1.0.13	2019/06/14
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -764,6 +764,7 @@ inrecomp=0;
 
                                         cpu_state.pc++;
                                                 
+                                        codegen_trace_pc = -1;
                                         codegen_generate_call(opcode, x86_opcodes[(opcode | cpu_state.op32) & 0x3ff], fetchdat, cpu_state.pc, cpu_state.pc-1);
 
                                         x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
@@ -774,6 +775,13 @@ inrecomp=0;
 
                                 if (!use32) cpu_state.pc &= 0xffff;
 
+                                /*If the code generator decided to follow this
+                                  branch, and it went where we expected, keep
+                                  adding to the block (superblock.)*/
+                                if (cpu_block_end && (codegen_trace_pc == cpu_state.pc) &&
+                                    !cpu_state.abrt && (block_pos < BLOCK_MAX))
+                                        cpu_block_end = 0;
+
                                 /*Cap source code at 4000 bytes per block; this
                                   will prevent any block from spanning more than
                                   2 pages. In practice this limit will never be
@@ -901,49 +909,15 @@ inrecomp=0;
                         }
                 }
                 
-                if (trap)
-                {
-
-                        flags_rebuild();
-                        if (msw&1)
-                        {
-                                pmodeint(1,0);
-                        }
-                        else
-                        {
-                                writememw(ss,(SP-2)&0xFFFF,flags);
-                                writememw(ss,(SP-4)&0xFFFF,CS);
-                                writememw(ss,(SP-6)&0xFFFF,cpu_state.pc);
-                                SP-=6;
-                                addr = (1 << 2) + idt.base;
-                                flags&=~I_FLAG;
-                                flags&=~T_FLAG;
-                                cpu_state.pc=readmemw(0,addr);
-                                loadcs(readmemw(0,addr+2));
-                        }
-                }
-                else if (nmi && nmi_enable && nmi_mask)
-                {
-                        cpu_state.oldpc = cpu_state.pc;
-                        oldcs = CS;
-                        x86_int(2);
-                        nmi_enable = 0;
-                        if (nmi_auto_clear)
-                        {
-                                nmi_auto_clear = 0;
-                                nmi = 0;
-                        }
-                }
-                else if (flags&I_FLAG)
+                /*Only check for traps and interrupts when something is pending*/
+                if (trap || cpu_events)
                 {
-                        temp=pic_interrupt();
-                        if (temp!=0xFF)
+                        if (trap)
                         {
-                                CPU_BLOCK_END();
                                 flags_rebuild();
                                 if (msw&1)
                                 {
-                                        pmodeint(temp,0);
+                                        pmodeint(1,0);
                                 }
                                 else
                                 {
@@ -951,14 +925,51 @@ inrecomp=0;
                                         writememw(ss,(SP-4)&0xFFFF,CS);
                                         writememw(ss,(SP-6)&0xFFFF,cpu_state.pc);
                                         SP-=6;
-                                        addr=temp<<2;
+                                        addr = (1 << 2) + idt.base;
                                         flags&=~I_FLAG;
                                         flags&=~T_FLAG;
-                                        oxpc=cpu_state.pc;
                                         cpu_state.pc=readmemw(0,addr);
                                         loadcs(readmemw(0,addr+2));
                                 }
                         }
+                        else if (nmi && nmi_enable && nmi_mask)
+                        {
+                                cpu_state.oldpc = cpu_state.pc;
+                                oldcs = CS;
+                                x86_int(2);
+                                nmi_enable = 0;
+                                if (nmi_auto_clear)
+                                {
+                                        nmi_auto_clear = 0;
+                                        nmi_set(0);
+                                }
+                        }
+                        else if ((cpu_events & CPU_EVENT_IRQ) && (flags&I_FLAG))
+                        {
+                                temp=pic_interrupt();
+                                if (temp!=0xFF)
+                                {
+                                        CPU_BLOCK_END();
+                                        flags_rebuild();
+                                        if (msw&1)
+                                        {
+                                                pmodeint(temp,0);
+                                        }
+                                        else
+                                        {
+                                                writememw(ss,(SP-2)&0xFFFF,flags);
+                                                writememw(ss,(SP-4)&0xFFFF,CS);
+                                                writememw(ss,(SP-6)&0xFFFF,cpu_state.pc);
+                                                SP-=6;
+                                                addr=temp<<2;
+                                                flags&=~I_FLAG;
+                                                flags&=~T_FLAG;
+                                                oxpc=cpu_state.pc;
+                                                cpu_state.pc=readmemw(0,addr);
+                                                loadcs(readmemw(0,addr+2));
+                                        }
+                                }
+                        }
                 }
         }
                 timer_end_period(cycles << TIMER_SHIFT);
@@ -8,7 +8,7 @@
  *
  *		808x CPU emulation.
  *
- * Version:	@(#)808x.c	1.0.20	2019/05/17
+ * Version:	@(#)808x.c	1.0.23	2019/07/03
  *
  * Authors:	Miran Grca, <mgrca8@gmail.com>
  *		Andrew Jenner (reenigne), <andrew@reenigne.org>
@@ -101,12 +101,19 @@ int		trap = 0;
 /* The current effective address's segment. */
 uint32_t	easeg;
 
-/* The prefetch queue (4 bytes for 8088, 6 bytes for 8086). */
-static uint8_t	pfq[6];
+/*
+ * The prefetch queue (4 bytes for 8088, 6 bytes for 8086.)
+ *
+ * This is kept as a small ring buffer, so taking a byte off the
+ * front of the queue does not have to move all the others down.
+ */
+#define PFQ_RING	8
+static uint8_t	pfq[PFQ_RING];
 
 /* Variables to aid with the prefetch queue operation. */
 static int	fetchcycles = 0,
-		pfq_pos = 0;
+		pfq_pos = 0,
+		pfq_head = 0;
 
 /* The IP equivalent of the current prefetch queue position. */
 static uint16_t pfq_ip;
@@ -287,7 +294,7 @@ makeznptable(void)
 
 
 /* Fetches the effective address from the prefetch queue according to MOD and R/M. */
-static void	pfq_add(int c);
+static void	pfq_fill(int d);
 static void	set_pzs(int bits);
 
 
@@ -307,13 +314,27 @@ irq_pending(void)
 }
 
 
-static void
+static __inline void
 cpu_wait(int c, int bus)
 {
+    int d;
+
     cycles -= c;
 
-    if (! bus)
-	pfq_add(c);
+    /*
+     * Non-bus cycles are used to fill the prefetch queue, one
+     * byte for every four cycles. This is done for (almost) all
+     * cycles, so only call out once there is a byte to fetch.
+     */
+    if (!bus && (c >= 0) && (pfq_pos < pfq_size)) {
+	d = c + (fetchcycles & 3);
+	if (d > 3)
+		pfq_fill(d);
+
+	fetchcycles += c;
+	if (fetchcycles > 16)
+		fetchcycles = 16;
+    }
 }
 
 
@@ -450,7 +471,7 @@ writememw(uint32_t s, uint32_t a, uint16_t v)
 }
 
 
-static void
+static __inline void
 pfq_write(void)
 {
     uint16_t tempw;
@@ -461,27 +482,24 @@ pfq_write(void)
 	   read more than one byte even on the 8086. */
 	if (is8086 && !(pfq_ip & 1) && !(pfq_pos & 1)) {
 		tempw = readmemwf(pfq_ip);
-		pfq[pfq_pos++] = (tempw & 0xff);
-		pfq[pfq_pos++] = (tempw >> 8);
+		pfq[(pfq_head + pfq_pos++) & (PFQ_RING - 1)] = (tempw & 0xff);
+		pfq[(pfq_head + pfq_pos++) & (PFQ_RING - 1)] = (tempw >> 8);
 		pfq_ip += 2;
     	} else {
-		pfq[pfq_pos] = readmembf(pfq_ip);
+		pfq[(pfq_head + pfq_pos++) & (PFQ_RING - 1)] = readmembf(pfq_ip);
 		pfq_ip++;
-		pfq_pos++;
 	}
     }
 }
 
 
-static uint8_t
+static __inline uint8_t
 pfq_read(void)
 {
-    uint8_t temp, i;
-
-    temp = pfq[0];
+    uint8_t temp;
 
-    for (i = 0; i < (pfq_size - 1); i++)
-	pfq[i] = pfq[i + 1];
+    temp = pfq[pfq_head];
+    pfq_head = (pfq_head + 1) & (PFQ_RING - 1);
     pfq_pos--;
 
     cpu_state.pc++;
@@ -492,7 +510,7 @@ pfq_read(void)
 
 /* Fetches a byte from the prefetch queue, or from memory if the queue has
    been drained. */
-static uint8_t
+static __inline uint8_t
 pfq_fetchb(void)
 {
     uint8_t temp;
@@ -526,23 +544,14 @@ pfq_fetchw(void)
 }
 
 
-/* Adds bytes to the prefetch queue based on the instruction's cycle count. */
+/* Adds bytes to the prefetch queue based on the available cycles. */
 static void
-pfq_add(int c)
+pfq_fill(int d)
 {
-    int d;
-    if (c < 0)
-	return;
-    if (pfq_pos >= pfq_size)
-	return;
-    d = c + (fetchcycles & 3);
     while ((d > 3) && (pfq_pos < pfq_size)) {
 	d -= 4;
 	pfq_write();
     }
-    fetchcycles += c;
-    if (fetchcycles > 16)
-	fetchcycles = 16;
 }
 
 
@@ -1447,6 +1456,167 @@ clear_ca(void)
 }
 
 
+/*
+ * Fast path for register operands.
+ *
+ * Most of the time of an instruction like "add ax,bx" is spent in a
+ * few internal (non-bus) waits, each of which may put bytes into the
+ * prefetch queue. Since nothing else happens between them, they can
+ * be done as a single wait, as long as we take care of the queue
+ * filling up halfway (which stops fetchcycles from being updated),
+ * and of fetchcycles hitting its limit of 16.
+ *
+ * The waits for each of these instructions are listed in a table,
+ * including the variable ones done through do_access(). Those depend
+ * on the cycle count modulo 3 or 4, so at reset we work out the
+ * actual waits for each value of the cycle count modulo 12. As that
+ * only holds while the count stays positive, the full decoder is used
+ * near the end of a time slice.
+ */
+#define FAST_ALU_R	0			/* alu r,rm / cmp */
+#define FAST_ALU_RM	1			/* alu rm,r */
+#define FAST_TEST	2			/* test rm,r */
+#define FAST_XCHG	3			/* xchg rm,r */
+#define FAST_MOV_RM	4			/* mov rm,r */
+#define FAST_MOV_R	5			/* mov r,rm */
+#define FAST_MAX	6
+
+#define FAST_MINCYCLES	16			/* more than any of the waits */
+
+#define W3(n)		(0x10 | (n))		/* n + (cycles % 3) */
+#define W4(n)		(0x20 | (n))		/* n + (cycles % 4) */
+
+static const uint8_t fast_waits[FAST_MAX][5] = {
+  { W3(2), 1, 1, 0 },			/* FAST_ALU_R */
+  { W3(2), 1, W3(3), 1, 0 },		/* FAST_ALU_RM */
+  { W4(1), 2, 2, 0 },			/* FAST_TEST */
+  { W4(1), 3, W3(4), 0 },		/* FAST_XCHG */
+  { 1, W3(4), 0 },			/* FAST_MOV_RM */
+  { W4(1), 1, 0 }			/* FAST_MOV_R */
+};
+
+int		cpu_808x_fast = 1;		/* use the fast path */
+static uint8_t	fast_tbl[FAST_MAX][12][6];	/* total, waits, 0 */
+static uint8_t	fast_fills[PFQ_RING][2];	/* fetches to fill the queue */
+
+/* Can we use the fast path for this instruction? */
+#define FAST_REG()	((cpu_mod == 3) && cpu_808x_fast && \
+			 (cycles >= FAST_MINCYCLES))
+
+
+/* Prepare the tables needed for the fast path. */
+static void
+makefasttable(void)
+{
+    const uint8_t *sp;
+    uint8_t *tp;
+    int c, i, r;
+
+    /* Work out the waits for each cycle count (modulo 12.) */
+    for (i = 0; i < FAST_MAX; i++) {
+	for (r = 0; r < 12; r++) {
+		tp = fast_tbl[i][r];
+		tp[0] = 0;
+		c = r + 12;
+		for (sp = fast_waits[i]; *sp != 0; sp++) {
+			*++tp = *sp & 0x0f;
+			if (*sp & 0x10)
+				*tp += (c % 3);
+			else if (*sp & 0x20)
+				*tp += (c % 4);
+			fast_tbl[i][r][0] += *tp;
+			c -= *tp;
+		}
+		*++tp = 0;
+	}
+    }
+
+    /*
+     * Work out the number of fetches needed to fill up the queue,
+     * for each queue position and IP parity (the 8086 may fetch two
+     * bytes at a time.)
+     */
+    for (i = 0; i < pfq_size; i++) {
+	for (r = 0; r < 2; r++) {
+		fast_fills[i][r] = 0;
+		for (c = i; c < pfq_size; fast_fills[i][r]++) {
+			if (is8086 && !((c - i + r) & 1) && !(c & 1))
+				c += 2;
+			else
+				c++;
+		}
+	}
+    }
+}
+
+
+/* Do the waits for an instruction, as a single one if that is exact. */
+static void
+fast_wait(int cls)
+{
+    const uint8_t *wp = fast_tbl[cls][cycles % 12];
+    const uint8_t *sp;
+    int c = wp[0];
+    int d, k, n;
+
+    /* With a full queue, nothing gets fetched at all. */
+    if (pfq_pos >= pfq_size) {
+	cycles -= c;
+	return;
+    }
+
+    /* The number of fetches it takes to fill up the queue. */
+    n = fast_fills[pfq_pos][pfq_ip & 1];
+
+    if ((fetchcycles + c) <= 16) {
+	/* We get one fetch for every four cycles. */
+	d = c + (fetchcycles & 3);
+	if (d < (n << 2)) {
+		cycles -= c;
+		pfq_fill(d);
+		fetchcycles += c;
+		return;
+	}
+
+	/*
+	 * The queue fills up during one of the waits, after
+	 * which fetchcycles is no longer updated.
+	 */
+	for (d = 0, sp = wp + 1; *sp != 0; sp++) {
+		d += *sp;
+		if ((d + (fetchcycles & 3)) >= (n << 2)) break;
+	}
+	cycles -= c;
+	pfq_fill(n << 2);
+	fetchcycles += d;
+	return;
+    }
+
+    /*
+     * Fetchcycles hits its cap during one of the waits. From
+     * then on, each of the waits only gets one fetch for every
+     * four cycles of its own.
+     */
+    for (d = 0, sp = wp + 1; (fetchcycles + d + *sp) < 16; sp++)
+	d += *sp;
+    d += *sp;
+    k = (d + (fetchcycles & 3)) >> 2;
+    while (*++sp != 0)
+	k += (*sp >> 2);
+
+    if (k < n) {
+	cycles -= c;
+	pfq_fill(k << 2);
+	fetchcycles = 16;
+	return;
+    }
+
+    /* Otherwise, just do them one by one. */
+    while (*++wp != 0)
+	cpu_wait(*wp, 0);
+}
+
+
 /* Executes instructions up to the specified number of cycles. */
 void
 execx86(int cycs)
@@ -1468,7 +1638,8 @@ execx86(int cycs)
 
 opcodestart:
 	if (halt) {
-		cpu_wait(2, 0);
+		/* Skip ahead to the next timer event, if nothing is pending. */
+		cpu_wait(takeint ? 2 : cpu_idle_cycles(2), 0);
 		goto on_halt;
 	}
 
@@ -1476,6 +1647,7 @@ opcodestart:
 		opcode = pfq_fetchb();
 		oldc = flags & C_FLAG;
 		trap = flags & T_FLAG;
+
 		cpu_wait(1, 0);
 
 #if 0
@@ -1528,12 +1700,31 @@ opcodestart:
 		case 0x38: case 0x39: case 0x3a: case 0x3b:
 			bits = 8 << (opcode & 1);
 			do_mod_rm();
+			cpu_alu_op = (opcode >> 3) & 7;
+			if (FAST_REG()) {
+				if (opcode & 2) {
+					cpu_dest = (opcode & 1) ? cpu_state.regs[cpu_reg].w : getr8(cpu_reg);
+					cpu_src = (opcode & 1) ? cpu_state.regs[cpu_rm].w : getr8(cpu_rm);
+				} else {
+					cpu_dest = (opcode & 1) ? cpu_state.regs[cpu_rm].w : getr8(cpu_rm);
+					cpu_src = (opcode & 1) ? cpu_state.regs[cpu_reg].w : getr8(cpu_reg);
+				}
+				alu_op(bits);
+				if (cpu_alu_op != 7) {
+					temp = (opcode & 2) ? cpu_reg : cpu_rm;
+					if (opcode & 1)
+						cpu_state.regs[temp].w = cpu_data;
+					else
+						setr8(temp, (uint8_t)(cpu_data & 0xff));
+				}
+				fast_wait(((opcode & 2) || (cpu_alu_op == 7)) ? FAST_ALU_R : FAST_ALU_RM);
+				break;
+			}
 			do_access(46, bits);
 			if (opcode & 1)
 				tempw = geteaw();
 			else
 				tempw = geteab();
-			cpu_alu_op = (opcode >> 3) & 7;
 			if ((opcode & 2) == 0) {
 				cpu_dest = tempw;
 				cpu_src = (opcode & 1) ? cpu_state.regs[cpu_reg].w : getr8(cpu_reg);
@@ -1788,6 +1979,14 @@ opcodestart:
 		case 0x85:
 			bits = 8 << (opcode & 1);
 			do_mod_rm();
+			if (FAST_REG()) {
+				if (opcode & 1)
+					do_test(bits, cpu_state.regs[cpu_rm].w, cpu_state.regs[cpu_reg].w);
+				else
+					do_test(bits, getr8(cpu_rm), getr8(cpu_reg));
+				fast_wait(FAST_TEST);
+				break;
+			}
 			do_access(48, bits);
 			if (opcode & 1) {
 				cpu_data = geteaw();
@@ -1805,6 +2004,19 @@ opcodestart:
 		case 0x87:
 			bits = 8 << (opcode & 1);
 			do_mod_rm();
+			if (FAST_REG()) {
+				if (opcode & 1) {
+					tempw = cpu_state.regs[cpu_rm].w;
+					cpu_state.regs[cpu_rm].w = cpu_state.regs[cpu_reg].w;
+					cpu_state.regs[cpu_reg].w = tempw;
+				} else {
+					temp = getr8(cpu_rm);
+					setr8(cpu_rm, getr8(cpu_reg));
+					setr8(cpu_reg, temp);
+				}
+				fast_wait(FAST_XCHG);
+				break;
+			}
 			do_access(49, bits);
 			if (opcode & 1) {
 				cpu_data = geteaw();
@@ -1827,6 +2039,14 @@ opcodestart:
 		case 0x89:
 			bits = 8 << (opcode & 1);
 			do_mod_rm();
+			if (FAST_REG()) {
+				if (opcode & 1)
+					cpu_state.regs[cpu_rm].w = cpu_state.regs[cpu_reg].w;
+				else
+					setr8(cpu_rm, getr8(cpu_reg));
+				fast_wait(FAST_MOV_RM);
+				break;
+			}
 			cpu_wait(1, 0);
 			do_access(13, bits);
 			if (opcode & 1)
@@ -1839,6 +2059,14 @@ opcodestart:
 		case 0x8b:
 			bits = 8 << (opcode & 1);
 			do_mod_rm();
+			if (FAST_REG()) {
+				if (opcode & 1)
+					cpu_state.regs[cpu_reg].w = cpu_state.regs[cpu_rm].w;
+				else
+					setr8(cpu_reg, getr8(cpu_rm));
+				fast_wait(FAST_MOV_R);
+				break;
+			}
 			do_access(50, bits);
 			if (opcode & 1)
 				cpu_state.regs[cpu_reg].w = geteaw();
@@ -2861,11 +3089,13 @@ cpu_reset(int hard)
 	makemod1table();
 	resetmcr();
 	pfq_clear();
+	fetchcycles = 0;
 	cpu_set_edx();
 	EAX = 0;
 	ESP = 0;
 	mmu_perm = 4;
 	pfq_size = (is8086) ? 6 : 4;
+	makefasttable();
     }
     takeint = 0;
 
@@ -8,7 +8,7 @@
  *
  *		Instruction parsing and generation.
  *
- * Version:	@(#)codegen.c	1.0.2	2018/05/06
+ * Version:	@(#)codegen.c	1.0.3	2019/06/12
  *
  * Authors:	Sarah Walker, <tommowalker@tommowalker.co.uk>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -63,3 +63,4 @@ void codegen_timing_set(codegen_timing_t *timing)
 }
 
 int codegen_in_recompile;
+uint32_t codegen_trace_pc = -1;
@@ -8,7 +8,7 @@
  *
  *		Definitions for the code generator.
  *
- * Version:	@(#)codegen.h	1.0.6	2019/05/17
+ * Version:	@(#)codegen.h	1.0.7	2019/06/12
  *
  * Authors:	Sarah Walker, <tommowalker@tommowalker.co.uk>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -131,6 +131,7 @@ extern codeblock_t	**codeblock_hash;
 
 extern int		cpu_block_end;
 extern uint32_t		codegen_endpc;
+extern uint32_t		codegen_trace_pc;	/* branch target being followed */
 
 /*Current physical page of block being recompiled. -1 if no recompilation taking place */
 extern int		block_current;
@@ -8,7 +8,7 @@
  *
  *		Miscellaneous Instructions.
  *
- * Version:	@(#)codegen_ops_jump.h	1.0.1	2018/02/14
+ * Version:	@(#)codegen_ops_jump.h	1.0.2	2019/06/12
  *
  * Authors:	Sarah Walker, <tommowalker@tommowalker.co.uk>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -35,6 +35,80 @@
  *   USA.
  */
 
+/*
+ * Superblocks.
+ *
+ * If a direct branch is taken while its block is being recompiled,
+ * and the target is a little further ahead in the same stretch of
+ * guest code, the block is not ended there. Instead, we continue with
+ * the instruction at the target, so the block becomes a trace along
+ * the path actually taken. The guest registers held in host registers
+ * and the lazy flags state then remain valid across the branch, and
+ * only the side exits have to leave the block.
+ */
+#define TRACE_MAX_BYTES	960		/* keep below the 1000 byte cap */
+
+static int
+codegen_trace_follow(uint32_t op_pc, uint32_t new_pc)
+{
+        codeblock_t *block = &codeblock[block_current];
+
+        if (! use32)
+                new_pc &= 0xffff;
+
+        /*Only follow forward branches, a loop ends the trace.*/
+        if (new_pc <= op_pc)
+                return 0;
+        if (((cs + new_pc) - block->pc) >= TRACE_MAX_BYTES)
+                return 0;
+        if (block_pos >= (BLOCK_MAX - 256))
+                return 0;
+
+        codegen_trace_pc = new_pc;
+
+        return 1;
+}
+
+/*Evaluate a Jcc condition code against the current guest flags.*/
+static int
+codegen_branch_taken(uint8_t opcode)
+{
+        int taken = 0;
+
+        switch (opcode & 0x0e)
+        {
+                case 0x00: /*JO*/
+                taken = VF_SET();
+                break;
+                case 0x02: /*JB*/
+                taken = CF_SET();
+                break;
+                case 0x04: /*JE*/
+                taken = ZF_SET();
+                break;
+                case 0x06: /*JBE*/
+                taken = CF_SET() || ZF_SET();
+                break;
+                case 0x08: /*JS*/
+                taken = NF_SET();
+                break;
+                case 0x0a: /*JP*/
+                taken = PF_SET();
+                break;
+                case 0x0c: /*JL*/
+                taken = (!NF_SET() != !VF_SET());
+                break;
+                case 0x0e: /*JLE*/
+                taken = ZF_SET() || (!NF_SET() != !VF_SET());
+                break;
+        }
+
+        if (opcode & 0x01)
+                taken = !taken;
+
+        return taken;
+}
+
 static uint32_t ropJMP_r8(uint8_t opcode, uint32_t fetchdat, uint32_t op_32, uint32_t op_pc, codeblock_t *block)
 {
         uint32_t offset = fetchdat & 0xff;
@@ -43,6 +117,7 @@ static uint32_t ropJMP_r8(uint8_t opcode, uint32_t fetchdat, uint32_t op_32, uin
                 offset |= 0xffffff00;
 
         STORE_IMM_ADDR_L((uintptr_t)&cpu_state.pc, op_pc+1+offset);
+        codegen_trace_follow(op_pc+1, op_pc+1+offset);
         
         return -1;
 }
@@ -52,6 +127,7 @@ static uint32_t ropJMP_r16(uint8_t opcode, uint32_t fetchdat, uint32_t op_32, ui
         uint16_t offset = fetchdat & 0xffff;
 
         STORE_IMM_ADDR_L((uintptr_t)&cpu_state.pc, (op_pc+2+offset) & 0xffff);
+        codegen_trace_follow(op_pc+2, (op_pc+2+offset) & 0xffff);
         
         return -1;
 }
@@ -61,6 +137,7 @@ static uint32_t ropJMP_r32(uint8_t opcode, uint32_t fetchdat, uint32_t op_32, ui
         uint32_t offset = fastreadl(cs + op_pc);
 
         STORE_IMM_ADDR_L((uintptr_t)&cpu_state.pc, op_pc+4+offset);
+        codegen_trace_follow(op_pc+4, op_pc+4+offset);
         
         return -1;
 }
@@ -251,6 +328,37 @@ static void BRANCH_COND_S(int pc_offset, uint32_t op_pc, uint32_t offset, int no
 }
 
 
+/*
+ * Generate a conditional branch. If the branch is taken right now,
+ * and we can follow it, the condition is inverted so that the
+ * fall-through path becomes the side exit, and the block continues
+ * at the branch target instead.
+ */
+static uint32_t
+BRANCH_COND(void (*func)(int pc_offset, uint32_t op_pc, uint32_t offset, int not),
+            uint8_t opcode, int pc_offset, uint32_t op_pc, uint32_t offset, int not)
+{
+        int bt;
+
+        if (codegen_branch_taken(opcode) &&
+            codegen_trace_follow(op_pc+pc_offset, op_pc+pc_offset+offset))
+        {
+                /*The taken path stays in the block, so it pays timing_bt.*/
+                bt = timing_bt;
+                timing_bt = 0;
+                func(pc_offset, op_pc, 0, !not);
+                timing_bt = bt;
+                codegen_block_cycles += bt;
+
+                return codegen_trace_pc;
+        }
+
+        func(pc_offset, op_pc, offset, not);
+
+        return op_pc+pc_offset;
+}
+
+
 #define ropBRANCH(name, func, not)                              \
 static uint32_t rop ## name(uint8_t opcode, uint32_t fetchdat,  \
                             uint32_t op_32, uint32_t op_pc,     \
@@ -261,9 +369,7 @@ static uint32_t rop ## name(uint8_t opcode, uint32_t fetchdat,  \
         if (offset & 0x80)                                      \
                 offset |= 0xffffff00;                           \
                                                                 \
-        func(1, op_pc, offset, not);                            \
-                                                                \
-        return op_pc+1;                                         \
+        return BRANCH_COND(func, opcode, 1, op_pc, offset, not); \
 }                                                               \
 static uint32_t rop ## name ## _w(uint8_t opcode,               \
                         uint32_t fetchdat, uint32_t op_32,      \
@@ -274,9 +380,7 @@ static uint32_t rop ## name ## _w(uint8_t opcode,               \
         if (offset & 0x8000)                                    \
                 offset |= 0xffff0000;                           \
                                                                 \
-        func(2, op_pc, offset, not);                            \
-                                                                \
-        return op_pc+2;                                         \
+        return BRANCH_COND(func, opcode, 2, op_pc, offset, not); \
 }                                                               \
 static uint32_t rop ## name ## _l(uint8_t opcode,               \
                         uint32_t fetchdat, uint32_t op_32,      \
@@ -284,9 +388,7 @@ static uint32_t rop ## name ## _l(uint8_t opcode,               \
 {                                                               \
         uint32_t offset = fastreadl(cs + op_pc);                \
                                                                 \
-        func(4, op_pc, offset, not);                            \
-                                                                \
-        return op_pc+4;                                         \
+        return BRANCH_COND(func, opcode, 4, op_pc, offset, not); \
 }
 
 ropBRANCH(JB,   BRANCH_COND_B, 0)
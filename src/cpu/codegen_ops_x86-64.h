@@ -8,7 +8,7 @@
  *
  *		Code generator definitions (64-bit)
  *
- * Version:	@(#)x86_ops_x86-64.h	1.0.2	2018/10/24
+ * Version:	@(#)x86_ops_x86-64.h	1.0.4	2019/07/03
  *
  * Authors:	Sarah Walker, <tommowalker@tommowalker.co.uk>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -80,10 +80,20 @@ static INLINE void call(codeblock_t *block, uintptr_t func)
 	}
 }
 
+/*
+ * R12-R15 (guest ESP, EBP, ESI and EDI) are callee-saved on both the
+ * SysV and Win64 ABIs, so they survive calls to helpers that do not
+ * modify the guest registers (memory accessors, flag evaluation.) Only
+ * R8-R11 have to be reloaded afterwards, which keeps the stack, frame
+ * and string registers in host registers for the whole block.
+ *
+ * This only holds as long as nothing updates one of those registers in
+ * cpu_state behind the back of its host copy. Code that does (such as
+ * SP_MODIFY) must clear its codegen_reg_loaded entry.
+ */
 static INLINE void call_long(uintptr_t func)
 {
         codegen_reg_loaded[0] = codegen_reg_loaded[1] = codegen_reg_loaded[2] = codegen_reg_loaded[3] = 0;
-        codegen_reg_loaded[4] = codegen_reg_loaded[5] = codegen_reg_loaded[6] = codegen_reg_loaded[7] = 0;
 
 	addbyte(0x48); /*MOV RAX, func*/
 	addbyte(0xb8);
@@ -220,7 +230,6 @@ static INLINE void load_param_3_reg_64(int reg)
 static INLINE void CALL_FUNC(uintptr_t func)
 {
         codegen_reg_loaded[0] = codegen_reg_loaded[1] = codegen_reg_loaded[2] = codegen_reg_loaded[3] = 0;
-        codegen_reg_loaded[4] = codegen_reg_loaded[5] = codegen_reg_loaded[6] = codegen_reg_loaded[7] = 0;
 
 	addbyte(0x48); /*MOV RAX, func*/
 	addbyte(0xb8);
@@ -3109,6 +3118,9 @@ static INLINE void LOAD_EBP_TO_EA(int off)
 
 static INLINE void SP_MODIFY(int off)
 {
+        /*ESP is updated in memory only, so the host copy is now stale*/
+        codegen_reg_loaded[REG_ESP] = 0;
+
         if (stack32)
         {
                 if (off < 0x80)
@@ -8,7 +8,7 @@
  *
  *		CPU type handler.
  *
- * Version:	@(#)cpu.c	1.0.14	2019/05/13
+ * Version:	@(#)cpu.c	1.0.16	2019/06/14
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Sarah Walker, <tommowalker@tommowalker.co.uk>
@@ -46,9 +46,11 @@
 #include "cpu.h"
 #include "../device.h"
 #include "../io.h"
+#include "../timer.h"
 #include "x86.h"
 #include "x86_ops.h"
 #include "../mem.h"
+#include "../devices/system/nmi.h"
 #include "../devices/system/pci.h"
 #ifdef USE_DYNAREC
 # include "codegen.h"
@@ -143,6 +145,15 @@ int		cpu_hasrdtsc,
 		cpu_hasCR4,
 		cpu_hasVME;
 
+/*
+ * Asynchronous events waiting to be delivered to the CPU.
+ *
+ * This is kept up to date by the PIC and the NMI logic, so the
+ * execution loops only have to test a single word after each
+ * instruction (or block) instead of polling every source.
+ */
+int		cpu_events = 0;
+
 uint64_t	tsc = 0;
 msr_t		msr;
 cr0_t		CR0;
@@ -1459,6 +1470,40 @@ cpu_get_speed(void)
 }
 
 
+/*
+ * The processor is halted, so nothing will happen until the next
+ * timer fires (or another thread raises an interrupt.) Rather than
+ * spinning through HLT a few cycles at a time, return the number of
+ * cycles to skip so we arrive right at the next timer deadline. We
+ * never skip more than 1ms of emulated time, to keep events coming
+ * in from the outside (keyboard, mouse, network) responsive.
+ */
+int
+cpu_idle_cycles(int min)
+{
+    tmrval_t left;
+    int max;
+
+    /* If an NMI is waiting to be serviced, do not delay it. */
+    if (nmi && nmi_enable)
+	return(min);
+
+    if (AT)
+	left = (timer_count - (timer_start - ((tmrval_t)cycles << TIMER_SHIFT))) >> TIMER_SHIFT;
+      else
+	left = (timer_count - (timer_start - ((tmrval_t)cycles * xt_cpu_multi))) / xt_cpu_multi;
+    left++;
+
+    max = cpu->rspeed / 1000;
+    if (left > max)
+	left = max;
+    if (left < min)
+	left = min;
+
+    return((int)left);
+}
+
+
 void
 cpu_update_waitstates(void)
 {
@@ -8,7 +8,7 @@
  *
  *		Definitions for the CPU module.
  *
- * Version:	@(#)cpu.h	1.0.14	2019/05/17
+ * Version:	@(#)cpu.h	1.0.17	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -167,6 +167,10 @@ extern const CPU	cpus_Pentium2D[];
 #define CR4_PVI		(1 << 1)
 #define CR4_PSE		(1 << 4)
 
+/* Pending asynchronous events, see cpu_events. */
+#define CPU_EVENT_IRQ	0x01			/* unmasked IRQ at the PIC */
+#define CPU_EVENT_NMI	0x02			/* NMI line asserted */
+
 #define CPL		((_cs.access>>5)&3)
 #define IOPL		((flags>>12)&3)
 #define IOPLp		((!(msw&1)) || (CPL<=IOPL))
@@ -335,6 +339,7 @@ extern int		cpu_dynarec;		/* dynamic recompiler enabled */
 extern int		cpu_busspeed;
 extern int		cpu_16bitbus;
 extern int		xt_cpu_multi;
+extern int		cpu_808x_fast;		/* 808x fast path enabled */
 extern int		cpu_cyrix_alignment;	/*Cyrix 5x86/6x86 only has data misalignment
 					  penalties when crossing 8-byte boundaries*/
 
@@ -347,6 +352,7 @@ extern int		cpu_hasCR4;
 extern int		cpu_hasVME;
 
 extern uint32_t		cpu_cur_status;
+extern int		cpu_events;		/* pending IRQ/NMI events */
 extern uint64_t		cpu_CR4_mask;
 extern uint64_t		tsc;
 extern msr_t		msr;
@@ -436,6 +442,7 @@ extern int	cpu_get_type(void);
 extern const char *cpu_get_name(void);
 extern int	cpu_set_speed(int new_speed);
 extern uint32_t	cpu_get_speed(void);
+extern int	cpu_idle_cycles(int min);
 extern int	cpu_get_flags(void);
 extern void	cpu_update_waitstates(void);
 extern char	*cpu_current_pc(char *bufp);
@@ -8,7 +8,7 @@
  *
  *		Definitions for the X86 architecture.
  *
- * Version:	@(#)x86.h	1.0.2	2019/05/17
+ * Version:	@(#)x86.h	1.0.4	2019/07/03
  *
  * Authors:	Sarah Walker, <tommowalker@tommowalker.co.uk>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -142,6 +142,8 @@ extern int inscounts[256];
 extern void x86illegal();
 
 extern void x86seg_reset();
+extern void x86seg_cache_flush(void);
+extern uint64_t x86seg_cache_hits, x86seg_cache_misses;
 extern void x86gpf(char *s, uint16_t error);
 
 extern uint16_t zero;
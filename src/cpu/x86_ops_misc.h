@@ -8,7 +8,7 @@
  *
  *		Miscellaneous x86 CPU Instructions.
  *
- * Version:	@(#)x86_ops_misc.h	1.0.5	2019/05/17
+ * Version:	@(#)x86_ops_misc.h	1.0.6	2019/06/13
  *
  * Authors:	Sarah Walker, <tommowalker@tommowalker.co.uk>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -632,7 +632,8 @@ static int opHLT(uint32_t fetchdat)
         }
         if (!((flags&I_FLAG) && pic_pending))
         {
-                CLOCK_CYCLES_ALWAYS(100);
+                /*Skip ahead to the next timer event.*/
+                CLOCK_CYCLES_ALWAYS(cpu_idle_cycles(100));
                 cpu_state.pc--;
         }
         else
@@ -8,7 +8,7 @@
  *
  *		Miscellaneous x86 CPU Instructions.
  *
- * Version:	@(#)x86_ops_mmx.h	1.0.1	2018/02/14
+ * Version:	@(#)x86_ops_mmx.h	1.0.3	2019/07/03
  *
  * Authors:	Sarah Walker, <tommowalker@tommowalker.co.uk>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -40,6 +40,42 @@
 #define USATB(val) (((val) < 0) ? 0 : (((val) > 255) ? 255 : (val)))
 #define USATW(val) (((val) < 0) ? 0 : (((val) > 65535) ? 65535 : (val)))
 
+/*
+ * If the host has SSE2, let it do the lane arithmetic for us. Almost
+ * every MMX operation has an SSE2 twin that does the same thing on the
+ * low 64 bits of an XMM register, saturation and all, so we can load
+ * both operands there, do the one instruction and store the low half
+ * back. The portable per-lane code is kept for all other hosts.
+ */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+# include <emmintrin.h>
+# define MMX_SSE2	1
+
+# define MMX_LOAD(r)		_mm_loadl_epi64((const __m128i *)&(r).q)
+# define MMX_STORE(r, v)	_mm_storel_epi64((__m128i *)&(r).q, (v))
+
+/* dst = op(dst, src) */
+# define MMX_SSE2_OP(op, src)						\
+	MMX_STORE(cpu_state.MM[cpu_reg],				\
+		  op(MMX_LOAD(cpu_state.MM[cpu_reg]), MMX_LOAD(src)))
+
+/* dst = op(dst, src), taking the high halves of the interleave. */
+# define MMX_SSE2_UNPCKH(op, src)					\
+	MMX_STORE(cpu_state.MM[cpu_reg],				\
+		  _mm_srli_si128(op(MMX_LOAD(cpu_state.MM[cpu_reg]),	\
+				    MMX_LOAD(src)), 8))
+
+/* dst = pack(dst:src), both packed into the low 64 bits. */
+# define MMX_SSE2_PACK(op, dst, src)					\
+	{ __m128i t = _mm_unpacklo_epi64(MMX_LOAD(dst), MMX_LOAD(src)); \
+	  MMX_STORE(cpu_state.MM[cpu_reg], op(t, t)); }
+
+/* reg = op(reg, shift), with out-of-range counts handled by the host. */
+# define MMX_SSE2_SHIFT(op, reg, shift)					\
+	MMX_STORE(cpu_state.MM[reg],					\
+		  op(MMX_LOAD(cpu_state.MM[reg]), _mm_cvtsi32_si128(shift)))
+#endif
+
 #define MMX_GETSRC()                                                            \
         if (cpu_mod == 3)                                                           \
         {                                                                       \
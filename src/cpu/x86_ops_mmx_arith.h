@@ -8,7 +8,7 @@
  *
  *		Miscellaneous x86 CPU Instructions.
  *
- * Version:	@(#)x86_ops_mmx_arith.h	1.0.1	2018/02/14
+ * Version:	@(#)x86_ops_mmx_arith.h	1.0.2	2019/06/18
  *
  * Authors:	Sarah Walker, <tommowalker@tommowalker.co.uk>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -43,6 +43,9 @@ static int opPADDB_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_add_epi8, src);
+#else
         cpu_state.MM[cpu_reg].b[0] += src.b[0];
         cpu_state.MM[cpu_reg].b[1] += src.b[1];
         cpu_state.MM[cpu_reg].b[2] += src.b[2];
@@ -51,6 +54,7 @@ static int opPADDB_a16(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[5] += src.b[5];
         cpu_state.MM[cpu_reg].b[6] += src.b[6];
         cpu_state.MM[cpu_reg].b[7] += src.b[7];
+#endif
 
         return 0;
 }
@@ -62,6 +66,9 @@ static int opPADDB_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_add_epi8, src);
+#else
         cpu_state.MM[cpu_reg].b[0] += src.b[0];
         cpu_state.MM[cpu_reg].b[1] += src.b[1];
         cpu_state.MM[cpu_reg].b[2] += src.b[2];
@@ -70,6 +77,7 @@ static int opPADDB_a32(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[5] += src.b[5];
         cpu_state.MM[cpu_reg].b[6] += src.b[6];
         cpu_state.MM[cpu_reg].b[7] += src.b[7];
+#endif
 
         return 0;
 }
@@ -82,10 +90,14 @@ static int opPADDW_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_add_epi16, src);
+#else
         cpu_state.MM[cpu_reg].w[0] += src.w[0];
         cpu_state.MM[cpu_reg].w[1] += src.w[1];
         cpu_state.MM[cpu_reg].w[2] += src.w[2];
         cpu_state.MM[cpu_reg].w[3] += src.w[3];
+#endif
 
         return 0;
 }
@@ -97,10 +109,14 @@ static int opPADDW_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_add_epi16, src);
+#else
         cpu_state.MM[cpu_reg].w[0] += src.w[0];
         cpu_state.MM[cpu_reg].w[1] += src.w[1];
         cpu_state.MM[cpu_reg].w[2] += src.w[2];
         cpu_state.MM[cpu_reg].w[3] += src.w[3];
+#endif
 
         return 0;
 }
@@ -113,8 +129,12 @@ static int opPADDD_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_add_epi32, src);
+#else
         cpu_state.MM[cpu_reg].l[0] += src.l[0];
         cpu_state.MM[cpu_reg].l[1] += src.l[1];
+#endif
 
         return 0;
 }
@@ -126,8 +146,12 @@ static int opPADDD_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_add_epi32, src);
+#else
         cpu_state.MM[cpu_reg].l[0] += src.l[0];
         cpu_state.MM[cpu_reg].l[1] += src.l[1];
+#endif
 
         return 0;
 }
@@ -140,6 +164,9 @@ static int opPADDSB_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_adds_epi8, src);
+#else
         cpu_state.MM[cpu_reg].sb[0] = SSATB(cpu_state.MM[cpu_reg].sb[0] + src.sb[0]);
         cpu_state.MM[cpu_reg].sb[1] = SSATB(cpu_state.MM[cpu_reg].sb[1] + src.sb[1]);
         cpu_state.MM[cpu_reg].sb[2] = SSATB(cpu_state.MM[cpu_reg].sb[2] + src.sb[2]);
@@ -148,6 +175,7 @@ static int opPADDSB_a16(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].sb[5] = SSATB(cpu_state.MM[cpu_reg].sb[5] + src.sb[5]);
         cpu_state.MM[cpu_reg].sb[6] = SSATB(cpu_state.MM[cpu_reg].sb[6] + src.sb[6]);
         cpu_state.MM[cpu_reg].sb[7] = SSATB(cpu_state.MM[cpu_reg].sb[7] + src.sb[7]);
+#endif
 
         return 0;
 }
@@ -159,6 +187,9 @@ static int opPADDSB_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_adds_epi8, src);
+#else
         cpu_state.MM[cpu_reg].sb[0] = SSATB(cpu_state.MM[cpu_reg].sb[0] + src.sb[0]);
         cpu_state.MM[cpu_reg].sb[1] = SSATB(cpu_state.MM[cpu_reg].sb[1] + src.sb[1]);
         cpu_state.MM[cpu_reg].sb[2] = SSATB(cpu_state.MM[cpu_reg].sb[2] + src.sb[2]);
@@ -167,6 +198,7 @@ static int opPADDSB_a32(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].sb[5] = SSATB(cpu_state.MM[cpu_reg].sb[5] + src.sb[5]);
         cpu_state.MM[cpu_reg].sb[6] = SSATB(cpu_state.MM[cpu_reg].sb[6] + src.sb[6]);
         cpu_state.MM[cpu_reg].sb[7] = SSATB(cpu_state.MM[cpu_reg].sb[7] + src.sb[7]);
+#endif
 
         return 0;
 }
@@ -179,6 +211,9 @@ static int opPADDUSB_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_adds_epu8, src);
+#else
         cpu_state.MM[cpu_reg].b[0] = USATB(cpu_state.MM[cpu_reg].b[0] + src.b[0]);
         cpu_state.MM[cpu_reg].b[1] = USATB(cpu_state.MM[cpu_reg].b[1] + src.b[1]);
         cpu_state.MM[cpu_reg].b[2] = USATB(cpu_state.MM[cpu_reg].b[2] + src.b[2]);
@@ -187,6 +222,7 @@ static int opPADDUSB_a16(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[5] = USATB(cpu_state.MM[cpu_reg].b[5] + src.b[5]);
         cpu_state.MM[cpu_reg].b[6] = USATB(cpu_state.MM[cpu_reg].b[6] + src.b[6]);
         cpu_state.MM[cpu_reg].b[7] = USATB(cpu_state.MM[cpu_reg].b[7] + src.b[7]);
+#endif
 
         return 0;
 }
@@ -198,6 +234,9 @@ static int opPADDUSB_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_adds_epu8, src);
+#else
         cpu_state.MM[cpu_reg].b[0] = USATB(cpu_state.MM[cpu_reg].b[0] + src.b[0]);
         cpu_state.MM[cpu_reg].b[1] = USATB(cpu_state.MM[cpu_reg].b[1] + src.b[1]);
         cpu_state.MM[cpu_reg].b[2] = USATB(cpu_state.MM[cpu_reg].b[2] + src.b[2]);
@@ -206,6 +245,7 @@ static int opPADDUSB_a32(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[5] = USATB(cpu_state.MM[cpu_reg].b[5] + src.b[5]);
         cpu_state.MM[cpu_reg].b[6] = USATB(cpu_state.MM[cpu_reg].b[6] + src.b[6]);
         cpu_state.MM[cpu_reg].b[7] = USATB(cpu_state.MM[cpu_reg].b[7] + src.b[7]);
+#endif
 
         return 0;
 }
@@ -218,10 +258,14 @@ static int opPADDSW_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_adds_epi16, src);
+#else
         cpu_state.MM[cpu_reg].sw[0] = SSATW(cpu_state.MM[cpu_reg].sw[0] + src.sw[0]);
         cpu_state.MM[cpu_reg].sw[1] = SSATW(cpu_state.MM[cpu_reg].sw[1] + src.sw[1]);
         cpu_state.MM[cpu_reg].sw[2] = SSATW(cpu_state.MM[cpu_reg].sw[2] + src.sw[2]);
         cpu_state.MM[cpu_reg].sw[3] = SSATW(cpu_state.MM[cpu_reg].sw[3] + src.sw[3]);
+#endif
 
         return 0;
 }
@@ -233,10 +277,14 @@ static int opPADDSW_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_adds_epi16, src);
+#else
         cpu_state.MM[cpu_reg].sw[0] = SSATW(cpu_state.MM[cpu_reg].sw[0] + src.sw[0]);
         cpu_state.MM[cpu_reg].sw[1] = SSATW(cpu_state.MM[cpu_reg].sw[1] + src.sw[1]);
         cpu_state.MM[cpu_reg].sw[2] = SSATW(cpu_state.MM[cpu_reg].sw[2] + src.sw[2]);
         cpu_state.MM[cpu_reg].sw[3] = SSATW(cpu_state.MM[cpu_reg].sw[3] + src.sw[3]);
+#endif
 
         return 0;
 }
@@ -249,10 +297,14 @@ static int opPADDUSW_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_adds_epu16, src);
+#else
         cpu_state.MM[cpu_reg].w[0] = USATW(cpu_state.MM[cpu_reg].w[0] + src.w[0]);
         cpu_state.MM[cpu_reg].w[1] = USATW(cpu_state.MM[cpu_reg].w[1] + src.w[1]);
         cpu_state.MM[cpu_reg].w[2] = USATW(cpu_state.MM[cpu_reg].w[2] + src.w[2]);
         cpu_state.MM[cpu_reg].w[3] = USATW(cpu_state.MM[cpu_reg].w[3] + src.w[3]);
+#endif
 
         return 0;
 }
@@ -264,10 +316,14 @@ static int opPADDUSW_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_adds_epu16, src);
+#else
         cpu_state.MM[cpu_reg].w[0] = USATW(cpu_state.MM[cpu_reg].w[0] + src.w[0]);
         cpu_state.MM[cpu_reg].w[1] = USATW(cpu_state.MM[cpu_reg].w[1] + src.w[1]);
         cpu_state.MM[cpu_reg].w[2] = USATW(cpu_state.MM[cpu_reg].w[2] + src.w[2]);
         cpu_state.MM[cpu_reg].w[3] = USATW(cpu_state.MM[cpu_reg].w[3] + src.w[3]);
+#endif
 
         return 0;
 }
@@ -280,6 +336,9 @@ static int opPMADDWD_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_madd_epi16, src);
+#else
         if (cpu_state.MM[cpu_reg].l[0] == 0x80008000 && src.l[0] == 0x80008000)
                 cpu_state.MM[cpu_reg].l[0] = 0x80000000;
         else
@@ -289,7 +348,8 @@ static int opPMADDWD_a16(uint32_t fetchdat)
                 cpu_state.MM[cpu_reg].l[1] = 0x80000000;
         else
                 cpu_state.MM[cpu_reg].sl[1] = ((int32_t)cpu_state.MM[cpu_reg].sw[2] * (int32_t)src.sw[2]) + ((int32_t)cpu_state.MM[cpu_reg].sw[3] * (int32_t)src.sw[3]);
-        
+#endif
+
         return 0;
 }
 static int opPMADDWD_a32(uint32_t fetchdat)
@@ -300,6 +360,9 @@ static int opPMADDWD_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_madd_epi16, src);
+#else
         if (cpu_state.MM[cpu_reg].l[0] == 0x80008000 && src.l[0] == 0x80008000)
                 cpu_state.MM[cpu_reg].l[0] = 0x80000000;
         else
@@ -309,7 +372,8 @@ static int opPMADDWD_a32(uint32_t fetchdat)
                 cpu_state.MM[cpu_reg].l[1] = 0x80000000;
         else
                 cpu_state.MM[cpu_reg].sl[1] = ((int32_t)cpu_state.MM[cpu_reg].sw[2] * (int32_t)src.sw[2]) + ((int32_t)cpu_state.MM[cpu_reg].sw[3] * (int32_t)src.sw[3]);
-        
+#endif
+
         return 0;
 }
 
@@ -321,10 +385,14 @@ static int opPMULLW_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         if (cpu_mod == 3)
         {
+#ifdef MMX_SSE2
+                MMX_SSE2_OP(_mm_mullo_epi16, cpu_state.MM[cpu_rm]);
+#else
                 cpu_state.MM[cpu_reg].w[0] *= cpu_state.MM[cpu_rm].w[0];
                 cpu_state.MM[cpu_reg].w[1] *= cpu_state.MM[cpu_rm].w[1];
                 cpu_state.MM[cpu_reg].w[2] *= cpu_state.MM[cpu_rm].w[2];
                 cpu_state.MM[cpu_reg].w[3] *= cpu_state.MM[cpu_rm].w[3];
+#endif
                 CLOCK_CYCLES(1);
         }
         else
@@ -333,10 +401,14 @@ static int opPMULLW_a16(uint32_t fetchdat)
         
                 src.l[0] = readmeml(easeg, cpu_state.eaaddr);
                 src.l[1] = readmeml(easeg, cpu_state.eaaddr + 4); if (cpu_state.abrt) return 0;
+#ifdef MMX_SSE2
+                MMX_SSE2_OP(_mm_mullo_epi16, src);
+#else
                 cpu_state.MM[cpu_reg].w[0] *= src.w[0];
                 cpu_state.MM[cpu_reg].w[1] *= src.w[1];
                 cpu_state.MM[cpu_reg].w[2] *= src.w[2];
                 cpu_state.MM[cpu_reg].w[3] *= src.w[3];
+#endif
                 CLOCK_CYCLES(2);
         }
         return 0;
@@ -348,10 +420,14 @@ static int opPMULLW_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         if (cpu_mod == 3)
         {
+#ifdef MMX_SSE2
+                MMX_SSE2_OP(_mm_mullo_epi16, cpu_state.MM[cpu_rm]);
+#else
                 cpu_state.MM[cpu_reg].w[0] *= cpu_state.MM[cpu_rm].w[0];
                 cpu_state.MM[cpu_reg].w[1] *= cpu_state.MM[cpu_rm].w[1];
                 cpu_state.MM[cpu_reg].w[2] *= cpu_state.MM[cpu_rm].w[2];
                 cpu_state.MM[cpu_reg].w[3] *= cpu_state.MM[cpu_rm].w[3];
+#endif
                 CLOCK_CYCLES(1);
         }
         else
@@ -360,10 +436,14 @@ static int opPMULLW_a32(uint32_t fetchdat)
         
                 src.l[0] = readmeml(easeg, cpu_state.eaaddr);
                 src.l[1] = readmeml(easeg, cpu_state.eaaddr + 4); if (cpu_state.abrt) return 0;
+#ifdef MMX_SSE2
+                MMX_SSE2_OP(_mm_mullo_epi16, src);
+#else
                 cpu_state.MM[cpu_reg].w[0] *= src.w[0];
                 cpu_state.MM[cpu_reg].w[1] *= src.w[1];
                 cpu_state.MM[cpu_reg].w[2] *= src.w[2];
                 cpu_state.MM[cpu_reg].w[3] *= src.w[3];
+#endif
                 CLOCK_CYCLES(2);
         }
         return 0;
@@ -376,10 +456,14 @@ static int opPMULHW_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         if (cpu_mod == 3)
         {
+#ifdef MMX_SSE2
+                MMX_SSE2_OP(_mm_mulhi_epi16, cpu_state.MM[cpu_rm]);
+#else
                 cpu_state.MM[cpu_reg].w[0] = ((int32_t)cpu_state.MM[cpu_reg].sw[0] * (int32_t)cpu_state.MM[cpu_rm].sw[0]) >> 16;
                 cpu_state.MM[cpu_reg].w[1] = ((int32_t)cpu_state.MM[cpu_reg].sw[1] * (int32_t)cpu_state.MM[cpu_rm].sw[1]) >> 16;
                 cpu_state.MM[cpu_reg].w[2] = ((int32_t)cpu_state.MM[cpu_reg].sw[2] * (int32_t)cpu_state.MM[cpu_rm].sw[2]) >> 16;
                 cpu_state.MM[cpu_reg].w[3] = ((int32_t)cpu_state.MM[cpu_reg].sw[3] * (int32_t)cpu_state.MM[cpu_rm].sw[3]) >> 16;
+#endif
                 CLOCK_CYCLES(1);
         }
         else
@@ -388,10 +472,14 @@ static int opPMULHW_a16(uint32_t fetchdat)
         
                 src.l[0] = readmeml(easeg, cpu_state.eaaddr);
                 src.l[1] = readmeml(easeg, cpu_state.eaaddr + 4); if (cpu_state.abrt) return 0;
+#ifdef MMX_SSE2
+                MMX_SSE2_OP(_mm_mulhi_epi16, src);
+#else
                 cpu_state.MM[cpu_reg].w[0] = ((int32_t)cpu_state.MM[cpu_reg].sw[0] * (int32_t)src.sw[0]) >> 16;
                 cpu_state.MM[cpu_reg].w[1] = ((int32_t)cpu_state.MM[cpu_reg].sw[1] * (int32_t)src.sw[1]) >> 16;
                 cpu_state.MM[cpu_reg].w[2] = ((int32_t)cpu_state.MM[cpu_reg].sw[2] * (int32_t)src.sw[2]) >> 16;
                 cpu_state.MM[cpu_reg].w[3] = ((int32_t)cpu_state.MM[cpu_reg].sw[3] * (int32_t)src.sw[3]) >> 16;
+#endif
                 CLOCK_CYCLES(2);
         }
         return 0;
@@ -403,10 +491,14 @@ static int opPMULHW_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         if (cpu_mod == 3)
         {
+#ifdef MMX_SSE2
+                MMX_SSE2_OP(_mm_mulhi_epi16, cpu_state.MM[cpu_rm]);
+#else
                 cpu_state.MM[cpu_reg].w[0] = ((int32_t)cpu_state.MM[cpu_reg].sw[0] * (int32_t)cpu_state.MM[cpu_rm].sw[0]) >> 16;
                 cpu_state.MM[cpu_reg].w[1] = ((int32_t)cpu_state.MM[cpu_reg].sw[1] * (int32_t)cpu_state.MM[cpu_rm].sw[1]) >> 16;
                 cpu_state.MM[cpu_reg].w[2] = ((int32_t)cpu_state.MM[cpu_reg].sw[2] * (int32_t)cpu_state.MM[cpu_rm].sw[2]) >> 16;
                 cpu_state.MM[cpu_reg].w[3] = ((int32_t)cpu_state.MM[cpu_reg].sw[3] * (int32_t)cpu_state.MM[cpu_rm].sw[3]) >> 16;
+#endif
                 CLOCK_CYCLES(1);
         }
         else
@@ -415,10 +507,14 @@ static int opPMULHW_a32(uint32_t fetchdat)
         
                 src.l[0] = readmeml(easeg, cpu_state.eaaddr);
                 src.l[1] = readmeml(easeg, cpu_state.eaaddr + 4); if (cpu_state.abrt) return 0;
+#ifdef MMX_SSE2
+                MMX_SSE2_OP(_mm_mulhi_epi16, src);
+#else
                 cpu_state.MM[cpu_reg].w[0] = ((int32_t)cpu_state.MM[cpu_reg].sw[0] * (int32_t)src.sw[0]) >> 16;
                 cpu_state.MM[cpu_reg].w[1] = ((int32_t)cpu_state.MM[cpu_reg].sw[1] * (int32_t)src.sw[1]) >> 16;
                 cpu_state.MM[cpu_reg].w[2] = ((int32_t)cpu_state.MM[cpu_reg].sw[2] * (int32_t)src.sw[2]) >> 16;
                 cpu_state.MM[cpu_reg].w[3] = ((int32_t)cpu_state.MM[cpu_reg].sw[3] * (int32_t)src.sw[3]) >> 16;
+#endif
                 CLOCK_CYCLES(2);
         }
         return 0;
@@ -432,6 +528,9 @@ static int opPSUBB_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_sub_epi8, src);
+#else
         cpu_state.MM[cpu_reg].b[0] -= src.b[0];
         cpu_state.MM[cpu_reg].b[1] -= src.b[1];
         cpu_state.MM[cpu_reg].b[2] -= src.b[2];
@@ -440,6 +539,7 @@ static int opPSUBB_a16(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[5] -= src.b[5];
         cpu_state.MM[cpu_reg].b[6] -= src.b[6];
         cpu_state.MM[cpu_reg].b[7] -= src.b[7];
+#endif
 
         return 0;
 }
@@ -451,6 +551,9 @@ static int opPSUBB_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_sub_epi8, src);
+#else
         cpu_state.MM[cpu_reg].b[0] -= src.b[0];
         cpu_state.MM[cpu_reg].b[1] -= src.b[1];
         cpu_state.MM[cpu_reg].b[2] -= src.b[2];
@@ -459,6 +562,7 @@ static int opPSUBB_a32(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[5] -= src.b[5];
         cpu_state.MM[cpu_reg].b[6] -= src.b[6];
         cpu_state.MM[cpu_reg].b[7] -= src.b[7];
+#endif
 
         return 0;
 }
@@ -471,10 +575,14 @@ static int opPSUBW_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_sub_epi16, src);
+#else
         cpu_state.MM[cpu_reg].w[0] -= src.w[0];
         cpu_state.MM[cpu_reg].w[1] -= src.w[1];
         cpu_state.MM[cpu_reg].w[2] -= src.w[2];
         cpu_state.MM[cpu_reg].w[3] -= src.w[3];
+#endif
 
         return 0;
 }
@@ -486,10 +594,14 @@ static int opPSUBW_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_sub_epi16, src);
+#else
         cpu_state.MM[cpu_reg].w[0] -= src.w[0];
         cpu_state.MM[cpu_reg].w[1] -= src.w[1];
         cpu_state.MM[cpu_reg].w[2] -= src.w[2];
         cpu_state.MM[cpu_reg].w[3] -= src.w[3];
+#endif
 
         return 0;
 }
@@ -502,8 +614,12 @@ static int opPSUBD_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_sub_epi32, src);
+#else
         cpu_state.MM[cpu_reg].l[0] -= src.l[0];
         cpu_state.MM[cpu_reg].l[1] -= src.l[1];
+#endif
 
         return 0;
 }
@@ -515,8 +631,12 @@ static int opPSUBD_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_sub_epi32, src);
+#else
         cpu_state.MM[cpu_reg].l[0] -= src.l[0];
         cpu_state.MM[cpu_reg].l[1] -= src.l[1];
+#endif
 
         return 0;
 }
@@ -529,6 +649,9 @@ static int opPSUBSB_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_subs_epi8, src);
+#else
         cpu_state.MM[cpu_reg].sb[0] = SSATB(cpu_state.MM[cpu_reg].sb[0] - src.sb[0]);
         cpu_state.MM[cpu_reg].sb[1] = SSATB(cpu_state.MM[cpu_reg].sb[1] - src.sb[1]);
         cpu_state.MM[cpu_reg].sb[2] = SSATB(cpu_state.MM[cpu_reg].sb[2] - src.sb[2]);
@@ -537,6 +660,7 @@ static int opPSUBSB_a16(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].sb[5] = SSATB(cpu_state.MM[cpu_reg].sb[5] - src.sb[5]);
         cpu_state.MM[cpu_reg].sb[6] = SSATB(cpu_state.MM[cpu_reg].sb[6] - src.sb[6]);
         cpu_state.MM[cpu_reg].sb[7] = SSATB(cpu_state.MM[cpu_reg].sb[7] - src.sb[7]);
+#endif
 
         return 0;
 }
@@ -548,6 +672,9 @@ static int opPSUBSB_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_subs_epi8, src);
+#else
         cpu_state.MM[cpu_reg].sb[0] = SSATB(cpu_state.MM[cpu_reg].sb[0] - src.sb[0]);
         cpu_state.MM[cpu_reg].sb[1] = SSATB(cpu_state.MM[cpu_reg].sb[1] - src.sb[1]);
         cpu_state.MM[cpu_reg].sb[2] = SSATB(cpu_state.MM[cpu_reg].sb[2] - src.sb[2]);
@@ -556,6 +683,7 @@ static int opPSUBSB_a32(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].sb[5] = SSATB(cpu_state.MM[cpu_reg].sb[5] - src.sb[5]);
         cpu_state.MM[cpu_reg].sb[6] = SSATB(cpu_state.MM[cpu_reg].sb[6] - src.sb[6]);
         cpu_state.MM[cpu_reg].sb[7] = SSATB(cpu_state.MM[cpu_reg].sb[7] - src.sb[7]);
+#endif
 
         return 0;
 }
@@ -568,6 +696,9 @@ static int opPSUBUSB_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_subs_epu8, src);
+#else
         cpu_state.MM[cpu_reg].b[0] = USATB(cpu_state.MM[cpu_reg].b[0] - src.b[0]);
         cpu_state.MM[cpu_reg].b[1] = USATB(cpu_state.MM[cpu_reg].b[1] - src.b[1]);
         cpu_state.MM[cpu_reg].b[2] = USATB(cpu_state.MM[cpu_reg].b[2] - src.b[2]);
@@ -576,6 +707,7 @@ static int opPSUBUSB_a16(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[5] = USATB(cpu_state.MM[cpu_reg].b[5] - src.b[5]);
         cpu_state.MM[cpu_reg].b[6] = USATB(cpu_state.MM[cpu_reg].b[6] - src.b[6]);
         cpu_state.MM[cpu_reg].b[7] = USATB(cpu_state.MM[cpu_reg].b[7] - src.b[7]);
+#endif
 
         return 0;
 }
@@ -587,6 +719,9 @@ static int opPSUBUSB_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_subs_epu8, src);
+#else
         cpu_state.MM[cpu_reg].b[0] = USATB(cpu_state.MM[cpu_reg].b[0] - src.b[0]);
         cpu_state.MM[cpu_reg].b[1] = USATB(cpu_state.MM[cpu_reg].b[1] - src.b[1]);
         cpu_state.MM[cpu_reg].b[2] = USATB(cpu_state.MM[cpu_reg].b[2] - src.b[2]);
@@ -595,6 +730,7 @@ static int opPSUBUSB_a32(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[5] = USATB(cpu_state.MM[cpu_reg].b[5] - src.b[5]);
         cpu_state.MM[cpu_reg].b[6] = USATB(cpu_state.MM[cpu_reg].b[6] - src.b[6]);
         cpu_state.MM[cpu_reg].b[7] = USATB(cpu_state.MM[cpu_reg].b[7] - src.b[7]);
+#endif
 
         return 0;
 }
@@ -607,10 +743,14 @@ static int opPSUBSW_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_subs_epi16, src);
+#else
         cpu_state.MM[cpu_reg].sw[0] = SSATW(cpu_state.MM[cpu_reg].sw[0] - src.sw[0]);
         cpu_state.MM[cpu_reg].sw[1] = SSATW(cpu_state.MM[cpu_reg].sw[1] - src.sw[1]);
         cpu_state.MM[cpu_reg].sw[2] = SSATW(cpu_state.MM[cpu_reg].sw[2] - src.sw[2]);
         cpu_state.MM[cpu_reg].sw[3] = SSATW(cpu_state.MM[cpu_reg].sw[3] - src.sw[3]);
+#endif
 
         return 0;
 }
@@ -622,10 +762,14 @@ static int opPSUBSW_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_subs_epi16, src);
+#else
         cpu_state.MM[cpu_reg].sw[0] = SSATW(cpu_state.MM[cpu_reg].sw[0] - src.sw[0]);
         cpu_state.MM[cpu_reg].sw[1] = SSATW(cpu_state.MM[cpu_reg].sw[1] - src.sw[1]);
         cpu_state.MM[cpu_reg].sw[2] = SSATW(cpu_state.MM[cpu_reg].sw[2] - src.sw[2]);
         cpu_state.MM[cpu_reg].sw[3] = SSATW(cpu_state.MM[cpu_reg].sw[3] - src.sw[3]);
+#endif
 
         return 0;
 }
@@ -638,10 +782,14 @@ static int opPSUBUSW_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_subs_epu16, src);
+#else
         cpu_state.MM[cpu_reg].w[0] = USATW(cpu_state.MM[cpu_reg].w[0] - src.w[0]);
         cpu_state.MM[cpu_reg].w[1] = USATW(cpu_state.MM[cpu_reg].w[1] - src.w[1]);
         cpu_state.MM[cpu_reg].w[2] = USATW(cpu_state.MM[cpu_reg].w[2] - src.w[2]);
         cpu_state.MM[cpu_reg].w[3] = USATW(cpu_state.MM[cpu_reg].w[3] - src.w[3]);
+#endif
 
         return 0;
 }
@@ -653,10 +801,14 @@ static int opPSUBUSW_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
         
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_subs_epu16, src);
+#else
         cpu_state.MM[cpu_reg].w[0] = USATW(cpu_state.MM[cpu_reg].w[0] - src.w[0]);
         cpu_state.MM[cpu_reg].w[1] = USATW(cpu_state.MM[cpu_reg].w[1] - src.w[1]);
         cpu_state.MM[cpu_reg].w[2] = USATW(cpu_state.MM[cpu_reg].w[2] - src.w[2]);
         cpu_state.MM[cpu_reg].w[3] = USATW(cpu_state.MM[cpu_reg].w[3] - src.w[3]);
+#endif
 
         return 0;
 }
@@ -8,7 +8,7 @@
  *
  *		Miscellaneous x86 CPU Instructions.
  *
- * Version:	@(#)x86_ops_mmx_cmp.h	1.0.1	2018/02/14
+ * Version:	@(#)x86_ops_mmx_cmp.h	1.0.2	2019/06/18
  *
  * Authors:	Sarah Walker, <tommowalker@tommowalker.co.uk>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -44,6 +44,9 @@ static int opPCMPEQB_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_cmpeq_epi8, src);
+#else
         cpu_state.MM[cpu_reg].b[0] = (cpu_state.MM[cpu_reg].b[0] == src.b[0]) ? 0xff : 0;
         cpu_state.MM[cpu_reg].b[1] = (cpu_state.MM[cpu_reg].b[1] == src.b[1]) ? 0xff : 0;
         cpu_state.MM[cpu_reg].b[2] = (cpu_state.MM[cpu_reg].b[2] == src.b[2]) ? 0xff : 0;
@@ -52,7 +55,8 @@ static int opPCMPEQB_a16(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[5] = (cpu_state.MM[cpu_reg].b[5] == src.b[5]) ? 0xff : 0;
         cpu_state.MM[cpu_reg].b[6] = (cpu_state.MM[cpu_reg].b[6] == src.b[6]) ? 0xff : 0;
         cpu_state.MM[cpu_reg].b[7] = (cpu_state.MM[cpu_reg].b[7] == src.b[7]) ? 0xff : 0;
-        
+#endif
+
         return 0;
 }
 static int opPCMPEQB_a32(uint32_t fetchdat)
@@ -64,6 +68,9 @@ static int opPCMPEQB_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_cmpeq_epi8, src);
+#else
         cpu_state.MM[cpu_reg].b[0] = (cpu_state.MM[cpu_reg].b[0] == src.b[0]) ? 0xff : 0;
         cpu_state.MM[cpu_reg].b[1] = (cpu_state.MM[cpu_reg].b[1] == src.b[1]) ? 0xff : 0;
         cpu_state.MM[cpu_reg].b[2] = (cpu_state.MM[cpu_reg].b[2] == src.b[2]) ? 0xff : 0;
@@ -72,7 +79,8 @@ static int opPCMPEQB_a32(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[5] = (cpu_state.MM[cpu_reg].b[5] == src.b[5]) ? 0xff : 0;
         cpu_state.MM[cpu_reg].b[6] = (cpu_state.MM[cpu_reg].b[6] == src.b[6]) ? 0xff : 0;
         cpu_state.MM[cpu_reg].b[7] = (cpu_state.MM[cpu_reg].b[7] == src.b[7]) ? 0xff : 0;
-        
+#endif
+
         return 0;
 }
 
@@ -85,6 +93,9 @@ static int opPCMPGTB_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_cmpgt_epi8, src);
+#else
         cpu_state.MM[cpu_reg].b[0] = (cpu_state.MM[cpu_reg].sb[0] > src.sb[0]) ? 0xff : 0;
         cpu_state.MM[cpu_reg].b[1] = (cpu_state.MM[cpu_reg].sb[1] > src.sb[1]) ? 0xff : 0;
         cpu_state.MM[cpu_reg].b[2] = (cpu_state.MM[cpu_reg].sb[2] > src.sb[2]) ? 0xff : 0;
@@ -93,7 +104,8 @@ static int opPCMPGTB_a16(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[5] = (cpu_state.MM[cpu_reg].sb[5] > src.sb[5]) ? 0xff : 0;
         cpu_state.MM[cpu_reg].b[6] = (cpu_state.MM[cpu_reg].sb[6] > src.sb[6]) ? 0xff : 0;
         cpu_state.MM[cpu_reg].b[7] = (cpu_state.MM[cpu_reg].sb[7] > src.sb[7]) ? 0xff : 0;
-        
+#endif
+
         return 0;
 }
 static int opPCMPGTB_a32(uint32_t fetchdat)
@@ -105,6 +117,9 @@ static int opPCMPGTB_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_cmpgt_epi8, src);
+#else
         cpu_state.MM[cpu_reg].b[0] = (cpu_state.MM[cpu_reg].sb[0] > src.sb[0]) ? 0xff : 0;
         cpu_state.MM[cpu_reg].b[1] = (cpu_state.MM[cpu_reg].sb[1] > src.sb[1]) ? 0xff : 0;
         cpu_state.MM[cpu_reg].b[2] = (cpu_state.MM[cpu_reg].sb[2] > src.sb[2]) ? 0xff : 0;
@@ -113,7 +128,8 @@ static int opPCMPGTB_a32(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[5] = (cpu_state.MM[cpu_reg].sb[5] > src.sb[5]) ? 0xff : 0;
         cpu_state.MM[cpu_reg].b[6] = (cpu_state.MM[cpu_reg].sb[6] > src.sb[6]) ? 0xff : 0;
         cpu_state.MM[cpu_reg].b[7] = (cpu_state.MM[cpu_reg].sb[7] > src.sb[7]) ? 0xff : 0;
-        
+#endif
+
         return 0;
 }
 
@@ -126,11 +142,15 @@ static int opPCMPEQW_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_cmpeq_epi16, src);
+#else
         cpu_state.MM[cpu_reg].w[0] = (cpu_state.MM[cpu_reg].w[0] == src.w[0]) ? 0xffff : 0;
         cpu_state.MM[cpu_reg].w[1] = (cpu_state.MM[cpu_reg].w[1] == src.w[1]) ? 0xffff : 0;
         cpu_state.MM[cpu_reg].w[2] = (cpu_state.MM[cpu_reg].w[2] == src.w[2]) ? 0xffff : 0;
         cpu_state.MM[cpu_reg].w[3] = (cpu_state.MM[cpu_reg].w[3] == src.w[3]) ? 0xffff : 0;
-        
+#endif
+
         return 0;
 }
 static int opPCMPEQW_a32(uint32_t fetchdat)
@@ -142,11 +162,15 @@ static int opPCMPEQW_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_cmpeq_epi16, src);
+#else
         cpu_state.MM[cpu_reg].w[0] = (cpu_state.MM[cpu_reg].w[0] == src.w[0]) ? 0xffff : 0;
         cpu_state.MM[cpu_reg].w[1] = (cpu_state.MM[cpu_reg].w[1] == src.w[1]) ? 0xffff : 0;
         cpu_state.MM[cpu_reg].w[2] = (cpu_state.MM[cpu_reg].w[2] == src.w[2]) ? 0xffff : 0;
         cpu_state.MM[cpu_reg].w[3] = (cpu_state.MM[cpu_reg].w[3] == src.w[3]) ? 0xffff : 0;
-        
+#endif
+
         return 0;
 }
 
@@ -159,11 +183,15 @@ static int opPCMPGTW_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_cmpgt_epi16, src);
+#else
         cpu_state.MM[cpu_reg].w[0] = (cpu_state.MM[cpu_reg].sw[0] > src.sw[0]) ? 0xffff : 0;
         cpu_state.MM[cpu_reg].w[1] = (cpu_state.MM[cpu_reg].sw[1] > src.sw[1]) ? 0xffff : 0;
         cpu_state.MM[cpu_reg].w[2] = (cpu_state.MM[cpu_reg].sw[2] > src.sw[2]) ? 0xffff : 0;
         cpu_state.MM[cpu_reg].w[3] = (cpu_state.MM[cpu_reg].sw[3] > src.sw[3]) ? 0xffff : 0;
-        
+#endif
+
         return 0;
 }
 static int opPCMPGTW_a32(uint32_t fetchdat)
@@ -175,11 +203,15 @@ static int opPCMPGTW_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_cmpgt_epi16, src);
+#else
         cpu_state.MM[cpu_reg].w[0] = (cpu_state.MM[cpu_reg].sw[0] > src.sw[0]) ? 0xffff : 0;
         cpu_state.MM[cpu_reg].w[1] = (cpu_state.MM[cpu_reg].sw[1] > src.sw[1]) ? 0xffff : 0;
         cpu_state.MM[cpu_reg].w[2] = (cpu_state.MM[cpu_reg].sw[2] > src.sw[2]) ? 0xffff : 0;
         cpu_state.MM[cpu_reg].w[3] = (cpu_state.MM[cpu_reg].sw[3] > src.sw[3]) ? 0xffff : 0;
-        
+#endif
+
         return 0;
 }
 
@@ -192,9 +224,13 @@ static int opPCMPEQD_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_cmpeq_epi32, src);
+#else
         cpu_state.MM[cpu_reg].l[0] = (cpu_state.MM[cpu_reg].l[0] == src.l[0]) ? 0xffffffff : 0;
         cpu_state.MM[cpu_reg].l[1] = (cpu_state.MM[cpu_reg].l[1] == src.l[1]) ? 0xffffffff : 0;
-        
+#endif
+
         return 0;
 }
 static int opPCMPEQD_a32(uint32_t fetchdat)
@@ -206,9 +242,13 @@ static int opPCMPEQD_a32(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_cmpeq_epi32, src);
+#else
         cpu_state.MM[cpu_reg].l[0] = (cpu_state.MM[cpu_reg].l[0] == src.l[0]) ? 0xffffffff : 0;
         cpu_state.MM[cpu_reg].l[1] = (cpu_state.MM[cpu_reg].l[1] == src.l[1]) ? 0xffffffff : 0;
-        
+#endif
+
         return 0;
 }
 
@@ -221,9 +261,13 @@ static int opPCMPGTD_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_cmpgt_epi32, src);
+#else
         cpu_state.MM[cpu_reg].l[0] = (cpu_state.MM[cpu_reg].sl[0] > src.sl[0]) ? 0xffffffff : 0;
         cpu_state.MM[cpu_reg].l[1] = (cpu_state.MM[cpu_reg].sl[1] > src.sl[1]) ? 0xffffffff : 0;
-        
+#endif
+
         return 0;
 }
 static int opPCMPGTD_a32(uint32_t fetchdat)
@@ -235,8 +279,12 @@ static int opPCMPGTD_a32(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_cmpgt_epi32, src);
+#else
         cpu_state.MM[cpu_reg].l[0] = (cpu_state.MM[cpu_reg].sl[0] > src.sl[0]) ? 0xffffffff : 0;
         cpu_state.MM[cpu_reg].l[1] = (cpu_state.MM[cpu_reg].sl[1] > src.sl[1]) ? 0xffffffff : 0;
-        
+#endif
+
         return 0;
 }
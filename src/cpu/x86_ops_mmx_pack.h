@@ -8,7 +8,7 @@
  *
  *		Miscellaneous x86 CPU Instructions.
  *
- * Version:	@(#)x86_ops_mmx_pack.h	1.0.1	2018/02/14
+ * Version:	@(#)x86_ops_mmx_pack.h	1.0.2	2019/06/18
  *
  * Authors:	Sarah Walker, <tommowalker@tommowalker.co.uk>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -113,6 +113,9 @@ static int opPUNPCKLBW_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_unpacklo_epi8, src);
+#else
         cpu_state.MM[cpu_reg].b[7] = src.b[3];
         cpu_state.MM[cpu_reg].b[6] = cpu_state.MM[cpu_reg].b[3];
         cpu_state.MM[cpu_reg].b[5] = src.b[2];
@@ -121,6 +124,7 @@ static int opPUNPCKLBW_a16(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[2] = cpu_state.MM[cpu_reg].b[1];
         cpu_state.MM[cpu_reg].b[1] = src.b[0];
         cpu_state.MM[cpu_reg].b[0] = cpu_state.MM[cpu_reg].b[0];
+#endif
 
         return 0;
 }
@@ -132,6 +136,9 @@ static int opPUNPCKLBW_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_unpacklo_epi8, src);
+#else
         cpu_state.MM[cpu_reg].b[7] = src.b[3];
         cpu_state.MM[cpu_reg].b[6] = cpu_state.MM[cpu_reg].b[3];
         cpu_state.MM[cpu_reg].b[5] = src.b[2];
@@ -140,6 +147,7 @@ static int opPUNPCKLBW_a32(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[2] = cpu_state.MM[cpu_reg].b[1];
         cpu_state.MM[cpu_reg].b[1] = src.b[0];
         cpu_state.MM[cpu_reg].b[0] = cpu_state.MM[cpu_reg].b[0];
+#endif
 
         return 0;
 }
@@ -152,6 +160,9 @@ static int opPUNPCKHBW_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_UNPCKH(_mm_unpacklo_epi8, src);
+#else
         cpu_state.MM[cpu_reg].b[0] = cpu_state.MM[cpu_reg].b[4];
         cpu_state.MM[cpu_reg].b[1] = src.b[4];
         cpu_state.MM[cpu_reg].b[2] = cpu_state.MM[cpu_reg].b[5];
@@ -160,7 +171,8 @@ static int opPUNPCKHBW_a16(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[5] = src.b[6];
         cpu_state.MM[cpu_reg].b[6] = cpu_state.MM[cpu_reg].b[7];
         cpu_state.MM[cpu_reg].b[7] = src.b[7];
-        
+#endif
+
         return 0;
 }
 static int opPUNPCKHBW_a32(uint32_t fetchdat)
@@ -171,6 +183,9 @@ static int opPUNPCKHBW_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_UNPCKH(_mm_unpacklo_epi8, src);
+#else
         cpu_state.MM[cpu_reg].b[0] = cpu_state.MM[cpu_reg].b[4];
         cpu_state.MM[cpu_reg].b[1] = src.b[4];
         cpu_state.MM[cpu_reg].b[2] = cpu_state.MM[cpu_reg].b[5];
@@ -179,7 +194,8 @@ static int opPUNPCKHBW_a32(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[5] = src.b[6];
         cpu_state.MM[cpu_reg].b[6] = cpu_state.MM[cpu_reg].b[7];
         cpu_state.MM[cpu_reg].b[7] = src.b[7];
-        
+#endif
+
         return 0;
 }
 
@@ -191,10 +207,14 @@ static int opPUNPCKLWD_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_unpacklo_epi16, src);
+#else
         cpu_state.MM[cpu_reg].w[3] = src.w[1];
         cpu_state.MM[cpu_reg].w[2] = cpu_state.MM[cpu_reg].w[1];
         cpu_state.MM[cpu_reg].w[1] = src.w[0];
         cpu_state.MM[cpu_reg].w[0] = cpu_state.MM[cpu_reg].w[0];
+#endif
 
         return 0;
 }
@@ -206,10 +226,14 @@ static int opPUNPCKLWD_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_OP(_mm_unpacklo_epi16, src);
+#else
         cpu_state.MM[cpu_reg].w[3] = src.w[1];
         cpu_state.MM[cpu_reg].w[2] = cpu_state.MM[cpu_reg].w[1];
         cpu_state.MM[cpu_reg].w[1] = src.w[0];
         cpu_state.MM[cpu_reg].w[0] = cpu_state.MM[cpu_reg].w[0];
+#endif
 
         return 0;
 }
@@ -222,10 +246,14 @@ static int opPUNPCKHWD_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_UNPCKH(_mm_unpacklo_epi16, src);
+#else
         cpu_state.MM[cpu_reg].w[0] = cpu_state.MM[cpu_reg].w[2];
         cpu_state.MM[cpu_reg].w[1] = src.w[2];
         cpu_state.MM[cpu_reg].w[2] = cpu_state.MM[cpu_reg].w[3];
         cpu_state.MM[cpu_reg].w[3] = src.w[3];
+#endif
 
         return 0;
 }
@@ -237,10 +265,14 @@ static int opPUNPCKHWD_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSRC();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_UNPCKH(_mm_unpacklo_epi16, src);
+#else
         cpu_state.MM[cpu_reg].w[0] = cpu_state.MM[cpu_reg].w[2];
         cpu_state.MM[cpu_reg].w[1] = src.w[2];
         cpu_state.MM[cpu_reg].w[2] = cpu_state.MM[cpu_reg].w[3];
         cpu_state.MM[cpu_reg].w[3] = src.w[3];
+#endif
 
         return 0;
 }
@@ -254,6 +286,9 @@ static int opPACKSSWB_a16(uint32_t fetchdat)
         MMX_GETSRC();
         dst = cpu_state.MM[cpu_reg];
 
+#ifdef MMX_SSE2
+        MMX_SSE2_PACK(_mm_packs_epi16, dst, src);
+#else
         cpu_state.MM[cpu_reg].sb[0] = SSATB(dst.sw[0]);
         cpu_state.MM[cpu_reg].sb[1] = SSATB(dst.sw[1]);
         cpu_state.MM[cpu_reg].sb[2] = SSATB(dst.sw[2]);
@@ -262,7 +297,8 @@ static int opPACKSSWB_a16(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].sb[5] = SSATB(src.sw[1]);
         cpu_state.MM[cpu_reg].sb[6] = SSATB(src.sw[2]);
         cpu_state.MM[cpu_reg].sb[7] = SSATB(src.sw[3]);
-        
+#endif
+
         return 0;
 }
 static int opPACKSSWB_a32(uint32_t fetchdat)
@@ -274,6 +310,9 @@ static int opPACKSSWB_a32(uint32_t fetchdat)
         MMX_GETSRC();
         dst = cpu_state.MM[cpu_reg];
 
+#ifdef MMX_SSE2
+        MMX_SSE2_PACK(_mm_packs_epi16, dst, src);
+#else
         cpu_state.MM[cpu_reg].sb[0] = SSATB(dst.sw[0]);
         cpu_state.MM[cpu_reg].sb[1] = SSATB(dst.sw[1]);
         cpu_state.MM[cpu_reg].sb[2] = SSATB(dst.sw[2]);
@@ -282,7 +321,8 @@ static int opPACKSSWB_a32(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].sb[5] = SSATB(src.sw[1]);
         cpu_state.MM[cpu_reg].sb[6] = SSATB(src.sw[2]);
         cpu_state.MM[cpu_reg].sb[7] = SSATB(src.sw[3]);
-        
+#endif
+
         return 0;
 }
 
@@ -295,6 +335,9 @@ static int opPACKUSWB_a16(uint32_t fetchdat)
         MMX_GETSRC();
         dst = cpu_state.MM[cpu_reg];
 
+#ifdef MMX_SSE2
+        MMX_SSE2_PACK(_mm_packus_epi16, dst, src);
+#else
         cpu_state.MM[cpu_reg].b[0] = USATB(dst.sw[0]);
         cpu_state.MM[cpu_reg].b[1] = USATB(dst.sw[1]);
         cpu_state.MM[cpu_reg].b[2] = USATB(dst.sw[2]);
@@ -303,7 +346,8 @@ static int opPACKUSWB_a16(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[5] = USATB(src.sw[1]);
         cpu_state.MM[cpu_reg].b[6] = USATB(src.sw[2]);
         cpu_state.MM[cpu_reg].b[7] = USATB(src.sw[3]);
-        
+#endif
+
         return 0;
 }
 static int opPACKUSWB_a32(uint32_t fetchdat)
@@ -315,6 +359,9 @@ static int opPACKUSWB_a32(uint32_t fetchdat)
         MMX_GETSRC();
         dst = cpu_state.MM[cpu_reg];
 
+#ifdef MMX_SSE2
+        MMX_SSE2_PACK(_mm_packus_epi16, dst, src);
+#else
         cpu_state.MM[cpu_reg].b[0] = USATB(dst.sw[0]);
         cpu_state.MM[cpu_reg].b[1] = USATB(dst.sw[1]);
         cpu_state.MM[cpu_reg].b[2] = USATB(dst.sw[2]);
@@ -323,6 +370,7 @@ static int opPACKUSWB_a32(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].b[5] = USATB(src.sw[1]);
         cpu_state.MM[cpu_reg].b[6] = USATB(src.sw[2]);
         cpu_state.MM[cpu_reg].b[7] = USATB(src.sw[3]);
+#endif
 
         return 0;
 }
@@ -336,11 +384,15 @@ static int opPACKSSDW_a16(uint32_t fetchdat)
         MMX_GETSRC();
         dst = cpu_state.MM[cpu_reg];
         
+#ifdef MMX_SSE2
+        MMX_SSE2_PACK(_mm_packs_epi32, dst, src);
+#else
         cpu_state.MM[cpu_reg].sw[0] = SSATW(dst.sl[0]);
         cpu_state.MM[cpu_reg].sw[1] = SSATW(dst.sl[1]);
         cpu_state.MM[cpu_reg].sw[2] = SSATW(src.sl[0]);
         cpu_state.MM[cpu_reg].sw[3] = SSATW(src.sl[1]);
-        
+#endif
+
         return 0;
 }
 static int opPACKSSDW_a32(uint32_t fetchdat)
@@ -352,10 +404,14 @@ static int opPACKSSDW_a32(uint32_t fetchdat)
         MMX_GETSRC();
         dst = cpu_state.MM[cpu_reg];
         
+#ifdef MMX_SSE2
+        MMX_SSE2_PACK(_mm_packs_epi32, dst, src);
+#else
         cpu_state.MM[cpu_reg].sw[0] = SSATW(dst.sl[0]);
         cpu_state.MM[cpu_reg].sw[1] = SSATW(dst.sl[1]);
         cpu_state.MM[cpu_reg].sw[2] = SSATW(src.sl[0]);
         cpu_state.MM[cpu_reg].sw[3] = SSATW(src.sl[1]);
-        
+#endif
+
         return 0;
 }
@@ -8,7 +8,7 @@
  *
  *		Miscellaneous x86 CPU Instructions.
  *
- * Version:	@(#)x86_ops_mmx_shift.h	1.0.2	2018/10/05
+ * Version:	@(#)x86_ops_mmx_shift.h	1.0.4	2019/07/03
  *
  * Authors:	Sarah Walker, <tommowalker@tommowalker.co.uk>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -38,12 +38,13 @@
 #define MMX_GETSHIFT()                                                  \
         if (cpu_mod == 3)                                                   \
         {                                                               \
-                shift = cpu_state.MM[cpu_rm].b[0];                                    \
+                shift = (cpu_state.MM[cpu_rm].q > 0xff) ? 0xff : cpu_state.MM[cpu_rm].b[0]; \
                 CLOCK_CYCLES(1);                                        \
         }                                                               \
         else                                                            \
         {                                                               \
-                shift = readmemb(easeg, cpu_state.eaaddr); if (cpu_state.abrt) return 0;    \
+                uint64_t count = readmemq(easeg, cpu_state.eaaddr); if (cpu_state.abrt) return 0; \
+                shift = (count > 0xff) ? 0xff : (int)count;             \
                 CLOCK_CYCLES(2);                                        \
         }
 
@@ -59,6 +60,9 @@ static int opPSxxW_imm(uint32_t fetchdat)
         switch (op)
         {
                 case 0x10: /*PSRLW*/
+#ifdef MMX_SSE2
+                MMX_SSE2_SHIFT(_mm_srl_epi16, reg, shift);
+#else
                 if (shift > 15)
                         cpu_state.MM[reg].q = 0;
                 else
@@ -68,16 +72,24 @@ static int opPSxxW_imm(uint32_t fetchdat)
                         cpu_state.MM[reg].w[2] >>= shift;
                         cpu_state.MM[reg].w[3] >>= shift;
                 }
+#endif
                 break;
                 case 0x20: /*PSRAW*/
+#ifdef MMX_SSE2
+                MMX_SSE2_SHIFT(_mm_sra_epi16, reg, shift);
+#else
                 if (shift > 15)
                         shift = 15;
                 cpu_state.MM[reg].sw[0] >>= shift;
                 cpu_state.MM[reg].sw[1] >>= shift;
                 cpu_state.MM[reg].sw[2] >>= shift;
                 cpu_state.MM[reg].sw[3] >>= shift;
+#endif
                 break;
                 case 0x30: /*PSLLW*/
+#ifdef MMX_SSE2
+                MMX_SSE2_SHIFT(_mm_sll_epi16, reg, shift);
+#else
                 if (shift > 15)
                         cpu_state.MM[reg].q = 0;
                 else
@@ -87,6 +99,7 @@ static int opPSxxW_imm(uint32_t fetchdat)
                         cpu_state.MM[reg].w[2] <<= shift;
                         cpu_state.MM[reg].w[3] <<= shift;
                 }
+#endif
                 break;
                 default:
                 ERRLOG("CPU: bad PSxxW (0F 71) instruction %02X\n", op);
@@ -108,6 +121,9 @@ static int opPSLLW_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSHIFT();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_SHIFT(_mm_sll_epi16, cpu_reg, shift);
+#else
         if (shift > 15)
                 cpu_state.MM[cpu_reg].q = 0;
         else
@@ -117,6 +133,7 @@ static int opPSLLW_a16(uint32_t fetchdat)
                 cpu_state.MM[cpu_reg].w[2] <<= shift;
                 cpu_state.MM[cpu_reg].w[3] <<= shift;
         }
+#endif
 
         return 0;
 }
@@ -129,6 +146,9 @@ static int opPSLLW_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSHIFT();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_SHIFT(_mm_sll_epi16, cpu_reg, shift);
+#else
         if (shift > 15)
                 cpu_state.MM[cpu_reg].q = 0;
         else
@@ -138,6 +158,7 @@ static int opPSLLW_a32(uint32_t fetchdat)
                 cpu_state.MM[cpu_reg].w[2] <<= shift;
                 cpu_state.MM[cpu_reg].w[3] <<= shift;
         }
+#endif
 
         return 0;
 }
@@ -151,6 +172,9 @@ static int opPSRLW_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSHIFT();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_SHIFT(_mm_srl_epi16, cpu_reg, shift);
+#else
         if (shift > 15)
                 cpu_state.MM[cpu_reg].q = 0;
         else
@@ -160,6 +184,7 @@ static int opPSRLW_a16(uint32_t fetchdat)
                 cpu_state.MM[cpu_reg].w[2] >>= shift;
                 cpu_state.MM[cpu_reg].w[3] >>= shift;
         }
+#endif
 
         return 0;
 }
@@ -172,6 +197,9 @@ static int opPSRLW_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSHIFT();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_SHIFT(_mm_srl_epi16, cpu_reg, shift);
+#else
         if (shift > 15)
                 cpu_state.MM[cpu_reg].q = 0;
         else
@@ -181,6 +209,7 @@ static int opPSRLW_a32(uint32_t fetchdat)
                 cpu_state.MM[cpu_reg].w[2] >>= shift;
                 cpu_state.MM[cpu_reg].w[3] >>= shift;
         }
+#endif
 
         return 0;
 }
@@ -194,6 +223,9 @@ static int opPSRAW_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSHIFT();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_SHIFT(_mm_sra_epi16, cpu_reg, shift);
+#else
         if (shift > 15)
                 shift = 15;
 
@@ -201,6 +233,7 @@ static int opPSRAW_a16(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].sw[1] >>= shift;
         cpu_state.MM[cpu_reg].sw[2] >>= shift;
         cpu_state.MM[cpu_reg].sw[3] >>= shift;
+#endif
         
         return 0;
 }
@@ -213,6 +246,9 @@ static int opPSRAW_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSHIFT();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_SHIFT(_mm_sra_epi16, cpu_reg, shift);
+#else
         if (shift > 15)
                 shift = 15;
 
@@ -220,6 +256,7 @@ static int opPSRAW_a32(uint32_t fetchdat)
         cpu_state.MM[cpu_reg].sw[1] >>= shift;
         cpu_state.MM[cpu_reg].sw[2] >>= shift;
         cpu_state.MM[cpu_reg].sw[3] >>= shift;
+#endif
         
         return 0;
 }
@@ -236,6 +273,9 @@ static int opPSxxD_imm(uint32_t fetchdat)
         switch (op)
         {
                 case 0x10: /*PSRLD*/
+#ifdef MMX_SSE2
+                MMX_SSE2_SHIFT(_mm_srl_epi32, reg, shift);
+#else
                 if (shift > 31)
                         cpu_state.MM[reg].q = 0;
                 else
@@ -243,14 +283,22 @@ static int opPSxxD_imm(uint32_t fetchdat)
                         cpu_state.MM[reg].l[0] >>= shift;
                         cpu_state.MM[reg].l[1] >>= shift;
                 }
+#endif
                 break;
                 case 0x20: /*PSRAD*/
+#ifdef MMX_SSE2
+                MMX_SSE2_SHIFT(_mm_sra_epi32, reg, shift);
+#else
                 if (shift > 31)
                         shift = 31;
                 cpu_state.MM[reg].sl[0] >>= shift;
                 cpu_state.MM[reg].sl[1] >>= shift;
+#endif
                 break;
                 case 0x30: /*PSLLD*/
+#ifdef MMX_SSE2
+                MMX_SSE2_SHIFT(_mm_sll_epi32, reg, shift);
+#else
                 if (shift > 31)
                         cpu_state.MM[reg].q = 0;
                 else
@@ -258,6 +306,7 @@ static int opPSxxD_imm(uint32_t fetchdat)
                         cpu_state.MM[reg].l[0] <<= shift;
                         cpu_state.MM[reg].l[1] <<= shift;
                 }
+#endif
                 break;
                 default:
                 ERRLOG("CPU: bad PSxxD (0F 72) instruction %02X\n", op);
@@ -279,6 +328,9 @@ static int opPSLLD_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSHIFT();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_SHIFT(_mm_sll_epi32, cpu_reg, shift);
+#else
         if (shift > 31)
                 cpu_state.MM[cpu_reg].q = 0;
         else
@@ -286,6 +338,7 @@ static int opPSLLD_a16(uint32_t fetchdat)
                 cpu_state.MM[cpu_reg].l[0] <<= shift;
                 cpu_state.MM[cpu_reg].l[1] <<= shift;
         }
+#endif
 
         return 0;
 }
@@ -298,6 +351,9 @@ static int opPSLLD_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSHIFT();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_SHIFT(_mm_sll_epi32, cpu_reg, shift);
+#else
         if (shift > 31)
                 cpu_state.MM[cpu_reg].q = 0;
         else
@@ -305,6 +361,7 @@ static int opPSLLD_a32(uint32_t fetchdat)
                 cpu_state.MM[cpu_reg].l[0] <<= shift;
                 cpu_state.MM[cpu_reg].l[1] <<= shift;
         }
+#endif
 
         return 0;
 }
@@ -318,6 +375,9 @@ static int opPSRLD_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSHIFT();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_SHIFT(_mm_srl_epi32, cpu_reg, shift);
+#else
         if (shift > 31)
                 cpu_state.MM[cpu_reg].q = 0;
         else
@@ -325,6 +385,7 @@ static int opPSRLD_a16(uint32_t fetchdat)
                 cpu_state.MM[cpu_reg].l[0] >>= shift;
                 cpu_state.MM[cpu_reg].l[1] >>= shift;
         }
+#endif
 
         return 0;
 }
@@ -337,6 +398,9 @@ static int opPSRLD_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSHIFT();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_SHIFT(_mm_srl_epi32, cpu_reg, shift);
+#else
         if (shift > 31)
                 cpu_state.MM[cpu_reg].q = 0;
         else
@@ -344,6 +408,7 @@ static int opPSRLD_a32(uint32_t fetchdat)
                 cpu_state.MM[cpu_reg].l[0] >>= shift;
                 cpu_state.MM[cpu_reg].l[1] >>= shift;
         }
+#endif
 
         return 0;
 }
@@ -357,11 +422,15 @@ static int opPSRAD_a16(uint32_t fetchdat)
         fetch_ea_16(fetchdat);
         MMX_GETSHIFT();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_SHIFT(_mm_sra_epi32, cpu_reg, shift);
+#else
         if (shift > 31)
                 shift = 31;
 
         cpu_state.MM[cpu_reg].sl[0] >>= shift;
         cpu_state.MM[cpu_reg].sl[1] >>= shift;
+#endif
         
         return 0;
 }
@@ -374,11 +443,15 @@ static int opPSRAD_a32(uint32_t fetchdat)
         fetch_ea_32(fetchdat);
         MMX_GETSHIFT();
 
+#ifdef MMX_SSE2
+        MMX_SSE2_SHIFT(_mm_sra_epi32, cpu_reg, shift);
+#else
         if (shift > 31)
                 shift = 31;
 
         cpu_state.MM[cpu_reg].sl[0] >>= shift;
         cpu_state.MM[cpu_reg].sl[1] >>= shift;
+#endif
 
         return 0;
 }
@@ -8,7 +8,7 @@
  *
  *		x86 CPU segment emulation.
  *
- * Version:	@(#)x86seg.c	1.0.8	2019/05/17
+ * Version:	@(#)x86seg.c	1.0.10	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -70,6 +70,35 @@ int cgate16,cgate32;
 
 int intgatesize;
 
+/*
+ * Small direct-mapped cache of descriptors, indexed by the linear
+ * address of the descriptor, which is the table base plus the index
+ * part of the selector. Protected mode code reloads the same few
+ * selectors all the time, and this saves us going through the memory
+ * and paging code four times for each of them.
+ *
+ * We only cache descriptors that live in RAM, and the pages holding
+ * them are watched by the memory code, so any write to such a page
+ * (including the accessed bit we set ourselves, and DMA) flushes the
+ * cache.
+ * Since the key is a linear address, loading a new GDT or LDT needs
+ * no flush, but anything changing the linear-to-physical mapping does,
+ * which is why the MMU cache flushes also flush this cache.
+ */
+#define DESC_CACHE_SIZE	64			/* must be a power of 2 */
+#define DESC_MAX_PAGES	16
+
+typedef struct {
+        uint32_t addr;
+        uint16_t segdat[4];
+} desc_cache_t;
+
+static desc_cache_t desc_cache[DESC_CACHE_SIZE];
+static uint32_t desc_pages[DESC_MAX_PAGES];
+static int desc_npages;
+
+uint64_t x86seg_cache_hits, x86seg_cache_misses;
+
 void taskswitch286(uint16_t seg, uint16_t *segdat, int is32);
 void taskswitch386(uint16_t seg, uint16_t *segdat);
 
@@ -118,8 +147,87 @@ static void seg_reset(x86seg *s)
 
 }
 
+void x86seg_cache_flush(void)
+{
+        int c;
+
+        if (! desc_npages)
+                return;
+
+        for (c = 0; c < DESC_CACHE_SIZE; c++)
+                desc_cache[c].addr = 0xffffffff;
+
+        for (c = 0; c < desc_npages; c++)
+                mem_watch_page(desc_pages[c], 0);
+        desc_npages = 0;
+}
+
+static void read_descriptor(uint32_t addr, uint16_t *segdat)
+{
+        desc_cache_t *d = &desc_cache[(addr >> 3) & (DESC_CACHE_SIZE - 1)];
+        uint32_t phys;
+        int c;
+
+        if (d->addr == addr)
+        {
+                segdat[0] = d->segdat[0];
+                segdat[1] = d->segdat[1];
+                segdat[2] = d->segdat[2];
+                segdat[3] = d->segdat[3];
+                x86seg_cache_hits++;
+                return;
+        }
+        x86seg_cache_misses++;
+
+        segdat[0]=readmemw(0,addr);
+        segdat[1]=readmemw(0,addr+2);
+        segdat[2]=readmemw(0,addr+4);
+        segdat[3]=readmemw(0,addr+6);
+        if (cpu_state.abrt)
+                return;
+
+        /*
+         * Only cache descriptors in RAM which do not cross a page. The
+         * A0000-FFFFF part of ram[] is only reached through the shadow
+         * and remap mappings, whose writes we can not watch, so skip it.
+         */
+        if ((addr & 0xfff) > 0xff8 || readlookup2[addr >> 12] == (uintptr_t)-1)
+                return;
+        phys = (uint32_t)(((uintptr_t)readlookup2[addr >> 12] + addr) - (uintptr_t)ram) & ~0xfff;
+        if (phys >= 0xa0000 && phys < 0x100000)
+                return;
+
+        for (c = 0; c < desc_npages; c++)
+        {
+                if (desc_pages[c] == phys)
+                        break;
+        }
+        if (c == desc_npages)
+        {
+                if (desc_npages == DESC_MAX_PAGES)
+                        x86seg_cache_flush();
+                desc_pages[desc_npages++] = phys;
+                mem_watch_page(phys, 1);
+        }
+
+        d->addr = addr;
+        d->segdat[0] = segdat[0];
+        d->segdat[1] = segdat[1];
+        d->segdat[2] = segdat[2];
+        d->segdat[3] = segdat[3];
+}
+
 void x86seg_reset()
 {
+        if (x86seg_cache_hits || x86seg_cache_misses)
+                INFO("CPU: descriptor cache %llu hits, %llu misses\n",
+                     (unsigned long long)x86seg_cache_hits,
+                     (unsigned long long)x86seg_cache_misses);
+        x86seg_cache_hits = x86seg_cache_misses = 0;
+
+        x86seg_cache_flush();
+        memset(desc_cache, 0xff, sizeof(desc_cache));
+
         seg_reset(&_cs);
         seg_reset(&_ds);
         seg_reset(&_es);
@@ -375,10 +483,7 @@ void loadseg(uint16_t seg, x86seg *s)
                         addr+=gdt.base;
                 }
                 cpl_override=1;
-                segdat[0]=readmemw(0,addr);
-                segdat[1]=readmemw(0,addr+2);
-                segdat[2]=readmemw(0,addr+4);
-                segdat[3]=readmemw(0,addr+6); cpl_override=0; if (cpu_state.abrt) return;
+                read_descriptor(addr, segdat); cpl_override=0; if (cpu_state.abrt) return;
                 dpl=(segdat[2]>>13)&3;
                 if (s==&_ss)
                 {
@@ -532,10 +637,7 @@ void loadcs(uint16_t seg)
                         addr+=gdt.base;
                 }
                 cpl_override=1;
-                segdat[0]=readmemw(0,addr);
-                segdat[1]=readmemw(0,addr+2);
-                segdat[2]=readmemw(0,addr+4);
-                segdat[3]=readmemw(0,addr+6); cpl_override=0; if (cpu_state.abrt) return;
+                read_descriptor(addr, segdat); cpl_override=0; if (cpu_state.abrt) return;
                 if (segdat[2]&0x1000) /*Normal code segment*/
                 {
                         if (!(segdat[2]&0x400)) /*Not conforming*/
@@ -639,10 +741,7 @@ void loadcsjmp(uint16_t seg, uint32_t oxpc)
                         addr+=gdt.base;
                 }
                 cpl_override=1;
-                segdat[0]=readmemw(0,addr);
-                segdat[1]=readmemw(0,addr+2);
-                segdat[2]=readmemw(0,addr+4);
-                segdat[3]=readmemw(0,addr+6); cpl_override=0; if (cpu_state.abrt) return;
+                read_descriptor(addr, segdat); cpl_override=0; if (cpu_state.abrt) return;
 #if 0
                 DEBUG("%04X %04X %04X %04X\n",segdat[0],segdat[1],segdat[2],segdat[3]);
 #endif
@@ -751,10 +850,7 @@ void loadcsjmp(uint16_t seg, uint32_t oxpc)
                                         addr+=gdt.base;
                                 }
                                 cpl_override=1;
-                                segdat[0]=readmemw(0,addr);
-                                segdat[1]=readmemw(0,addr+2);
-                                segdat[2]=readmemw(0,addr+4);
-                                segdat[3]=readmemw(0,addr+6); cpl_override=0; if (cpu_state.abrt) return;
+                                read_descriptor(addr, segdat); cpl_override=0; if (cpu_state.abrt) return;
 
                                 if (DPL > CPL)
                                 {
@@ -934,10 +1030,7 @@ void loadcscall(uint16_t seg)
                         addr+=gdt.base;
                 }
                 cpl_override=1;
-                segdat[0]=readmemw(0,addr);
-                segdat[1]=readmemw(0,addr+2);
-                segdat[2]=readmemw(0,addr+4);
-                segdat[3]=readmemw(0,addr+6); cpl_override=0; if (cpu_state.abrt) return;
+                read_descriptor(addr, segdat); cpl_override=0; if (cpu_state.abrt) return;
                 type=segdat[2]&0xF00;
                 newpc=segdat[0];
                 if (type&0x800) newpc|=segdat[3]<<16;
@@ -1060,10 +1153,7 @@ void loadcscall(uint16_t seg)
                                         addr+=gdt.base;
                                 }
                                 cpl_override=1;
-                                segdat[0]=readmemw(0,addr);
-                                segdat[1]=readmemw(0,addr+2);
-                                segdat[2]=readmemw(0,addr+4);
-                                segdat[3]=readmemw(0,addr+6); cpl_override=0; if (cpu_state.abrt) return;
+                                read_descriptor(addr, segdat); cpl_override=0; if (cpu_state.abrt) return;
                                 
 #if 0
                                 DEBUG("Code seg2 call - %04X - %04X %04X %04X\n",seg2,segdat[0],segdat[1],segdat[2]);
@@ -1149,10 +1239,7 @@ void loadcscall(uint16_t seg)
 #if 0
                                                 DEBUG("Read stack seg\n");
 #endif
-                                                segdat2[0]=readmemw(0,addr);
-                                                segdat2[1]=readmemw(0,addr+2);
-                                                segdat2[2]=readmemw(0,addr+4);
-                                                segdat2[3]=readmemw(0,addr+6); cpl_override=0; if (cpu_state.abrt) return;
+                                                read_descriptor(addr, segdat2); cpl_override=0; if (cpu_state.abrt) return;
 #if 0
                                                 DEBUG("Read stack seg done!\n");
 #endif
@@ -1387,10 +1474,7 @@ void pmoderetf(int is32, uint16_t off)
                 addr+=gdt.base;
         }
         cpl_override=1;
-        segdat[0]=readmemw(0,addr);
-        segdat[1]=readmemw(0,addr+2);
-        segdat[2]=readmemw(0,addr+4);
-        segdat[3]=readmemw(0,addr+6); cpl_override=0; if (cpu_state.abrt) { ESP=oldsp; return; }
+        read_descriptor(addr, segdat); cpl_override=0; if (cpu_state.abrt) { ESP=oldsp; return; }
         oaddr = addr;
         
 #if 0
@@ -1535,10 +1619,7 @@ void pmoderetf(int is32, uint16_t off)
                         addr+=gdt.base;
                 }
                 cpl_override=1;
-                segdat2[0]=readmemw(0,addr);
-                segdat2[1]=readmemw(0,addr+2);
-                segdat2[2]=readmemw(0,addr+4);
-                segdat2[3]=readmemw(0,addr+6); cpl_override=0; if (cpu_state.abrt) { ESP=oldsp; return; }
+                read_descriptor(addr, segdat2); cpl_override=0; if (cpu_state.abrt) { ESP=oldsp; return; }
 #if 0
                 DEBUG("Segment data %04X %04X %04X %04X\n", segdat2[0], segdat2[1], segdat2[2], segdat2[3]);
 #endif
@@ -1650,10 +1731,7 @@ void pmodeint(int num, int soft)
         }
         addr+=idt.base;
         cpl_override=1;
-        segdat[0]=readmemw(0,addr);
-        segdat[1]=readmemw(2,addr);
-        segdat[2]=readmemw(4,addr);
-        segdat[3]=readmemw(6,addr); cpl_override=0; if (cpu_state.abrt) { /* ERRLOG("Abrt reading from %08X\n",addr); */ return; }
+        read_descriptor(addr, segdat); cpl_override=0; if (cpu_state.abrt) { /* ERRLOG("Abrt reading from %08X\n",addr); */ return; }
         oaddr = addr;
 
 #if 0
@@ -1702,10 +1780,7 @@ void pmodeint(int num, int soft)
                                 addr+=gdt.base;
                         }
                         cpl_override=1;
-                        segdat2[0]=readmemw(0,addr);
-                        segdat2[1]=readmemw(0,addr+2);
-                        segdat2[2]=readmemw(0,addr+4);
-                        segdat2[3]=readmemw(0,addr+6); cpl_override=0; if (cpu_state.abrt) return;
+                        read_descriptor(addr, segdat2); cpl_override=0; if (cpu_state.abrt) return;
                         oaddr = addr;
                         
                         if (DPL2 > CPL)
@@ -1770,10 +1845,7 @@ void pmodeint(int num, int soft)
                                                 addr+=gdt.base;
                                         }
                                         cpl_override=1;
-                                        segdat3[0]=readmemw(0,addr);
-                                        segdat3[1]=readmemw(0,addr+2);
-                                        segdat3[2]=readmemw(0,addr+4);
-                                        segdat3[3]=readmemw(0,addr+6); cpl_override=0; if (cpu_state.abrt) return;
+                                        read_descriptor(addr, segdat3); cpl_override=0; if (cpu_state.abrt) return;
                                         if (((newss & 3) != DPL2) || (DPL3 != DPL2))
                                         {
                                                 x86ss(NULL,newss&~3);
@@ -1917,10 +1989,7 @@ void pmodeint(int num, int soft)
                                 addr+=gdt.base;
                         }
                         cpl_override=1;
-                        segdat2[0]=readmemw(0,addr);
-                        segdat2[1]=readmemw(0,addr+2);
-                        segdat2[2]=readmemw(0,addr+4);
-                        segdat2[3]=readmemw(0,addr+6);
+                        read_descriptor(addr, segdat2);
                         cpl_override=0; if (cpu_state.abrt) return;
                                 if (!(segdat2[2]&0x8000))
                                 {
@@ -2002,10 +2071,7 @@ void pmodeiret(int is32)
                         addr+=gdt.base;
                 }
                 cpl_override=1;
-                segdat[0]=readmemw(0,addr);
-                segdat[1]=readmemw(0,addr+2);
-                segdat[2]=readmemw(0,addr+4);
-                segdat[3]=readmemw(0,addr+6);
+                read_descriptor(addr, segdat);
                 taskswitch286(seg,segdat,segdat[2] & 0x800);
                 cpl_override=0;
                 return;
@@ -2100,10 +2166,7 @@ void pmodeiret(int is32)
                 return;
         }
         cpl_override=1;
-        segdat[0]=readmemw(0,addr);
-        segdat[1]=readmemw(0,addr+2);
-        segdat[2]=readmemw(0,addr+4);
-        segdat[3]=readmemw(0,addr+6); cpl_override=0; if (cpu_state.abrt) { ESP = oldsp; return; }
+        read_descriptor(addr, segdat); cpl_override=0; if (cpu_state.abrt) { ESP = oldsp; return; }
         
         switch (segdat[2]&0x1F00)
         {
@@ -2198,10 +2261,7 @@ void pmodeiret(int is32)
                         addr+=gdt.base;
                 }
                 cpl_override=1;
-                segdat2[0]=readmemw(0,addr);
-                segdat2[1]=readmemw(0,addr+2);
-                segdat2[2]=readmemw(0,addr+4);
-                segdat2[3]=readmemw(0,addr+6); cpl_override=0; if (cpu_state.abrt) { ESP = oldsp; return; }
+                read_descriptor(addr, segdat2); cpl_override=0; if (cpu_state.abrt) { ESP = oldsp; return; }
                 if ((newss & 3) != (seg & 3))
                 {
                         ESP = oldsp;
@@ -2423,10 +2483,7 @@ void taskswitch286(uint16_t seg, uint16_t *segdat, int is32)
                                 }
                                 addr+=gdt.base;
                         }
-                        segdat2[0]=readmemw(0,addr);
-                        segdat2[1]=readmemw(0,addr+2);
-                        segdat2[2]=readmemw(0,addr+4);
-                        segdat2[3]=readmemw(0,addr+6);
+                        read_descriptor(addr, segdat2);
                         if (!(segdat2[2]&0x8000))
                         {
                                 x86np("TS loading CS not present\n", new_cs & 0xfffc);
@@ -2596,10 +2653,7 @@ void taskswitch286(uint16_t seg, uint16_t *segdat, int is32)
                         }
                         addr+=gdt.base;
                 }
-                segdat2[0]=readmemw(0,addr);
-                segdat2[1]=readmemw(0,addr+2);
-                segdat2[2]=readmemw(0,addr+4);
-                segdat2[3]=readmemw(0,addr+6);
+                read_descriptor(addr, segdat2);
                 if (!(segdat2[2]&0x8000))
                 {
                         x86np("TS loading CS not present\n", new_cs & 0xfffc);
@@ -8,7 +8,7 @@
  *
  *		x87 FPU instructions core.
  *
- * Version:	@(#)x87_ops.h	1.0.9	2019/05/17
+ * Version:	@(#)x87_ops.h	1.0.11	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Sarah Walker, <tommowalker@tommowalker.co.uk>
@@ -295,156 +295,54 @@ static INLINE void x87_stmmx(MMX_REG r)
         writememw(easeg, cpu_state.eaaddr + 8, 0xffff);
 }
 
+/*
+ * Compare two stack values the way FCOM/FUCOM do.
+ *
+ * We used to push both values back onto the host x87 stack and read
+ * the status word back through memory, which costs a store/reload of
+ * both operands and an FNSTSW per compare, and left the x64 builds
+ * (which have no x87 inline assembly) with a version that got NaNs
+ * wrong. Since ST() holds host doubles, an ordinary C compare gives
+ * the same answer and compiles to a single COMISD/UCOMISD on SSE2
+ * hosts, whose ZF/PF/CF map 1:1 onto C3/C2/C0 (this is also what the
+ * x86-64 recompiler emits for these instructions.)
+ *
+ * The only case the host cannot decide for us is the 8087/80287
+ * projective infinity mode, in which any two infinities compare equal.
+ */
 static INLINE uint16_t x87_compare(double a, double b)
 {
-        uint32_t result = 0;
-
-#if defined(_MSC_VER) && !defined(_M_X64)
-	if (!is386)
-	{
-		if (((a == INFINITY) || (a == -INFINITY)) && ((b == INFINITY) || (b == -INFINITY)))
-		{
+	if (!is386) {
+		if (((a == INFINITY) || (a == -INFINITY)) && ((b == INFINITY) || (b == -INFINITY))) {
 			/* DEBUG("Comparing infinity\n"); */
-                	_ReadWriteBarrier();
-                	__asm
-                	{
-                        	fld a
-                        	fld a
-                        	fclex
-                        	fcompp
-                        	fnstsw result
-                	}
-
-		        return result & (C0|C2|C3);
+			return(C3);
 		}
 	}
-        
-        _ReadWriteBarrier();
-        _asm
-        {
-                fld b
-                fld a
-                fclex
-                fcompp
-                fnstsw result
-        }
 
-        return result & (C0|C2|C3);
-#endif
-
-#if defined(__GNUC__) && (defined(__i386) || defined(__i386__) || defined(_X86_) || defined(_M_IX86) || defined(_M_X64))
-	if (!is386)
-	{
-		if (((a == INFINITY) || (a == -INFINITY)) && ((b == INFINITY) || (b == -INFINITY)))
-		{
-			/* DEBUG("Comparing infinity\n"); */
-		        __asm volatile ("" : : : "memory");
-        
-		        __asm(
-		                "fldl %2\n"
-		                "fldl %1\n"
-		                "fclex\n"
-		                "fcompp\n"                
-		                "fnstsw %0\n"
-		                : "=m" (result)
-		                : "m" (a), "m" (a)
-		        );
-		}
-	}
-
-        /* Memory barrier, to force GCC to write to the input parameters
-         * before the compare rather than after */
-        __asm volatile ("" : : : "memory");
-        
-        __asm(
-                "fldl %2\n"
-                "fldl %1\n"
-                "fclex\n"
-                "fcompp\n"                
-                "fnstsw %0\n"
-                : "=m" (result)
-                : "m" (a), "m" (b)
-        );
-
-        return result & (C0|C2|C3);
-#endif
+	if (a == b)
+		return(C3);
+	if (a < b)
+		return(C0);
+	if (a > b)
+		return(0);
 
-        /*
-	 * Generic C version is known to give incorrect results
-	 * in some situations, eg comparison of infinity (Unreal).
-	 */
-	if (!is386)
-	{
-		if (((a == INFINITY) || (a == -INFINITY)) && ((b == INFINITY) || (b == -INFINITY)))
-		{
-			/* DEBUG("Comparing infinity\n"); */
-			result |= C3;
-			return result;
-		}
-
-	        if (a == b)
-	                result |= C3;
-	        else if (a < b)
-	                result |= C0;
-	}
-	else
-	{
-	        if (a == b)
-	                result |= C3;
-	        else if (a < b)
-	                result |= C0;
-	}
-                
-        return result;
+	/* Unordered, at least one of them is a NaN. */
+	return(C0 | C2 | C3);
 }
 
 static INLINE uint16_t x87_ucompare(double a, double b)
 {
-        uint32_t result = 0;
-
-#if defined(_MSC_VER) && !defined(_M_X64)
-        _ReadWriteBarrier();
-        _asm
-        {
-                fld b
-                fld a
-                fclex
-                fcompp
-                fnstsw result
-        }
-
-        return result & (C0|C2|C3);
-#endif
-
-#ifdef __GNUC__
-        /* Memory barrier, to force GCC to write to the input parameters
-         * before the compare rather than after */
-        __asm volatile ("" : : : "memory");
-        
-        __asm(
-                "fldl %2\n"
-                "fldl %1\n"
-                "fclex\n"
-                "fucompp\n"                
-                "fnstsw %0\n"
-                : "=m" (result)
-                : "m" (a), "m" (b)
-        );
-
-        return result & (C0|C2|C3);
-#endif
-
-        /* Generic C version is known to give incorrect results in some
-         * situations, eg comparison of infinity (Unreal) */
-        if (a == b)
-                result |= C3;
-        else if (a < b)
-                result |= C0;
-                
-        return result;
+	if (a == b)
+		return(C3);
+	if (a < b)
+		return(C0);
+	if (a > b)
+		return(0);
+
+	/* Unordered, at least one of them is a NaN. */
+	return(C0 | C2 | C3);
 }
 
-
 typedef union
 {
         float s;
@@ -8,7 +8,7 @@
  *
  *		Miscellaneous x87 FPU Instructions.
  *
- * Version:	@(#)x87_ops_arith.h	1.0.2	2018/10/05
+ * Version:	@(#)x87_ops_arith.h	1.0.3	2019/06/17
  *
  * Authors:	Sarah Walker, <tommowalker@tommowalker.co.uk>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -241,6 +241,7 @@ static int opFCOMI(uint32_t fetchdat)
         flags &= ~(Z_FLAG | P_FLAG | C_FLAG);
         if (ST(0) == ST(fetchdat & 7))     flags |= Z_FLAG;
         else if (ST(0) < ST(fetchdat & 7)) flags |= C_FLAG;
+        else if (!(ST(0) > ST(fetchdat & 7))) flags |= (Z_FLAG | P_FLAG | C_FLAG);
         CLOCK_CYCLES(4);
         return 0;
 }
@@ -253,6 +254,7 @@ static int opFCOMIP(uint32_t fetchdat)
         flags &= ~(Z_FLAG | P_FLAG | C_FLAG);
         if (ST(0) == ST(fetchdat & 7))     flags |= Z_FLAG;
         else if (ST(0) < ST(fetchdat & 7)) flags |= C_FLAG;
+        else if (!(ST(0) > ST(fetchdat & 7))) flags |= (Z_FLAG | P_FLAG | C_FLAG);
         x87_pop();
         CLOCK_CYCLES(4);
         return 0;
@@ -450,6 +452,7 @@ static int opFUCOMI(uint32_t fetchdat)
         flags &= ~(Z_FLAG | P_FLAG | C_FLAG);
         if (ST(0) == ST(fetchdat & 7))     flags |= Z_FLAG;
         else if (ST(0) < ST(fetchdat & 7)) flags |= C_FLAG;
+        else if (!(ST(0) > ST(fetchdat & 7))) flags |= (Z_FLAG | P_FLAG | C_FLAG);
         CLOCK_CYCLES(4);
         return 0;
 }
@@ -462,6 +465,7 @@ static int opFUCOMIP(uint32_t fetchdat)
         flags &= ~(Z_FLAG | P_FLAG | C_FLAG);
         if (ST(0) == ST(fetchdat & 7))     flags |= Z_FLAG;
         else if (ST(0) < ST(fetchdat & 7)) flags |= C_FLAG;
+        else if (!(ST(0) > ST(fetchdat & 7))) flags |= (Z_FLAG | P_FLAG | C_FLAG);
         x87_pop();
         CLOCK_CYCLES(4);
         return 0;
@@ -11,7 +11,7 @@
  *
  * **TODO**	Merge the various 'add' variants, its getting too messy.
  *
- * Version:	@(#)device.c	1.0.27	2019/05/15
+ * Version:	@(#)device.c	1.0.28	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -523,6 +523,10 @@ device_force_redraw(void)
 {
     int c;
 
+    /* Not all cards have a handler, so make sure it all gets blitted. */
+    video_text_invalidate(NULL, -1);
+    video_damage_all();
+
     for (c = 0; c < DEVICE_MAX; c++) {
 	if (devices[c] != NULL) {
 		if (devices[c]->force_redraw != NULL)
@@ -8,7 +8,7 @@
  *
  *		Definitions for the hard disk image handler.
  *
- * Version:	@(#)hdd.h	1.0.14	2018/11/08
+ * Version:	@(#)hdd.h	1.0.16	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -40,6 +40,8 @@
 
 #define HDD_NUM		30	/* total of 30 images supported */
 
+#define HDZ_BLOCK_SIZE	65536	/* default HDZ compression block size */
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -160,6 +162,18 @@ extern void	generate_vhd_checksum(vhd_footer_t *vhd);
 extern int	image_is_hdi(const wchar_t *s);
 extern int	image_is_hdx(const wchar_t *s, int check_signature);
 extern int	image_is_vhd(const wchar_t *s, int check_signature);
+extern int	image_is_hdz(const wchar_t *s, int check_signature);
+
+extern int	hdz_create(const wchar_t *fn, const char *store,
+			   uint32_t block_size,
+			   uint32_t spt, uint32_t hpc, uint32_t tracks);
+extern void	*hdz_open(const wchar_t *fn, int rdonly, int direct);
+extern int	hdz_close(void *priv);
+extern void	hdz_geometry(void *priv, uint32_t *spt, uint32_t *hpc, uint32_t *tracks);
+extern uint32_t	hdz_sectors(void *priv);
+extern void	hdz_set_level(void *priv, int level);
+extern int	hdz_read(void *priv, uint32_t sector, uint32_t count, uint8_t *bufp);
+extern int	hdz_write(void *priv, uint32_t sector, uint32_t count, const uint8_t *bufp);
 
 #ifdef __cplusplus
 }
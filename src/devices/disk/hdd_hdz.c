@@ -0,0 +1,887 @@
+/*
+ * VARCem	Virtual ARchaeological Computer EMulator.
+ *		An emulator of (mostly) x86-based PC systems and devices,
+ *		using the ISA,EISA,VLB,MCA  and PCI system buses, roughly
+ *		spanning the era between 1981 and 1995.
+ *
+ *		This file is part of the VARCem Project.
+ *
+ *		Handling of compressed (HDZ) hard disk images.
+ *
+ *		An HDZ image splits the disk into fixed-size blocks, each
+ *		of which is compressed with zlib and stored as a "blob".
+ *		All-zero blocks take no space at all, and blocks with the
+ *		same contents are only stored once. The blobs either live
+ *		in the image file itself, or in a separate "blob store"
+ *		file which can be shared by many images, so that common
+ *		system files are deduplicated across an entire archive.
+ *
+ *		The emulator never modifies the compressed data. Writes
+ *		go into an overlay file (image name plus ".ovl") which
+ *		holds uncompressed copies of all modified blocks, and is
+ *		folded back into a new image by the hdzconv tool.
+ *
+ *		Image file layout:
+ *
+ *		  00000000  header (512 bytes, geometry as in HDX)
+ *		  00000200  block index, 16 bytes per block
+ *		  ........  blobs (if not using a shared store)
+ *
+ *		Store and overlay files also start with a 512-byte header.
+ *		Each blob is preceded by a 16-byte blob header.
+ *
+ * Version:	@(#)hdd_hdz.c	1.0.1	2019/07/03
+ *
+ * Author:	Fred N. van Kempen, <decwiz@yahoo.com>
+ *
+ *		Copyright 2019 Fred N. van Kempen.
+ *
+ *		Redistribution and  use  in source  and binary forms, with
+ *		or  without modification, are permitted  provided that the
+ *		following conditions are met:
+ *
+ *		1. Redistributions of  source  code must retain the entire
+ *		   above notice, this list of conditions and the following
+ *		   disclaimer.
+ *
+ *		2. Redistributions in binary form must reproduce the above
+ *		   copyright  notice,  this list  of  conditions  and  the
+ *		   following disclaimer in  the documentation and/or other
+ *		   materials provided with the distribution.
+ *
+ *		3. Neither the  name of the copyright holder nor the names
+ *		   of  its  contributors may be used to endorse or promote
+ *		   products  derived from  this  software without specific
+ *		   prior written permission.
+ *
+ * THIS SOFTWARE  IS  PROVIDED BY THE  COPYRIGHT  HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND  ANY EXPRESS  OR  IMPLIED  WARRANTIES,  INCLUDING, BUT  NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE  ARE  DISCLAIMED. IN  NO  EVENT  SHALL THE COPYRIGHT
+ * HOLDER OR  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL,  EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON  ANY
+ * THEORY OF  LIABILITY, WHETHER IN  CONTRACT, STRICT  LIABILITY, OR  TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING  IN ANY  WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define _LARGEFILE_SOURCE
+#define _LARGEFILE64_SOURCE
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <time.h>
+#include "../../emu.h"
+#include "../../plat.h"
+#include "../../zlib/zlib.h"
+#include "hdd.h"
+
+
+#define HDZ_VERSION	1
+#define HDZ_HDR_SIZE	512
+#define HDZ_BLOB_MAGIC	0x425a4448		/* "HDZB" */
+#define HDZ_HASH_SIZE	4096			/* dedup hash buckets */
+#define HDZ_NONE	0xffffffff
+
+
+#pragma pack(push,1)
+typedef struct {
+    uint8_t	magic[8];		/* 00: signature */
+    uint64_t	size;			/* 08: full size of the data */
+    uint32_t	sector_size;		/* 10: sector size in bytes */
+    uint32_t	spt;			/* 14: sectors per track */
+    uint32_t	hpc;			/* 18: heads per cylinder */
+    uint32_t	tracks;			/* 1C: cylinders */
+    uint32_t	version;		/* 20: format version */
+    uint32_t	block_size;		/* 24: size of a block in bytes */
+    uint32_t	blocks;			/* 28: number of blocks */
+    uint32_t	stamp;			/* 2C: ties overlays to the image */
+    uint64_t	index;			/* 30: offset of block index */
+    char	store[256];		/* 38: name of blob store, if any */
+    uint8_t	pad[HDZ_HDR_SIZE-0x138];
+} hdz_hdr_t;
+
+typedef struct {
+    uint64_t	offset;			/* blob data offset, 0=zero block */
+    uint32_t	length;			/* blob length, block_size=stored */
+    uint32_t	crc;			/* CRC32 of the block data */
+} hdz_ent_t;
+
+typedef struct {
+    uint32_t	magic;
+    uint32_t	length;
+    uint32_t	crc;
+    uint32_t	adler;
+} hdz_blob_t;
+#pragma pack(pop)
+
+typedef struct _hash_ {
+    struct _hash_ *next;
+
+    uint32_t	crc,
+		adler,
+		length;
+    uint64_t	offset;
+} hdz_hash_t;
+
+typedef struct {
+    FILE	*fp;			/* image file */
+    FILE	*sfp;			/* blob store (may be fp) */
+    FILE	*ofp;			/* write overlay, if any */
+
+    int8_t	rdonly,			/* image is READ-ONLY */
+		direct,			/* writes go to the blobs */
+		dirty;			/* index needs to be written */
+    int		level;			/* compression level */
+
+    hdz_hdr_t	hdr;
+    hdz_ent_t	*index;
+
+    uint64_t	store_end;		/* append position in store */
+    hdz_hash_t	**hash;			/* dedup hash, only if direct */
+
+    uint32_t	*map;			/* overlay slot map */
+    uint32_t	slots;			/* overlay slots in use */
+    uint64_t	ovl_base;		/* offset of first overlay slot */
+
+    uint32_t	cached;			/* block currently in the cache */
+    uint8_t	*cache;			/* decompressed block */
+    uint8_t	*zbuf;			/* compressed block */
+    uLongf	zlen;			/* size of zbuf */
+
+    wchar_t	ovl_fn[260];		/* name of overlay file */
+} hdz_t;
+
+
+static const uint8_t hdz_magic[8] = { 'V','A','R','C','H','D','Z',0x1a };
+static const uint8_t store_magic[8] = { 'V','A','R','C','H','D','S',0x1a };
+static const uint8_t ovl_magic[8] = { 'V','A','R','C','H','D','O',0x1a };
+
+
+/* Create the full name of a blob store, relative to the image. */
+static void
+store_path(wchar_t *dest, int sz, const wchar_t *fn, const char *name)
+{
+    const wchar_t *sep;
+    wchar_t temp[256];
+    int i;
+
+    mbstowcs(temp, name, sizeof_w(temp));
+    temp[sizeof_w(temp) - 1] = L'\0';
+
+    /* Absolute pathnames are used as-is. */
+    if ((temp[0] == L'/') || (temp[0] == L'\\') || (temp[1] == L':')) {
+	wcsncpy(dest, temp, sz);
+	dest[sz - 1] = L'\0';
+	return;
+    }
+
+    /* Otherwise, the store lives in (or below) the image's folder. */
+    sep = NULL;
+    for (i = 0; fn[i] != L'\0'; i++)
+	if ((fn[i] == L'/') || (fn[i] == L'\\'))
+		sep = &fn[i];
+
+    i = 0;
+    if (sep != NULL) {
+	i = (int)(sep - fn) + 1;
+	if (i > (sz - 1))
+		i = sz - 1;
+	wcsncpy(dest, fn, i);
+    }
+    wcsncpy(&dest[i], temp, sz - i);
+    dest[sz - 1] = L'\0';
+}
+
+
+static int
+is_zero(const uint8_t *bufp, uint32_t len)
+{
+    const uint32_t *p = (const uint32_t *)bufp;
+
+    len >>= 2;
+    while (len--)
+	if (*p++ != 0) return(0);
+
+    return(1);
+}
+
+
+static void
+hash_add(hdz_t *dev, const hdz_blob_t *blob, uint64_t offset)
+{
+    hdz_hash_t *h;
+    int i = blob->crc & (HDZ_HASH_SIZE - 1);
+
+    h = (hdz_hash_t *)mem_alloc(sizeof(hdz_hash_t));
+    h->crc = blob->crc;
+    h->adler = blob->adler;
+    h->length = blob->length;
+    h->offset = offset;
+    h->next = dev->hash[i];
+    dev->hash[i] = h;
+}
+
+
+static void
+hash_free(hdz_t *dev)
+{
+    hdz_hash_t *h, *n;
+    int i;
+
+    if (dev->hash == NULL) return;
+
+    for (i = 0; i < HDZ_HASH_SIZE; i++) {
+	for (h = dev->hash[i]; h != NULL; h = n) {
+		n = h->next;
+		free(h);
+	}
+    }
+
+    free(dev->hash);
+    dev->hash = NULL;
+}
+
+
+/* Walk all blobs in the store, and (optionally) hash them. */
+static int
+store_scan(hdz_t *dev, uint64_t start)
+{
+    hdz_blob_t blob;
+    uint64_t pos;
+
+    fseeko64(dev->sfp, 0, SEEK_END);
+    dev->store_end = ftello64(dev->sfp);
+    if (dev->hash == NULL)
+	return(1);
+
+    for (pos = start; (pos + sizeof(blob)) <= dev->store_end; ) {
+	fseeko64(dev->sfp, pos, SEEK_SET);
+	if (fread(&blob, 1, sizeof(blob), dev->sfp) != sizeof(blob))
+		break;
+	if (blob.magic != HDZ_BLOB_MAGIC) {
+		ERRLOG("HDZ: bad blob at offset %llu in store\n", pos);
+		return(0);
+	}
+	pos += sizeof(blob);
+	hash_add(dev, &blob, pos);
+	pos += blob.length;
+    }
+
+    /* Anything after the last complete blob is garbage. */
+    if (pos < dev->store_end)
+	dev->store_end = pos;
+
+    return(1);
+}
+
+
+/* Read a blob, and decompress it into a buffer. */
+static int
+blob_read(hdz_t *dev, uint64_t offset, uint32_t length, uint8_t *bufp)
+{
+    uint32_t bs = dev->hdr.block_size;
+    uLongf len = bs;
+
+    if (offset == 0) {
+	memset(bufp, 0x00, bs);
+	return(1);
+    }
+
+    fseeko64(dev->sfp, offset, SEEK_SET);
+    if (length == bs) {
+	/* Incompressible block, stored as-is. */
+	return(fread(bufp, 1, bs, dev->sfp) == bs);
+    }
+
+    if (fread(dev->zbuf, 1, length, dev->sfp) != length)
+	return(0);
+
+    if (uncompress(bufp, &len, dev->zbuf, length) != Z_OK || len != bs)
+	return(0);
+
+    return(1);
+}
+
+
+/* Store a block as a blob, re-using an identical one if we have it. */
+static int
+blob_write(hdz_t *dev, uint32_t block, const uint8_t *data)
+{
+    uint32_t bs = dev->hdr.block_size;
+    hdz_ent_t *ent = &dev->index[block];
+    hdz_blob_t blob;
+    hdz_hash_t *h;
+    uint8_t *temp;
+    uLongf len;
+
+    if (is_zero(data, bs)) {
+	ent->offset = 0;
+	ent->length = 0;
+	ent->crc = 0;
+	dev->dirty = 1;
+	return(1);
+    }
+
+    blob.magic = HDZ_BLOB_MAGIC;
+    blob.crc = crc32(0L, data, bs);
+    blob.adler = adler32(1L, data, bs);
+
+    /* See if we already have this block somewhere. */
+    temp = NULL;
+    for (h = dev->hash[blob.crc & (HDZ_HASH_SIZE - 1)]; h != NULL; h = h->next) {
+	if ((h->crc != blob.crc) || (h->adler != blob.adler)) continue;
+
+	/* Checksums match, so make sure the data does, too. */
+	if (temp == NULL)
+		temp = (uint8_t *)mem_alloc(bs);
+	if (! blob_read(dev, h->offset, h->length, temp)) continue;
+	if (memcmp(temp, data, bs)) continue;
+
+	ent->offset = h->offset;
+	ent->length = h->length;
+	ent->crc = blob.crc;
+	dev->dirty = 1;
+	free(temp);
+	return(1);
+    }
+    if (temp != NULL)
+	free(temp);
+
+    /* New data, compress it (or not, if that does not help.) */
+    len = dev->zlen;
+    if ((compress2(dev->zbuf, &len, data, bs, dev->level) == Z_OK) &&
+	(len < bs)) {
+	blob.length = (uint32_t)len;
+	data = dev->zbuf;
+    } else
+	blob.length = bs;
+
+    fseeko64(dev->sfp, dev->store_end, SEEK_SET);
+    if ((fwrite(&blob, 1, sizeof(blob), dev->sfp) != sizeof(blob)) ||
+	(fwrite(data, 1, blob.length, dev->sfp) != blob.length)) {
+	ERRLOG("HDZ: unable to write blob store\n");
+	return(0);
+    }
+
+    ent->offset = dev->store_end + sizeof(blob);
+    ent->length = blob.length;
+    ent->crc = blob.crc;
+    dev->store_end = ent->offset + blob.length;
+    dev->dirty = 1;
+
+    hash_add(dev, &blob, ent->offset);
+
+    return(1);
+}
+
+
+/* Open (and optionally create) the overlay file. */
+static int
+ovl_open(hdz_t *dev, int create)
+{
+    uint8_t temp[HDZ_HDR_SIZE];
+    uint32_t i, n = dev->hdr.blocks;
+
+    dev->map = (uint32_t *)mem_alloc(n * sizeof(uint32_t));
+    memset(dev->map, 0x00, n * sizeof(uint32_t));
+    dev->ovl_base = (HDZ_HDR_SIZE + (n * sizeof(uint32_t)) + 4095) & ~4095ULL;
+    dev->slots = 0;
+
+    dev->ofp = plat_fopen(dev->ovl_fn, dev->rdonly ? L"rb" : L"rb+");
+    if (dev->ofp != NULL) {
+	memset(temp, 0x00, sizeof(temp));
+	(void)fread(temp, 1, sizeof(temp), dev->ofp);
+	if (memcmp(temp, ovl_magic, 8) ||
+	    (*(uint32_t *)&temp[8] != dev->hdr.stamp) ||
+	    (*(uint32_t *)&temp[12] != dev->hdr.block_size) ||
+	    (*(uint32_t *)&temp[16] != n)) {
+		ERRLOG("HDZ: overlay '%ls' does not belong to this image\n",
+							dev->ovl_fn);
+		(void)fclose(dev->ofp);
+		dev->ofp = NULL;
+		return(0);
+	}
+
+	if (fread(dev->map, sizeof(uint32_t), n, dev->ofp) != n) {
+		ERRLOG("HDZ: overlay '%ls' is truncated\n", dev->ovl_fn);
+		(void)fclose(dev->ofp);
+		dev->ofp = NULL;
+		return(0);
+	}
+
+	for (i = 0; i < n; i++)
+		if (dev->map[i] > dev->slots)
+			dev->slots = dev->map[i];
+
+	DEBUG("HDZ: overlay has %u modified blocks\n", dev->slots);
+	return(1);
+    }
+
+    if (! create)
+	return(1);
+
+    dev->ofp = plat_fopen(dev->ovl_fn, L"wb+");
+    if (dev->ofp == NULL) {
+	ERRLOG("HDZ: unable to create overlay '%ls'\n", dev->ovl_fn);
+	return(0);
+    }
+
+    memset(temp, 0x00, sizeof(temp));
+    memcpy(temp, ovl_magic, 8);
+    *(uint32_t *)&temp[8] = dev->hdr.stamp;
+    *(uint32_t *)&temp[12] = dev->hdr.block_size;
+    *(uint32_t *)&temp[16] = n;
+    if ((fwrite(temp, 1, sizeof(temp), dev->ofp) != sizeof(temp)) ||
+	(fwrite(dev->map, sizeof(uint32_t), n, dev->ofp) != n) ||
+	(fflush(dev->ofp) != 0)) {
+	ERRLOG("HDZ: unable to write overlay '%ls'\n", dev->ovl_fn);
+	(void)fclose(dev->ofp);
+	dev->ofp = NULL;
+	return(0);
+    }
+
+    return(1);
+}
+
+
+/* Load a block into the cache, from the overlay or from the blobs. */
+static uint8_t *
+block_get(hdz_t *dev, uint32_t block)
+{
+    hdz_ent_t *ent;
+    uint64_t addr;
+
+    if (dev->cached == block)
+	return(dev->cache);
+    dev->cached = HDZ_NONE;
+
+    if ((dev->map != NULL) && dev->map[block]) {
+	addr = dev->ovl_base +
+	       ((uint64_t)(dev->map[block] - 1) * dev->hdr.block_size);
+	fseeko64(dev->ofp, addr, SEEK_SET);
+	if (fread(dev->cache, 1, dev->hdr.block_size, dev->ofp) != dev->hdr.block_size) {
+		ERRLOG("HDZ: read error on overlay, block %u\n", block);
+		return(NULL);
+	}
+    } else {
+	ent = &dev->index[block];
+	if (! blob_read(dev, ent->offset, ent->length, dev->cache)) {
+		ERRLOG("HDZ: read error on block %u\n", block);
+		return(NULL);
+	}
+	if (ent->offset && (crc32(0L, dev->cache, dev->hdr.block_size) != ent->crc)) {
+		ERRLOG("HDZ: CRC error on block %u\n", block);
+		return(NULL);
+	}
+    }
+
+    dev->cached = block;
+
+    return(dev->cache);
+}
+
+
+/* Write the cached block back to the overlay or to the blobs. */
+static int
+block_put(hdz_t *dev, uint32_t block)
+{
+    uint32_t bs = dev->hdr.block_size;
+    uint64_t addr;
+
+    if (dev->direct)
+	return(blob_write(dev, block, dev->cache));
+
+    if ((dev->ofp == NULL) && !ovl_open(dev, 1))
+	return(0);
+
+    if (dev->map[block] == 0) {
+	/* First write to this block, allocate a slot for it. */
+	dev->map[block] = ++dev->slots;
+	fseeko64(dev->ofp, HDZ_HDR_SIZE + (block * sizeof(uint32_t)), SEEK_SET);
+	if (fwrite(&dev->map[block], sizeof(uint32_t), 1, dev->ofp) != 1) {
+		ERRLOG("HDZ: write error on overlay map, block %u\n", block);
+		dev->map[block] = 0;
+		dev->slots--;
+		return(0);
+	}
+    }
+
+    /*
+     * Flush every write, so that the guest's idea of what is on
+     * the disk matches the overlay file if we go down hard.
+     */
+    addr = dev->ovl_base + ((uint64_t)(dev->map[block] - 1) * bs);
+    fseeko64(dev->ofp, addr, SEEK_SET);
+    if ((fwrite(dev->cache, 1, bs, dev->ofp) != bs) ||
+	(fflush(dev->ofp) != 0)) {
+	ERRLOG("HDZ: write error on overlay, block %u\n", block);
+	return(0);
+    }
+
+    return(1);
+}
+
+
+static void
+hdz_free(hdz_t *dev)
+{
+    if (dev->ofp != NULL)
+	(void)fclose(dev->ofp);
+    if ((dev->sfp != NULL) && (dev->sfp != dev->fp))
+	(void)fclose(dev->sfp);
+    if (dev->fp != NULL)
+	(void)fclose(dev->fp);
+
+    hash_free(dev);
+
+    if (dev->index != NULL)
+	free(dev->index);
+    if (dev->map != NULL)
+	free(dev->map);
+    if (dev->cache != NULL)
+	free(dev->cache);
+    if (dev->zbuf != NULL)
+	free(dev->zbuf);
+
+    free(dev);
+}
+
+
+int
+image_is_hdz(const wchar_t *s, int check_signature)
+{
+    uint8_t temp[8];
+    int len;
+    FILE *f;
+
+    len = (int)wcslen(s);
+    if ((len < 4) || (s[0] == L'.'))
+	return(0);
+
+    if (wcscasecmp(&s[len - 4], L".HDZ"))
+	return(0);
+
+    if (check_signature) {
+	f = plat_fopen((wchar_t *)s, L"rb");
+	if (f == NULL)
+		return(0);
+	len = (int)fread(temp, 1, sizeof(temp), f);
+	(void)fclose(f);
+	if ((len != sizeof(temp)) || memcmp(temp, hdz_magic, sizeof(temp)))
+		return(0);
+    }
+
+    return(1);
+}
+
+
+/*
+ * Create a new, empty image. If a store name is given, the
+ * blobs will go into that file, which is created if needed.
+ */
+int
+hdz_create(const wchar_t *fn, const char *store, uint32_t block_size,
+	   uint32_t spt, uint32_t hpc, uint32_t tracks)
+{
+    uint8_t temp[HDZ_HDR_SIZE];
+    wchar_t path[1024];
+    hdz_hdr_t hdr;
+    hdz_ent_t ent;
+    uint32_t i;
+    FILE *fp;
+
+    if (block_size == 0)
+	block_size = HDZ_BLOCK_SIZE;
+    if ((block_size < 4096) || (block_size & (block_size - 1))) {
+	ERRLOG("HDZ: invalid block size %u\n", block_size);
+	return(0);
+    }
+
+    memset(&hdr, 0x00, sizeof(hdr));
+    memcpy(hdr.magic, hdz_magic, sizeof(hdr.magic));
+    hdr.size = ((uint64_t)spt * hpc * tracks) << 9;
+    hdr.sector_size = 512;
+    hdr.spt = spt;
+    hdr.hpc = hpc;
+    hdr.tracks = tracks;
+    hdr.version = HDZ_VERSION;
+    hdr.block_size = block_size;
+    hdr.blocks = (uint32_t)((hdr.size + block_size - 1) / block_size);
+    hdr.stamp = (uint32_t)time(NULL) ^ (uint32_t)(hdr.size >> 9);
+    hdr.index = HDZ_HDR_SIZE;
+    if (store != NULL) {
+	strncpy(hdr.store, store, sizeof(hdr.store) - 1);
+
+	/* Make sure the store exists. */
+	store_path(path, sizeof_w(path), fn, store);
+	fp = plat_fopen(path, L"rb");
+	if (fp == NULL) {
+		fp = plat_fopen(path, L"wb");
+		if (fp == NULL) {
+			ERRLOG("HDZ: unable to create store '%ls'\n", path);
+			return(0);
+		}
+		memset(temp, 0x00, sizeof(temp));
+		memcpy(temp, store_magic, 8);
+		*(uint32_t *)&temp[8] = HDZ_VERSION;
+		fwrite(temp, 1, sizeof(temp), fp);
+	}
+	(void)fclose(fp);
+    }
+
+    fp = plat_fopen(fn, L"wb");
+    if (fp == NULL) {
+	ERRLOG("HDZ: unable to create image '%ls'\n", fn);
+	return(0);
+    }
+
+    fwrite(&hdr, 1, sizeof(hdr), fp);
+
+    /* All blocks start out as zero blocks. */
+    memset(&ent, 0x00, sizeof(ent));
+    for (i = 0; i < hdr.blocks; i++)
+	fwrite(&ent, 1, sizeof(ent), fp);
+
+    i = ferror(fp);
+    (void)fclose(fp);
+
+    return(! i);
+}
+
+
+/*
+ * Open an image.
+ *
+ * In normal mode, the compressed data is never touched, and all
+ * writes go into the overlay file. In direct mode (used by the
+ * conversion tool) blocks are compressed, deduplicated and added
+ * to the blob store.
+ */
+void *
+hdz_open(const wchar_t *fn, int rdonly, int direct)
+{
+    wchar_t path[1024];
+    uint8_t temp[16];
+    hdz_t *dev;
+    uint32_t n;
+
+    dev = (hdz_t *)mem_alloc(sizeof(hdz_t));
+    memset(dev, 0x00, sizeof(hdz_t));
+    dev->rdonly = rdonly;
+    dev->direct = direct && !rdonly;
+    dev->level = Z_BEST_COMPRESSION;
+    dev->cached = HDZ_NONE;
+
+    dev->fp = plat_fopen(fn, dev->direct ? L"rb+" : L"rb");
+    if (dev->fp == NULL) {
+	ERRLOG("HDZ: unable to open image '%ls'\n", fn);
+	free(dev);
+	return(NULL);
+    }
+
+    if ((fread(&dev->hdr, 1, sizeof(dev->hdr), dev->fp) != sizeof(dev->hdr)) ||
+	memcmp(dev->hdr.magic, hdz_magic, sizeof(dev->hdr.magic)) ||
+	(dev->hdr.version != HDZ_VERSION) ||
+	(dev->hdr.sector_size != 512) ||
+	(dev->hdr.block_size < 4096) ||
+	(dev->hdr.block_size & (dev->hdr.block_size - 1)) ||
+	(dev->hdr.blocks != (uint32_t)((dev->hdr.size + dev->hdr.block_size - 1) / dev->hdr.block_size))) {
+	ERRLOG("HDZ: '%ls' is not a valid image\n", fn);
+	hdz_free(dev);
+	return(NULL);
+    }
+    dev->hdr.store[sizeof(dev->hdr.store) - 1] = '\0';
+
+    n = dev->hdr.blocks;
+    dev->index = (hdz_ent_t *)mem_alloc(n * sizeof(hdz_ent_t));
+    fseeko64(dev->fp, dev->hdr.index, SEEK_SET);
+    if (fread(dev->index, sizeof(hdz_ent_t), n, dev->fp) != n) {
+	ERRLOG("HDZ: '%ls' has a truncated index\n", fn);
+	hdz_free(dev);
+	return(NULL);
+    }
+
+    dev->cache = (uint8_t *)mem_alloc(dev->hdr.block_size);
+    dev->zlen = compressBound(dev->hdr.block_size);
+    dev->zbuf = (uint8_t *)mem_alloc(dev->zlen);
+
+    if (dev->hdr.store[0] != '\0') {
+	store_path(path, sizeof_w(path), fn, dev->hdr.store);
+	dev->sfp = plat_fopen(path, dev->direct ? L"rb+" : L"rb");
+	memset(temp, 0x00, sizeof(temp));
+	if (dev->sfp != NULL)
+		(void)fread(temp, 1, sizeof(temp), dev->sfp);
+	if ((dev->sfp == NULL) || memcmp(temp, store_magic, 8)) {
+		ERRLOG("HDZ: unable to open blob store '%ls'\n", path);
+		hdz_free(dev);
+		return(NULL);
+	}
+    } else
+	dev->sfp = dev->fp;
+
+    if (dev->direct) {
+	/* We need to know about all existing blobs. */
+	dev->hash = (hdz_hash_t **)mem_alloc(HDZ_HASH_SIZE * sizeof(hdz_hash_t *));
+	memset(dev->hash, 0x00, HDZ_HASH_SIZE * sizeof(hdz_hash_t *));
+	if (! store_scan(dev, (dev->sfp == dev->fp) ?
+			 dev->hdr.index + (n * sizeof(hdz_ent_t)) : HDZ_HDR_SIZE)) {
+		hdz_free(dev);
+		return(NULL);
+	}
+    } else {
+	/* Pick up any earlier modifications. */
+	wcsncpy(dev->ovl_fn, fn, sizeof_w(dev->ovl_fn) - 5);
+	wcscat(dev->ovl_fn, L".ovl");
+	if (! ovl_open(dev, 0)) {
+		hdz_free(dev);
+		return(NULL);
+	}
+    }
+
+    INFO("HDZ: opened '%ls' (%u blocks of %uK%s)\n",
+	 fn, n, dev->hdr.block_size >> 10, dev->ofp ? ", overlay" : "");
+
+    return(dev);
+}
+
+
+/* Close an image, returns 0 if pending data could not be written. */
+int
+hdz_close(void *priv)
+{
+    hdz_t *dev = (hdz_t *)priv;
+    int ret = 1;
+
+    if (dev == NULL) return(1);
+
+    if (dev->dirty) {
+	fseeko64(dev->fp, dev->hdr.index, SEEK_SET);
+	if (fwrite(dev->index, sizeof(hdz_ent_t),
+		   dev->hdr.blocks, dev->fp) != dev->hdr.blocks) {
+		ERRLOG("HDZ: unable to write block index\n");
+		ret = 0;
+	}
+    }
+
+    if ((dev->sfp != NULL) && (dev->sfp != dev->fp) && fflush(dev->sfp)) {
+	ERRLOG("HDZ: unable to write blob store\n");
+	ret = 0;
+    }
+    if ((dev->fp != NULL) && fflush(dev->fp)) {
+	ERRLOG("HDZ: unable to write image\n");
+	ret = 0;
+    }
+    if ((dev->ofp != NULL) && fflush(dev->ofp)) {
+	ERRLOG("HDZ: unable to write overlay '%ls'\n", dev->ovl_fn);
+	ret = 0;
+    }
+
+    hdz_free(dev);
+
+    return(ret);
+}
+
+
+void
+hdz_geometry(void *priv, uint32_t *spt, uint32_t *hpc, uint32_t *tracks)
+{
+    hdz_t *dev = (hdz_t *)priv;
+
+    *spt = dev->hdr.spt;
+    *hpc = dev->hdr.hpc;
+    *tracks = dev->hdr.tracks;
+}
+
+
+uint32_t
+hdz_sectors(void *priv)
+{
+    hdz_t *dev = (hdz_t *)priv;
+
+    return((uint32_t)(dev->hdr.size >> 9));
+}
+
+
+void
+hdz_set_level(void *priv, int level)
+{
+    hdz_t *dev = (hdz_t *)priv;
+
+    dev->level = level;
+}
+
+
+int
+hdz_read(void *priv, uint32_t sector, uint32_t count, uint8_t *bufp)
+{
+    hdz_t *dev = (hdz_t *)priv;
+    uint32_t spb = dev->hdr.block_size >> 9;
+    uint32_t block, skip, n;
+    uint8_t *data;
+
+    if (((uint64_t)sector + count) > (dev->hdr.size >> 9))
+	return(0);
+
+    while (count > 0) {
+	block = sector / spb;
+	skip = sector % spb;
+	n = MIN(count, spb - skip);
+
+	if ((data = block_get(dev, block)) == NULL)
+		return(0);
+	memcpy(bufp, data + (skip << 9), n << 9);
+
+	bufp += (n << 9);
+	sector += n;
+	count -= n;
+    }
+
+    return(1);
+}
+
+
+/* Write sectors to the image. A NULL buffer writes zeroes. */
+int
+hdz_write(void *priv, uint32_t sector, uint32_t count, const uint8_t *bufp)
+{
+    hdz_t *dev = (hdz_t *)priv;
+    uint32_t spb = dev->hdr.block_size >> 9;
+    uint32_t block, skip, n;
+
+    if (dev->rdonly || (((uint64_t)sector + count) > (dev->hdr.size >> 9)))
+	return(0);
+
+    while (count > 0) {
+	block = sector / spb;
+	skip = sector % spb;
+	n = MIN(count, spb - skip);
+
+	if (n < spb) {
+		/* Partial block, merge with the existing data. */
+		if (block_get(dev, block) == NULL)
+			return(0);
+	}
+	dev->cached = block;
+
+	if (bufp != NULL) {
+		memcpy(dev->cache + (skip << 9), bufp, n << 9);
+		bufp += (n << 9);
+	} else
+		memset(dev->cache + (skip << 9), 0x00, n << 9);
+
+	if (! block_put(dev, block)) {
+		dev->cached = HDZ_NONE;
+		return(0);
+	}
+
+	sector += n;
+	count -= n;
+    }
+
+    return(1);
+}
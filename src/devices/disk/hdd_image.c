@@ -14,7 +14,7 @@
  *		merged with hdd.c, since that is the scope of hdd.c. The
  *		actual format handlers can then be in hdd_format.c etc.
  *
- * Version:	@(#)hdd_image.c	1.0.11	2019/05/23
+ * Version:	@(#)hdd_image.c	1.0.12	2019/06/08
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -78,9 +78,12 @@
 #define VHD_OFFSET_SAVED_STATE 84
 #define VHD_OFFSET_RESERVED 85
 
+#define IMAGE_TYPE_HDZ	4
+
 
 typedef struct {
     FILE	*file;
+    void	*hdz;			/* compressed image handler */
     uint32_t	base;
     uint32_t	last_sector,
 		pos;
@@ -475,6 +478,38 @@ hdd_image_calc_chs(uint32_t *c, uint32_t *h, uint32_t *s, uint32_t size)
 }
 
 
+/* Load a compressed (HDZ) image, creating it if needed. */
+static int
+load_hdz(hdd_image_t *img, int id)
+{
+    wchar_t *fn = hdd[id].fn;
+    FILE *f;
+
+    f = plat_fopen(fn, L"rb");
+    if (f != NULL)
+	(void)fclose(f);
+    else if (hdd[id].wp || !hdz_create(fn, NULL, 0, hdd[id].spt,
+				       hdd[id].hpc, hdd[id].tracks)) {
+	DEBUG("HDZ: unable to create image\n");
+	memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
+	return 0;
+    }
+
+    img->hdz = hdz_open(fn, hdd[id].wp, 0);
+    if (img->hdz == NULL) {
+	memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
+	return 0;
+    }
+
+    hdz_geometry(img->hdz, &hdd[id].spt, &hdd[id].hpc, &hdd[id].tracks);
+    img->last_sector = hdz_sectors(img->hdz) - 1;
+    img->type = IMAGE_TYPE_HDZ;
+    img->loaded = 1;
+
+    return 1;
+}
+
+
 static int
 prepare_new_hard_disk(hdd_image_t *img, uint64_t full_size)
 {
@@ -549,14 +584,21 @@ hdd_image_load(int id)
 		(void)fclose(img->file);
 		img->file = NULL;
 	}
+	if (img->hdz) {
+		hdz_close(img->hdz);
+		img->hdz = NULL;
+	}
 	img->loaded = 0;
     }
 
+    img->pos = 0;
+
+    if (image_is_hdz(fn, 0))
+	return load_hdz(img, id);
+
     is_hdx[0] = image_is_hdx(fn, 0);
     is_hdx[1] = image_is_hdx(fn, 1);
 
-    img->pos = 0;
-
     /* Try to open existing hard disk image */
     img->file = plat_fopen(fn, L"rb+");
     if (img->file == NULL) {
@@ -773,6 +815,8 @@ hdd_image_seek(uint8_t id, uint32_t sector)
 
     img->pos = sector;
 
+    if (img->hdz != NULL) return;
+
     fseeko64(img->file, addr + img->base, SEEK_SET);
 }
 
@@ -783,6 +827,12 @@ hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
     hdd_image_t *img = &hdd_images[id];
     uint32_t i;
 
+    if (img->hdz != NULL) {
+	if (hdz_read(img->hdz, sector, count, buffer))
+		img->pos = sector + count - 1;
+	return;
+    }
+
     /* Move to the desired position in the image. */
     fseeko64(img->file, ((uint64_t)sector << 9LL) + img->base, SEEK_SET);
 
@@ -810,6 +860,9 @@ hdd_sectors(uint8_t id)
 {
     hdd_image_t *img = &hdd_images[id];
 
+    if (img->hdz != NULL)
+	return hdz_sectors(img->hdz);
+
     fseeko64(img->file, 0, SEEK_END);
 
     return (uint32_t) ((ftello64(img->file) - img->base) >> 9);
@@ -828,6 +881,12 @@ hdd_image_read_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 
     img->pos = sector;
 
+    if (img->hdz != NULL) {
+	if (! hdz_read(img->hdz, sector, transfer_sectors, buffer))
+		return 1;
+	return (count != transfer_sectors);
+    }
+
     fseeko64(img->file, ((uint64_t)sector << 9LL) + img->base, SEEK_SET);
     fread(buffer, 1, transfer_sectors << 9, img->file);
 
@@ -844,6 +903,12 @@ hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
     hdd_image_t *img = &hdd_images[id];
     uint32_t i;
 
+    if (img->hdz != NULL) {
+	if (hdz_write(img->hdz, sector, count, buffer))
+		img->pos = sector + count - 1;
+	return;
+    }
+
     /* Move to the desired position in the image. */
     fseeko64(img->file, ((uint64_t)sector << 9LL) + img->base, SEEK_SET);
 
@@ -874,6 +939,12 @@ hdd_image_write_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 
     img->pos = sector;
 
+    if (img->hdz != NULL) {
+	if (! hdz_write(img->hdz, sector, transfer_sectors, buffer))
+		return 1;
+	return (count != transfer_sectors);
+    }
+
     fseeko64(img->file, ((uint64_t)sector << 9LL) + img->base, SEEK_SET);
     fwrite(buffer, transfer_sectors << 9, 1, img->file);
 
@@ -891,6 +962,12 @@ hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
     uint8_t empty[512];
     uint32_t i = 0;
 
+    if (img->hdz != NULL) {
+	if (hdz_write(img->hdz, sector, count, NULL))
+		img->pos = sector + count - 1;
+	return;
+    }
+
     memset(empty, 0x00, sizeof(empty));
 
     /* Move to the desired position in the image. */
@@ -923,10 +1000,16 @@ hdd_image_zero_ex(uint8_t id, uint32_t sector, uint32_t count)
     if ((sectors - sector) < transfer_sectors)
 	transfer_sectors = sectors - sector;
 
-    memset(empty, 0x00, sizeof(empty));
-
     img->pos = sector;
 
+    if (img->hdz != NULL) {
+	if (! hdz_write(img->hdz, sector, transfer_sectors, NULL))
+		return 1;
+	return (count != transfer_sectors);
+    }
+
+    memset(empty, 0x00, sizeof(empty));
+
     fseeko64(img->file, ((uint64_t)sector << 9LL) + img->base, SEEK_SET);
 
     for (i = 0; i < transfer_sectors; i++) {
@@ -996,6 +1079,10 @@ hdd_image_unload(uint8_t id, int fn_preserve)
 		(void)fclose(img->file);
 		img->file = NULL;
 	}
+	if (img->hdz != NULL) {
+		hdz_close(img->hdz);
+		img->hdz = NULL;
+	}
 	img->loaded = 0;
     }
 
@@ -1022,5 +1109,10 @@ hdd_image_close(uint8_t id)
 	img->file = NULL;
     }
 
+    if (img->hdz != NULL) {
+	hdz_close(img->hdz);
+	img->hdz = NULL;
+    }
+
     memset(img, 0x00, sizeof(hdd_image_t));
 }
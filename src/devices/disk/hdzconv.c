@@ -0,0 +1,363 @@
+/*
+ * VARCem	Virtual ARchaeological Computer EMulator.
+ *		An emulator of (mostly) x86-based PC systems and devices,
+ *		using the ISA,EISA,VLB,MCA  and PCI system buses, roughly
+ *		spanning the era between 1981 and 1995.
+ *
+ *		This file is part of the VARCem Project.
+ *
+ *		Simple program to convert hard disk images to HDZ format.
+ *
+ *		Accepted input formats are raw (IMG), HDI, HDX, fixed-size
+ *		VHD and HDZ images. Converting an HDZ image to a new one
+ *		merges its write overlay (if any) into the new image.
+ *
+ *		Usage:	hdzconv [-s store] [-b kbytes] [-l level]
+ *				[-g cyl,hpc,spt] input output.hdz
+ *
+ * Version:	@(#)hdzconv.c	1.0.1	2019/07/03
+ *
+ * Author:	Fred N. van Kempen, <decwiz@yahoo.com>
+ *
+ *		Copyright 2019 Fred N. van Kempen.
+ *
+ *		Redistribution and  use  in source  and binary forms, with
+ *		or  without modification, are permitted  provided that the
+ *		following conditions are met:
+ *
+ *		1. Redistributions of  source  code must retain the entire
+ *		   above notice, this list of conditions and the following
+ *		   disclaimer.
+ *
+ *		2. Redistributions in binary form must reproduce the above
+ *		   copyright  notice,  this list  of  conditions  and  the
+ *		   following disclaimer in  the documentation and/or other
+ *		   materials provided with the distribution.
+ *
+ *		3. Neither the  name of the copyright holder nor the names
+ *		   of  its  contributors may be used to endorse or promote
+ *		   products  derived from  this  software without specific
+ *		   prior written permission.
+ *
+ * THIS SOFTWARE  IS  PROVIDED BY THE  COPYRIGHT  HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND  ANY EXPRESS  OR  IMPLIED  WARRANTIES,  INCLUDING, BUT  NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE  ARE  DISCLAIMED. IN  NO  EVENT  SHALL THE COPYRIGHT
+ * HOLDER OR  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL,  EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING,  BUT  NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE  GOODS OR SERVICES;  LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON  ANY
+ * THEORY OF  LIABILITY, WHETHER IN  CONTRACT, STRICT  LIABILITY, OR  TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING  IN ANY  WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define _LARGEFILE_SOURCE
+#define _LARGEFILE64_SOURCE
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <wchar.h>
+#include "../../emu.h"
+#include "../../plat.h"
+#include "hdd.h"
+
+
+typedef struct {
+    FILE	*fp;			/* plain image file */
+    void	*hdz;			/* or, HDZ image */
+    uint64_t	base;			/* offset of sector 0 */
+    uint64_t	size;			/* size of data in bytes */
+    uint32_t	spt,
+		hpc,
+		tracks;
+} source_t;
+
+
+static uint32_t
+be32(const uint8_t *p)
+{
+    return(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+	   ((uint32_t)p[2] << 8) | p[3]);
+}
+
+
+/* Figure out what kind of image we have, and get its geometry. */
+static int
+source_open(source_t *src, const wchar_t *fn, const char *name)
+{
+    uint8_t temp[512];
+    uint32_t sector_size;
+    const char *ext;
+    int len;
+
+    memset(src, 0x00, sizeof(source_t));
+
+    ext = strrchr(name, '.');
+    if (ext == NULL)
+	ext = "";
+
+    if (! strcasecmp(ext, ".hdz")) {
+	src->hdz = hdz_open(fn, 1, 0);
+	if (src->hdz == NULL)
+		return(0);
+	hdz_geometry(src->hdz, &src->spt, &src->hpc, &src->tracks);
+	src->size = (uint64_t)hdz_sectors(src->hdz) << 9;
+	return(1);
+    }
+
+    src->fp = plat_fopen(fn, L"rb");
+    if (src->fp == NULL) {
+	fprintf(stderr, "Unable to open '%s' !\n", name);
+	return(0);
+    }
+
+    memset(temp, 0x00, sizeof(temp));
+    len = (int)fread(temp, 1, sizeof(temp), src->fp);
+
+    if (! strcasecmp(ext, ".hdi")) {
+	src->base = *(uint32_t *)&temp[0x08];
+	src->size = *(uint32_t *)&temp[0x0c];
+	sector_size = *(uint32_t *)&temp[0x10];
+	src->spt = *(uint32_t *)&temp[0x14];
+	src->hpc = *(uint32_t *)&temp[0x18];
+	src->tracks = *(uint32_t *)&temp[0x1c];
+    } else if (! strcasecmp(ext, ".hdx")) {
+	if ((len < 0x28) || (*(uint64_t *)&temp[0] != 0xD778A82044445459ll)) {
+		fprintf(stderr, "'%s' is not a valid HDX image !\n", name);
+		return(0);
+	}
+	src->base = 0x28;
+	src->size = *(uint64_t *)&temp[0x08];
+	sector_size = *(uint32_t *)&temp[0x10];
+	src->spt = *(uint32_t *)&temp[0x14];
+	src->hpc = *(uint32_t *)&temp[0x18];
+	src->tracks = *(uint32_t *)&temp[0x1c];
+    } else if (! strcasecmp(ext, ".vhd")) {
+	/* The footer lives in the last sector of the file. */
+	fseeko64(src->fp, -512, SEEK_END);
+	if ((fread(temp, 1, 512, src->fp) != 512) ||
+	    memcmp(temp, "conectix", 8) || (be32(&temp[60]) != 2)) {
+		fprintf(stderr, "'%s' is not a fixed-size VHD image !\n", name);
+		return(0);
+	}
+	src->size = ((uint64_t)be32(&temp[40]) << 32) | be32(&temp[44]);
+	sector_size = 512;
+	src->tracks = (temp[56] << 8) | temp[57];
+	src->hpc = temp[58];
+	src->spt = temp[59];
+    } else {
+	/* Raw image, guess the geometry from its size. */
+	fseeko64(src->fp, 0, SEEK_END);
+	src->size = ftello64(src->fp);
+	sector_size = 512;
+	if (((src->size % (17 * 512)) == 0) && (src->size <= 142606336)) {
+		src->spt = 17;
+		src->hpc = (src->size <= 26738688) ? 4 : 16;
+	} else {
+		src->spt = 63;
+		src->hpc = 16;
+	}
+	src->tracks = (uint32_t)(((src->size >> 9) / src->hpc) / src->spt);
+    }
+
+    if (sector_size != 512) {
+	fprintf(stderr, "'%s' has a sector size of %u, not supported !\n",
+							name, sector_size);
+	return(0);
+    }
+
+    return(1);
+}
+
+
+static int
+source_read(source_t *src, uint32_t sector, uint32_t count, uint8_t *bufp)
+{
+    uint32_t len = count << 9;
+
+    if (src->hdz != NULL)
+	return(hdz_read(src->hdz, sector, count, bufp));
+
+    /* Anything past the end of the file reads as zeroes. */
+    memset(bufp, 0x00, len);
+    fseeko64(src->fp, src->base + ((uint64_t)sector << 9), SEEK_SET);
+    (void)fread(bufp, 1, len, src->fp);
+
+    return(! ferror(src->fp));
+}
+
+
+static void
+source_close(source_t *src)
+{
+    if (src->hdz != NULL)
+	hdz_close(src->hdz);
+    if (src->fp != NULL)
+	(void)fclose(src->fp);
+}
+
+
+static void
+usage(void)
+{
+    fprintf(stderr,
+	"Usage: hdzconv [-s store] [-b kbytes] [-l level] [-g cyl,hpc,spt] input output.hdz\n\n"
+	"  -s store   put the data in a (shared) blob store file\n"
+	"  -b kbytes  compression block size (default %u)\n"
+	"  -l level   zlib compression level, 1-9 (default 9)\n"
+	"  -g c,h,s   override the geometry of the input image\n",
+	HDZ_BLOCK_SIZE >> 10);
+}
+
+
+void
+pclog(int level, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (fmt == NULL || level > LOG_INFO) return;
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+}
+
+
+void *
+mem_alloc(size_t sz)
+{
+    void *ptr = malloc(sz);
+
+    if (ptr == NULL) {
+	fprintf(stderr, "Out of memory !\n");
+	exit(1);
+    }
+
+    return(ptr);
+}
+
+
+FILE *
+plat_fopen(const wchar_t *path, const wchar_t *mode)
+{
+#ifdef _WIN32
+    return(_wfopen(path, mode));
+#else
+    char temp[1024], m[8];
+
+    wcstombs(temp, path, sizeof(temp));
+    wcstombs(m, mode, sizeof(m));
+
+    return(fopen(temp, m));
+#endif
+}
+
+
+int
+main(int argc, char **argv)
+{
+    wchar_t infn[1024], outfn[1024];
+    uint32_t c = 0, h = 0, s = 0;
+    uint32_t bs = HDZ_BLOCK_SIZE;
+    uint32_t sector, sectors, n;
+    char *store = NULL;
+    int level = 9;
+    source_t src;
+    uint8_t *bufp;
+    void *dst;
+    int i, ret;
+
+    for (i = 1; i < argc; i++) {
+	if (argv[i][0] != '-') break;
+
+	if (! strcmp(argv[i], "-s") && (i + 1) < argc) {
+		store = argv[++i];
+	} else if (! strcmp(argv[i], "-b") && (i + 1) < argc) {
+		bs = atoi(argv[++i]) << 10;
+	} else if (! strcmp(argv[i], "-l") && (i + 1) < argc) {
+		level = atoi(argv[++i]);
+	} else if (! strcmp(argv[i], "-g") && (i + 1) < argc) {
+		if (sscanf(argv[++i], "%u,%u,%u", &c, &h, &s) != 3) {
+			usage();
+			return(1);
+		}
+	} else {
+		usage();
+		return(1);
+	}
+    }
+
+    if ((argc - i) != 2) {
+	usage();
+	return(1);
+    }
+
+    mbstowcs(infn, argv[i], sizeof_w(infn));
+    mbstowcs(outfn, argv[i + 1], sizeof_w(outfn));
+    if (! image_is_hdz(outfn, 0)) {
+	fprintf(stderr, "Output file '%s' must have a .hdz extension !\n",
+							argv[i + 1]);
+	return(1);
+    }
+
+    if (! source_open(&src, infn, argv[i])) {
+	source_close(&src);
+	return(2);
+    }
+    if (c != 0) {
+	src.tracks = c;
+	src.hpc = h;
+	src.spt = s;
+    }
+    sectors = (uint32_t)(src.size >> 9);
+    if ((uint64_t)src.spt * src.hpc * src.tracks > sectors) {
+	fprintf(stderr, "Geometry %u,%u,%u is larger than the image !\n",
+					src.tracks, src.hpc, src.spt);
+	source_close(&src);
+	return(2);
+    }
+    sectors = src.spt * src.hpc * src.tracks;
+
+    printf("Converting '%s' (C=%u H=%u S=%u, %uMB)..\n",
+	argv[i], src.tracks, src.hpc, src.spt, sectors >> 11);
+
+    if (! hdz_create(outfn, store, bs, src.spt, src.hpc, src.tracks)) {
+	source_close(&src);
+	return(3);
+    }
+    dst = hdz_open(outfn, 0, 1);
+    if (dst == NULL) {
+	source_close(&src);
+	return(3);
+    }
+    hdz_set_level(dst, level);
+
+    bufp = (uint8_t *)mem_alloc(bs);
+    for (sector = 0; sector < sectors; sector += n) {
+	n = MIN(bs >> 9, sectors - sector);
+
+	if (! source_read(&src, sector, n, bufp) ||
+	    ! hdz_write(dst, sector, n, bufp)) {
+		fprintf(stderr, "\nConversion failed at sector %u !\n", sector);
+		break;
+	}
+
+	if ((sector % ((bs >> 9) * 64)) == 0)
+		printf("\r%3u%%", (uint32_t)(((uint64_t)sector * 100) / sectors));
+    }
+    if (sector >= sectors)
+	printf("\r100%%\n");
+    free(bufp);
+
+    ret = (sector < sectors) ? 4 : 0;
+    if (! hdz_close(dst)) {
+	fprintf(stderr, "Unable to finish writing '%s' !\n", argv[i + 1]);
+	ret = 4;
+    }
+    source_close(&src);
+
+    return(ret);
+}
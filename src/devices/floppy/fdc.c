@@ -9,7 +9,7 @@
  *		Implementation of the NEC uPD-765 and compatible floppy disk
  *		controller.
  *
- * Version:	@(#)fdc.c	1.0.24	2019/05/20
+ * Version:	@(#)fdc.c	1.0.25	2019/06/10
  *
  * Authors:	Miran Grca, <mgrca8@gmail.com>
  *		Sarah Walker, <tommowalker@tommowalker.co.uk>
@@ -255,6 +255,16 @@ fdc_is_mfm(fdc_t *fdc)
 }
 
 
+int
+fdc_is_dma(fdc_t *fdc)
+{
+    if ((fdc->flags & FDC_FLAG_PCJR) || !fdc->dma)
+	return(0);
+
+    return(1);
+}
+
+
 void
 fdc_request_next_sector_id(fdc_t *fdc)
 {
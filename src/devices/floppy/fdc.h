@@ -8,7 +8,7 @@
  *
  *		Definitions for the floppy disk	controller driver.
  *
- * Version:	@(#)fdc.h	1.0.9	2019/05/20
+ * Version:	@(#)fdc.h	1.0.10	2019/06/10
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -170,6 +170,7 @@ extern int	fdc_get_drive(fdc_t *fdc);
 extern int	fdc_get_perp(fdc_t *fdc);
 extern int	fdc_get_format_n(fdc_t *fdc);
 extern int	fdc_is_mfm(fdc_t *fdc);
+extern int	fdc_is_dma(fdc_t *fdc);
 extern double	fdc_get_hut(fdc_t *fdc);
 extern double	fdc_get_hlt(fdc_t *fdc);
 extern void	fdc_request_next_sector_id(fdc_t *fdc);
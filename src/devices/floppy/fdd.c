@@ -8,7 +8,7 @@
  *
  *		Implementation of the floppy drive emulation.
  *
- * Version:	@(#)fdd.c	1.0.20	2019/05/03
+ * Version:	@(#)fdd.c	1.0.21	2019/06/10
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -643,6 +643,21 @@ fdd_real_period(int drive)
 }
 
 
+/*
+ * Delay the next poll of a drive by the time needed to move
+ * the given number of bytes at the current data rate. Used
+ * by the sector-mode fast path, which moves entire sectors
+ * in a single poll.
+ */
+void
+fdd_transfer_delay(int drive, int bytes)
+{
+    if (bytes <= 0) return;
+
+    fdd_poll_time[drive] += (int64_t)(fdd_byteperiod(drive) * (double)bytes * (double)TIMER_USEC);
+}
+
+
 void
 fdd_poll(int drive)
 {
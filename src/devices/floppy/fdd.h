@@ -8,7 +8,7 @@
  *
  *		Definitions for the floppy drive emulation.
  *
- * Version:	@(#)fdd.h	1.0.10	2019/02/10
+ * Version:	@(#)fdd.h	1.0.11	2019/06/10
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -133,6 +133,7 @@ extern void	fdd_readaddress(int drive, int side, int density);
 extern void	fdd_format(int drive, int side, int density, uint8_t fill);
 extern int	fdd_hole(int drive);
 extern double	fdd_byteperiod(int drive);
+extern void	fdd_transfer_delay(int drive, int bytes);
 extern void	fdd_stop(int drive);
 extern void	fdd_set_rate(int drive, int drvden, int rate);
 
@@ -10,7 +10,7 @@
  *		data in the form of FM/MFM-encoded transitions) which also
  *		forms the core of the emulator's floppy disk emulation.
  *
- * Version:	@(#)fdd_86f.c	1.0.19	2019/05/17
+ * Version:	@(#)fdd_86f.c	1.0.22	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -194,6 +194,15 @@ typedef struct _sector_ {
  *		If bits 6, 5 are 0, and bit 7 is 1, the extra bitcell count
  *		specifies the entire bitcell count
  */
+
+/* A queued write of a (serialized) track to the image file. */
+typedef struct wbjob {
+    struct wbjob *next;
+    uint32_t	offset;
+    uint32_t	len;
+    uint8_t	data[1];
+} wbjob_t;
+
 typedef struct {
     FILE	*f;
     uint16_t	version;
@@ -239,6 +248,16 @@ typedef struct {
     uint32_t	dma_over;
     int		turbo_pos;
     sector_t	*last_side_sector[2];
+
+    int		dirty,			/* current track was modified */
+		table_dirty,		/* track table was modified */
+		modified;		/* image was modified */
+    mutex_t	*wb_mutex;		/* background writer */
+    event_t	*wb_event;
+    thread_t	*wb_thread;
+    volatile int wb_running;
+    wbjob_t	*wb_head,
+		*wb_tail;
 } d86f_t;
 
 
@@ -278,6 +297,7 @@ uint64_t	table[256];
 uint16_t	d86f_side_flags(int drive);
 int		d86f_is_mfm(int drive);
 void		d86f_writeback(int drive);
+static void	d86f_flush(int drive);
 uint8_t		d86f_poll_read_data(int drive, int side, uint16_t pos);
 void		d86f_poll_write_data(int drive, int side, uint16_t pos, uint8_t data);
 int		d86f_format_conditions(int drive);
@@ -2148,6 +2168,25 @@ d86f_initialize_last_sector_id(int drive, int c, int h, int r, int n)
 }
 
 
+/*
+ * In turbo mode, proxied images (IMG, IMD, TD0 and so on) are
+ * accessed at the sector level. If the host side does not need
+ * to see each byte (DMA transfer, or VERIFY), we can move the
+ * entire sector in one go, and then idle the drive for as long
+ * as the transfer would have taken.
+ */
+static int
+d86f_turbo_sector_mode(int drive)
+{
+    d86f_t *dev = d86f[drive];
+
+    if (dev->state == STATE_16_VERIFY_DATA)
+	return(1);
+
+    return(fdc_is_dma(d86f_fdc));
+}
+
+
 void
 d86f_turbo_read(int drive, int side)
 {
@@ -2155,23 +2194,33 @@ d86f_turbo_read(int drive, int side)
     uint8_t dat = 0;
     int recv_data = 0;
     int read_status = 0;
+    int sector_mode;
+    int bytes = 0;
 
-    dat = d86f_handler[drive].read_data(drive, side, dev->turbo_pos);
-    dev->turbo_pos++;
+    sector_mode = d86f_turbo_sector_mode(drive);
 
-    if (dev->state == STATE_11_SCAN_DATA) {
-	/* Scan/compare command. */
-	recv_data = d86f_get_data(drive, 0);
-	d86f_compare_byte(drive, recv_data, dat);
-    } else {
-	if (dev->data_find.bytes_obtained < (128UL << dev->last_sector.id.n)) {
-		if (dev->state != STATE_16_VERIFY_DATA) {
-			read_status = fdc_data(d86f_fdc, dat);
-			if (read_status == -1)
-				dev->dma_over++;
+    do {
+	dat = d86f_handler[drive].read_data(drive, side, dev->turbo_pos);
+	dev->turbo_pos++;
+	bytes++;
+
+	if (dev->state == STATE_11_SCAN_DATA) {
+		/* Scan/compare command. */
+		recv_data = d86f_get_data(drive, 0);
+		d86f_compare_byte(drive, recv_data, dat);
+	} else {
+		if (dev->data_find.bytes_obtained < (128UL << dev->last_sector.id.n)) {
+			if (dev->state != STATE_16_VERIFY_DATA) {
+				read_status = fdc_data(d86f_fdc, dat);
+				if (read_status == -1)
+					dev->dma_over++;
+			}
 		}
 	}
-    }
+    } while (sector_mode && (dev->turbo_pos < (128 << dev->last_sector.id.n)));
+
+    if (sector_mode)
+	fdd_transfer_delay(drive, bytes - 1);
 
     if (dev->turbo_pos >= (128 << dev->last_sector.id.n)) {
 	/* CRC is valid. */
@@ -2193,11 +2242,21 @@ d86f_turbo_write(int drive, int side)
 {
     d86f_t *dev = d86f[drive];
     uint8_t dat = 0;
+    int sector_mode;
+    int bytes = 0;
+
+    sector_mode = d86f_turbo_sector_mode(drive);
 
-    dat = d86f_get_data(drive, 1);
-    d86f_handler[drive].write_data(drive, side, dev->turbo_pos, dat);
+    do {
+	dat = d86f_get_data(drive, 1);
+	d86f_handler[drive].write_data(drive, side, dev->turbo_pos, dat);
 
-    dev->turbo_pos++;
+	dev->turbo_pos++;
+	bytes++;
+    } while (sector_mode && (dev->turbo_pos < (128 << dev->last_sector.id.n)));
+
+    if (sector_mode)
+	fdd_transfer_delay(drive, bytes - 1);
 
     if (dev->turbo_pos >= (128 << dev->last_sector.id.n)) {
 	/* We've written the data. */
@@ -2903,6 +2962,154 @@ d86f_track_header_size(int drive)
 }
 
 
+/* Take the first job off the write queue and write it out. */
+static int
+d86f_wb_pop(d86f_t *dev)
+{
+    wbjob_t *job = dev->wb_head;
+
+    if (job == NULL) return(0);
+
+    dev->wb_head = job->next;
+    if (dev->wb_head == NULL)
+	dev->wb_tail = NULL;
+
+    fseek(dev->f, job->offset, SEEK_SET);
+    fwrite(job->data, 1, job->len, dev->f);
+    free(job);
+
+    return(1);
+}
+
+
+/* Background writer, updates the image file with queued tracks. */
+static void
+d86f_wb_thread(void *priv)
+{
+    d86f_t *dev = (d86f_t *)priv;
+    int ret;
+
+    while (dev->wb_running) {
+	thread_wait_event(dev->wb_event, -1);
+
+	do {
+		thread_wait_mutex(dev->wb_mutex);
+		ret = d86f_wb_pop(dev);
+		if (! ret)
+			fflush(dev->f);
+		thread_release_mutex(dev->wb_mutex);
+	} while (ret);
+    }
+}
+
+
+static void
+d86f_wb_start(d86f_t *dev)
+{
+    dev->wb_mutex = thread_create_mutex(NULL);
+    dev->wb_event = thread_create_event();
+
+    dev->wb_running = 1;
+    dev->wb_thread = thread_create(d86f_wb_thread, dev);
+    if (dev->wb_thread == NULL) {
+	ERRLOG("86F: unable to create writer thread, using direct writes\n");
+	dev->wb_running = 0;
+	thread_destroy_event(dev->wb_event);
+	thread_close_mutex(dev->wb_mutex);
+    }
+}
+
+
+static void
+d86f_wb_stop(d86f_t *dev)
+{
+    if (dev->wb_thread == NULL) return;
+
+    dev->wb_running = 0;
+    thread_set_event(dev->wb_event);
+    thread_wait(dev->wb_thread, -1);
+    dev->wb_thread = NULL;
+
+    /* Should be empty by now, but make sure. */
+    while (d86f_wb_pop(dev))
+	;
+
+    thread_destroy_event(dev->wb_event);
+    thread_close_mutex(dev->wb_mutex);
+}
+
+
+/* Hand a job to the writer, or write it out directly if we have none. */
+static void
+d86f_wb_queue(d86f_t *dev, wbjob_t *job)
+{
+    job->next = NULL;
+
+    if (dev->wb_thread == NULL) {
+	fseek(dev->f, job->offset, SEEK_SET);
+	fwrite(job->data, 1, job->len, dev->f);
+	free(job);
+	return;
+    }
+
+    thread_wait_mutex(dev->wb_mutex);
+    if (dev->wb_tail != NULL)
+	dev->wb_tail->next = job;
+      else
+	dev->wb_head = job;
+    dev->wb_tail = job;
+    thread_release_mutex(dev->wb_mutex);
+
+    thread_set_event(dev->wb_event);
+}
+
+
+/*
+ * Lock the image file for reading a track. If that track is
+ * still waiting in the write queue, write it out first (along
+ * with anything queued before it) so we read back current data.
+ */
+static void
+d86f_wb_lock(d86f_t *dev, uint32_t offset)
+{
+    wbjob_t *job;
+
+    if (dev->wb_thread == NULL) return;
+
+    thread_wait_mutex(dev->wb_mutex);
+
+    for (job = dev->wb_head; job != NULL; job = job->next) {
+	if (job->offset == offset) {
+		while (dev->wb_head != job)
+			(void)d86f_wb_pop(dev);
+		(void)d86f_wb_pop(dev);
+		break;
+	}
+    }
+}
+
+
+static void
+d86f_wb_unlock(d86f_t *dev)
+{
+    if (dev->wb_thread != NULL)
+	thread_release_mutex(dev->wb_mutex);
+}
+
+
+/* Write out everything still queued. */
+static void
+d86f_wb_sync(d86f_t *dev)
+{
+    if (dev->wb_thread == NULL) return;
+
+    thread_wait_mutex(dev->wb_mutex);
+    while (d86f_wb_pop(dev))
+	;
+    thread_release_mutex(dev->wb_mutex);
+}
+
+
 void
 d86f_read_track(int drive, int track, int thin_track, int side, uint16_t *da, uint16_t *sa)
 {
@@ -2916,6 +3123,7 @@ d86f_read_track(int drive, int track, int thin_track, int side, uint16_t *da, ui
 	logical_track = track + thin_track;
 
     if (dev->track_offset[logical_track]) {
+	d86f_wb_lock(dev, dev->track_offset[logical_track]);
 	if (! thin_track) {
 		fseek(dev->f, dev->track_offset[logical_track], SEEK_SET);
 		fread(&(dev->side_flags[side]), 2, 1, dev->f);
@@ -2938,6 +3146,7 @@ d86f_read_track(int drive, int track, int thin_track, int side, uint16_t *da, ui
 	if (d86f_has_surface_desc(drive))
 		fread(sa, 1, array_size, dev->f);
 	fread(da, 1, array_size, dev->f);
+	d86f_wb_unlock(dev);
     } else {
 	if (! thin_track) {
 		switch((dev->disk_flags >> 1) & 3) {
@@ -2984,6 +3193,9 @@ d86f_seek(int drive, int track)
     int side, thin_track;
     sides = d86f_get_sides(drive);
 
+    /* Write back the track we are leaving, if it was modified. */
+    d86f_flush(drive);
+
     /* If the drive has thick tracks, shift the track number by 1. */
     if (! fdd_doublestep_40(drive)) {
 	track <<= 1;
@@ -3017,25 +3229,54 @@ d86f_seek(int drive, int track)
 }
 
 
+/*
+ * Serialize a track at the given file offset. If no file is
+ * given, the track is queued for the image's background writer.
+ */
 void
-d86f_write_track(int drive, FILE **f, int side, uint16_t *da0, uint16_t *sa0)
+d86f_write_track(int drive, FILE **f, uint32_t offset, int side, uint16_t *da0, uint16_t *sa0)
 {
     uint32_t array_size = d86f_get_array_size(drive, side, 0);
     uint16_t side_flags = d86f_handler[drive].side_flags(drive);
     uint32_t extra_bit_cells = d86f_handler[drive].extra_bit_cells(drive, side);
     uint32_t index_hole_pos = d86f_handler[drive].index_hole_pos(drive, side);
+    wbjob_t *job;
+    uint8_t *p;
 
-    fwrite(&side_flags, 1, 2, *f);
+    job = (wbjob_t *)mem_alloc(sizeof(wbjob_t) +
+			       d86f_track_header_size(drive) + (array_size << 1));
+    job->offset = offset;
+    p = job->data;
 
-    if (d86f_has_extra_bit_cells(drive))
-	fwrite(&extra_bit_cells, 1, 4, *f);
+    memcpy(p, &side_flags, 2);
+    p += 2;
+
+    if (d86f_has_extra_bit_cells(drive)) {
+	memcpy(p, &extra_bit_cells, 4);
+	p += 4;
+    }
+
+    memcpy(p, &index_hole_pos, 4);
+    p += 4;
+
+    if (d86f_has_surface_desc(drive)) {
+	memcpy(p, sa0, array_size);
+	p += array_size;
+    }
+
+    memcpy(p, da0, array_size);
+    p += array_size;
 
-    fwrite(&index_hole_pos, 1, 4, *f);
+    job->len = (uint32_t)(p - job->data);
 
-    if (d86f_has_surface_desc(drive))
-	fwrite(sa0, 1, array_size, *f);
+    if (f == NULL) {
+	d86f_wb_queue(d86f[drive], job);
+	return;
+    }
 
-    fwrite(da0, 1, array_size, *f);
+    fseek(*f, offset, SEEK_SET);
+    fwrite(job->data, 1, job->len, *f);
+    free(job);
 }
 
 
@@ -3093,10 +3334,8 @@ d86f_write_tracks(int drive, FILE **f, uint32_t *track_table)
 				tbl[logical_track] = ftell(*f);
 			}
 
-			if (tbl[logical_track]) {
-				fseek(*f, tbl[logical_track], SEEK_SET);
-				d86f_write_track(drive, f, side, d86f_handler[drive].encoded_data(drive, side), dev->track_surface_data[side]);
-			}
+			if (tbl[logical_track])
+				d86f_write_track(drive, f, tbl[logical_track], side, d86f_handler[drive].encoded_data(drive, side), dev->track_surface_data[side]);
 		}
 	}
     } else {
@@ -3112,10 +3351,8 @@ d86f_write_tracks(int drive, FILE **f, uint32_t *track_table)
 			track_table[logical_track] = ftell(*f);
 		}
 
-		if (tbl[logical_track]) {
-			fseek(*f, tbl[logical_track], SEEK_SET);
-			d86f_write_track(drive, f, side, dev->track_encoded_data[side], dev->track_surface_data[side]);
-		}
+		if (tbl[logical_track])
+			d86f_write_track(drive, f, tbl[logical_track], side, dev->track_encoded_data[side], dev->track_surface_data[side]);
 	}
     }
 
@@ -3123,61 +3360,47 @@ d86f_write_tracks(int drive, FILE **f, uint32_t *track_table)
 }
 
 
-void
-d86f_writeback(int drive)
+/* Write back the current track and the track table, if modified. */
+static void
+d86f_flush(int drive)
 {
     d86f_t *dev = d86f[drive];
-    uint8_t header[32];
-    int header_size;
-#ifdef D86F_COMPRESS
+    wbjob_t *job;
     uint32_t len;
-    int ret = 0;
-    FILE *cf;
-#endif
-    header_size = d86f_header_size(drive);
 
-    if (! dev->f) return;
+    if (!dev->dirty || !dev->f) return;
 
-    /* First write the track offsets table. */
-    fseek(dev->f, 0, SEEK_SET);
-    fread(header, 1, header_size, dev->f);
-
-    fseek(dev->f, 8, SEEK_SET);
-    fwrite(dev->track_offset, 1, d86f_get_track_table_size(drive), dev->f);
-
-    d86f_write_tracks(drive, &dev->f, NULL);
-
-#ifdef D86F_COMPRESS
-    if (dev->is_compressed) {
-	/* The image is compressed. */
+    if (dev->table_dirty) {
+	len = d86f_get_track_table_size(drive);
+	job = (wbjob_t *)mem_alloc(sizeof(wbjob_t) + len);
+	job->offset = 8;
+	job->len = len;
+	memcpy(job->data, dev->track_offset, len);
+	d86f_wb_queue(dev, job);
 
-	/* Open the original, compressed file. */
-	cf = plat_fopen(dev->original_file_name, L"wb");
+	dev->table_dirty = 0;
+    }
 
-	/* Write the header to the original file. */
-	fwrite(header, 1, header_size, cf);
+    d86f_write_tracks(drive, NULL, NULL);
 
-	fseek(dev->f, 0, SEEK_END);
-	len = ftell(dev->f);
-	len -= header_size;
+    dev->dirty = 0;
+}
 
-	fseek(dev->f, header_size, SEEK_SET);
 
-	/* Compress data from the temporary uncompressed file to the original, compressed file. */
-	dev->filebuf = (uint8_t *) mem_alloc(len);
-	dev->outbuf = (uint8_t *) mem_alloc(len - 1);
-	fread(dev->filebuf, 1, len, dev->f);
-	ret = lzf_compress(dev->filebuf, len, dev->outbuf, len - 1);
+void
+d86f_writeback(int drive)
+{
+    d86f_t *dev = d86f[drive];
 
-	if (! ret) {
-		DEBUG("86F: Error compressing file\n");
-	}
+    if (! dev->f) return;
 
-	fwrite(dev->outbuf, 1, ret, cf);
-	free(dev->outbuf);
-	free(dev->filebuf);
-    }
-#endif
+    /*
+     * Only mark the track as modified. It gets written back
+     * (by the background writer) once the head moves to some
+     * other track, or when the image is closed.
+     */
+    dev->dirty = 1;
+    dev->modified = 1;
 }
 
 
@@ -3320,6 +3543,7 @@ d86f_add_track(int drive, int track, int side)
     if (! dev->track_offset[logical_track]) {
 	/* Track is absent from the file, let's add it. */
 	dev->track_offset[logical_track] = dev->file_size;
+	dev->table_dirty = 1;
 
 	dev->file_size += (array_size + 6);
 	if (d86f_has_extra_bit_cells(drive))
@@ -3455,6 +3679,10 @@ d86f_export(int drive, const wchar_t *fn)
     if (!f)
 	return 0;
 
+    /* Get the image file up to date before we save the drive state. */
+    d86f_flush(drive);
+    d86f_wb_sync(dev);
+
     /* Allocate a temporary drive for conversion. */
     temp86 = (d86f_t *)mem_alloc(sizeof(d86f_t));
     memcpy(temp86, dev, sizeof(d86f_t));
@@ -3776,6 +4004,9 @@ d86f_load(int drive, const wchar_t *fn)
 
     d86f_register_86f(drive);
 
+    if (! writeprot[drive])
+	d86f_wb_start(dev);
+
     drives[drive].seek = d86f_seek;
     d86f_common_handlers(drive);
     drives[drive].format = d86f_format;
@@ -3812,6 +4043,58 @@ d86f_set_fdc(void *fdc)
 }
 
 
+#ifdef D86F_COMPRESS
+/* Compress the (temporary) uncompressed image back to the original. */
+static void
+d86f_compress(int drive)
+{
+    d86f_t *dev = d86f[drive];
+    uint8_t header[32];
+    int header_size;
+    uint32_t len;
+    int ret = 0;
+    FILE *cf;
+
+    header_size = d86f_header_size(drive);
+
+    fseek(dev->f, 0, SEEK_SET);
+    fread(header, 1, header_size, dev->f);
+
+    /* Open the original, compressed file. */
+    cf = plat_fopen(dev->original_file_name, L"wb");
+    if (cf == NULL) {
+	ERRLOG("86F: unable to update compressed image\n");
+	return;
+    }
+
+    /* Write the header to the original file. */
+    fwrite(header, 1, header_size, cf);
+
+    fseek(dev->f, 0, SEEK_END);
+    len = ftell(dev->f);
+    len -= header_size;
+
+    fseek(dev->f, header_size, SEEK_SET);
+
+    /* Compress data from the temporary uncompressed file to the original, compressed file. */
+    dev->filebuf = (uint8_t *) mem_alloc(len);
+    dev->outbuf = (uint8_t *) mem_alloc(len - 1);
+    fread(dev->filebuf, 1, len, dev->f);
+    ret = lzf_compress(dev->filebuf, len, dev->outbuf, len - 1);
+
+    if (! ret) {
+	DEBUG("86F: Error compressing file\n");
+    }
+
+    fwrite(dev->outbuf, 1, ret, cf);
+    free(dev->outbuf);
+    free(dev->filebuf);
+
+    fclose(cf);
+}
+#endif
+
+
 void
 d86f_close(int drive)
 {
@@ -3824,6 +4107,16 @@ d86f_close(int drive)
     if (dev == NULL) return;
 
     if (dev->f) {
+	/* Write back any pending changes. */
+	d86f_flush(drive);
+	d86f_wb_stop(dev);
+
+#ifdef D86F_COMPRESS
+	/* Only recompress the image if it was actually modified. */
+	if (dev->is_compressed && dev->modified)
+		d86f_compress(drive);
+#endif
+
 	fclose(dev->f);
 	dev->f = NULL;
     }
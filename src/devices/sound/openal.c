@@ -8,7 +8,7 @@
  *
  *		Interface to the OpenAL sound processing library.
  *
- * Version:	@(#)openal.c	1.0.19	2019/05/03
+ * Version:	@(#)openal.c	1.0.20	2019/06/20
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -351,7 +351,8 @@ openal_reset(void)
 }
 
 
-static void
+/* Queue a buffer, returns 0 if the source had no free buffer for it. */
+static int
 openal_buffer_common(void *buf, uint8_t src, int size, int freq)
 {
 #ifdef USE_OPENAL
@@ -360,7 +361,7 @@ openal_buffer_common(void *buf, uint8_t src, int size, int freq)
     ALuint buffer;
     double gain;
 
-    if (openal_handle == NULL) return;
+    if (openal_handle == NULL) return(1);
 
     f_alGetSourcei(source[src], AL_SOURCE_STATE, &state);
 
@@ -382,15 +383,21 @@ openal_buffer_common(void *buf, uint8_t src, int size, int freq)
 	}
 
 	f_alSourceQueueBuffers(source[src], 1, &buffer);
+
+	return(1);
     }
+
+    return(0);
+#else
+    return(1);
 #endif
 }
 
 
-void
+int
 openal_buffer(void *buf)
 {
-    openal_buffer_common(buf, 0, BUFLEN << 1, FREQ);
+    return(openal_buffer_common(buf, 0, BUFLEN << 1, FREQ));
 }
 
 
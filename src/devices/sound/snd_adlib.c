@@ -8,7 +8,7 @@
  *
  *		Implementation of the ADLIB sound device.
  *
- * Version:	@(#)snd_adlib.c	1.0.11	2019/05/17
+ * Version:	@(#)snd_adlib.c	1.0.12	2019/06/22
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -147,6 +147,8 @@ adlib_close(priv_t priv)
 {
     adlib_t *dev = (adlib_t *)priv;
 
+    opl_close(&dev->opl);
+
     free(dev);
 }
 
@@ -10,7 +10,7 @@
  *
  * TODO:	Stack allocation of big buffers (line 688 et al.)
  *
- * Version:	@(#)snd_adlibgold.c	1.0.15	2019/05/17
+ * Version:	@(#)snd_adlibgold.c	1.0.16	2019/06/22
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -882,6 +882,8 @@ static void adgold_close(priv_t priv)
                 fclose(f);
         }
 
+        opl_close(&adgold->opl);
+
         free(adgold);
 }
 
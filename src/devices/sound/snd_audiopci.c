@@ -8,7 +8,7 @@
  *
  *		Implementation of the AudioPCI sound device.
  *
- * Version:	@(#)snd_audiopci.c	1.0.19	2019/05/17
+ * Version:	@(#)snd_audiopci.c	1.0.20	2019/06/14
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -453,7 +453,7 @@ es1371_outb(uint16_t port, uint8_t val, priv_t priv)
 
 	case 0x18:
 		dev->legacy_ctrl |= LEGACY_INT;
-		nmi = 0;
+		nmi_set(0);
 		break;
 
 	case 0x1a:
@@ -721,7 +721,7 @@ capture_event(priv_t priv, int type, int rw, uint16_t port)
     dev->legacy_ctrl |= ((port << LEGACY_EVENT_ADDR_SHIFT) & LEGACY_EVENT_ADDR_MASK);
     dev->legacy_ctrl &= ~LEGACY_INT;
 
-    nmi = 1;
+    nmi_set(1);
 
     DBGLOG(1, "Event! %s %04x\n", rw ? "write" : "read", port);
 }
@@ -8,9 +8,7 @@
  *
  *		DOSbox OPL emulation.
  *
- * NOTE:	See MSC_ macros for allocation on stack. --FvK
- *
- * Version:	@(#)snd_dbopl.cpp	1.0.10	2019/05/17
+ * Version:	@(#)snd_dbopl.cpp	1.0.12	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -52,11 +50,13 @@
 #include "snd_dbopl.h"
 
 
-static struct
+typedef struct
 {
         DBOPL::Chip chip;
 	opl3_chip opl3chip;
         int addr;
+        int chip_addr;
+        int opl3_mode;
         int timer[2];
         uint8_t timer_ctrl;
         uint8_t status_mask;
@@ -65,7 +65,9 @@ static struct
 
         void (*timer_callback)(priv_t param, int timer, tmrval_t period);
         priv_t timer_param;
-} opl[2];
+
+        Bit32s buffer_32[SOUNDBUFLEN * 2];
+} dbopl_t;
 
 enum
 {
@@ -83,177 +85,191 @@ enum
         CTRL_TIMER1_CTRL = 0x01
 };
 
-void opl_init(void (*timer_callback)(priv_t param, int timer, tmrval_t period), priv_t timer_param, int nr, int is_opl3)
+/* Each card has its own chips, as they may run on their own threads. */
+void *opl_init(void (*timer_callback)(priv_t param, int timer, tmrval_t period), priv_t timer_param, int is_opl3)
 {
-	opl[nr].timer_callback = timer_callback;
-	opl[nr].timer_param = timer_param;
-	opl[nr].is_opl3 = is_opl3;
+	dbopl_t *opl = new dbopl_t();
+
+	opl->timer_callback = timer_callback;
+	opl->timer_param = timer_param;
+	opl->is_opl3 = is_opl3;
+	opl->opl3_mode = 0;
 	if (! config.opl_type)
 	{
 		DBOPL::InitTables();
-		opl[nr].chip.Setup(48000, is_opl3);
+		opl->chip.Setup(48000, is_opl3);
 	}
 	else
 	{
-		opl[nr].opl3chip.newm = 0;
-		OPL3_Reset(&opl[nr].opl3chip, 48000);
+		opl->opl3chip.newm = 0;
+		OPL3_Reset(&opl->opl3chip, 48000);
 	}
+
+	return(opl);
 }
 
-void opl_status_update(int nr)
+void opl_free(void *priv)
 {
-        if (opl[nr].status & (STATUS_TIMER_1 | STATUS_TIMER_2) & opl[nr].status_mask)
-                opl[nr].status |= STATUS_TIMER_ALL;
+	dbopl_t *opl = (dbopl_t *)priv;
+
+	delete opl;
+}
+
+void opl_status_update(void *priv)
+{
+        dbopl_t *opl = (dbopl_t *)priv;
+
+        if (opl->status & (STATUS_TIMER_1 | STATUS_TIMER_2) & opl->status_mask)
+                opl->status |= STATUS_TIMER_ALL;
         else
-                opl[nr].status &= ~STATUS_TIMER_ALL;
+                opl->status &= ~STATUS_TIMER_ALL;
 }
 
-void opl_timer_over(int nr, int timer)
+void opl_timer_over(void *priv, int timer)
 {
+        dbopl_t *opl = (dbopl_t *)priv;
+
         if (!timer)
         {
-                opl[nr].status |= STATUS_TIMER_1;
-                opl[nr].timer_callback(opl[nr].timer_param, 0, opl[nr].timer[0] * 4);
+                opl->status |= STATUS_TIMER_1;
+                opl->timer_callback(opl->timer_param, 0, opl->timer[0] * 4);
         }
         else
         {
-                opl[nr].status |= STATUS_TIMER_2;
-                opl[nr].timer_callback(opl[nr].timer_param, 1, opl[nr].timer[1] * 16);
+                opl->status |= STATUS_TIMER_2;
+                opl->timer_callback(opl->timer_param, 1, opl->timer[1] * 16);
         }
                 
-        opl_status_update(nr);
+        opl_status_update(opl);
 }
 
-void opl_write(int nr, uint16_t addr, uint8_t val)
+/*
+ * Handle a write for the status and timer logic, which the CPU can
+ * see right away. The chip itself gets it in opl_write_chip().
+ */
+void opl_write(void *priv, uint16_t addr, uint8_t val)
 {
+        dbopl_t *opl = (dbopl_t *)priv;
+
         if (!(addr & 1))
 	{
-		if (! config.opl_type)
-			opl[nr].addr = (int)opl[nr].chip.WriteAddr(addr, val) & 0x1ff;
-		else
-			opl[nr].addr = (int)OPL3_WriteAddr(&opl[nr].opl3chip, addr, val) & 0x1ff;
-		if (!opl[nr].is_opl3)
-			opl[nr].addr &= 0xff;
+		/* Same address decoding as the synthesizers do. */
+		opl->addr = val;
+		if ((addr & 2) && (opl->opl3_mode || (val == 0x05)))
+			opl->addr |= 0x100;
+		if (!opl->is_opl3)
+			opl->addr &= 0xff;
 	}
         else
         {
-		if (! config.opl_type)
-			opl[nr].chip.WriteReg(opl[nr].addr, val);
-		else {
-			OPL3_WriteRegBuffered(&opl[nr].opl3chip, (uint16_t) opl[nr].addr, val);
-			if (opl[nr].addr == 0x105)
-				opl[nr].opl3chip.newm = opl[nr].addr & 0x01;
-		}
-
-                switch (opl[nr].addr)
+                switch (opl->addr)
                 {
                         case 0x02: /*Timer 1*/
-                        opl[nr].timer[0] = 256 - val;
+                        opl->timer[0] = 256 - val;
                         break;
                         case 0x03: /*Timer 2*/
-                        opl[nr].timer[1] = 256 - val;
+                        opl->timer[1] = 256 - val;
                         break;
                         case 0x04: /*Timer control*/
                         if (val & CTRL_IRQ_RESET) /*IRQ reset*/
                         {
-                                opl[nr].status &= ~(STATUS_TIMER_1 | STATUS_TIMER_2);
-                                opl_status_update(nr);
+                                opl->status &= ~(STATUS_TIMER_1 | STATUS_TIMER_2);
+                                opl_status_update(opl);
                                 return;
                         }
-                        if ((val ^ opl[nr].timer_ctrl) & CTRL_TIMER1_CTRL)
+                        if ((val ^ opl->timer_ctrl) & CTRL_TIMER1_CTRL)
                         {
                                 if (val & CTRL_TIMER1_CTRL)
-                                        opl[nr].timer_callback(opl[nr].timer_param, 0, opl[nr].timer[0] * 4);
+                                        opl->timer_callback(opl->timer_param, 0, opl->timer[0] * 4);
                                 else
-                                        opl[nr].timer_callback(opl[nr].timer_param, 0, 0);
+                                        opl->timer_callback(opl->timer_param, 0, 0);
                         }
-                        if ((val ^ opl[nr].timer_ctrl) & CTRL_TIMER2_CTRL)
+                        if ((val ^ opl->timer_ctrl) & CTRL_TIMER2_CTRL)
                         {
                                 if (val & CTRL_TIMER2_CTRL)
-                                        opl[nr].timer_callback(opl[nr].timer_param, 1, opl[nr].timer[1] * 16);
+                                        opl->timer_callback(opl->timer_param, 1, opl->timer[1] * 16);
                                 else
-                                        opl[nr].timer_callback(opl[nr].timer_param, 1, 0);
+                                        opl->timer_callback(opl->timer_param, 1, 0);
                         }
-                        opl[nr].status_mask = (~val & (CTRL_TIMER1_MASK | CTRL_TIMER2_MASK)) | 0x80;
-                        opl[nr].timer_ctrl = val;
+                        opl->status_mask = (~val & (CTRL_TIMER1_MASK | CTRL_TIMER2_MASK)) | 0x80;
+                        opl->timer_ctrl = val;
+                        break;
+                        case 0x105: /*OPL3 mode*/
+                        opl->opl3_mode = val & 0x01;
                         break;
                 }
         }
                 
 }
 
-uint8_t opl_read(int nr, uint16_t addr)
+/* Pass a write on to the synthesizer (synthesis thread.) */
+void opl_write_chip(void *priv, uint16_t addr, uint8_t val)
 {
+        dbopl_t *opl = (dbopl_t *)priv;
+
         if (!(addr & 1))
+	{
+		if (! config.opl_type)
+			opl->chip_addr = (int)opl->chip.WriteAddr(addr, val) & 0x1ff;
+		else
+			opl->chip_addr = (int)OPL3_WriteAddr(&opl->opl3chip, addr, val) & 0x1ff;
+		if (!opl->is_opl3)
+			opl->chip_addr &= 0xff;
+	}
+        else
         {
-                return (opl[nr].status & opl[nr].status_mask) | (opl[nr].is_opl3 ? 0 : 0x06);
+		if (! config.opl_type)
+			opl->chip.WriteReg(opl->chip_addr, val);
+		else {
+			OPL3_WriteRegBuffered(&opl->opl3chip, (uint16_t) opl->chip_addr, val);
+			if (opl->chip_addr == 0x105)
+				opl->opl3chip.newm = opl->chip_addr & 0x01;
+		}
         }
-        return opl[nr].is_opl3 ? 0 : 0xff;
 }
 
-void opl2_update(int nr, int16_t *buffer, int samples)
+uint8_t opl_read(void *priv, uint16_t addr)
 {
-#ifdef _MSC_VER
-        static Bit32s *buffer_32 = NULL;
-	static Bit32u buffer_sz = 0;
+        dbopl_t *opl = (dbopl_t *)priv;
 
-        /* TODO: Fix this to use a static buffer */
-        if (samples > 512*1024) {
-		INFO("opl2_update: possible stack overflow detected. sample count was %d", samples);
-		return;
+        if (!(addr & 1))
+        {
+                return (opl->status & opl->status_mask) | (opl->is_opl3 ? 0 : 0x06);
         }
-	if ((sizeof(Bit32s) * samples) > buffer_sz) {
-		if (buffer_32 != NULL)
-			free(buffer_32);
-		buffer_sz = sizeof(Bit32s) * samples;
-		buffer_32 = (Bit32s *)mem_alloc(buffer_sz);
-	}
-#else
-        Bit32s buffer_32[SOUNDBUFLEN * 2];
-#endif
+        return opl->is_opl3 ? 0 : 0xff;
+}
+
+void opl2_update(void *priv, int16_t *buffer, int samples)
+{
+        dbopl_t *opl = (dbopl_t *)priv;
+        Bit32s *buffer_32 = opl->buffer_32;
         int c;
 
 	if (config.opl_type)
 	{
-		OPL3_GenerateStream(&opl[nr].opl3chip, buffer, samples);
+		OPL3_GenerateStream(&opl->opl3chip, buffer, samples);
 	}
 	else
 	{
-	        opl[nr].chip.GenerateBlock2(samples, buffer_32);
+	        opl->chip.GenerateBlock2(samples, buffer_32);
 	        for (c = 0; c < samples; c++)
 	                buffer[c*2] = (int16_t)buffer_32[c];
 	}
 }
 
-void opl3_update(int nr, int16_t *buffer, int samples)
+void opl3_update(void *priv, int16_t *buffer, int samples)
 {
-#ifdef _MSC_VER
-        static Bit32s *buffer_32 = NULL;
-	static Bit32u buffer_sz = 0;
-
-        /* TODO: Fix this to use a static buffer */
-        if (samples > 512*1024) {
-		INFO("opl2_update: possible stack overflow detected. sample count was %d", samples);
-		return;
-        }
-	if ((sizeof(Bit32s) * samples) > buffer_sz) {
-		if (buffer_32 != NULL)
-			free(buffer_32);
-		buffer_sz = sizeof(Bit32s) * samples;
-		buffer_32 = (Bit32s *)mem_alloc(buffer_sz);
-	}
-#else
-        Bit32s buffer_32[SOUNDBUFLEN * 2];
-#endif
+        dbopl_t *opl = (dbopl_t *)priv;
+        Bit32s *buffer_32 = opl->buffer_32;
         int c;
 
 	if (config.opl_type)
 	{
-		OPL3_GenerateStream(&opl[nr].opl3chip, buffer, samples);
+		OPL3_GenerateStream(&opl->opl3chip, buffer, samples);
 	}
 	else
 	{
-		opl[nr].chip.GenerateBlock3(samples, buffer_32);
+		opl->chip.GenerateBlock3(samples, buffer_32);
 
 		for (c = 0; c < samples*2; c++)
 			buffer[c] = (int16_t)buffer_32[c];
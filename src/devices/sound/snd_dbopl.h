@@ -8,7 +8,7 @@
  *
  *		Definitions for the DOSbox OPL emulator.
  *
- * Version:	@(#)snd_dbopl.h	1.0.4	2019/05/03
+ * Version:	@(#)snd_dbopl.h	1.0.6	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -45,13 +45,15 @@
 extern "C" {
 #endif
 
-void	opl_init(void (*timer_callback)(void *param, int timer, int64_t period), void *timer_param, int nr, int is_opl3);
-void	opl_write(int nr, uint16_t addr, uint8_t val);
-uint8_t	opl_read(int nr, uint16_t addr);
-void	opl_status_update(int nr);
-void	opl_timer_over(int nr, int timer);
-void	opl2_update(int nr, int16_t *buffer, int samples);
-void	opl3_update(int nr, int16_t *buffer, int samples);
+void	*opl_init(void (*timer_callback)(void *param, int timer, int64_t period), void *timer_param, int is_opl3);
+void	opl_free(void *priv);
+void	opl_write(void *priv, uint16_t addr, uint8_t val);
+void	opl_write_chip(void *priv, uint16_t addr, uint8_t val);
+uint8_t	opl_read(void *priv, uint16_t addr);
+void	opl_status_update(void *priv);
+void	opl_timer_over(void *priv, int timer);
+void	opl2_update(void *priv, int16_t *buffer, int samples);
+void	opl3_update(void *priv, int16_t *buffer, int samples);
 
 #ifdef __cplusplus
 }
@@ -8,7 +8,7 @@
  *
  *		Implementation of Emu8000 emulator.
  *
- * Version:	@(#)snd_emu8k.c	1.0.16	2019/05/17
+ * Version:	@(#)snd_emu8k.c	1.0.18	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -69,6 +69,11 @@
 
 //#define EMU8K_DEBUG_REGISTERS
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+# include <emmintrin.h>
+# define EMU8K_SSE2	1
+#endif
+
 const char *PORT_NAMES[][8] =
 {
         /* Data 0 ( 0x620/0x622) */
@@ -146,6 +151,8 @@ enum
 static int random_helper = 0;
 int dmareadbit = 0;
 int dmawritebit = 0;
+/* Skip idle voices in emu8k_update (the benchmark turns this off.) */
+int emu8k_idle_skip = 1;
 
 
 /* cubic and linear tables resolution. Note: higher than 10 does not improve the result. */
@@ -371,11 +378,28 @@ static inline int32_t EMU8K_READ_INTERP_CUBIC(emu8k_t *emu8k, uint32_t int_addr,
          * Also, it takes into account the "Note that the actual audio location is the point
          * 1 word higher than this value due to interpolation offset".
          * That's why the pointers are 0, 1, 2, 3 and not -1, 0, 1, 2 */
-        int32_t dat2 = EMU8K_READ(emu8k, int_addr+1);
         const float *table = &cubic_table[fract];
-        const int32_t dat1 = EMU8K_READ(emu8k, int_addr);
-        const int32_t dat3 = EMU8K_READ(emu8k, int_addr+2);
-        const int32_t dat4 = EMU8K_READ(emu8k, int_addr+3);
+        int32_t dat1, dat2, dat3, dat4;
+
+        /* Nearly always, all four words live in the same 64K block, so
+         * we only need to look up its pointer once. */
+        if ((int_addr & 0xffff) <= 0xfffc)
+        {
+                const emu8k_mem_pointers_t addrmem = {{int_addr}};
+                const int16_t *ptr = &emu8k->ram_pointers[addrmem.hb_address][addrmem.lw_address];
+
+                dat1 = ptr[0];
+                dat2 = ptr[1];
+                dat3 = ptr[2];
+                dat4 = ptr[3];
+        }
+        else
+        {
+                dat1 = EMU8K_READ(emu8k, int_addr);
+                dat2 = EMU8K_READ(emu8k, int_addr+1);
+                dat3 = EMU8K_READ(emu8k, int_addr+2);
+                dat4 = EMU8K_READ(emu8k, int_addr+3);
+        }
         /* Note: I've ended using float for the table values to avoid some cases of integer overflow. */
         dat2 = (int32_t) (dat1*table[0] + dat2*table[1] + dat3*table[2] + dat4*table[3]);
         return dat2;
@@ -1750,6 +1774,7 @@ void emu8k_update(emu8k_t *emu8k)
 
         int32_t *buf;
         emu8k_voice_t* emu_voice;
+        int mixing;
         int pos;
         int c;
 
@@ -1764,20 +1789,49 @@ void emu8k_update(emu8k_t *emu8k)
         {
                 emu_voice = &emu8k->voice[c];
                 buf = &emu8k->buffer[emu8k->pos*2];
-                
+
+                /* Neither the output enable nor the DMA bit can change while
+                 * we render this block, so only test them once. */
+                mixing = (emu8k->hwcf3 & 0x04) && !CCCA_DMA_ACTIVE(emu_voice->ccca);
+
+                /* Most of the 32 voices sit idle most of the time. If a
+                 * voice is stopped, unfiltered and silent, a sample step
+                 * changes nothing in it, so skip the whole block. */
+                if (emu8k_idle_skip && !emu_voice->env_engine_on &&
+                    !emu_voice->cpf_curr_pitch && !emu_voice->ptrx_pit_target &&
+                    emu_voice->addr.addr < emu_voice->loop_end.addr &&
+                    !emu_voice->filterq_idx &&
+                    emu_voice->cvcf_curr_filt_ctoff == 0xFFFF &&
+                    emu_voice->vtft_filter_target == 0xFFFF &&
+                    emu_voice->volumeslide.last == emu_voice->vtft_vol_target &&
+                    emu_voice->cvcf_curr_volume == emu_voice->vtft_vol_target &&
+                    (!mixing || !emu_voice->cvcf_curr_volume))
+                {
+                        /* Keep the address registers in step, as below. */
+                        emu_voice->ccca = (((uint32_t)emu_voice->ccca_qcontrol) << 24) | emu_voice->addr.int_address;
+                        emu_voice->cpf_curr_frac_addr = emu_voice->addr.fract_address;
+                        continue;
+                }
+
                 for (pos = emu8k->pos; pos < new_pos; pos++)
                 {
                         int32_t dat;
 
-                        /* Waveform oscillator */
+                        /* Waveform oscillator, only if someone will hear it. */
+                        if ((mixing && emu_voice->cvcf_curr_volume) ||
+                            emu_voice->filterq_idx || emu_voice->cvcf_curr_filt_ctoff != 0xFFFF)
+                        {
 #ifdef RESAMPLER_LINEAR
-                        dat = EMU8K_READ_INTERP_LINEAR(emu8k, emu_voice->addr.int_address, 
-                                                emu_voice->addr.fract_address);
+                                dat = EMU8K_READ_INTERP_LINEAR(emu8k, emu_voice->addr.int_address, 
+                                                        emu_voice->addr.fract_address);
 
 #elif defined RESAMPLER_CUBIC
-                        dat = EMU8K_READ_INTERP_CUBIC(emu8k, emu_voice->addr.int_address, 
-                                                emu_voice->addr.fract_address);
+                                dat = EMU8K_READ_INTERP_CUBIC(emu8k, emu_voice->addr.int_address, 
+                                                        emu_voice->addr.fract_address);
 #endif
+                        }
+                        else
+                                dat = 0;
 
                         /* Filter section */
                         if (emu_voice->filterq_idx || emu_voice->cvcf_curr_filt_ctoff != 0xFFFF )
@@ -1853,7 +1907,7 @@ void emu8k_update(emu8k_t *emu8k)
                 #endif
                                 
                         }
-                        if (( emu8k->hwcf3 & 0x04) && !CCCA_DMA_ACTIVE(emu_voice->ccca))
+                        if (mixing)
                         {
                                 /*volume and pan*/
                                 dat = (dat * emu_voice->cvcf_curr_volume) >> 16;
@@ -1966,7 +2020,6 @@ void emu8k_update(emu8k_t *emu8k)
                                         case ENV_ATTACK:
                                         /* Attack amount is in linear amplitude */
                                         modenv->value_amp_hz += modenv->attack_amount_amp_hz;
-                                        modenv->value_db_oct = env_mod_hertz_to_octave[modenv->value_amp_hz >> 5] << 5;
                                         if (modenv->value_amp_hz >= (1 << 21))
                                         {
                                                 modenv->value_amp_hz = 1 << 21;
@@ -1980,6 +2033,11 @@ void emu8k_update(emu8k_t *emu8k)
                                                         modenv->state = ENV_RAMP_DOWN;
                                                 }
                                         }
+                                        else
+                                        {
+                                                /* Only look it up once in range, the table ends at 1 << 21. */
+                                                modenv->value_db_oct = env_mod_hertz_to_octave[modenv->value_amp_hz >> 5] << 5;
+                                        }
                                         break;
 
                                         case ENV_HOLD:
@@ -2129,7 +2187,21 @@ I've recopilated these sentences to get an idea of how to loop
         emu8k_work_eq(buf, new_pos-emu8k->pos);
         
         // Clip signal
-        for (pos = emu8k->pos; pos < new_pos; pos++)        
+        pos = emu8k->pos;
+#ifdef EMU8K_SSE2
+        /* Two stereo samples at a time: saturate to 16 bits and widen back. */
+        for (; pos + 2 <= new_pos; pos += 2)
+        {
+                __m128i v = _mm_loadu_si128((__m128i *)buf);
+
+                v = _mm_packs_epi32(v, v);
+                v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+                _mm_storeu_si128((__m128i *)buf, v);
+
+                buf += 4;
+        }
+#endif
+        for (; pos < new_pos; pos++)
         {
                 if (buf[0] < -32768)
                         buf[0] = -32768;
@@ -2152,11 +2224,8 @@ I've recopilated these sentences to get an idea of how to loop
 /* onboard_ram in kilobytes */
 void emu8k_init(emu8k_t *emu8k, const wchar_t *romfile, uint16_t emu_addr, int onboard_ram)
 {
-        uint32_t const BLOCK_SIZE_WORDS = 0x10000;
         FILE *fp;
-        int c;
-        double out;
- 
+
         fp = rom_fopen(romfile, L"rb");
         if (fp == NULL)
                 fatal("EMU8K: ROM file not found\n");
@@ -2172,6 +2241,20 @@ void emu8k_init(emu8k_t *emu8k, const wchar_t *romfile, uint16_t emu_addr, int o
                 emu8k->rom[0x7ffff] = 0;
         }
 
+        emu8k_setup(emu8k, onboard_ram);
+
+        io_sethandler(emu_addr,       0x0004, emu8k_inb, emu8k_inw, NULL, emu8k_outb, emu8k_outw, NULL, emu8k);
+        io_sethandler(emu_addr+0x400, 0x0004, emu8k_inb, emu8k_inw, NULL, emu8k_outb, emu8k_outw, NULL, emu8k);
+        io_sethandler(emu_addr+0x800, 0x0004, emu8k_inb, emu8k_inw, NULL, emu8k_outb, emu8k_outw, NULL, emu8k);
+}
+
+/* Set up the chip around an already loaded (1MB) sound ROM. */
+void emu8k_setup(emu8k_t *emu8k, int onboard_ram)
+{
+        uint32_t const BLOCK_SIZE_WORDS = 0x10000;
+        int c;
+        double out;
+
         emu8k->empty = (int16_t *)mem_alloc(2*BLOCK_SIZE_WORDS); 
         memset(emu8k->empty, 0, 2*BLOCK_SIZE_WORDS);
 
@@ -2225,10 +2308,6 @@ void emu8k_init(emu8k_t *emu8k, const wchar_t *romfile, uint16_t emu_addr, int o
                 
         }
 
-        io_sethandler(emu_addr,       0x0004, emu8k_inb, emu8k_inw, NULL, emu8k_outb, emu8k_outw, NULL, emu8k);
-        io_sethandler(emu_addr+0x400, 0x0004, emu8k_inb, emu8k_inw, NULL, emu8k_outb, emu8k_outw, NULL, emu8k);
-        io_sethandler(emu_addr+0x800, 0x0004, emu8k_inb, emu8k_inw, NULL, emu8k_outb, emu8k_outw, NULL, emu8k);
-
         /*Create frequency table. (Convert initial pitch register value to a linear speed change)
          * The input is encoded such as 0xe000 is center note (no pitch shift)
          * and from then on , changing up or down 0x1000 (4096) increments/decrements an octave.
@@ -2416,6 +2495,7 @@ void emu8k_close(emu8k_t *emu8k)
 {
         free(emu8k->rom);
         free(emu8k->ram);
+        free(emu8k->empty);
 
 	/* Release the allocated buffers. */
 	free(cubic_table); cubic_table = NULL;
@@ -8,7 +8,7 @@
  *
  *		Definitions for the Emu8K emulator.
  *
- * Version:	@(#)snd_emu8k.h	1.0.3	2019/05/17
+ * Version:	@(#)snd_emu8k.h	1.0.4	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -423,9 +423,15 @@ typedef struct emu8k_t
 
 
 
+extern int emu8k_idle_skip;
+
 void emu8k_init(emu8k_t *emu8k, const wchar_t *romfile, uint16_t emu_addr, int onboard_ram);
+void emu8k_setup(emu8k_t *emu8k, int onboard_ram);
 void emu8k_close(emu8k_t *emu8k);
 
+uint16_t emu8k_inw(uint16_t addr, priv_t priv);
+void emu8k_outw(uint16_t addr, uint16_t val, priv_t priv);
+
 void emu8k_update(emu8k_t *emu8k);
 
 
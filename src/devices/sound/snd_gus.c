@@ -8,7 +8,7 @@
  *
  *		Implementation of the Gravis UltraSound sound device.
  *
- * Version:	@(#)snd_gus.c	1.0.15	2019/05/17
+ * Version:	@(#)snd_gus.c	1.0.18	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -44,6 +44,7 @@
 #define dbglog sound_card_log
 #include "../../emu.h"
 #include "../../timer.h"
+#include "../../cpu/cpu.h"
 #include "../../io.h"
 #include "../../device.h"
 #include "../../plat.h"
@@ -57,6 +58,17 @@
 #endif
 
 
+/*
+ * The voices are not run from a timer on every sample, but rendered
+ * in blocks when their output or state is needed: at a buffer pull,
+ * when the voice registers are accessed, and when a wave or volume
+ * ramp IRQ is due. A block never runs past the next IRQ, so those
+ * still happen on the exact sample.
+ */
+#define GUS_BLOCK	128			/* most samples per block */
+#define GUS_BUFLEN	(SOUNDBUFLEN * 2)	/* samples between pulls */
+
+
 enum {
     MIDI_INT_RECEIVE = 0x01,
     MIDI_INT_TRANSMIT = 0x02,
@@ -120,13 +132,15 @@ typedef struct {
     int32_t	out_l,
 		out_r;
 
-    tmrval_t	samp_timer,
-		samp_latch;
+    tmrval_t	samp_timer,		/* until the end of the block */
+		samp_latch,
+		samp_step;		/* sample period of this block */
+    int		samp_left;		/* samples of it not rendered yet */
 
     uint8_t	*ram;
 
-    int		pos;
-    int16_t	buffer[2][SOUNDBUFLEN];
+    int		pos;			/* samples rendered since last pull */
+    int16_t	buffer[GUS_BUFLEN][2];
 
     int		irqnext;
 
@@ -237,6 +251,296 @@ midi_update_int_status(gus_t *dev)
 }
 
 
+/* Run one voice for a number of samples, and mix it into the block. */
+static int
+render_voice(gus_t *dev, int d, int32_t *mix, int len)
+{
+    uint32_t addr;
+    int16_t v;
+    int32_t vl;
+    int update_irqs = 0;
+    int c;
+
+    for (c = 0; c < len; c++, mix += 2) {
+	if (!(dev->ctrl[d] & 3)) {
+		if (dev->ctrl[d] & 4) {
+			addr = dev->cur[d] >> 9;
+			addr = (addr & 0xC0000) | ((addr << 1) & 0x3FFFE);
+
+			if (!(dev->freq[d] >> 10)) {	/*Interpolate*/
+				vl = (int16_t)(int8_t)((dev->ram[(addr + 1) & 0xFFFFF] ^ 0x80) - 0x80) * (511 - (dev->cur[d] & 511));
+				vl += (int16_t)(int8_t)((dev->ram[(addr + 3) & 0xFFFFF] ^ 0x80) - 0x80) * (dev->cur[d] & 511);
+				v = vl >> 9;
+			} else
+				v = (int16_t)(int8_t)((dev->ram[(addr + 1) & 0xFFFFF] ^ 0x80) - 0x80);
+		} else {
+			if (!(dev->freq[d] >> 10)) {	/*Interpolate*/
+				vl = ((int8_t)((dev->ram[(dev->cur[d] >> 9) & 0xFFFFF] ^ 0x80) - 0x80)) * (511 - (dev->cur[d] & 511));
+				vl += ((int8_t)((dev->ram[((dev->cur[d] >> 9) + 1) & 0xFFFFF] ^ 0x80) - 0x80)) * (dev->cur[d] & 511);
+				v = vl >> 9;
+			} else
+				v = (int16_t)(int8_t)((dev->ram[(dev->cur[d] >> 9) & 0xFFFFF] ^ 0x80) - 0x80);
+		}
+
+		if ((dev->rcur[d] >> 14) > 4095)
+			v = (int16_t)((float)v * 24.0 * vol16bit[4095]);
+		else
+			v = (int16_t)((float)v * 24.0 * vol16bit[(dev->rcur[d] >> 10) & 4095]);
+
+		mix[0] += (v * dev->pan_l[d]) / 7;
+		mix[1] += (v * dev->pan_r[d]) / 7;
+
+		if (dev->ctrl[d] & 0x40) {
+			dev->cur[d] -= (dev->freq[d] >> 1);
+			if (dev->cur[d] <= dev->start[d]) {
+				int diff = dev->start[d] - dev->cur[d];
+
+				if (dev->ctrl[d] & 8) {
+					if (dev->ctrl[d] & 0x10)
+						dev->ctrl[d] ^= 0x40;
+					dev->cur[d] = (dev->ctrl[d] & 0x40) ? (dev->end[d] - diff) : (dev->start[d] + diff);
+				} else if (!(dev->rctrl[d] & 4)) {
+					dev->ctrl[d] |= 1;
+					dev->cur[d] = (dev->ctrl[d] & 0x40) ? dev->end[d] : dev->start[d];
+				}
+
+				if ((dev->ctrl[d] & 0x20) && !dev->waveirqs[d]) {
+					dev->waveirqs[d] = 1;
+					update_irqs = 1;
+				}
+			}
+		} else {
+			dev->cur[d] += (dev->freq[d] >> 1);
+
+			if (dev->cur[d] >= dev->end[d]) {
+				int diff = dev->cur[d] - dev->end[d];
+
+				if (dev->ctrl[d] & 8) {
+					if (dev->ctrl[d] & 0x10)
+						dev->ctrl[d] ^= 0x40;
+					dev->cur[d] = (dev->ctrl[d] & 0x40) ? (dev->end[d] - diff) : (dev->start[d] + diff);
+				} else if (!(dev->rctrl[d] & 4)) {
+					dev->ctrl[d] |= 1;
+					dev->cur[d] = (dev->ctrl[d] & 0x40) ? dev->end[d] : dev->start[d];
+				}
+
+				if ((dev->ctrl[d] & 0x20) && !dev->waveirqs[d]) {
+					dev->waveirqs[d] = 1;
+					update_irqs = 1;
+				}
+			}
+		}
+	}
+
+	if (!(dev->rctrl[d] & 3)) {
+		if (dev->rctrl[d] & 0x40) {
+			dev->rcur[d] -= dev->rfreq[d];
+			if (dev->rcur[d] <= dev->rstart[d]) {
+				int diff = dev->rstart[d] - dev->rcur[d];
+
+				if (!(dev->rctrl[d] & 8)) {
+					dev->rctrl[d] |= 1;
+					dev->rcur[d] = (dev->rctrl[d] & 0x40) ? dev->rstart[d] : dev->rend[d];
+				} else {
+					if (dev->rctrl[d] & 0x10)
+						dev->rctrl[d] ^= 0x40;
+					dev->rcur[d] = (dev->rctrl[d] & 0x40) ? (dev->rend[d] - diff) : (dev->rstart[d] + diff);
+				}
+
+				if ((dev->rctrl[d] & 0x20) && !dev->rampirqs[d]) {
+					dev->rampirqs[d] = 1;
+					update_irqs = 1;
+				}
+			}
+		} else {
+			dev->rcur[d] += dev->rfreq[d];
+			if (dev->rcur[d] >= dev->rend[d]) {
+				int diff = dev->rcur[d] - dev->rend[d];
+
+				if (!(dev->rctrl[d] & 8)) {
+					dev->rctrl[d] |= 1;
+					dev->rcur[d] = (dev->rctrl[d] & 0x40) ? dev->rstart[d] : dev->rend[d];
+				} else {
+					if (dev->rctrl[d] & 0x10)
+						dev->rctrl[d] ^= 0x40;
+					dev->rcur[d] = (dev->rctrl[d] & 0x40) ? (dev->rend[d] - diff) : (dev->rstart[d] + diff);
+				}
+
+				if ((dev->rctrl[d] & 0x20) && !dev->rampirqs[d]) {
+					dev->rampirqs[d] = 1;
+					update_irqs = 1;
+				}
+			}
+		}
+	}
+    }
+
+    return(update_irqs);
+}
+
+
+/* Render the next samples of the current block. */
+static void
+render_block(gus_t *dev, int len)
+{
+    int32_t mix[GUS_BLOCK * 2];
+    int c, d, update_irqs = 0;
+
+    memset(mix, 0x00, len * 2 * sizeof(int32_t));
+
+    if ((dev->reset & 3) == 3) {
+	for (d = 0; d < 32; d++) {
+		/* Stopped voices and ramps do nothing at all. */
+		if ((dev->ctrl[d] & 3) && (dev->rctrl[d] & 3)) continue;
+
+		update_irqs |= render_voice(dev, d, mix, len);
+	}
+    }
+
+    for (c = 0; c < len; c++) {
+	if (dev->pos < GUS_BUFLEN) {
+		if (mix[c * 2] < -32768)
+			dev->buffer[dev->pos][0] = -32768;
+		else if (mix[c * 2] > 32767)
+			dev->buffer[dev->pos][0] = 32767;
+		else
+			dev->buffer[dev->pos][0] = mix[c * 2];
+		if (mix[c * 2 + 1] < -32768)
+			dev->buffer[dev->pos][1] = -32768;
+		else if (mix[c * 2 + 1] > 32767)
+			dev->buffer[dev->pos][1] = 32767;
+		else
+			dev->buffer[dev->pos][1] = mix[c * 2 + 1];
+		dev->pos++;
+	}
+    }
+    dev->out_l = mix[(len - 1) * 2];
+    dev->out_r = mix[(len - 1) * 2 + 1];
+
+    dev->samp_left -= len;
+
+    if (update_irqs)
+	poll_irqs(dev);
+}
+
+
+/*
+ * Samples until a running wave or ramp with its IRQ enabled crosses
+ * its end point, or GUS_BLOCK if that is further away. Where the
+ * count is hard to tell (the position wrapping around), it errs on
+ * the early side, and the block is simply cut shorter.
+ */
+static int
+next_irq(gus_t *dev)
+{
+    int64_t n, step;
+    int d, len = GUS_BLOCK;
+
+    if ((dev->reset & 3) != 3)
+	return(len);
+
+    for (d = 0; d < 32; d++) {
+	if (!(dev->ctrl[d] & 3) && (dev->ctrl[d] & 0x20) && !dev->waveirqs[d]) {
+		step = dev->freq[d] >> 1;
+		if (dev->ctrl[d] & 0x40) {
+			if (! step)
+				n = (dev->cur[d] <= dev->start[d]) ? 1 : len;
+			else if (dev->cur[d] <= dev->start[d])
+				n = 1;
+			else
+				n = (dev->cur[d] - dev->start[d] + step - 1) / step;
+
+			/* Does it wrap around before getting there? */
+			if ((n * step) > dev->cur[d])
+				n = dev->cur[d] / step;
+		} else {
+			if (! step)
+				n = (dev->cur[d] >= dev->end[d]) ? 1 : len;
+			else if (dev->cur[d] >= dev->end[d])
+				n = 1;
+			else
+				n = (dev->end[d] - dev->cur[d] + step - 1) / step;
+
+			if (((int64_t)dev->cur[d] + (n * step)) > 0xffffffffLL)
+				n = 1;
+		}
+		if (n < 1)
+			n = 1;
+		if (n < len)
+			len = (int)n;
+	}
+
+	if (!(dev->rctrl[d] & 3) && (dev->rctrl[d] & 0x20) && !dev->rampirqs[d]) {
+		step = dev->rfreq[d];
+		if (dev->rctrl[d] & 0x40) {
+			if (dev->rcur[d] <= dev->rstart[d])
+				n = 1;
+			else if (! step)
+				n = len;
+			else
+				n = ((int64_t)dev->rcur[d] - dev->rstart[d] + step - 1) / step;
+		} else {
+			if (dev->rcur[d] >= dev->rend[d])
+				n = 1;
+			else if (! step)
+				n = len;
+			else
+				n = ((int64_t)dev->rend[d] - dev->rcur[d] + step - 1) / step;
+		}
+		if (n < len)
+			len = (int)n;
+	}
+    }
+
+    return(len);
+}
+
+
+/* Render all samples that are due by now. */
+static void
+gus_update(gus_t *dev)
+{
+    int len = dev->samp_left;
+
+    /* Those still in the future, at their sample period. */
+    if (dev->samp_timer > 0)
+	len -= (int)((dev->samp_timer + dev->samp_step - 1) / dev->samp_step);
+
+    if (len > 0)
+	render_block(dev, len);
+}
+
+
+/* Voice registers are about to be used, bring them up to date. */
+static void
+gus_sync(gus_t *dev)
+{
+    timer_clock();
+
+    gus_update(dev);
+}
+
+
+/*
+ * The voice registers have been used, and may have moved the next IRQ
+ * closer. Start a new block at the next sample, ending at that IRQ.
+ */
+static void
+gus_schedule(gus_t *dev)
+{
+    tmrval_t next = dev->samp_timer;
+
+    if (dev->samp_left > 1)
+	next -= (dev->samp_left - 1) * dev->samp_step;
+
+    dev->samp_left = next_irq(dev);
+    dev->samp_step = dev->samp_latch;
+    dev->samp_timer = next + (dev->samp_left - 1) * dev->samp_step;
+
+    timer_update_outstanding();
+}
+
+
 static void
 gus_write(uint16_t addr, uint8_t val, priv_t priv)
 {
@@ -244,11 +548,16 @@ gus_write(uint16_t addr, uint8_t val, priv_t priv)
 #if defined(DEV_BRANCH) && defined(USE_GUSMAX)
     uint16_t ioport;
 #endif
-    int c, d, old;
+    int c, d, old, sync;
 
     if (dev->latch_enable && addr != 0x24b)
 	dev->latch_enable = 0;
 
+    /* Voice registers and memory have to be up to date. */
+    sync = (addr == 0x344) || (addr == 0x345) || (addr == 0x347);
+    if (sync)
+	gus_sync(dev);
+
     switch (addr) {
 	case 0x340: /*MIDI control*/
 		old = dev->midi_ctrl;
@@ -505,11 +814,11 @@ gus_write(uint16_t addr, uint8_t val, priv_t priv)
 				if (!(val & 8)) dev->irqstatus &= ~8;
 				if (!(val & 0x20)) {
 					dev->ad_status &= ~0x18;
-					nmi = 0;
+					nmi_set(0);
 				}
 				if (!(val & 0x02)) {
 					dev->ad_status &= ~0x01;
-					nmi = 0;
+					nmi_set(0);
 				}
 				dev->tctrl = val;
 				dev->sb_ctrl = val;
@@ -547,7 +856,7 @@ gus_write(uint16_t addr, uint8_t val, priv_t priv)
 			dev->ad_status |= 0x01;
 			if (dev->sb_ctrl & 0x02) {
 				if (dev->sb_nmi)
-					nmi = 1;
+					nmi_set(1);
 				else if (dev->irq != -1)
 					picint(1 << dev->irq);
 			}
@@ -632,7 +941,7 @@ gus_write(uint16_t addr, uint8_t val, priv_t priv)
 		dev->ad_status |= 0x08;
 		if (dev->sb_ctrl & 0x20) {
 			if (dev->sb_nmi)
-				nmi = 1;
+				nmi_set(1);
 			else if (dev->irq != -1)
 				picint(1 << dev->irq);
 		}
@@ -646,7 +955,7 @@ gus_write(uint16_t addr, uint8_t val, priv_t priv)
 		dev->ad_status |= 0x10;
 		if (dev->sb_ctrl & 0x20) {
 			if (dev->sb_nmi)
-				nmi = 1;
+				nmi_set(1);
 			else if (dev->irq != -1)
 				picint(1 << dev->irq);
 		}
@@ -684,6 +993,9 @@ gus_write(uint16_t addr, uint8_t val, priv_t priv)
 #endif
 		break;
 	}
+
+    if (sync)
+	gus_schedule(dev);
 }
 
 
@@ -692,6 +1004,12 @@ gus_read(uint16_t addr, priv_t priv)
 {
     gus_t *dev = (gus_t *)priv;
     uint8_t val = 0xff;
+    int sync;
+
+    /* Voice registers and the IRQ status have to be up to date. */
+    sync = (addr == 0x246) || (addr == 0x344) || (addr == 0x345);
+    if (sync)
+	gus_sync(dev);
 
     switch (addr) {
 	case 0x340: /*MIDI status*/
@@ -889,7 +1207,7 @@ gus_read(uint16_t addr, priv_t priv)
 
 	case 0x249:
 		dev->ad_status &= ~0x01;
-		nmi = 0;
+		nmi_set(0);
 		/*FALLTHROUGH?*/
 
 	case 0x389:
@@ -902,6 +1220,9 @@ gus_read(uint16_t addr, priv_t priv)
 
     }
 
+    if (sync)
+	gus_schedule(dev);
+
     return(val);
 }
 
@@ -968,161 +1289,18 @@ poll_timer_2(priv_t priv)
 }
 
 
-static void
-gus_update(gus_t *dev)
-{
-    for (; dev->pos < sound_pos_global; dev->pos++) {
-	if (dev->out_l < -32768)
-		dev->buffer[0][dev->pos] = -32768;
-	else if (dev->out_l > 32767)
-		dev->buffer[0][dev->pos] = 32767;
-	else
-		dev->buffer[0][dev->pos] = dev->out_l;
-	if (dev->out_r < -32768)
-		dev->buffer[1][dev->pos] = -32768;
-	else if (dev->out_r > 32767)
-		dev->buffer[1][dev->pos] = 32767;
-	else
-		dev->buffer[1][dev->pos] = dev->out_r;
-    }
-}
-
-
 static void
 poll_wave(priv_t priv)
 {
     gus_t *dev = (gus_t *)priv;
-    uint32_t addr;
-    int d;
-    int16_t v;
-    int32_t vl;
-    int update_irqs = 0;
-
-    gus_update(dev);
 
-    dev->samp_timer += dev->samp_latch;
-
-    dev->out_l = dev->out_r = 0;
-
-    if ((dev->reset & 3) != 3)
-	return;
+    /* Finish the block, the last sample of which is due now. */
+    if (dev->samp_left > 0)
+	render_block(dev, dev->samp_left);
 
-    for (d = 0; d < 32; d++) {
-	if (!(dev->ctrl[d] & 3)) {
-		if (dev->ctrl[d] & 4) {
-			addr = dev->cur[d] >> 9;
-			addr = (addr & 0xC0000) | ((addr << 1) & 0x3FFFE);
-
-			if (!(dev->freq[d] >> 10)) {	/*Interpolate*/
-				vl = (int16_t)(int8_t)((dev->ram[(addr + 1) & 0xFFFFF] ^ 0x80) - 0x80) * (511 - (dev->cur[d] & 511));
-				vl += (int16_t)(int8_t)((dev->ram[(addr + 3) & 0xFFFFF] ^ 0x80) - 0x80) * (dev->cur[d] & 511);
-				v = vl >> 9;
-			} else
-				v = (int16_t)(int8_t)((dev->ram[(addr + 1) & 0xFFFFF] ^ 0x80) - 0x80);
-		} else {
-			if (!(dev->freq[d] >> 10)) {	/*Interpolate*/
-				vl = ((int8_t)((dev->ram[(dev->cur[d] >> 9) & 0xFFFFF] ^ 0x80) - 0x80)) * (511 - (dev->cur[d] & 511));
-				vl += ((int8_t)((dev->ram[((dev->cur[d] >> 9) + 1) & 0xFFFFF] ^ 0x80) - 0x80)) * (dev->cur[d] & 511);
-				v = vl >> 9;
-			} else
-				v = (int16_t)(int8_t)((dev->ram[(dev->cur[d] >> 9) & 0xFFFFF] ^ 0x80) - 0x80);
-		}
-
-		if ((dev->rcur[d] >> 14) > 4095)
-			v = (int16_t)((float)v * 24.0 * vol16bit[4095]);
-		else
-			v = (int16_t)((float)v * 24.0 * vol16bit[(dev->rcur[d] >> 10) & 4095]);
-
-		dev->out_l += (v * dev->pan_l[d]) / 7;
-		dev->out_r += (v * dev->pan_r[d]) / 7;
-
-		if (dev->ctrl[d] & 0x40) {
-			dev->cur[d] -= (dev->freq[d] >> 1);
-			if (dev->cur[d] <= dev->start[d]) {
-				int diff = dev->start[d] - dev->cur[d];
-
-				if (dev->ctrl[d] & 8) {
-					if (dev->ctrl[d] & 0x10)
-						dev->ctrl[d] ^= 0x40;
-					dev->cur[d] = (dev->ctrl[d] & 0x40) ? (dev->end[d] - diff) : (dev->start[d] + diff);
-				} else if (!(dev->rctrl[d] & 4)) {
-					dev->ctrl[d] |= 1;
-					dev->cur[d] = (dev->ctrl[d] & 0x40) ? dev->end[d] : dev->start[d];
-				}
-
-				if ((dev->ctrl[d] & 0x20) && !dev->waveirqs[d]) {
-					dev->waveirqs[d] = 1;
-					update_irqs = 1;
-				}
-			}
-		} else {
-			dev->cur[d] += (dev->freq[d] >> 1);
-
-			if (dev->cur[d] >= dev->end[d]) {
-				int diff = dev->cur[d] - dev->end[d];
-
-				if (dev->ctrl[d] & 8) {
-					if (dev->ctrl[d] & 0x10)
-						dev->ctrl[d] ^= 0x40;
-					dev->cur[d] = (dev->ctrl[d] & 0x40) ? (dev->end[d] - diff) : (dev->start[d] + diff);
-				} else if (!(dev->rctrl[d] & 4)) {
-					dev->ctrl[d] |= 1;
-					dev->cur[d] = (dev->ctrl[d] & 0x40) ? dev->end[d] : dev->start[d];
-				}
-
-				if ((dev->ctrl[d] & 0x20) && !dev->waveirqs[d]) {
-					dev->waveirqs[d] = 1;
-					update_irqs = 1;
-				}
-			}
-		}
-	}
-
-	if (!(dev->rctrl[d] & 3)) {
-		if (dev->rctrl[d] & 0x40) {
-			dev->rcur[d] -= dev->rfreq[d];
-			if (dev->rcur[d] <= dev->rstart[d]) {
-				int diff = dev->rstart[d] - dev->rcur[d];
-
-				if (!(dev->rctrl[d] & 8)) {
-					dev->rctrl[d] |= 1;
-					dev->rcur[d] = (dev->rctrl[d] & 0x40) ? dev->rstart[d] : dev->rend[d];
-				} else {
-					if (dev->rctrl[d] & 0x10)
-						dev->rctrl[d] ^= 0x40;
-					dev->rcur[d] = (dev->rctrl[d] & 0x40) ? (dev->rend[d] - diff) : (dev->rstart[d] + diff);
-				}
-
-				if ((dev->rctrl[d] & 0x20) && !dev->rampirqs[d]) {
-					dev->rampirqs[d] = 1;
-					update_irqs = 1;
-				}
-			}
-		} else {
-			dev->rcur[d] += dev->rfreq[d];
-			if (dev->rcur[d] >= dev->rend[d]) {
-				int diff = dev->rcur[d] - dev->rend[d];
-
-				if (!(dev->rctrl[d] & 8)) {
-					dev->rctrl[d] |= 1;
-					dev->rcur[d] = (dev->rctrl[d] & 0x40) ? dev->rstart[d] : dev->rend[d];
-				} else {
-					if (dev->rctrl[d] & 0x10)
-						dev->rctrl[d] ^= 0x40;
-					dev->rcur[d] = (dev->rctrl[d] & 0x40) ? (dev->rend[d] - diff) : (dev->rstart[d] + diff);
-				}
-
-				if ((dev->rctrl[d] & 0x20) && !dev->rampirqs[d]) {
-					dev->rampirqs[d] = 1;
-					update_irqs = 1;
-				}
-			}
-		}
-	}
-    }
-
-    if (update_irqs)
-	poll_irqs(dev);
+    dev->samp_left = next_irq(dev);
+    dev->samp_step = dev->samp_latch;
+    dev->samp_timer += dev->samp_left * dev->samp_step;
 }
 
 
@@ -1138,12 +1316,20 @@ get_buffer(int32_t *buffer, int len, priv_t priv)
 #endif	
     gus_update(dev);
 
+    /* Nothing rendered, hold the last sample. */
+    if (dev->pos == 0) {
+	dev->buffer[0][0] = (dev->out_l < -32768) ? -32768 : ((dev->out_l > 32767) ? 32767 : dev->out_l);
+	dev->buffer[0][1] = (dev->out_r < -32768) ? -32768 : ((dev->out_r > 32767) ? 32767 : dev->out_r);
+	dev->pos = 1;
+    }
+
+    /* Stretch the samples rendered since the last pull over the buffer. */
     for (c = 0; c < len * 2; c++) {
 #if defined(DEV_BRANCH) && defined(USE_GUSMAX)    
 	if (dev->max_ctrl)
 		buffer[c] += (int32_t)(dev->cs423x.buffer[c] / 2);
 #endif		
-	buffer[c] += (int32_t)dev->buffer[c & 1][c >> 1];
+	buffer[c] += (int32_t)dev->buffer[((c >> 1) * dev->pos) / len][c & 1];
     }
 
 #if defined(DEV_BRANCH) && defined(USE_GUSMAX)    
@@ -1184,6 +1370,8 @@ gus_init(const device_t *info, UNUSED(void *parent))
     dev->voices = 14;
 
     dev->samp_timer = dev->samp_latch = (tmrval_t)(TIMER_USEC * (1000000.0 / 44100.0));
+    dev->samp_step = dev->samp_latch;
+    dev->samp_left = 1;
 
     dev->t1l = dev->t2l = 0xff;
 
@@ -8,7 +8,7 @@
  *
  *		Interface to the actual OPL emulator.
  *
- * Version:	@(#)snd_opl.c	1.0.7	2019/05/17
+ * Version:	@(#)snd_opl.c	1.0.9	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -47,18 +47,30 @@
 #include "../../timer.h"
 #include "../../cpu/cpu.h"
 #include "../../io.h"
+#include "../../plat.h"
 #include "sound.h"
 #include "snd_opl.h"
 #include "snd_dbopl.h"
 
 
+#define OPL_RENDER	0xff		/* queue entry is a render request */
+#define OPL_BLOCK	64		/* render at least this many samples */
+
+#ifdef _MSC_VER
+# include <intrin.h>
+# define OPL_BARRIER()	_ReadWriteBarrier()
+#else
+# define OPL_BARRIER()	__asm volatile ("" : : : "memory")
+#endif
+
+
 static void
 timer_callback00(priv_t priv)
 {
     opl_t *opl = (opl_t *)priv;
 
     opl->timers_enable[0][0] = 0;
-    opl_timer_over(0, 0);
+    opl_timer_over(opl->chip[0], 0);
 }
 
 
@@ -68,7 +80,7 @@ timer_callback01(priv_t priv)
     opl_t *opl = (opl_t *)priv;
 
     opl->timers_enable[0][1] = 0;
-    opl_timer_over(0, 1);
+    opl_timer_over(opl->chip[0], 1);
 }
 
 
@@ -78,7 +90,7 @@ timer_callback10(priv_t priv)
     opl_t *opl = (opl_t *)priv;
 
     opl->timers_enable[1][0] = 0;
-    opl_timer_over(1, 0);
+    opl_timer_over(opl->chip[1], 0);
 }
 
 
@@ -88,33 +100,132 @@ timer_callback11(priv_t priv)
     opl_t *opl = (opl_t *)priv;
 
     opl->timers_enable[1][1] = 0;
-    opl_timer_over(1, 1);
+    opl_timer_over(opl->chip[1], 1);
 }
 	
 
-void
-opl2_update2(opl_t *opl)
+/* Render the samples up to position 'pos' (synthesis thread.) */
+static void
+opl_render(opl_t *opl, int pos)
+{
+    if (pos > SOUNDBUFLEN)
+	pos = SOUNDBUFLEN;
+    if (opl->pos >= pos) return;
+
+    if (opl->is_opl3) {
+	opl3_update(opl->chip[0], &opl->buffer[opl->pos*2], pos - opl->pos);
+    } else {
+	opl2_update(opl->chip[0], &opl->buffer[opl->pos*2], pos - opl->pos);
+	opl2_update(opl->chip[1], &opl->buffer[opl->pos*2 + 1], pos - opl->pos);
+    }
+
+    for (; opl->pos < pos; opl->pos++) {
+	opl->filtbuf[0] = opl->buffer[opl->pos*2]   = (opl->buffer[opl->pos*2]   / 2);
+	opl->filtbuf[1] = opl->buffer[opl->pos*2+1] = (opl->buffer[opl->pos*2+1] / 2);
+    }
+}
+
+
+/*
+ * Play back the queued writes, rendering the samples in between
+ * them in one go. Since the CPU keeps on running meanwhile, most
+ * of a buffer is usually done by the time the sound card wants it.
+ */
+static void
+opl_thread(void *param)
 {
-    if (opl->pos < sound_pos_global) {
-	opl2_update(0, &opl->buffer[opl->pos*2], sound_pos_global - opl->pos);
-	opl2_update(1, &opl->buffer[opl->pos*2 + 1], sound_pos_global - opl->pos);
-	for (; opl->pos < sound_pos_global; opl->pos++) {
-		opl->filtbuf[0] = opl->buffer[opl->pos*2]   = (opl->buffer[opl->pos*2]   / 2);
-		opl->filtbuf[1] = opl->buffer[opl->pos*2+1] = (opl->buffer[opl->pos*2+1] / 2);
+    opl_t *opl = (opl_t *)param;
+    opl_write_t *w;
+    int rd;
+
+    while (opl->run) {
+	thread_wait_event(opl->wake, -1);
+
+	for (rd = opl->q_rd; rd != opl->q_wr; rd = (rd + 1) % OPL_QUEUE_LEN) {
+		OPL_BARRIER();
+		w = &opl->queue[rd];
+
+		opl_render(opl, w->pos);
+		if (w->nr != OPL_RENDER)
+			opl_write_chip(opl->chip[w->nr], w->port, w->val);
+
+		OPL_BARRIER();
+		opl->q_rd = (rd + 1) % OPL_QUEUE_LEN;
 	}
+
+	thread_set_event(opl->done);
     }
 }
 
 
+/* Queue a write, or a render request, for the synthesis thread. */
+static void
+opl_queue(opl_t *opl, int nr, uint16_t port, uint8_t val)
+{
+    int wr = opl->q_wr;
+    int next = (wr + 1) % OPL_QUEUE_LEN;
+    opl_write_t *w;
+
+    /* If the queue is full, let the synthesis thread catch up. */
+    while (next == opl->q_rd) {
+	thread_set_event(opl->wake);
+	thread_wait_event(opl->done, -1);
+    }
+
+    w = &opl->queue[wr];
+    w->pos = sound_pos_global;
+    w->port = port;
+    w->nr = nr;
+    w->val = val;
+
+    OPL_BARRIER();
+    opl->q_wr = next;
+
+    /*
+     * Waking up the thread is not free, so only do so once there
+     * is a worthwhile block of samples to render. Whatever is left
+     * over gets done when the sound card flushes.
+     */
+    if ((nr == OPL_RENDER) || (w->pos - opl->wake_pos) >= OPL_BLOCK) {
+	opl->wake_pos = w->pos;
+	thread_set_event(opl->wake);
+    }
+}
+
+
+/* Wait until all samples up to now have been rendered. */
+static void
+opl_flush(opl_t *opl)
+{
+    if (opl->pos >= sound_pos_global && opl->q_rd == opl->q_wr)
+	return;
+
+    opl_queue(opl, OPL_RENDER, 0, 0);
+
+    while (opl->q_rd != opl->q_wr)
+	thread_wait_event(opl->done, -1);
+    OPL_BARRIER();
+
+    /* The card starts a new buffer after this. */
+    opl->wake_pos = 0;
+}
+
+
+void
+opl2_update2(opl_t *opl)
+{
+    opl_flush(opl);
+}
+
+
 uint8_t
 opl2_read(uint16_t a, priv_t priv)
 {
     opl_t *opl = (opl_t *)priv;
 
     cycles -= ISA_CYCLES(8);
-    opl2_update2(opl);
 
-    return opl_read(0, a);
+    return opl_read(opl->chip[0], a);
 }
 
 
@@ -123,9 +234,10 @@ opl2_write(uint16_t a, uint8_t v, priv_t priv)
 {
     opl_t *opl = (opl_t *)priv;
 
-    opl2_update2(opl);
-    opl_write(0, a, v);
-    opl_write(1, a, v);
+    opl_write(opl->chip[0], a, v);
+    opl_write(opl->chip[1], a, v);
+    opl_queue(opl, 0, a, v);
+    opl_queue(opl, 1, a, v);
 }
 
 
@@ -135,9 +247,8 @@ opl2_l_read(uint16_t a, priv_t priv)
     opl_t *opl = (opl_t *)priv;
 
     cycles -= ISA_CYCLES(8);
-    opl2_update2(opl);
 
-    return opl_read(0, a);
+    return opl_read(opl->chip[0], a);
 }
 
 
@@ -146,8 +257,8 @@ opl2_l_write(uint16_t a, uint8_t v, priv_t priv)
 {
     opl_t *opl = (opl_t *)priv;
 
-    opl2_update2(opl);
-    opl_write(0, a, v);
+    opl_write(opl->chip[0], a, v);
+    opl_queue(opl, 0, a, v);
 }
 
 
@@ -157,9 +268,8 @@ opl2_r_read(uint16_t a, priv_t priv)
     opl_t *opl = (opl_t *)priv;
 
     cycles -= ISA_CYCLES(8);
-    opl2_update2(opl);
 
-    return opl_read(1, a);
+    return opl_read(opl->chip[1], a);
 }
 
 
@@ -168,22 +278,15 @@ opl2_r_write(uint16_t a, uint8_t v, priv_t priv)
 {
     opl_t *opl = (opl_t *)priv;
 
-    opl2_update2(opl);
-    opl_write(1, a, v);
+    opl_write(opl->chip[1], a, v);
+    opl_queue(opl, 1, a, v);
 }
 
 
 void
 opl3_update2(opl_t *opl)
 {
-    if (opl->pos < sound_pos_global) {
-	opl3_update(0, &opl->buffer[opl->pos*2], sound_pos_global - opl->pos);
-
-	for (; opl->pos < sound_pos_global; opl->pos++) {
-		opl->filtbuf[0] = opl->buffer[opl->pos*2]   = (opl->buffer[opl->pos*2]   / 2);
-		opl->filtbuf[1] = opl->buffer[opl->pos*2+1] = (opl->buffer[opl->pos*2+1] / 2);
-	}
-    }
+    opl_flush(opl);
 }
 
 
@@ -193,9 +296,8 @@ opl3_read(uint16_t a, priv_t priv)
     opl_t *opl = (opl_t *)priv;
 
     cycles -= ISA_CYCLES(8);
-    opl3_update2(opl);
 
-    return opl_read(0, a);
+    return opl_read(opl->chip[0], a);
 }
 
 
@@ -204,8 +306,8 @@ opl3_write(uint16_t a, uint8_t v, priv_t priv)
 {
     opl_t *opl = (opl_t *)priv;
 	
-    opl3_update2(opl);
-    opl_write(0, a, v);
+    opl_write(opl->chip[0], a, v);
+    opl_queue(opl, 0, a, v);
 }
 
 
@@ -245,11 +347,24 @@ ymf262_timer_set(priv_t param, int timer, tmrval_t period)
 }
 
 
+static void
+opl_thread_start(opl_t *opl)
+{
+    opl->q_wr = opl->q_rd = 0;
+
+    opl->run = 1;
+    opl->wake = thread_create_event();
+    opl->done = thread_create_event();
+    opl->thread = thread_create(opl_thread, opl);
+}
+
+
 void
 opl2_init(opl_t *opl)
 {
-    opl_init(ym3812_timer_set_0, opl, 0, 0);
-    opl_init(ym3812_timer_set_1, opl, 1, 0);
+    opl->is_opl3 = 0;
+    opl->chip[0] = opl_init(ym3812_timer_set_0, opl, 0);
+    opl->chip[1] = opl_init(ym3812_timer_set_1, opl, 0);
 
     timer_add(timer_callback00, (priv_t)opl,
 	      &opl->timers[0][0], &opl->timers_enable[0][0]);
@@ -259,17 +374,42 @@ opl2_init(opl_t *opl)
 	      &opl->timers[1][0], &opl->timers_enable[1][0]);
     timer_add(timer_callback11, (priv_t)opl,
 	      &opl->timers[1][1], &opl->timers_enable[1][1]);
+
+    opl_thread_start(opl);
 }
 
 
 void
 opl3_init(opl_t *opl)
 {
-    opl_init(ymf262_timer_set, opl, 0, 1);
+    opl->is_opl3 = 1;
+    opl->chip[0] = opl_init(ymf262_timer_set, opl, 1);
 
     timer_add(timer_callback00, (priv_t)opl,
 	      &opl->timers[0][0], &opl->timers_enable[0][0]);
     timer_add(timer_callback01, (priv_t)opl,
 	      &opl->timers[0][1], &opl->timers_enable[0][1]);
+
+    opl_thread_start(opl);
 }
 
+
+void
+opl_close(opl_t *opl)
+{
+    if (opl->thread == NULL) return;
+
+    opl->run = 0;
+    thread_set_event(opl->wake);
+    thread_wait(opl->thread, -1);
+
+    thread_destroy_event(opl->wake);
+    thread_destroy_event(opl->done);
+    opl->thread = NULL;
+
+    if (opl->chip[0] != NULL)
+	opl_free(opl->chip[0]);
+    if (opl->chip[1] != NULL)
+	opl_free(opl->chip[1]);
+    opl->chip[0] = opl->chip[1] = NULL;
+}
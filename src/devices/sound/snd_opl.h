@@ -8,7 +8,7 @@
  *
  *		Definitions for the OPL interface.
  *
- * Version:	@(#)snd_opl.h	1.0.2	2010/05/17
+ * Version:	@(#)snd_opl.h	1.0.4	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -41,8 +41,21 @@
 # define SOUND_OPL_H
 
 
+/* Size of the register write queue, in writes. */
+#define OPL_QUEUE_LEN	1024
+
+
+typedef struct {
+    int		pos;			/* sample position of the write */
+    uint16_t	port;
+    uint8_t	nr,			/* chip, or OPL_RENDER */
+		val;
+} opl_write_t;
+
+
 typedef struct {
-    int		chip_nr[2];
+    void	*chip[2];
+    int		is_opl3;
 
     tmrval_t	timers[2][2];
     tmrval_t	timers_enable[2][2];
@@ -51,6 +64,21 @@ typedef struct {
 
     int		pos;
     int16_t	buffer[SOUNDBUFLEN * 2];
+
+    /*
+     * Writes to the chip registers are queued here, and played
+     * back on the synthesis thread, which renders the samples
+     * between them in blocks.
+     */
+    opl_write_t	queue[OPL_QUEUE_LEN];
+    volatile int q_wr,
+		q_rd;
+    int		wake_pos;
+
+    volatile int run;
+    void	*thread;
+    void	*wake,
+		*done;
 } opl_t;
 
 
@@ -70,5 +98,7 @@ extern uint8_t	opl3_read(uint16_t a, priv_t);
 extern void	opl3_write(uint16_t a, uint8_t v, priv_t);
 extern void	opl3_init(opl_t *opl);
 
+extern void	opl_close(opl_t *opl);
+
 
 #endif	/*SOUND_OPL_H*/
@@ -79,7 +79,7 @@
  *		FF88 - board model
  *		  3 = PAS16
  *
- * Version:	@(#)snd_pas16.c	1.0.16	2019/05/17
+ * Version:	@(#)snd_pas16.c	1.0.17	2019/06/22
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -754,6 +754,8 @@ static void pas16_close(priv_t priv)
 {
         pas16_t *pas16 = (pas16_t *)priv;
 
+        opl_close(&pas16->opl);
+
         free(pas16);
 }
 
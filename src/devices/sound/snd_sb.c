@@ -8,7 +8,7 @@
  *
  *		Sound Blaster emulation.
  *
- * Version:	@(#)snd_sb.c	1.0.14	2019/05/17
+ * Version:	@(#)snd_sb.c	1.0.15	2019/06/22
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -1322,6 +1322,8 @@ void sb_close(priv_t priv)
 {
         sb_t *sb = (sb_t *)priv;
         sb_dsp_close(&sb->dsp);
+        if (sb->opl_enabled)
+                opl_close(&sb->opl);
         #ifdef SB_DSP_RECORD_DEBUG
             if (soundfsb != 0)
             {
@@ -8,7 +8,7 @@
  *
  *		Implementation of the Windows Sound System sound device.
  *
- * Version:	@(#)snd_wss.c	1.0.10	2019/05/17
+ * Version:	@(#)snd_wss.c	1.0.11	2019/06/22
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		TheCollector1995, <mariogplayer@gmail.com>
@@ -171,6 +171,8 @@ wss_close(priv_t priv)
 {
     wss_t *dev = (wss_t *)priv;
 
+    opl_close(&dev->opl);
+
     free(dev);
 }
 
@@ -8,7 +8,7 @@
  *
  *		Sound emulation core.
  *
- * Version:	@(#)sound.c	1.0.20	2019/05/17
+ * Version:	@(#)sound.c	1.0.23	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -49,6 +49,7 @@
 #include "../../timer.h"
 #include "../../device.h"
 #include "../../plat.h"
+#include "../../capture.h"
 #include "../cdrom/cdrom.h"
 #include "sound.h"
 #include "midi.h"
@@ -62,6 +63,30 @@
 #include "snd_sb_dsp.h"
 #include "snd_speaker.h"
 #include "filters.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+# include <emmintrin.h>
+# define SOUND_SSE2	1
+#endif
+#ifdef _MSC_VER
+# include <intrin.h>
+# define SOUND_BARRIER()	_ReadWriteBarrier()
+#else
+# define SOUND_BARRIER()	__asm volatile ("" : : : "memory")
+#endif
+
+
+/*
+ * The mixed output of all sound devices goes into this ring, which
+ * is filled by the CPU thread and drained by the sound thread. This
+ * keeps the (possibly slow) sample conversion and OpenAL calls away
+ * from the emulation, and lets either side run ahead of the other by
+ * a few buffers. There is one producer and one consumer, so the two
+ * indices need no locking, as long as the data is written before the
+ * index that publishes it.
+ */
+#define RING_LEN	(SOUNDBUFLEN * 8)	/* in stereo frames */
+#define RING_TARGET	SOUNDBUFLEN		/* fill level we aim for */
+#define RING_TRIM_MAX	(65536 / 200)		/* max. rate trim, 0.5% */
 
 
 typedef struct {
@@ -81,8 +106,18 @@ static int	handlers_num;
 static tmrval_t	poll_time = 0,
 		poll_latch;
 static int32_t	*outbuffer;
-static float	*outbuffer_ex;
-static int16_t	*outbuffer_ex_int16;
+
+static int32_t	ring[RING_LEN * 2];
+static volatile uint32_t ring_wr,
+		ring_rd;
+static uint32_t	ring_frac;
+static int	ring_overruns;
+static int32_t	mix_buffer[SOUNDBUFLEN * 2];
+static float	mix_out[SOUNDBUFLEN * 2];
+static int16_t	mix_out_int16[SOUNDBUFLEN * 2];
+static thread_t	*sound_thread_h;
+static event_t	*sound_event;
+static volatile int sound_thread_run = 0;
 
 static int16_t	cd_buffer[CDROM_NUM][CD_BUFLEN * 2];
 static float	cd_out_buffer[CD_BUFLEN * 2];
@@ -250,6 +285,185 @@ cd_thread_end(void)
 }
 
 
+/* Add a block of mixed samples to the ring (CPU thread.) */
+static void
+ring_put(const int32_t *buf, uint32_t frames)
+{
+    uint32_t wr = ring_wr;
+    uint32_t space, first;
+
+    space = (ring_rd + RING_LEN - wr - 1) % RING_LEN;
+    if (frames > space) {
+	/* The sound thread is not keeping up, drop this block. */
+	ring_overruns++;
+	return;
+    }
+
+    first = RING_LEN - wr;
+    if (first > frames)
+	first = frames;
+    memcpy(&ring[wr * 2], buf, first * 2 * sizeof(int32_t));
+    if (frames > first)
+	memcpy(ring, &buf[first * 2], (frames - first) * 2 * sizeof(int32_t));
+
+    SOUND_BARRIER();
+    ring_wr = (wr + frames) % RING_LEN;
+
+    if (sound_event != NULL)
+	thread_set_event(sound_event);
+}
+
+
+/* Convert a block of mixed samples to the output format. */
+static void
+mix_convert(const int32_t *in, int len)
+{
+    int c;
+
+#ifdef SOUND_SSE2
+    if (config.sound_is_float) {
+	const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+
+	for (c = 0; c < len; c += 4)
+		_mm_storeu_ps(&mix_out[c],
+			      _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)&in[c])), scale));
+    } else {
+	/* PACKSSDW does the clamping to 16 bits for us. */
+	for (c = 0; c < len; c += 8)
+		_mm_storeu_si128((__m128i *)&mix_out_int16[c],
+				 _mm_packs_epi32(_mm_loadu_si128((const __m128i *)&in[c]),
+						 _mm_loadu_si128((const __m128i *)&in[c + 4])));
+    }
+#else
+    for (c = 0; c < len; c++) {
+	if (config.sound_is_float) {
+		mix_out[c] = (float)((in[c]) / 32768.0);
+	} else {
+		if (in[c] > 32767)
+			mix_out_int16[c] = 32767;
+		else if (in[c] < -32768)
+			mix_out_int16[c] = -32768;
+		else
+			mix_out_int16[c] = in[c];
+	}
+    }
+#endif
+}
+
+
+/*
+ * Take one output buffer worth of samples from the ring, and hand it
+ * to OpenAL (sound thread.)
+ *
+ * To keep the latency in check without dropping or repeating whole
+ * buffers (which clicks), the ring is read at a rate that is slightly
+ * trimmed according to how far its fill level is off the target, and
+ * the samples are linearly interpolated. The trim is at most 0.5%,
+ * which is not audible.
+ *
+ * Returns 0 if there was not enough data, or OpenAL had no room.
+ */
+static int
+ring_get(void)
+{
+    uint32_t rd = ring_rd;
+    uint32_t fill, pos, i, j;
+    int32_t step, f;
+    int c;
+
+    fill = (ring_wr + RING_LEN - rd) % RING_LEN;
+    SOUND_BARRIER();
+
+    step = ((int32_t)fill - RING_TARGET) / 4;
+    if (step > RING_TRIM_MAX)
+	step = RING_TRIM_MAX;
+    else if (step < -RING_TRIM_MAX)
+	step = -RING_TRIM_MAX;
+    step += 65536;
+
+    if (fill < ((ring_frac + (SOUNDBUFLEN - 1) * (uint32_t)step) >> 16) + 2)
+	return(0);
+
+    pos = ring_frac;
+    for (c = 0; c < SOUNDBUFLEN * 2; c += 2) {
+	i = (rd + (pos >> 16)) % RING_LEN;
+	j = (i + 1) % RING_LEN;
+	f = pos & 0xffff;
+
+	mix_buffer[c] = ring[i * 2] + (int32_t)(((int64_t)(ring[j * 2] - ring[i * 2]) * f) >> 16);
+	mix_buffer[c + 1] = ring[i * 2 + 1] + (int32_t)(((int64_t)(ring[j * 2 + 1] - ring[i * 2 + 1]) * f) >> 16);
+
+	pos += step;
+    }
+
+    mix_convert(mix_buffer, SOUNDBUFLEN * 2);
+
+    if (config.sound_is_float)
+	c = openal_buffer(mix_out);
+    else
+	c = openal_buffer(mix_out_int16);
+    if (! c)
+	return(0);
+
+    SOUND_BARRIER();
+    ring_rd = (rd + (pos >> 16)) % RING_LEN;
+    ring_frac = pos & 0xffff;
+
+    return(1);
+}
+
+
+static void
+sound_thread(void *param)
+{
+    while (sound_thread_run) {
+	/*
+	 * Wake up for every new block, but also poll now and then,
+	 * as OpenAL does not tell us when it has room again.
+	 */
+	thread_wait_event(sound_event, 10);
+	thread_reset_event(sound_event);
+
+	while (sound_thread_run && ring_get())
+		;
+    }
+}
+
+
+static void
+sound_thread_start(void)
+{
+    if (sound_thread_run) return;
+
+    ring_wr = ring_rd = 0;
+    ring_frac = 0;
+
+    sound_thread_run = 1;
+    sound_event = thread_create_event();
+    sound_thread_h = thread_create(sound_thread, NULL);
+}
+
+
+static void
+sound_thread_end(void)
+{
+    if (! sound_thread_run) return;
+
+    sound_thread_run = 0;
+
+    DEBUG("Waiting for sound thread to terminate...\n");
+
+    thread_set_event(sound_event);
+    thread_wait(sound_thread_h, -1);
+
+    DEBUG("Sound thread terminated (%i overruns.)\n", ring_overruns);
+
+    thread_destroy_event(sound_event);
+    sound_event = NULL;
+    sound_thread_h = NULL;
+}
+
+
 static void
 sound_poll(void *priv)
 {
@@ -266,24 +480,12 @@ sound_poll(void *priv)
 	for (c = 0; c < handlers_num; c++)
 		handlers[c].get_buffer(outbuffer, SOUNDBUFLEN, handlers[c].priv);
 
-	for (c = 0; c < SOUNDBUFLEN * 2; c++) {
-		if (config.sound_is_float) {
-			outbuffer_ex[c] = (float)((outbuffer[c]) / 32768.0);
-		} else {
-			if (outbuffer[c] > 32767)
-				outbuffer[c] = 32767;
-			if (outbuffer[c] < -32768)
-				outbuffer[c] = -32768;
+	if (capture_active)
+		capture_audio(outbuffer, SOUNDBUFLEN);
 
-			outbuffer_ex_int16[c] = outbuffer[c];
-		}
-	}
+	/* The sound thread does the rest. */
+	ring_put(outbuffer, SOUNDBUFLEN);
 
-	if (config.sound_is_float)
-		openal_buffer(outbuffer_ex);
-	else
-		openal_buffer(outbuffer_ex_int16);
-	
 	if (cd_thread_enable) {
 		cd_buf_update--;
 		if (! cd_buf_update) {
@@ -325,15 +527,8 @@ sound_reset(void)
     /* Kill the CD-Audio thread. */
     sound_cd_stop();
 
-    /* Reset the sound module buffers. */
-    if (outbuffer_ex != NULL)
-	free(outbuffer_ex);
-    if (outbuffer_ex_int16 != NULL)
-	free(outbuffer_ex_int16);
-    if (config.sound_is_float)
-	outbuffer_ex = (float *)mem_alloc(SOUNDBUFLEN * 2 * sizeof(float));
-      else
-	outbuffer_ex_int16 = (int16_t *)mem_alloc(SOUNDBUFLEN * 2 * sizeof(int16_t));
+    /* Stop the sound thread while we reset OpenAL. */
+    sound_thread_end();
 
     /* Reset the sound module data handlers. */
     handlers_num = 0;
@@ -344,6 +539,8 @@ sound_reset(void)
     /* Reset OpenAL. */
     openal_reset();
 
+    sound_thread_start();
+
     timer_add(sound_poll, NULL, &poll_time, TIMER_ALWAYS_ENABLED);
 
     sound_cd_set_volume(65535, 65535);
@@ -381,9 +578,6 @@ sound_init(void)
 
     handlers_num = 0;
 
-    outbuffer_ex = NULL;
-    outbuffer_ex_int16 = NULL;
-
     outbuffer = (int32_t *)mem_alloc(SOUNDBUFLEN * 2 * sizeof(int32_t));
 
     /* Set up the CD-AUDIO thread. */
@@ -421,6 +615,9 @@ sound_close(void)
     /* Kill the CD-Audio thread if needed. */
     sound_cd_stop();
 
+    /* Kill the sound thread. */
+    sound_thread_end();
+
     /* Close down the MIDI module. */
     midi_close();
 
@@ -8,7 +8,7 @@
  *
  *		Definitions for the Sound Emulation core.
  *
- * Version:	@(#)sound.h	1.0.11	2018/10/25
+ * Version:	@(#)sound.h	1.0.12	2019/06/20
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -85,7 +85,7 @@ extern void	sound_cd_set_volume(unsigned int vol_l, unsigned int vol_r);
 extern void	openal_close(void);
 extern void	openal_init(void);
 extern void	openal_reset(void);
-extern void	openal_buffer(void *buf);
+extern int	openal_buffer(void *buf);
 extern void	openal_buffer_cd(void *buf);
 extern void	openal_buffer_midi(void *buf, uint32_t size);
 extern void	openal_set_midi(int freq, int buf_size);
@@ -8,7 +8,7 @@
  *
  *		Implementation of the NMI handler.
  *
- * Version:	@(#)nmi.c	1.0.3	2019/05/13
+ * Version:	@(#)nmi.c	1.0.4	2019/06/14
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -41,6 +41,7 @@
 #include <string.h>
 #include <wchar.h>
 #include "../../emu.h"
+#include "../../cpu/cpu.h"
 #include "../../io.h"
 #include "nmi.h"
 
@@ -55,6 +56,19 @@ nmi_write(uint16_t port, uint8_t val, priv_t priv)
 }
 
 
+/* Raise or lower the NMI line, and let the CPU know about it. */
+void
+nmi_set(int val)
+{
+    nmi = val;
+
+    if (nmi)
+	cpu_events |= CPU_EVENT_NMI;
+    else
+	cpu_events &= ~CPU_EVENT_NMI;
+}
+
+
 void
 nmi_init(void)
 {
@@ -8,7 +8,7 @@
  *
  *		Definitions for the NMI handler.
  *
- * Version:	@(#)nmi.h	1.0.3	2019/05/13
+ * Version:	@(#)nmi.h	1.0.4	2019/06/14
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -46,6 +46,7 @@ extern int	nmi_auto_clear;
 
 
 extern void	nmi_init(void);
+extern void	nmi_set(int val);
 
 
 #endif	/*EMU_NMI_H*/
@@ -8,7 +8,7 @@
  *
  *		Implementation of Intel 8259 interrupt controller.
  *
- * Version:	@(#)pic.c	1.0.9	2019/05/17
+ * Version:	@(#)pic.c	1.0.10	2019/06/14
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -42,6 +42,7 @@
 #include <wchar.h>
 #include "../../emu.h"
 #include "../../timer.h"
+#include "../../cpu/cpu.h"
 #include "../../io.h"
 #include "pci.h"
 #include "pic.h"
@@ -107,6 +108,12 @@ update_pending(void)
 	}
     }
 
+    /* Tell the CPU whether it has to go and ask us for a vector. */
+    if (pic_pending)
+	cpu_events |= CPU_EVENT_IRQ;
+    else
+	cpu_events &= ~CPU_EVENT_IRQ;
+
 #if 0
     DBGLOG(2, "pic_intpending = %i  %02X %02X %02X %02X\n",
 	   pic_pending, pic.ins, pic.pend, pic.mask, pic.mask2);
@@ -529,6 +536,7 @@ pic_reset(void)
     pic2.pend = pic2.ins = 0;
 
     pic_pending = 0;
+    cpu_events &= ~CPU_EVENT_IRQ;
 }
 
 
@@ -13,7 +13,7 @@
  *		B4 to 40, two writes to 43, then two reads
  *			- value _does_ change!
  *
- * Version:	@(#)pit.c	1.0.17	2019/05/17
+ * Version:	@(#)pit.c	1.0.18	2019/06/14
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -541,7 +541,7 @@ ps2_irq0(int new_out, int old_out)
 static void
 ps2_nmi(int new_out, int old_out)
 {
-    nmi = new_out;
+    nmi_set(new_out);
 
     if (nmi)
 	nmi_auto_clear = 1;
@@ -8,7 +8,7 @@
  *
  *		ATi Mach64 graphics card emulation.
  *
- * Version:	@(#)vid_ati_mach64.c	1.0.21	2019/05/17
+ * Version:	@(#)vid_ati_mach64.c	1.0.23	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -1205,6 +1205,314 @@ void mach64_start_line(mach64_t *mach64)
                                         svga->changedvram[(((addr) >> 3) & mach64->vram_mask) >> 12] = changeframecount;        \
                                 }
 
+/*
+ * Span routines for rectangle operations.
+ *
+ * Fills, pattern fills, screen-to-screen copies and monochrome expands
+ * from video memory whose mix does not need the destination are done
+ * a scanline at a time by mach64_blit_rect(), which is tried once when
+ * the operation starts. Anything else, or anything that would wrap
+ * around, is left to the pel-by-pel code in mach64_blit().
+ */
+static int mach64_mix_solid(int mix)
+{
+        switch (mix)
+        {
+                case 0x1: case 0x2: case 0x3: case 0x4: case 0x7:
+                return 1;
+        }
+
+        return mix >= 0x10;
+}
+
+/* Work out what a solid mix writes, or 0 if it leaves the pel alone. */
+static int mach64_mix_pel(int mix, uint32_t src_dat, uint32_t *val)
+{
+        switch (mix)
+        {
+                case 0x1: *val =  0;       break;
+                case 0x2: *val = ~0;       break;
+                case 0x4: *val = ~src_dat; break;
+                case 0x7: *val =  src_dat; break;
+                default:  return 0;
+        }
+
+        return 1;
+}
+
+static void mach64_span_dirty(mach64_t *mach64, uint32_t addr, int n)
+{
+        int size = mach64->accel.dst_size;
+        uint32_t c;
+
+        for (c = (addr << size) >> 12; c <= (((addr + n) << size) - 1) >> 12; c++)
+                mach64->svga.changedvram[c] = changeframecount;
+}
+
+/* Is this span of pels all in memory, without wrapping around? */
+static int mach64_span_ok(mach64_t *mach64, uint32_t addr, int n, int size)
+{
+        uint32_t mask = mach64->vram_mask >> size;
+
+        return (addr <= mask) && ((uint32_t)(n - 1) <= (mask - addr));
+}
+
+/*
+ * Fill n pels from addr on, for screen column x, with an 8-pel pattern.
+ * Columns with their bit clear in opaque are left alone.
+ */
+static void mach64_span_fill(mach64_t *mach64, uint32_t addr, int x, int n, const uint32_t *pat, int opaque)
+{
+        svga_t *svga = &mach64->svga;
+        int size = mach64->accel.dst_size;
+        uint32_t dest_dat;
+        uint8_t *p;
+        int c, len;
+
+        if (n <= 0 || !opaque)
+                return;
+
+        if (!mach64_span_ok(mach64, addr, n, size) || opaque != 0xff)
+        {
+                for (c = 0; c < n; c++)
+                {
+                        if (!(opaque & (1 << ((x + c) & 7))))
+                                continue;
+                        dest_dat = pat[(x + c) & 7];
+                        WRITE(addr + c, size);
+                }
+                return;
+        }
+
+        p = &svga->vram[addr << size];
+        for (c = 1; c < 8; c++)
+                if (pat[c] != pat[0])
+                        break;
+        if (c == 8 && size == 0)
+        {
+                memset(p, pat[0], n);
+                mach64_span_dirty(mach64, addr, n);
+                return;
+        }
+
+        /* Lay down one pattern period, and keep doubling it. */
+        len = (n < 8) ? n : 8;
+        for (c = 0; c < len; c++)
+        {
+                switch (size)
+                {
+                        case 0: p[c] = pat[(x + c) & 7]; break;
+                        case 1: ((uint16_t *)p)[c] = pat[(x + c) & 7]; break;
+                        case 2: ((uint32_t *)p)[c] = pat[(x + c) & 7]; break;
+                }
+        }
+        while (len < n)
+        {
+                c = (len < (n - len)) ? len : (n - len);
+                memcpy(p + (len << size), p, c << size);
+                len += c;
+        }
+        mach64_span_dirty(mach64, addr, n);
+}
+
+/*
+ * Copy n pels from src to dest, going left or right (inc) like the
+ * pel-by-pel code does, so overlapping copies come out the same.
+ */
+static void mach64_span_copy(mach64_t *mach64, uint32_t dest, uint32_t src, int n, int inc)
+{
+        svga_t *svga = &mach64->svga;
+        int size = mach64->accel.dst_size;
+        uint32_t dest_dat;
+        int c;
+
+        if (n <= 0)
+                return;
+
+        if (!mach64_span_ok(mach64, dest, n, size) || !mach64_span_ok(mach64, src, n, size) ||
+            (inc && dest > src && dest < (src + n)) ||
+            (!inc && dest < src && (dest + n) > src))
+        {
+                for (c = 0; c < n; c++)
+                {
+                        int o = inc ? c : (n - 1 - c);
+
+                        READ(src + o, dest_dat, size);
+                        WRITE(dest + o, size);
+                }
+                return;
+        }
+
+        memmove(&svga->vram[dest << size], &svga->vram[src << size], n << size);
+        mach64_span_dirty(mach64, dest, n);
+}
+
+/* Do a whole rectangle operation, if we can. */
+static int mach64_blit_rect(mach64_t *mach64)
+{
+        svga_t *svga = &mach64->svga;
+        int w = mach64->accel.dst_width;
+        int h = mach64->accel.dst_height;
+        int xinc = mach64->accel.xinc, yinc = mach64->accel.yinc;
+        int x0 = mach64->accel.dst_x_start, y0 = mach64->accel.dst_y_start;
+        int sx0 = mach64->accel.src_x_start, sy0 = mach64->accel.src_y_start;
+        int linear = mach64->src_cntl & SRC_LINEAR_EN;
+        int source_mix = mach64->accel.source_mix;
+        int use_bg = (source_mix != MONO_SRC_1);
+        int copy = 0, fg_on = 0, bg_on = 0;
+        uint32_t fg = 0, bg = 0, pat[8];
+        uint32_t dst, src, dest_dat;
+        int r, c, x, y, l, n, mix;
+
+        if (mach64->accel.source_host || mach64->accel.dst_size == WIDTH_1BIT ||
+            (mach64->dst_cntl & (DST_POLYGON_EN | DST_24_ROT_EN)) ||
+            mach64->accel.clr_cmp_fn == 1 || mach64->accel.clr_cmp_fn == 4 ||
+            mach64->accel.clr_cmp_fn == 5 || w <= 0 || h <= 0)
+                return 0;
+
+        /* Rows may wrap around, but the pels within a row may not. */
+        if ((xinc > 0) ? (x0 + w - 1 > 0xfff) : (x0 - w + 1 < 0))
+                return 0;
+
+        switch (source_mix)
+        {
+                case MONO_SRC_1:
+                case MONO_SRC_PAT:
+                break;
+
+                case MONO_SRC_BLITSRC:
+                if (!linear && ((mach64->src_cntl & (SRC_PATT_EN | SRC_PATT_ROT_EN)) ||
+                    mach64->accel.src_width1 < w ||
+                    ((xinc > 0) ? (sx0 + w - 1 > 0xfff) : (sx0 - w + 1 < 0))))
+                        return 0;
+                break;
+
+                default:
+                return 0;
+        }
+
+        if (mach64->accel.source_fg == SRC_BLITSRC)
+        {
+                /* Only plain copies of the source. */
+                if (source_mix != MONO_SRC_1 || mach64->accel.mix_fg != 0x7 ||
+                    mach64->accel.src_size != mach64->accel.dst_size ||
+                    (mach64->src_cntl & (SRC_LINEAR_EN | SRC_PATT_EN | SRC_PATT_ROT_EN)) ||
+                    mach64->accel.src_width1 < w ||
+                    ((xinc > 0) ? (sx0 + w - 1 > 0xfff) : (sx0 - w + 1 < 0)))
+                        return 0;
+                copy = 1;
+        }
+        else
+        {
+                if (!mach64_mix_solid(mach64->accel.mix_fg) ||
+                    (use_bg && (mach64->accel.source_bg == SRC_BLITSRC ||
+                                !mach64_mix_solid(mach64->accel.mix_bg))))
+                        return 0;
+
+#define SOLID(s)        (((s) == SRC_FG) ? mach64->accel.dp_frgd_clr : ((s) == SRC_BG) ? mach64->accel.dp_bkgd_clr : 0)
+                fg_on = mach64_mix_pel(mach64->accel.mix_fg, SOLID(mach64->accel.source_fg), &fg);
+                if (use_bg)
+                        bg_on = mach64_mix_pel(mach64->accel.mix_bg, SOLID(mach64->accel.source_bg), &bg);
+#undef SOLID
+        }
+
+        for (r = 0; r < h; r++)
+        {
+                y = (y0 + (r * yinc)) & 0xfff;
+                if (y < mach64->accel.sc_top || y > mach64->accel.sc_bottom)
+                        continue;
+
+                /* Clip the row, leftmost pel first. */
+                l = (xinc > 0) ? x0 : (x0 - w + 1);
+                n = w;
+                if (l < mach64->accel.sc_left)
+                {
+                        n -= mach64->accel.sc_left - l;
+                        l = mach64->accel.sc_left;
+                }
+                if (l + n - 1 > mach64->accel.sc_right)
+                        n = mach64->accel.sc_right - l + 1;
+                if (n <= 0)
+                        continue;
+
+                dst = mach64->accel.dst_offset + (y * mach64->accel.dst_pitch) + l;
+
+                if (copy)
+                {
+                        src = mach64->accel.src_offset + (((sy0 + (r * yinc)) & 0xfff) * mach64->accel.src_pitch) + sx0 + (l - x0);
+                        mach64_span_copy(mach64, dst, src, n, xinc > 0);
+                        continue;
+                }
+
+                switch (source_mix)
+                {
+                        case MONO_SRC_1:
+                        for (c = 0; c < 8; c++)
+                                pat[c] = fg;
+                        mach64_span_fill(mach64, dst, l, n, pat, fg_on ? 0xff : 0);
+                        break;
+
+                        case MONO_SRC_PAT:
+                        mix = 0;
+                        for (c = 0; c < 8; c++)
+                        {
+                                if (mach64->accel.pattern[y & 7][c])
+                                {
+                                        pat[c] = fg;
+                                        mix |= fg_on << c;
+                                }
+                                else
+                                {
+                                        pat[c] = bg;
+                                        mix |= bg_on << c;
+                                }
+                        }
+                        mach64_span_fill(mach64, dst, l, n, pat, mix);
+                        break;
+
+                        case MONO_SRC_BLITSRC:
+                        for (c = 0; c < n; c++)
+                        {
+                                /* Same order as the hardware, in case we overwrite the source. */
+                                x = (xinc > 0) ? (l + c) : (l + n - 1 - c);
+                                if (linear)
+                                        src = mach64->accel.src_offset + (((r * w) + ((x - x0) * xinc)) * xinc);
+                                else
+                                        src = mach64->accel.src_offset + (((sy0 + (r * yinc)) & 0xfff) * mach64->accel.src_pitch) + sx0 + (x - x0);
+                                READ(src, mix, WIDTH_1BIT);
+                                if (mix ? fg_on : bg_on)
+                                {
+                                        dest_dat = mix ? fg : bg;
+                                        WRITE(dst + (x - l), mach64->accel.dst_size);
+                                }
+                        }
+                        break;
+                }
+        }
+
+        /* Leave things as the pel-by-pel code would. */
+        mach64->accel.dst_x = 0;
+        mach64->accel.dst_y += h * yinc;
+        mach64->accel.x_count = mach64->accel.dst_width;
+        if (linear)
+                mach64->accel.src_x = h * w * xinc;
+        else
+        {
+                mach64->accel.src_x = 0;
+                mach64->accel.src_y += h * yinc;
+        }
+        mach64->accel.dst_height = 0;
+        mach64->accel.poly_draw = 0;
+
+        mach64->accel.busy = 0;
+        if (mach64->dst_cntl & DST_X_TILE)
+                mach64->dst_y_x = (mach64->dst_y_x & 0xfff) | ((mach64->dst_y_x + (mach64->accel.dst_width << 16)) & 0xfff0000);
+        if (mach64->dst_cntl & DST_Y_TILE)
+                mach64->dst_y_x = (mach64->dst_y_x & 0xfff0000) | ((mach64->dst_y_x + (mach64->dst_height_width & 0x1fff)) & 0xfff);
+
+        return 1;
+}
+
 void mach64_blit(uint32_t cpu_dat, int count, mach64_t *mach64)
 {
         svga_t *svga = &mach64->svga;
@@ -1218,6 +1526,9 @@ void mach64_blit(uint32_t cpu_dat, int count, mach64_t *mach64)
         switch (mach64->accel.op)
         {
                 case OP_RECT:
+                if (count == -1 && mach64_blit_rect(mach64))
+                        break;
+
                 while (count)
                 {
                         uint32_t src_dat, dest_dat;
@@ -15,7 +15,11 @@
  *
  *		Reworked to have its data on the heap.
  *
- * Version:	@(#)vid_cga_comp.c	1.0.9	2019/05/17
+ *		The decoder uses SSE2 if the host has it, and keeps a
+ *		small cache of recently decoded lines, as most of them
+ *		repeat from one line (or frame) to the next.
+ *
+ * Version:	@(#)vid_cga_comp.c	1.0.11	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -55,6 +59,10 @@
 #include "video.h"
 #include "vid_cga.h"
 #include "vid_cga_comp.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+# include <emmintrin.h>
+# define COMP_SSE2	1
+#endif
 
 
 static const double tau = 6.28318531; /* == 2*pi */
@@ -86,6 +94,17 @@ static const double intensity[4] = {
 /* 2048x1536 is the maximum we can possibly support. */
 #define SCALER_MAXWIDTH 2048
 
+#define COMP_CACHE	32		/* decoded lines we keep around */
+
+
+typedef struct {
+    uint32_t	hash;
+    int		w;			/* line width, 0 if unused */
+    uint8_t	border,
+		mono;
+    uint32_t	key[SCALER_MAXWIDTH / 4];	/* colors of the line */
+    uint32_t	out[SCALER_MAXWIDTH];	/* decoded pels */
+} compline_t;
 
 typedef struct {
     int		new_cga;
@@ -103,14 +122,41 @@ typedef struct {
 		sharpness,
 		hue_offset;
 
-    int		temp[SCALER_MAXWIDTH + 10];
-    int		atemp[SCALER_MAXWIDTH + 2];
-    int		btemp[SCALER_MAXWIDTH + 2];
+    int		temp[SCALER_MAXWIDTH + 16];
+    int		atemp[SCALER_MAXWIDTH + 8];
+    int		btemp[SCALER_MAXWIDTH + 8];
+    int		jtemp[SCALER_MAXWIDTH + 8];
 
     int		table[1024];
+
+    uint32_t	key[SCALER_MAXWIDTH / 4];
+    compline_t	cache[COMP_CACHE];
 } cga_comp_t;
 
 
+#ifdef COMP_SSE2
+/* SSE2 has no PMULLD, so build the low 32 bits of the products. */
+static __inline __m128i
+mullo32(__m128i a, __m128i b)
+{
+    __m128i e = _mm_mul_epu32(a, b);
+    __m128i o = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+    return(_mm_unpacklo_epi32(_mm_shuffle_epi32(e, _MM_SHUFFLE(0,0,2,0)),
+			      _mm_shuffle_epi32(o, _MM_SHUFFLE(0,0,2,0))));
+}
+
+
+/*
+ * Shift four values down to the pel range, saturated to 16 bits.
+ * The _mm_packus_epi16 done on the result clamps them to 0..255.
+ */
+static __inline __m128i
+clamp16(__m128i v)
+{
+    return(_mm_packs_epi32(_mm_srai_epi32(v, 13), _mm_setzero_si128()));
+}
+#else
 static uint8_t
 byte_clamp(int v)
 {
@@ -118,17 +164,118 @@ byte_clamp(int v)
 
     return v < 0 ? 0 : (v > 255 ? 255 : v);
 }
+#endif
 
 
-void
-cga_comp_process(priv_t priv, uint8_t cgamode, uint8_t border,
-		 uint32_t blocks/*, int8_t doublewidth*/, pel_t *pels)
+/* Decode a line of monochrome composite, for the 640x200 mode. */
+static void
+decode_mono(cga_comp_t *state, int w, pel_t *ptr)
 {
-    cga_comp_t *state = (cga_comp_t *)priv;
+    int *i = state->temp + 5;
+    int x;
+#ifdef COMP_SSE2
+    __m128i sharp = _mm_set1_epi32(state->video_sharpness);
+    __m128i c, d, y;
+
+    for (x = 0; x < w; x += 4) {
+	c = _mm_slli_epi32(_mm_loadu_si128((__m128i *)&i[x]), 4);
+	d = _mm_slli_epi32(_mm_add_epi32(_mm_loadu_si128((__m128i *)&i[x - 1]),
+					 _mm_loadu_si128((__m128i *)&i[x + 1])), 3);
+	y = _mm_add_epi32(_mm_slli_epi32(_mm_add_epi32(c, d), 8),
+			  mullo32(sharp, _mm_sub_epi32(c, d)));
+
+	/* Spread each gray value over R, G and B. */
+	y = _mm_packus_epi16(clamp16(y), _mm_setzero_si128());
+	y = _mm_unpacklo_epi16(_mm_unpacklo_epi8(y, y),
+			       _mm_unpacklo_epi8(y, _mm_setzero_si128()));
+	_mm_storeu_si128((__m128i *)&ptr[x], y);
+    }
+#else
+    for (x = 0; x < w; ++x) {
+	int c = (i[0]+i[0])<<3;
+	int d = (i[-1]+i[1])<<3;
+	int y = ((c+d)<<8) + state->video_sharpness*(c-d);
+	++i;
+	ptr[0].val = byte_clamp(y)*0x10101;
+	ptr++;
+    }
+#endif
+}
+
+
+/* Decode a line of color composite. */
+static void
+decode_color(cga_comp_t *state, int w, pel_t *ptr)
+{
+    int *i, *ap, *bp;
+    int x;
+#ifdef COMP_SSE2
+    __m128i cr[2], cg[2], cb[2];
+    __m128i sharp, a, b, c, d, j, y;
+    __m128i rr, gg, bb;
+    int *jp;
+
+    /*
+     * The chroma of pel x is (I,Q) = (a,b), (-b,a), (-a,-b) or (b,-a)
+     * for phase x&3, so fold those signs into per-lane coefficients.
+     * A line always starts at phase 0 and is a multiple of 4 long.
+     */
+#define COEFS(v, ci, cq) \
+	v[0] = _mm_setr_epi32((int)ci, (int)cq, -(int)ci, -(int)cq); \
+	v[1] = _mm_setr_epi32((int)cq, -(int)ci, -(int)cq, (int)ci)
+    COEFS(cr, state->video_ri, state->video_rq);
+    COEFS(cg, state->video_gi, state->video_gq);
+    COEFS(cb, state->video_bi, state->video_bq);
+#undef COEFS
+    sharp = _mm_set1_epi32(state->video_sharpness);
+
+    /*
+     * Store chroma, and the luma with the chroma taken out. This
+     * runs a few pels past the line end, which is harmless as
+     * the buffers have room for it.
+     */
+    i = state->temp + 5;
+    ap = state->atemp + 1;
+    bp = state->btemp + 1;
+    jp = state->jtemp + 1;
+    for (x = -1; x < w + 1; x += 4) {
+#define T(n)	_mm_loadu_si128((__m128i *)&i[x + (n)])
+	c = _mm_slli_epi32(_mm_sub_epi32(_mm_add_epi32(T(-2), T(2)), T(0)), 1);
+	a = _mm_add_epi32(_mm_sub_epi32(T(-4), c), T(4));
+	b = _mm_slli_epi32(_mm_sub_epi32(_mm_add_epi32(T(-3), T(1)),
+					 _mm_add_epi32(T(-1), T(3))), 1);
+	j = _mm_sub_epi32(_mm_slli_epi32(T(0), 3), a);
+#undef T
+	_mm_storeu_si128((__m128i *)&ap[x], a);
+	_mm_storeu_si128((__m128i *)&bp[x], b);
+	_mm_storeu_si128((__m128i *)&jp[x], j);
+    }
+
+    /* Decode. */
+    for (x = 0; x < w; x += 4) {
+	j = _mm_loadu_si128((__m128i *)&jp[x]);
+	c = _mm_add_epi32(j, j);
+	d = _mm_add_epi32(_mm_loadu_si128((__m128i *)&jp[x - 1]),
+			  _mm_loadu_si128((__m128i *)&jp[x + 1]));
+	y = _mm_add_epi32(_mm_slli_epi32(_mm_add_epi32(c, d), 8),
+			  mullo32(sharp, _mm_sub_epi32(c, d)));
+
+	a = _mm_loadu_si128((__m128i *)&ap[x]);
+	b = _mm_loadu_si128((__m128i *)&bp[x]);
+	rr = _mm_add_epi32(y, _mm_add_epi32(mullo32(cr[0], a), mullo32(cr[1], b)));
+	gg = _mm_add_epi32(y, _mm_add_epi32(mullo32(cg[0], a), mullo32(cg[1], b)));
+	bb = _mm_add_epi32(y, _mm_add_epi32(mullo32(cb[0], a), mullo32(cb[1], b)));
+
+	/* Pack down to bytes, and interleave into B,G,R,0 pels. */
+	bb = _mm_packus_epi16(_mm_unpacklo_epi64(clamp16(bb), clamp16(rr)),
+			      _mm_setzero_si128());
+	gg = _mm_packus_epi16(clamp16(gg), _mm_setzero_si128());
+	bb = _mm_unpacklo_epi8(bb, gg);
+	bb = _mm_unpacklo_epi16(bb, _mm_srli_si128(bb, 8));
+	_mm_storeu_si128((__m128i *)&ptr[x], bb);
+    }
+#else
     uint32_t x2;
-    pel_t *ptr;
-    int x, w = blocks*4;
-    int *o, *b2, *i, *ap, *bp;
 
 #define COMPOSITE_CONVERT(I, Q) do { \
         i[1] = (i[1]<<3) - ap[1]; \
@@ -147,6 +294,65 @@ cga_comp_process(priv_t priv, uint8_t cgamode, uint8_t border,
         ptr++; \
     } while (0)
 
+    /* Store chroma. */
+    i = state->temp + 4;
+    ap = state->atemp + 1;
+    bp = state->btemp + 1;
+    for (x = -1; x < w + 1; ++x) {
+	ap[x] = i[-4]-((i[-2]-i[0]+i[2])<<1)+i[4];
+	bp[x] = (i[-3]-i[-1]+i[1]-i[3])<<1;
+	++i;
+    }
+
+    /* Decode. */
+    i = state->temp + 5;
+    i[-1] = (i[-1]<<3) - ap[-1];
+    i[0] = (i[0]<<3) - ap[0];
+    for (x2 = 0; x2 < (uint32_t)w / 4; ++x2) {
+	int y,a,b,c,d,rr,gg,bb;
+
+	COMPOSITE_CONVERT(a, b);
+	COMPOSITE_CONVERT(-b, a);
+	COMPOSITE_CONVERT(-a, -b);
+	COMPOSITE_CONVERT(b, -a);
+    }
+#endif
+}
+
+
+void
+cga_comp_process(priv_t priv, uint8_t cgamode, uint8_t border,
+		 uint32_t blocks/*, int8_t doublewidth*/, pel_t *pels)
+{
+    cga_comp_t *state = (cga_comp_t *)priv;
+    compline_t *cl;
+    uint32_t h, v;
+    pel_t *ptr;
+    int x, w = blocks*4;
+    int mono = !!(cgamode & 4);
+    int *o, *b2;
+
+    /*
+     * The decoded line only depends on its colors, the border and the
+     * mode, and most lines (at least half of them, on the CGA which
+     * sends every line twice) are the same as one we did recently.
+     */
+    ptr = pels;
+    h = 2166136261U ^ (border << 8) ^ mono;
+    for (x = 0; x < w; x += 4) {
+	v = (ptr[0].pal & 0x0f) | ((ptr[1].pal & 0x0f) << 8) |
+	    ((ptr[2].pal & 0x0f) << 16) | ((uint32_t)(ptr[3].pal & 0x0f) << 24);
+	state->key[x >> 2] = v;
+	h = (h ^ v) * 16777619U;
+	ptr += 4;
+    }
+    cl = &state->cache[(h ^ (h >> 16)) & (COMP_CACHE - 1)];
+    if (cl->w == w && cl->hash == h && cl->border == border &&
+	cl->mono == mono && !memcmp(cl->key, state->key, w)) {
+	memcpy(pels, cl->out, w * sizeof(pel_t));
+	return;
+    }
+
 #define OUT(v) do { *o = (v); ++o; } while (0)
 
     /* Simulate CGA composite output. */
@@ -166,42 +372,18 @@ cga_comp_process(priv_t priv, uint8_t cgamode, uint8_t border,
     for (x = 0; x < 5; ++x)
 	OUT(b2[x&3]);
 
-    ptr = pels;
-    if ((cgamode & 4) != 0) {
-	/* Decode. */
-	i = state->temp + 5;
-	for (x2 = 0; x2 < blocks*4; ++x2) {
-		int c = (i[0]+i[0])<<3;
-		int d = (i[-1]+i[1])<<3;
-		int y = ((c+d)<<8) + state->video_sharpness*(c-d);
-		++i;
-		ptr[0].val = byte_clamp(y)*0x10101;
-		ptr++;
-	}
-    } else {
-	/* Store chroma. */
-	i = state->temp + 4;
-	ap = state->atemp + 1;
-	bp = state->btemp + 1;
-	for (x = -1; x < w + 1; ++x) {
-		ap[x] = i[-4]-((i[-2]-i[0]+i[2])<<1)+i[4];
-		bp[x] = (i[-3]-i[-1]+i[1]-i[3])<<1;
-		++i;
-	}
-
-	/* Decode. */
-	i = state->temp + 5;
-	i[-1] = (i[-1]<<3) - ap[-1];
-	i[0] = (i[0]<<3) - ap[0];
-	for (x2 = 0; x2 < blocks; ++x2) {
-		int y,a,b,c,d,rr,gg,bb;
-
-		COMPOSITE_CONVERT(a, b);
-		COMPOSITE_CONVERT(-b, a);
-		COMPOSITE_CONVERT(-a, -b);
-		COMPOSITE_CONVERT(b, -a);
-	}
-    }
+    if (mono)
+	decode_mono(state, w, pels);
+      else
+	decode_color(state, w, pels);
+
+    /* Remember this line. */
+    cl->hash = h;
+    cl->w = w;
+    cl->border = border;
+    cl->mono = mono;
+    memcpy(cl->key, state->key, w);
+    memcpy(cl->out, pels, w * sizeof(pel_t));
 }
 
 
@@ -283,6 +465,10 @@ cga_comp_update(priv_t priv, uint8_t cgamode)
     state->video_bi = (int) (bi * iq_adjust_i + bq * iq_adjust_q);
     state->video_bq = (int) (-bi * iq_adjust_q + bq * iq_adjust_i);
     state->video_sharpness = (int) ((state->sharpness * 256) / 100);
+
+    /* Anything we decoded before is stale now. */
+    for (x = 0; x < COMP_CACHE; x++)
+	state->cache[x].w = 0;
 }
 
 
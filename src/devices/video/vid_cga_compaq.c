@@ -8,7 +8,7 @@
  *
  *		Implementation of CGA used by Compaq PC's.
  *
- * Version:	@(#)vid_cga_compaq.c	1.0.13	2019/05/17
+ * Version:	@(#)vid_cga_compaq.c	1.0.14	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -121,7 +121,6 @@ compaq_poll(priv_t priv)
 	if (dev->cga.cgadispon) {
 		if (dev->cga.displine < dev->cga.firstline) {
 			dev->cga.firstline = dev->cga.displine;
-			video_blit_wait_buffer();
 		}
 		dev->cga.lastline = dev->cga.displine;
 
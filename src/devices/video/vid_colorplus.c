@@ -8,7 +8,7 @@
  *
  *		Plantronics ColorPlus emulation.
  *
- * Version:	@(#)vid_colorplus.c	1.0.17	2019/05/13
+ * Version:	@(#)vid_colorplus.c	1.0.18	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -187,7 +187,6 @@ colorplus_poll(priv_t priv)
 	if (dev->cga.cgadispon) {
 		if (dev->cga.displine < dev->cga.firstline) {
 			dev->cga.firstline = dev->cga.displine;
-			video_blit_wait_buffer();
 		}
 		dev->cga.lastline = dev->cga.displine;
 
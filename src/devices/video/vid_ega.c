@@ -9,7 +9,7 @@
  *		Emulation of the EGA, Chips & Technologies SuperEGA, and
  *		AX JEGA graphics cards.
  *
- * Version:	@(#)vid_ega.c	1.0.21	2019/05/17
+ * Version:	@(#)vid_ega.c	1.0.23	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -320,6 +320,9 @@ ega_recalctimings(ega_t *dev)
 
     dev->dispontime  = (tmrval_t)(_dispontime  * (1LL << TIMER_SHIFT));
     dev->dispofftime = (tmrval_t)(_dispofftime * (1LL << TIMER_SHIFT));
+
+    /* The mode may have changed, so the text cells have to be redrawn. */
+    video_text_invalidate(&dev->textcache, -1);
 }
 
 
@@ -344,7 +347,6 @@ ega_poll(priv_t priv)
 	if (dev->dispon) {
 		if (dev->firstline == 2000) {
 			dev->firstline = dev->displine;
-			video_blit_wait_buffer();
 		}
 
 		if (dev->scrblank)
@@ -373,6 +375,10 @@ ega_poll(priv_t priv)
 			}
 		}
 
+		/* Anything but plain text leaves the text cells stale. */
+		if (dev->scrblank || (dev->gdcreg[6] & 1))
+			video_text_invalidate(&dev->textcache, ega_display_line(dev));
+
 		if (dev->lastline < dev->displine) 
 			dev->lastline = dev->displine;
 	}
@@ -1117,6 +1123,8 @@ ega_close(priv_t priv)
 {
     ega_t *dev = (ega_t *)priv;
 
+    video_text_close(&dev->textcache);
+
     free(dev->vram);
 
     free(dev);
@@ -9,7 +9,7 @@
  *		EGA renderers.
  * NOTE:	FIXME: make sure this works (line 99 shadow parameter)
  *
- * Version:	@(#)vid_ega_render.c	1.0.7	2019/05/17
+ * Version:	@(#)vid_ega_render.c	1.0.8	2019/06/23
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -102,15 +102,21 @@ ega_render_text_standard(ega_t *ega, int draw)
 {
     int x_add = (enable_overscan) ? 8 : 0;
     int dl = ega_display_line(ega);
+    int cw = (ega->seqregs[1] & 1) ? 8 : 9;
+    textcell_t *cell;
     int x, xx;
-	
+
+    if (ega->seqregs[1] & 8)
+	cw <<= 1;
+    cell = video_text_line(&ega->textcache, dl, ega->hdisp, x_add);
+
     for (x = 0; x < ega->hdisp; x++) {
 	int do_draw = ((ega->ma == ega->ca) && ega->con && ega->cursoron);
 	uint8_t chr  = ega->vram[(ega->ma << 1) & ega->vrammask];
 	uint8_t attr = ega->vram[((ega->ma << 1) + 1) & ega->vrammask];
 	uint8_t dat;
 	uint32_t fg, bg;
-	uint32_t charaddr;
+	uint32_t charaddr, glyph;
 	
 	if (attr & 8)
 		charaddr = ega->charsetb + (chr * 128);
@@ -131,29 +137,28 @@ ega_render_text_standard(ega_t *ega, int draw)
 	}
 
 	dat = ega->vram[charaddr + (ega->sc << 2)];
-	if (ega->seqregs[1] & 8) {
-		if (ega->seqregs[1] & 1) { 
-			for (xx = 0; xx < 8; xx++) 
-				screen->line[dl][((x << 4) + 32 + (xx << 1) + x_add) & 2047].val = screen->line[dl][((x << 4) + 33 + (xx << 1) + x_add) & 2047].val = (dat & (0x80 >> xx)) ? fg : bg; 
-		} else {
-			for (xx = 0; xx < 8; xx++) 
-				screen->line[dl][((x * 18) + 32 + (xx << 1) + x_add) & 2047].val = screen->line[dl][((x * 18) + 33 + (xx << 1) + x_add) & 2047].val = (dat & (0x80 >> xx)) ? fg : bg;
-			if ((chr & ~0x1f) != 0xc0 || !(ega->attrregs[0x10] & 4)) 
-				screen->line[dl][((x * 18) + 32 + 16 + x_add) & 2047].val = screen->line[dl][((x * 18) + 32 + 17 + x_add) & 2047].val = bg;
-			else
-				screen->line[dl][((x * 18) + 32 + 16 + x_add) & 2047].val = screen->line[dl][((x * 18) + 32 + 17 + x_add) & 2047].val = (dat & 1) ? fg : bg;
-		}
+	glyph = dat;
+	if (ega->seqregs[1] & 8)
+		glyph |= TEXT_WIDE;
+	if (! (ega->seqregs[1] & 1)) {
+		glyph |= TEXT_9DOT;
+		if ((chr & ~0x1f) == 0xc0 && (ega->attrregs[0x10] & 4) && (dat & 1))
+			glyph |= TEXT_DOT9;
+	}
+
+	if (((x + 1) * cw) + 32 + x_add <= 2048) {
+		video_text_draw(&screen->line[dl][(x * cw) + 32 + x_add],
+				&cell[x], glyph, fg, bg);
 	} else {
-		if (ega->seqregs[1] & 1) { 
-			for (xx = 0; xx < 8; xx++) 
-				screen->line[dl][((x << 3) + 32 + xx + x_add) & 2047].val = (dat & (0x80 >> xx)) ? fg : bg; 
-		} else {
-			for (xx = 0; xx < 8; xx++) 
-				screen->line[dl][((x * 9) + 32 + xx + x_add) & 2047].val = (dat & (0x80 >> xx)) ? fg : bg;
-			if ((chr & ~0x1f) != 0xc0 || !(ega->attrregs[0x10] & 4)) 
-				screen->line[dl][((x * 9) + 32 + 8 + x_add) & 2047].val = bg;
-			else		  
-				screen->line[dl][((x * 9) + 32 + 8 + x_add) & 2047].val = (dat & 1) ? fg : bg;
+		/* Cell wraps around the end of the line, draw it by hand. */
+		cell[x].glyph = TEXT_INVALID;
+		for (xx = 0; xx < cw; xx++) {
+			int bit = (ega->seqregs[1] & 8) ? (xx >> 1) : xx;
+
+			if (bit < 8)
+				screen->line[dl][((x * cw) + 32 + xx + x_add) & 2047].val = (dat & (0x80 >> bit)) ? fg : bg;
+			else
+				screen->line[dl][((x * cw) + 32 + xx + x_add) & 2047].val = (glyph & TEXT_DOT9) ? fg : bg;
 		}
 	}
 
@@ -205,6 +210,8 @@ ega_render_text_jega(ega_t *ega, int draw)
     uint32_t fg = 0, bg = 0;
     int x;
 
+    video_text_invalidate(&ega->textcache, dl);
+
     /* Temporary for DBCS. */
     unsigned int chr_left = 0;
     unsigned int bsattr = 0;
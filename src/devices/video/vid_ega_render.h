@@ -8,7 +8,7 @@
  *
  *		Definitions for the EGA renderer.
  *
- * Version:	@(#)vid_ega_render.h	1.0.1	2018/02/14
+ * Version:	@(#)vid_ega_render.h	1.0.2	2019/06/23
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -51,6 +51,8 @@ extern int scrollcache;
 
 extern uint8_t edatlookup[4][4];
 
+int  ega_display_line(ega_t *ega);
+
 void ega_render_blank(ega_t *ega);
 void ega_render_text_standard(ega_t *ega, int drawcursor);
 #ifdef JEGA
@@ -8,7 +8,7 @@
  *
  *		Hercules Plus emulation.
  *
- * Version:	@(#)vid_hercules_plus.c	1.0.23	2019/05/17
+ * Version:	@(#)vid_hercules_plus.c	1.0.24	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -526,7 +526,6 @@ herculesplus_poll(priv_t priv)
 	if (dev->dispon) {
 		if (dev->displine < dev->firstline) {
 			dev->firstline = dev->displine;
-			video_blit_wait_buffer();
 		}
 		dev->lastline = dev->displine;
 
@@ -44,7 +44,7 @@
  *
  *		This is expected to be done shortly.
  *
- * Version:	@(#)vid_pgc.c	1.0.7	2019/05/17
+ * Version:	@(#)vid_pgc.c	1.0.8	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		John Elliott, <jce@seasip.info>
@@ -2317,9 +2317,6 @@ pgc_cga_poll(pgc_t *dev)
 	dev->linepos = 1;
 
 	if (dev->cgadispon) {
-		if (dev->displine == 0)
-			video_blit_wait_buffer();
-
 		if ((dev->mapram[0x03d8] & 0x12) == 0x12)
 			pgc_cga_gfx80(dev);	
 		else if (dev->mapram[0x03d8] & 0x02)
@@ -2400,9 +2397,6 @@ pgc_poll(priv_t priv)
 	dev->mapram[0x03da] |= 1;
 	dev->linepos = 1;
 	if (dev->cgadispon && (uint32_t)dev->displine < dev->maxh) {
-		if (dev->displine == 0)
-			video_blit_wait_buffer();
-
 		/* Don't know why pan needs to be multiplied by -2, but
 		 * the IM1024 driver uses PAN -112 for an offset of 
 		 * 224. */
@@ -10,7 +10,7 @@
  *
  * NOTE:	ROM images need more/better organization per chipset.
  *
- * Version:	@(#)vid_s3.c	1.0.20	2019/06/05
+ * Version:	@(#)vid_s3.c	1.0.21	2019/06/29
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -1862,6 +1862,226 @@ static void polygon_setup(s3_t *s3)
 				svga->changedvram[((addr) & (s3->vram_mask >> 2)) >> 10] = changeframecount;	    \
 			}
 
+/*
+ * Span routines for the common operations.
+ *
+ * Most of what a GUI driver asks for is a solid fill, a pattern fill, a
+ * screen-to-screen copy or a monochrome expand, with a mix that does
+ * not look at the destination. Those we check for once per operation,
+ * and then do a scanline at a time instead of going through the whole
+ * READ/MIX/WRITE dance for every pel.
+ */
+#define PEL_SHIFT(s3)	(((s3)->bpp == 0) ? 0 : ((s3)->bpp == 1) ? 1 : 2)
+#define PEL_MASK(s3)	(((s3)->bpp == 0) ? 0xff : ((s3)->bpp == 1) ? 0xffff : 0xffffffff)
+
+
+/* Can this mix be done without reading the destination? */
+static int s3_mix_solid(s3_t *s3, uint8_t mix)
+{
+	switch (mix & 0xf)
+	{
+		case 0x3:
+		return 1;
+
+		case 0x1: case 0x2: case 0x4: case 0x7:
+		return (s3->accel.wrt_mask & PEL_MASK(s3)) == PEL_MASK(s3);
+	}
+
+	return 0;
+}
+
+/* Work out what a solid mix writes, or 0 if it leaves the pel alone. */
+static int s3_mix_pel(s3_t *s3, uint8_t mix, uint32_t src_dat, int compare_mode, uint32_t compare, uint32_t *val)
+{
+	if ((compare_mode == 2 && src_dat == compare) ||
+	    (compare_mode == 3 && src_dat != compare))
+		return 0;
+
+	switch (mix & 0xf)
+	{
+		case 0x1: *val =  0;	   break;
+		case 0x2: *val = ~0;	   break;
+		case 0x4: *val = ~src_dat; break;
+		case 0x7: *val =  src_dat; break;
+		default:  return 0;
+	}
+
+	return 1;
+}
+
+static void s3_span_dirty(s3_t *s3, uint32_t addr, int n)
+{
+	uint32_t c;
+
+	addr <<= PEL_SHIFT(s3);
+	for (c = addr >> 12; c <= ((addr + (n << PEL_SHIFT(s3)) - 1) >> 12); c++)
+		s3->svga.changedvram[c] = changeframecount;
+}
+
+/*
+ * Fill n pels from addr on, for screen column x, with an 8-pel pattern.
+ * Columns with their bit clear in opaque are left alone.
+ */
+static void s3_span_fill(s3_t *s3, uint32_t addr, int x, int n, const uint32_t *pat, int opaque)
+{
+	svga_t *svga = &s3->svga;
+	uint16_t *vram_w = (uint16_t *)svga->vram;
+	uint32_t *vram_l = (uint32_t *)svga->vram;
+	uint32_t mask = s3->vram_mask >> PEL_SHIFT(s3);
+	uint32_t dest_dat;
+	uint8_t *p;
+	int c, len;
+
+	if (n <= 0 || !opaque)
+		return;
+
+	if (addr > mask || (uint32_t)(n - 1) > (mask - addr))
+	{
+		/* Wraps around the end of memory, do it the slow way. */
+		for (c = 0; c < n; c++)
+		{
+			if (!(opaque & (1 << ((x + c) & 7))))
+				continue;
+			dest_dat = pat[(x + c) & 7];
+			WRITE(addr + c);
+		}
+		return;
+	}
+
+	if (opaque != 0xff)
+	{
+		for (c = 0; c < n; c++)
+		{
+			if (!(opaque & (1 << ((x + c) & 7))))
+				continue;
+			switch (PEL_SHIFT(s3))
+			{
+				case 0: svga->vram[addr + c] = pat[(x + c) & 7]; break;
+				case 1: vram_w[addr + c] = pat[(x + c) & 7]; break;
+				case 2: vram_l[addr + c] = pat[(x + c) & 7]; break;
+			}
+		}
+		s3_span_dirty(s3, addr, n);
+		return;
+	}
+
+	p = &svga->vram[addr << PEL_SHIFT(s3)];
+	for (c = 1; c < 8; c++)
+		if (pat[c] != pat[0])
+			break;
+	if (c == 8 && s3->bpp == 0)
+	{
+		memset(p, pat[0], n);
+		s3_span_dirty(s3, addr, n);
+		return;
+	}
+
+	/* Lay down one pattern period, and keep doubling it. */
+	len = (n < 8) ? n : 8;
+	for (c = 0; c < len; c++)
+	{
+		switch (PEL_SHIFT(s3))
+		{
+			case 0: svga->vram[addr + c] = pat[(x + c) & 7]; break;
+			case 1: vram_w[addr + c] = pat[(x + c) & 7]; break;
+			case 2: vram_l[addr + c] = pat[(x + c) & 7]; break;
+		}
+	}
+	while (len < n)
+	{
+		c = (len < (n - len)) ? len : (n - len);
+		memcpy(p + (len << PEL_SHIFT(s3)), p, c << PEL_SHIFT(s3));
+		len += c;
+	}
+	s3_span_dirty(s3, addr, n);
+}
+
+/*
+ * Copy n pels from src to dest, going left or right (inc) like the
+ * per-pel code does, so overlapping copies come out the same.
+ */
+static void s3_span_copy(s3_t *s3, uint32_t dest, uint32_t src, int n, int inc)
+{
+	svga_t *svga = &s3->svga;
+	uint16_t *vram_w = (uint16_t *)svga->vram;
+	uint32_t *vram_l = (uint32_t *)svga->vram;
+	uint32_t mask = s3->vram_mask >> PEL_SHIFT(s3);
+	uint32_t src_dat, dest_dat;
+	int vram_mask = 0;
+	uint32_t rd_mask = 0;
+	int c;
+
+	if (n <= 0)
+		return;
+
+	if (dest > mask || (uint32_t)(n - 1) > (mask - dest) ||
+	    src > mask || (uint32_t)(n - 1) > (mask - src) ||
+	    (inc && dest > src && dest < (src + n)) ||
+	    (!inc && dest < src && (dest + n) > src))
+	{
+		/* Wraps, or overlaps the wrong way, do it pel by pel. */
+		for (c = 0; c < n; c++)
+		{
+			int o = inc ? c : (n - 1 - c);
+
+			READ_SRC(src + o, src_dat);
+			dest_dat = src_dat;
+			WRITE(dest + o);
+		}
+		return;
+	}
+
+	memmove(&svga->vram[dest << PEL_SHIFT(s3)],
+		&svga->vram[src << PEL_SHIFT(s3)], n << PEL_SHIFT(s3));
+	s3_span_dirty(s3, dest, n);
+}
+
+/*
+ * Does the 8x8 pattern lie within the area a pattern fill will draw?
+ * If so, it changes while we draw, and only the per-pel code gets
+ * that right.
+ */
+static int s3_pattern_overlaps(s3_t *s3)
+{
+	int w = (s3->accel.maj_axis_pcnt & 0xfff) + 1;
+	int mask = s3->vram_mask >> PEL_SHIFT(s3);
+	int y1 = s3->accel.dy, y2;
+	int lo, hi, pat;
+
+	if (s3->accel.cmd & 0x80)
+		y2 = y1 + s3->accel.sy;
+	else
+	{
+		y2 = y1;
+		y1 -= s3->accel.sy;
+	}
+	lo = (y1 * s3->width) + s3->accel.dx - w;
+	hi = (y2 * s3->width) + s3->accel.dx + w;
+
+	pat = (int)s3->accel.pattern;
+
+	/* If either one wraps around memory, just assume the worst. */
+	if (pat < 0 || (pat + (7 * s3->width) + 7) > mask || hi > mask)
+		return 1;
+
+	return (pat <= hi) && ((pat + (7 * s3->width) + 7) >= lo);
+}
+
+/* Clip a span of w pels, going left (!inc) or right from x. */
+static int s3_span_clip(int *x, int w, int inc, int clip_l, int clip_r)
+{
+	int l = inc ? *x : (*x - w + 1);
+	int r = l + w - 1;
+
+	if (l < clip_l)
+		l = clip_l;
+	if (r > clip_r)
+		r = clip_r;
+	*x = l;
+
+	return r - l + 1;
+}
+
 void s3_accel_start(int count, int cpu_input, uint32_t mix_dat, uint32_t cpu_dat, s3_t *s3)
 {
 	svga_t *svga = &s3->svga;
@@ -2100,6 +2320,94 @@ void s3_accel_start(int count, int cpu_input, uint32_t mix_dat, uint32_t cpu_dat
 
 		frgd_mix = (s3->accel.frgd_mix >> 5) & 3;
 		bkgd_mix = (s3->accel.bkgd_mix >> 5) & 3;			
+
+		if (!cpu_input && s3_mix_solid(s3, s3->accel.frgd_mix))
+		{
+			/*Solid fill, a scanline at a time*/
+			uint32_t pat[8];
+			int inc = s3->accel.cmd & 0x20;
+			int w = (s3->accel.maj_axis_pcnt & 0xfff) + 1;
+			int opaque = 0, c;
+
+			switch (frgd_mix)
+			{
+				case 0: src_dat = s3->accel.bkgd_color; break;
+				case 1: src_dat = s3->accel.frgd_color; break;
+				case 2: src_dat = cpu_dat; break;
+				case 3: src_dat = 0; break;
+			}
+			if (s3_mix_pel(s3, s3->accel.frgd_mix, src_dat, compare_mode, compare, &pat[0]))
+				opaque = 0xff;
+			for (c = 1; c < 8; c++)
+				pat[c] = pat[0];
+
+			while (s3->accel.sy >= 0)
+			{
+				if (s3->accel.cy >= clip_t && s3->accel.cy <= clip_b)
+				{
+					int x = s3->accel.cx;
+					int n = s3_span_clip(&x, w, inc, clip_l, clip_r);
+
+					s3_span_fill(s3, s3->accel.dest + x, x, n, pat, opaque);
+				}
+
+				if (s3->accel.cmd & 0x80) s3->accel.cy++;
+				else		     s3->accel.cy--;
+
+				s3->accel.dest = s3->accel.cy * s3->width;
+				s3->accel.sy--;
+			}
+			s3->accel.cur_x = s3->accel.cx;
+			s3->accel.cur_y = s3->accel.cy;
+			return;
+		}
+
+		if (cpu_input && frgd_mix != 2 && bkgd_mix != 2 &&
+		    s3_mix_solid(s3, s3->accel.frgd_mix) && s3_mix_solid(s3, s3->accel.bkgd_mix))
+		{
+			/*Color expand of CPU data, no need to look at the destination*/
+			uint32_t fg = 0, bg = 0;
+			int fg_on, bg_on;
+
+			fg_on = s3_mix_pel(s3, s3->accel.frgd_mix, frgd_mix ? ((frgd_mix == 1) ? s3->accel.frgd_color : 0) : s3->accel.bkgd_color,
+					   compare_mode, compare, &fg);
+			bg_on = s3_mix_pel(s3, s3->accel.bkgd_mix, bkgd_mix ? ((bkgd_mix == 1) ? s3->accel.frgd_color : 0) : s3->accel.bkgd_color,
+					   compare_mode, compare, &bg);
+
+			while (count-- && s3->accel.sy >= 0)
+			{
+				if (((mix_dat & mix_mask) ? fg_on : bg_on) &&
+				    s3->accel.cx >= clip_l && s3->accel.cx <= clip_r &&
+				    s3->accel.cy >= clip_t && s3->accel.cy <= clip_b)
+				{
+					dest_dat = (mix_dat & mix_mask) ? fg : bg;
+
+					WRITE(s3->accel.dest + s3->accel.cx);
+				}
+
+				mix_dat <<= 1;
+				mix_dat |= 1;
+
+				if (s3->accel.cmd & 0x20) s3->accel.cx++;
+				else		     s3->accel.cx--;
+				s3->accel.sx--;
+				if (s3->accel.sx < 0)
+				{
+					if (s3->accel.cmd & 0x20) s3->accel.cx   -= (s3->accel.maj_axis_pcnt & 0xfff) + 1;
+					else		     s3->accel.cx   += (s3->accel.maj_axis_pcnt & 0xfff) + 1;
+					s3->accel.sx    = s3->accel.maj_axis_pcnt & 0xfff;
+
+					if (s3->accel.cmd & 0x80) s3->accel.cy++;
+					else		     s3->accel.cy--;
+
+					s3->accel.dest = s3->accel.cy * s3->width;
+					s3->accel.sy--;
+
+					return;
+				}
+			}
+			break;
+		}
 				
 		while (count-- && s3->accel.sy >= 0)
 		{
@@ -2193,46 +2501,41 @@ void s3_accel_start(int count, int cpu_input, uint32_t mix_dat, uint32_t cpu_dat
 		frgd_mix = (s3->accel.frgd_mix >> 5) & 3;
 		bkgd_mix = (s3->accel.bkgd_mix >> 5) & 3;
 		
-		if (!cpu_input && frgd_mix == 3 && !vram_mask && !compare_mode &&
-		    (s3->accel.cmd & 0xa0) == 0xa0 && (s3->accel.frgd_mix & 0xf) == 7 &&
-					(s3->accel.bkgd_mix & 0xf) == 7)
+		if (!cpu_input && frgd_mix == 3 && !vram_mask && compare_mode < 2 &&
+		    (s3->accel.frgd_mix & 0xf) == 7 && s3_mix_solid(s3, s3->accel.frgd_mix))
 		{
-			while (1)
+			/*Screen to screen copy, a scanline at a time*/
+			int inc = s3->accel.cmd & 0x20;
+			int w = (s3->accel.maj_axis_pcnt & 0xfff) + 1;
+
+			while (s3->accel.sy >= 0)
 			{
-				if (s3->accel.dx >= clip_l && s3->accel.dx <= clip_r &&
-				    s3->accel.dy >= clip_t && s3->accel.dy <= clip_b)
+				if (s3->accel.dy >= clip_t && s3->accel.dy <= clip_b)
 				{
-					READ_SRC(s3->accel.src + s3->accel.cx, src_dat);
-					READ_DST(s3->accel.dest + s3->accel.dx, dest_dat);  
+					int x = s3->accel.dx;
+					int n = s3_span_clip(&x, w, inc, clip_l, clip_r);
 
-					dest_dat = (src_dat & s3->accel.wrt_mask) | (dest_dat & ~s3->accel.wrt_mask);
-
-					WRITE(s3->accel.dest + s3->accel.dx);
+					s3_span_copy(s3, s3->accel.dest + x,
+						     s3->accel.src + x + (s3->accel.cx - s3->accel.dx), n, inc);
 				}
-	
-				s3->accel.cx++;
-				s3->accel.dx++;
-				s3->accel.sx--;
-				if (s3->accel.sx < 0)
+
+				if (s3->accel.cmd & 0x80)
 				{
-					s3->accel.cx -= (s3->accel.maj_axis_pcnt & 0xfff) + 1;
-					s3->accel.dx -= (s3->accel.maj_axis_pcnt & 0xfff) + 1;
-					s3->accel.sx  =  s3->accel.maj_axis_pcnt & 0xfff;
-	
 					s3->accel.cy++;
 					s3->accel.dy++;
-	
-					s3->accel.src  = s3->accel.cy * s3->width;
-					s3->accel.dest = s3->accel.dy * s3->width;
-	
-					s3->accel.sy--;
-	
-					if (s3->accel.sy < 0)
-					{
-						return;
-					}
 				}
+				else
+				{
+					s3->accel.cy--;
+					s3->accel.dy--;
+				}
+
+				s3->accel.src  = s3->accel.cy * s3->width;
+				s3->accel.dest = s3->accel.dy * s3->width;
+
+				s3->accel.sy--;
 			}
+			return;
 		}
 		else
 		{		     
@@ -2361,6 +2664,62 @@ void s3_accel_start(int count, int cpu_input, uint32_t mix_dat, uint32_t cpu_dat
 		frgd_mix = (s3->accel.frgd_mix >> 5) & 3;
 		bkgd_mix = (s3->accel.bkgd_mix >> 5) & 3;
 
+		if (!cpu_input && s3_mix_solid(s3, s3->accel.frgd_mix) &&
+		    (!vram_mask || s3_mix_solid(s3, s3->accel.bkgd_mix)) &&
+		    !s3_pattern_overlaps(s3))
+		{
+			/*Work out the pattern row once, and fill a scanline at a time*/
+			int inc = s3->accel.cmd & 0x20;
+			int w = (s3->accel.maj_axis_pcnt & 0xfff) + 1;
+
+			while (s3->accel.sy >= 0)
+			{
+				if (s3->accel.dy >= clip_t && s3->accel.dy <= clip_b)
+				{
+					uint32_t pat[8];
+					int x = s3->accel.dx;
+					int n = s3_span_clip(&x, w, inc, clip_l, clip_r);
+					int opaque = 0, c, m = 1;
+
+					for (c = 0; c < 8; c++)
+					{
+						if (vram_mask)
+						{
+							READ_SRC(s3->accel.src + c, m)
+						}
+						switch (m ? frgd_mix : bkgd_mix)
+						{
+							case 0: src_dat = s3->accel.bkgd_color;		  break;
+							case 1: src_dat = s3->accel.frgd_color;		  break;
+							case 2: src_dat = cpu_dat;			      break;
+							case 3: READ_SRC(s3->accel.src + c, src_dat);	  break;
+						}
+						if (s3_mix_pel(s3, m ? s3->accel.frgd_mix : s3->accel.bkgd_mix, src_dat, compare_mode, compare, &pat[c]))
+							opaque |= (1 << c);
+					}
+
+					s3_span_fill(s3, s3->accel.dest + x, x, n, pat, opaque);
+				}
+
+				if (s3->accel.cmd & 0x80)
+				{
+					s3->accel.cy = ((s3->accel.cy + 1) & 7) | (s3->accel.cy & ~7);
+					s3->accel.dy++;
+				}
+				else
+				{
+					s3->accel.cy = ((s3->accel.cy - 1) & 7) | (s3->accel.cy & ~7);
+					s3->accel.dy--;
+				}
+
+				s3->accel.src  = s3->accel.pattern + (s3->accel.cy * s3->width);
+				s3->accel.dest = s3->accel.dy * s3->width;
+
+				s3->accel.sy--;
+			}
+			return;
+		}
+
 		while (count-- && s3->accel.sy >= 0)
 		{
 			if (s3->accel.dx >= clip_l && s3->accel.dx <= clip_r &&
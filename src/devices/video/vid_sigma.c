@@ -54,7 +54,7 @@
  *		is well, but some strange mishaps with cursor positioning
  *		occur.
  *
- * Version:	@(#)vid_sigma.c	1.0.12	2019/05/21
+ * Version:	@(#)vid_sigma.c	1.0.14	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -520,7 +520,6 @@ sigma_poll(priv_t priv)
 	if (dev->cgadispon) {
 		if (dev->displine < dev->firstline) {
 			dev->firstline = dev->displine;
-			video_blit_wait_buffer();
 		}
 		dev->lastline = dev->displine;
 
@@ -799,7 +798,7 @@ sigma_out(uint16_t port, uint8_t val, priv_t priv)
 	/* If set to NMI on video I/O... */
 	if (dev->enable_nmi && (dev->sigma_ctl & CTL_NMI)) {
 		dev->lastport |= 0x80; 	/* card raised NMI */
-		nmi = 1;
+		nmi_set(1);
 	}
 
 	/*
@@ -848,7 +847,7 @@ sigma_out(uint16_t port, uint8_t val, priv_t priv)
 		break;
 
 	case 0x02dc:	/* reset NMI */
-		nmi = 0;
+		nmi_set(0);
 		dev->lastport &= 0x7f;
 		break;
 
@@ -11,7 +11,7 @@
  *		This is intended to be used by another SVGA driver,
  *		and not as a card in it's own right.
  *
- * Version:	@(#)vid_svga.c	1.0.23	2019/05/13
+ * Version:	@(#)vid_svga.c	1.0.27	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -88,17 +88,39 @@ svga_get_pri(void)
 void
 svga_set_override(svga_t *svga, int val)
 {
-    if (svga->override && !val)
+    if (svga->override && !val) {
 	svga->fullchange = changeframecount;
+	video_text_invalidate(&svga->textcache, -1);
+	video_damage_all();
+    }
     svga->override = val;
 }
 
 
+/*
+ * A DAC entry has changed. The 8bpp modes show nothing but VRAM seen
+ * through the palette, so rather than redrawing all of the screen for
+ * a few frames, each line gets its palette lookup redone once when the
+ * beam finds it was drawn with an older palette. Other modes get the
+ * full redraw.
+ */
+static void
+svga_palette_changed(svga_t *svga)
+{
+    if ((svga->render == svga_render_8bpp_lowres) ||
+	(svga->render == svga_render_8bpp_highres))
+	svga->pal_gen++;
+    else
+	svga->fullchange = changeframecount;
+}
+
+
 void
 svga_out(uint16_t addr, uint8_t val, priv_t priv)
 {
     svga_t *svga = (svga_t *)priv;
     uint8_t indx, o;
+    uint32_t col;
     int c;
 
     switch (addr) {
@@ -209,7 +231,6 @@ svga_out(uint16_t addr, uint8_t val, priv_t priv)
 		break;
 
 	case 0x3c9:
-		svga->fullchange = changeframecount;
 		switch (svga->dac_pos) {
 			case 0:
 				svga->dac_r = val;
@@ -227,9 +248,15 @@ svga_out(uint16_t addr, uint8_t val, priv_t priv)
 				svga->vgapal[indx].g = svga->dac_g;
 				svga->vgapal[indx].b = val; 
 				if (svga->ramdac_type == RAMDAC_8BIT)
-					svga->pallook[indx] = makecol32(svga->vgapal[indx].r, svga->vgapal[indx].g, svga->vgapal[indx].b);
+					col = makecol32(svga->vgapal[indx].r, svga->vgapal[indx].g, svga->vgapal[indx].b);
 				else
-					svga->pallook[indx] = makecol32(video_6to8[svga->vgapal[indx].r & 0x3f], video_6to8[svga->vgapal[indx].g & 0x3f], video_6to8[svga->vgapal[indx].b & 0x3f]);
+					col = makecol32(video_6to8[svga->vgapal[indx].r & 0x3f], video_6to8[svga->vgapal[indx].g & 0x3f], video_6to8[svga->vgapal[indx].b & 0x3f]);
+
+				/* Programs often rewrite the whole palette to change a few. */
+				if (col != svga->pallook[indx]) {
+					svga->pallook[indx] = col;
+					svga_palette_changed(svga);
+				}
 				svga->dac_pos = 0; 
 				svga->dac_addr = (svga->dac_addr + 1) & 255; 
 				break;
@@ -584,6 +611,10 @@ svga_recalctimings(svga_t *svga)
 
     svga->dispontime = (int)(_dispontime * (1 << TIMER_SHIFT));
     svga->dispofftime = (int)(_dispofftime * (1 << TIMER_SHIFT));
+
+    /* The mode may have changed, so everything has to be redrawn. */
+    video_text_invalidate(&svga->textcache, -1);
+    video_damage_all();
 }
 
 
@@ -592,7 +623,7 @@ svga_poll(priv_t priv)
 {
     svga_t *svga = (svga_t *)priv;
     uint32_t x;
-    int wx, wy;
+    int wx, wy, y;
 
     if (!svga->linepos) {
 	if (svga->displine == svga->hwcursor_latch.y && svga->hwcursor_latch.ena) {
@@ -626,7 +657,6 @@ svga_poll(priv_t priv)
 		svga->ma &= svga->vram_display_mask;
 		if (svga->firstline == 2000) {
 			svga->firstline = svga->displine;
-			video_blit_wait_buffer();
 		}
 
 		if (svga->hwcursor_on || svga->overlay_on) {
@@ -634,9 +664,24 @@ svga_poll(priv_t priv)
 							    svga->interlace ? 3 : 2;
 		}
 
-		if (!svga->override)
+		y = svga->displine + (enable_overscan ? (overscan_y >> 1) : 0);
+
+		if (!svga->override) {
 			svga->render(svga);
 
+			/* Text lines report their own damage. */
+			if ((svga->lastline_draw == svga->displine) &&
+			    (svga->render != svga_render_text_40) &&
+			    (svga->render != svga_render_text_80))
+				video_damage(0, y, 2048, 1);
+		}
+
+		/* The overlay and cursor draw over any text cells. */
+		if (svga->overlay_on || svga->hwcursor_on) {
+			video_text_invalidate(&svga->textcache, y);
+			video_damage(0, y, 2048, 1);
+		}
+
 		if (svga->overlay_on) {
 			if (!svga->override)
 				svga->overlay_draw(svga, svga->displine);
@@ -812,6 +857,7 @@ svga_init(svga_t *svga, priv_t priv, int vramsize,
     int c, d, e;
 
     svga->p = priv;
+    memset(&svga->textcache, 0x00, sizeof(textcache_t));
 
     for (c = 0; c < 256; c++) {
 	e = c;
@@ -864,6 +910,10 @@ svga_init(svga_t *svga, priv_t priv, int vramsize,
 void
 svga_close(svga_t *svga)
 {
+    video_text_close(&svga->textcache);
+
+    if (svga->idx != NULL)
+	free(svga->idx);
     free(svga->changedvram);
     free(svga->vram);
 
@@ -1191,6 +1241,8 @@ svga_doblit(int y1, int y2, int wx, int wy, svga_t *svga)
 
 	if (video_force_resize_get())
 		video_force_resize_set(0);
+
+	video_damage_all();
     }
 
     if (enable_overscan && !suppress_overscan) {
@@ -1213,9 +1265,21 @@ svga_doblit(int y1, int y2, int wx, int wy, svga_t *svga)
 				screen->line[i & 0x7ff][32 + xsize + (x_add >> 1) + j].val = svga->overscan_color;
 			}
 		}
+
+		/* Resizes damage it all, so only a new color is left. */
+		if (svga->overscan_color != svga->overscan_drawn) {
+			video_damage(32, 0, xsize + x_add, y_add >> 1);
+			video_damage(32, ysize + (y_add >> 1),
+				     xsize + x_add, y_add >> 1);
+			video_damage(32, y_add >> 1, 8, ysize);
+			video_damage(32 + xsize + (x_add >> 1), y_add >> 1,
+				     8, ysize);
+			svga->overscan_drawn = svga->overscan_color;
+		}
 	}
     }
 
+    video_damage_track();
     video_blit_start(0, 32, 0, y1, y2 + y_add, xsize + x_add, ysize + y_add);
 }
 
@@ -8,7 +8,7 @@
  *
  *		Definitions for the generic SVGA driver.
  *
- * Version:	@(#)vid_svga.h	1.0.8	2019/05/17
+ * Version:	@(#)vid_svga.h	1.0.11	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -89,8 +89,18 @@ typedef struct svga_t
 	     write_bank, read_bank,
 	     banked_mask,
 	     ca, overscan_color,
+	     overscan_drawn,		/* border color on the screen */
 	     pallook[256];
 
+    /* DAC palette changes, and the palette each line was drawn with. */
+    uint32_t pal_gen,
+	     pal_line[2048];
+
+    /* The 8bpp pels of each line, and where in VRAM they came from. */
+    uint8_t  *idx;
+    int	     idx_w;
+    uint32_t idx_tag[2048];
+
     PALETTE vgapal;
 
     tmrval_t dispontime, dispofftime,
@@ -116,6 +126,8 @@ typedef struct svga_t
     int		override;
     priv_t	p;
 
+    textcache_t	textcache;		/* text cells on the screen */
+
     uint8_t crtc[128], gdcreg[64], attrregs[32], seqregs[64],
 	    egapal[16],
 	    *vram, *changedvram;
@@ -8,7 +8,7 @@
  *
  *		SVGA renderers.
  *
- * Version:	@(#)vid_svga_render.c	1.0.17	2019/05/17
+ * Version:	@(#)vid_svga_render.c	1.0.21	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -38,6 +38,7 @@
  */
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
 #include "../../emu.h"
@@ -90,9 +91,11 @@ svga_render_text_40(svga_t *svga)
     int x_add = enable_overscan ? 8 : 0;
     int xinc = (svga->seqregs[1] & 1) ? 16 : 18;
     uint8_t chr, attr, dat;
-    uint32_t charaddr;
-    int bg, fg, x, xx;
+    uint32_t charaddr, glyph;
+    int bg, fg, x;
     int drawcursor;
+    int first = -1, last = 0;
+    textcell_t *cell;
     pel_t *p;
 
     if (svga->firstline_draw == 2000) 
@@ -101,6 +104,8 @@ svga_render_text_40(svga_t *svga)
 	
     if (svga->fullchange) {
 	p = &screen->line[svga->displine + y_add][32 + x_add];
+	cell = video_text_line(&svga->textcache, svga->displine + y_add,
+			       (svga->hdisp + xinc - 1) / xinc, x_add);
 
 	for (x = 0; x < svga->hdisp; x += xinc) {
 		drawcursor = ((svga->ma == svga->ca) && svga->con && svga->cursoron);
@@ -125,16 +130,16 @@ svga_render_text_40(svga_t *svga)
 		}
 
 		dat = svga->vram[charaddr + (svga->sc << 2)];
-		if (svga->seqregs[1] & 1) { 
-			for (xx = 0; xx < 16; xx += 2) 
-				p[xx].val = p[xx + 1].val = (dat & (0x80 >> (xx >> 1))) ? fg : bg;
-		} else {
-			for (xx = 0; xx < 16; xx += 2)
-				p[xx].val = p[xx + 1].val = (dat & (0x80 >> (xx >> 1))) ? fg : bg;
-			if ((chr & ~0x1F) != 0xC0 || !(svga->attrregs[0x10] & 4))
-				p[16].val = p[17].val = bg;
-			else		  
-				p[16].val = p[17].val = (dat & 1) ? fg : bg;
+		glyph = dat | TEXT_WIDE;
+		if (! (svga->seqregs[1] & 1)) {
+			glyph |= TEXT_9DOT;
+			if ((chr & ~0x1F) == 0xC0 && (svga->attrregs[0x10] & 4) && (dat & 1))
+				glyph |= TEXT_DOT9;
+		}
+		if (video_text_draw(p, cell++, glyph, fg, bg)) {
+			if (first < 0)
+				first = x;
+			last = x + xinc;
 		}
 
 		svga->ma += 4; 
@@ -142,6 +147,10 @@ svga_render_text_40(svga_t *svga)
 	}
 
 	svga->ma &= svga->vram_display_mask;
+
+	if (first >= 0)
+		video_damage(32 + x_add + first, svga->displine + y_add,
+			     last - first, 1);
     }
 }
 
@@ -153,9 +162,11 @@ svga_render_text_80(svga_t *svga)
     int x_add = enable_overscan ? 8 : 0;
     int xinc = (svga->seqregs[1] & 1) ? 8 : 9;
     uint8_t chr, attr, dat;
-    uint32_t charaddr;
-    int bg, fg, x, xx;
+    uint32_t charaddr, glyph;
+    int bg, fg, x;
     int drawcursor;
+    int first = -1, last = 0;
+    textcell_t *cell;
     pel_t *p;
 
     if (svga->firstline_draw == 2000) 
@@ -164,6 +175,8 @@ svga_render_text_80(svga_t *svga)
 	
     if (svga->fullchange) {
 	p = &screen->line[svga->displine + y_add][32 + x_add];
+	cell = video_text_line(&svga->textcache, svga->displine + y_add,
+			       (svga->hdisp + xinc - 1) / xinc, x_add);
 
 	for (x = 0; x < svga->hdisp; x += xinc) {
 		drawcursor = ((svga->ma == svga->ca) && svga->con && svga->cursoron);
@@ -190,16 +203,16 @@ svga_render_text_80(svga_t *svga)
 		}
 
 		dat = svga->vram[charaddr + (svga->sc << 2)];
-		if (svga->seqregs[1] & 1) { 
-			for (xx = 0; xx < 8; xx++) 
-				p[xx].val = (dat & (0x80 >> xx)) ? fg : bg;
-		} else {
-			for (xx = 0; xx < 8; xx++) 
-				p[xx].val = (dat & (0x80 >> xx)) ? fg : bg;
-			if ((chr & ~0x1F) != 0xC0 || !(svga->attrregs[0x10] & 4)) 
-				p[8].val = bg;
-			else		  
-				p[8].val = (dat & 1) ? fg : bg;
+		glyph = dat;
+		if (! (svga->seqregs[1] & 1)) {
+			glyph |= TEXT_9DOT;
+			if ((chr & ~0x1F) == 0xC0 && (svga->attrregs[0x10] & 4) && (dat & 1))
+				glyph |= TEXT_DOT9;
+		}
+		if (video_text_draw(p, cell++, glyph, fg, bg)) {
+			if (first < 0)
+				first = x;
+			last = x + xinc;
 		}
 
 		svga->ma += 4; 
@@ -207,6 +220,10 @@ svga_render_text_80(svga_t *svga)
 	}
 
 	svga->ma &= svga->vram_display_mask;
+
+	if (first >= 0)
+		video_damage(32 + x_add + first, svga->displine + y_add,
+			     last - first, 1);
     }
 }
 
@@ -498,35 +515,83 @@ svga_render_4bpp_highres(svga_t *svga)
 }
 
 
+/*
+ * Return the line of 8bpp pels for a display line, making room for
+ * the current mode first. The pels are kept as they are in VRAM, so
+ * when only the palette changes, the line can be redone from them,
+ * at the same point in the frame, without decoding VRAM again. The
+ * cursor and overlay are drawn over the line afterwards, as usual.
+ */
+static uint32_t *
+idx_line(svga_t *svga, int line)
+{
+    int w = (svga->hdisp + 16) & ~7;
+
+    if (w > svga->idx_w) {
+	if (svga->idx != NULL)
+		free(svga->idx);
+	svga->idx_w = (w + 63) & ~63;
+	svga->idx = (uint8_t *)mem_alloc(2048 * svga->idx_w);
+	memset(svga->idx_tag, 0xff, sizeof(svga->idx_tag));
+    }
+
+    return((uint32_t *)&svga->idx[line * svga->idx_w]);
+}
+
+
 void
 svga_render_8bpp_lowres(svga_t *svga)
 {
     int y_add = enable_overscan ? (overscan_y >> 1) : 0;
     int x_add = enable_overscan ? 8 : 0;
+    int line = svga->displine & 2047;
     int offset, x;
-    uint32_t dat;
+    uint32_t dat, tag, *q;
     pel_t *p;
 
-    if (svga->changedvram[svga->ma >> 12] || svga->changedvram[(svga->ma >> 12) + 1] || svga->fullchange) {
+    if (svga->changedvram[svga->ma >> 12] || svga->changedvram[(svga->ma >> 12) + 1] || svga->fullchange ||
+	(svga->pal_line[line] != svga->pal_gen)) {
 	offset = (8 - (svga->scrollcache & 6)) + 24;
 	p = &screen->line[svga->displine + y_add][offset + x_add];
+	q = idx_line(svga, line);
+	tag = svga->ma | (offset << 24) | 0x80000000;
 
 	if (svga->firstline_draw == 2000) 
 		svga->firstline_draw = svga->displine;
 	svga->lastline_draw = svga->displine;
 
-	for (x = 0; x <= svga->hdisp; x += 8) {
-		dat = *(uint32_t *)(&svga->vram[svga->ma & svga->vram_display_mask]);
+	if (!svga->changedvram[svga->ma >> 12] && !svga->changedvram[(svga->ma >> 12) + 1] &&
+	    !svga->fullchange && (svga->idx_tag[line] == tag)) {
+		/* Only the palette has changed. */
+		for (x = 0; x <= svga->hdisp; x += 8) {
+			dat = *q++;
+
+			p[0].val = p[1].val = svga->pallook[dat & 0xff];
+			p[2].val = p[3].val = svga->pallook[(dat >> 8) & 0xff];
+			p[4].val = p[5].val = svga->pallook[(dat >> 16) & 0xff];
+			p[6].val = p[7].val = svga->pallook[(dat >> 24) & 0xff];
+
+			svga->ma += 4;
+			p += 8;
+		}
+	} else {
+		svga->idx_tag[line] = tag;
 
-		p[0].val = p[1].val = svga->pallook[dat & 0xff];
-		p[2].val = p[3].val = svga->pallook[(dat >> 8) & 0xff];
-		p[4].val = p[5].val = svga->pallook[(dat >> 16) & 0xff];
-		p[6].val = p[7].val = svga->pallook[(dat >> 24) & 0xff];
+		for (x = 0; x <= svga->hdisp; x += 8) {
+			dat = *(uint32_t *)(&svga->vram[svga->ma & svga->vram_display_mask]);
+			*q++ = dat;
+
+			p[0].val = p[1].val = svga->pallook[dat & 0xff];
+			p[2].val = p[3].val = svga->pallook[(dat >> 8) & 0xff];
+			p[4].val = p[5].val = svga->pallook[(dat >> 16) & 0xff];
+			p[6].val = p[7].val = svga->pallook[(dat >> 24) & 0xff];
 		
-		svga->ma += 4;
-		p += 8;
+			svga->ma += 4;
+			p += 8;
+		}
 	}
 
+	svga->pal_line[line] = svga->pal_gen;
 	svga->ma &= svga->vram_display_mask;
     }
 }
@@ -537,35 +602,65 @@ svga_render_8bpp_highres(svga_t *svga)
 {
     int y_add = enable_overscan ? (overscan_y >> 1) : 0;
     int x_add = enable_overscan ? 8 : 0;
+    int line = svga->displine & 2047;
     int offset, x;
-    uint32_t dat;
+    uint32_t dat, tag, *q;
     pel_t *p;
 
-    if (svga->changedvram[svga->ma >> 12] || svga->changedvram[(svga->ma >> 12) + 1] || svga->fullchange) {
+    if (svga->changedvram[svga->ma >> 12] || svga->changedvram[(svga->ma >> 12) + 1] || svga->fullchange ||
+	(svga->pal_line[line] != svga->pal_gen)) {
 	offset = (8 - ((svga->scrollcache & 6) >> 1)) + 24;
 	p = &screen->line[svga->displine + y_add][offset + x_add];
+	q = idx_line(svga, line);
+	tag = svga->ma | (offset << 24);
 
 	if (svga->firstline_draw == 2000) 
 		svga->firstline_draw = svga->displine;
 	svga->lastline_draw = svga->displine;
 
-	for (x = 0; x <= svga->hdisp; x += 8) {
-		dat = *(uint32_t *)(&svga->vram[svga->ma & svga->vram_display_mask]);
-		p[0].val = svga->pallook[dat & 0xff];
-		p[1].val = svga->pallook[(dat >> 8) & 0xff];
-		p[2].val = svga->pallook[(dat >> 16) & 0xff];
-		p[3].val = svga->pallook[(dat >> 24) & 0xff];
-
-		dat = *(uint32_t *)(&svga->vram[(svga->ma + 4) & svga->vram_display_mask]);
-		p[4].val = svga->pallook[dat & 0xff];
-		p[5].val = svga->pallook[(dat >> 8) & 0xff];
-		p[6].val = svga->pallook[(dat >> 16) & 0xff];
-		p[7].val = svga->pallook[(dat >> 24) & 0xff];
+	if (!svga->changedvram[svga->ma >> 12] && !svga->changedvram[(svga->ma >> 12) + 1] &&
+	    !svga->fullchange && (svga->idx_tag[line] == tag)) {
+		/* Only the palette has changed. */
+		for (x = 0; x <= svga->hdisp; x += 8) {
+			dat = *q++;
+			p[0].val = svga->pallook[dat & 0xff];
+			p[1].val = svga->pallook[(dat >> 8) & 0xff];
+			p[2].val = svga->pallook[(dat >> 16) & 0xff];
+			p[3].val = svga->pallook[(dat >> 24) & 0xff];
+
+			dat = *q++;
+			p[4].val = svga->pallook[dat & 0xff];
+			p[5].val = svga->pallook[(dat >> 8) & 0xff];
+			p[6].val = svga->pallook[(dat >> 16) & 0xff];
+			p[7].val = svga->pallook[(dat >> 24) & 0xff];
+
+			svga->ma += 8;
+			p += 8;
+		}
+	} else {
+		svga->idx_tag[line] = tag;
+
+		for (x = 0; x <= svga->hdisp; x += 8) {
+			dat = *(uint32_t *)(&svga->vram[svga->ma & svga->vram_display_mask]);
+			*q++ = dat;
+			p[0].val = svga->pallook[dat & 0xff];
+			p[1].val = svga->pallook[(dat >> 8) & 0xff];
+			p[2].val = svga->pallook[(dat >> 16) & 0xff];
+			p[3].val = svga->pallook[(dat >> 24) & 0xff];
+
+			dat = *(uint32_t *)(&svga->vram[(svga->ma + 4) & svga->vram_display_mask]);
+			*q++ = dat;
+			p[4].val = svga->pallook[dat & 0xff];
+			p[5].val = svga->pallook[(dat >> 8) & 0xff];
+			p[6].val = svga->pallook[(dat >> 16) & 0xff];
+			p[7].val = svga->pallook[(dat >> 24) & 0xff];
 		
-		svga->ma += 8;
-		p += 8;
+			svga->ma += 8;
+			p += 8;
+		}
 	}
 
+	svga->pal_line[line] = svga->pal_gen;
 	svga->ma &= svga->vram_display_mask;
     }
 }
@@ -8,7 +8,7 @@
  *
  *		Emulation of the 3DFX Voodoo Graphics controller.
  *
- * Version:	@(#)vid_voodoo.c	1.0.21	2019/05/17
+ * Version:	@(#)vid_voodoo.c	1.0.24	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -77,7 +77,20 @@
 
 #define TEX_DIRTY_SHIFT 10
 
-#define TEX_CACHE_MAX 64
+/*Textures are cached per TMU. The configured size is what the cache fills up
+  to before it starts replacing the least recently used entries. Only while
+  every entry is still queued for rendering does it grow, by at most
+  TEX_CACHE_SPARE entries, after which it waits for the render threads. Each
+  entry holds TEX_DATA_SIZE bytes of decoded texels (about 700KB), and is not
+  freed until the card is closed, so the default stays at 64.*/
+#define TEX_CACHE_SPARE 16
+#define TEX_CACHE_MAX (256 + TEX_CACHE_SPARE)
+#define TEX_HASH_SIZE 256
+#define TEX_HASH_MASK (TEX_HASH_SIZE - 1)
+#define TEX_DATA_SIZE ((256*256 + 256*256 + 128*128 + 64*64 + 32*32 + 16*16 + 8*8 + 4*4 + 2*2) * 4)
+
+#define TEX_JOBS 16
+#define TEX_JOBS_MASK (TEX_JOBS - 1)
 
 enum
 {
@@ -248,12 +261,23 @@ typedef struct texture_t
         uint32_t base;
         uint32_t tLOD;
         volatile int refcount, refcount_r[2];
+        volatile int ready; /*Decoded, and safe for rendering*/
         int is16;
         uint32_t palette_checksum;
         uint32_t addr_start[4], addr_end[4];
+        uint32_t last_used;
+        int hash, next;
         uint32_t *data;
 } texture_t;
 
+/*A texture waiting to be decoded, with the state it was set up with*/
+typedef struct tex_job_t
+{
+        int tmu, entry;
+        voodoo_params_t params;
+        rgba_u pal[256];
+} tex_job_t;
+
 typedef struct voodoo_t
 {
         mem_map_t mapping;
@@ -448,8 +472,17 @@ typedef struct voodoo_t
         uint16_t purpleline[256][3];
 
         texture_t texture_cache[2][TEX_CACHE_MAX];
+        int texture_hash[2][TEX_HASH_SIZE];
+        int texture_entries[2], texture_cache_size;
+        uint32_t texture_stamp;
         uint8_t texture_present[2][4096];
-        int texture_last_removed;
+
+        tex_job_t tex_jobs[TEX_JOBS];
+        volatile int tex_job_read, tex_job_write;
+        thread_t *tex_thread;
+        event_t *wake_tex_thread;
+        event_t *tex_done_event;
+        event_t *tex_ready_event[2];
         
         uint32_t palette_checksum[2];
         int palette_dirty[2];
@@ -1300,189 +1333,190 @@ static void voodoo_recalc_tex(voodoo_t *voodoo, int tmu)
 
 #define makergba(r, g, b, a)  ((b) | ((g) << 8) | ((r) << 16) | ((a) << 24))
 
-static void use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
+#define TEX_IDLE(voodoo, tex) ((tex)->refcount == (tex)->refcount_r[0] && \
+                               ((voodoo)->render_threads == 1 || (tex)->refcount == (tex)->refcount_r[1]))
+
+static inline int tex_hash(uint32_t base, uint32_t tLOD, uint32_t palette_checksum)
 {
-        int c, d;
-        int lod;
-        int lod_min, lod_max;
-        uint32_t addr = 0, addr_end;
-        uint32_t palette_checksum;
+        uint32_t h = (base >> 3) ^ (tLOD * 0x9e3779b1) ^ palette_checksum;
 
-        lod_min = (params->tLOD[tmu] >> 2) & 15;
-        lod_max = (params->tLOD[tmu] >> 8) & 15;
-        
-        if (params->tformat[tmu] == TEX_PAL8 || params->tformat[tmu] == TEX_APAL8 || params->tformat[tmu] == TEX_APAL88)
-        {
-                if (voodoo->palette_dirty[tmu])
-                {
-                        palette_checksum = 0;
-                        
-                        for (c = 0; c < 256; c++)
-                                palette_checksum ^= voodoo->palette[tmu][c].u;
-                
-                        voodoo->palette_checksum[tmu] = palette_checksum;
-                        voodoo->palette_dirty[tmu] = 0;
-                }
-                else
-                        palette_checksum = voodoo->palette_checksum[tmu];
-        }
-        else
-                palette_checksum = 0;
+        return (h ^ (h >> 16) ^ (h >> 8)) & TEX_HASH_MASK;
+}
 
-        if ((voodoo->params.tLOD[tmu] & LOD_SPLIT) && (voodoo->params.tLOD[tmu] & LOD_ODD) && (voodoo->params.tLOD[tmu] & LOD_TMULTIBASEADDR))
-                addr = params->texBaseAddr1[tmu];
-        else
-                addr = params->texBaseAddr[tmu];
+/*Take a texture out of the cache. Its data is left alone, so triangles that
+  are still queued can keep using it until they are done.*/
+static void tex_unlink(voodoo_t *voodoo, int tmu, int c)
+{
+        texture_t *tex = &voodoo->texture_cache[tmu][c];
+        int *p = &voodoo->texture_hash[tmu][tex->hash];
 
-        /*Try to find texture in cache*/
-        for (c = 0; c < TEX_CACHE_MAX; c++)
+        while (*p != c)
+                p = &voodoo->texture_cache[tmu][*p].next;
+        *p = tex->next;
+        tex->base = -1;
+}
+
+/*Find a cache entry for a new texture. The cache is filled up to its
+  configured size first, and after that the least recently used idle entry
+  is replaced. If all of them are still queued for rendering, the cache grows
+  by a few spare entries instead of waiting for the render threads to catch
+  up, and only waits once those are used as well.*/
+static int tex_alloc(voodoo_t *voodoo, int tmu)
+{
+        texture_t *tex;
+        int c, best;
+
+        while (1)
         {
-                if (voodoo->texture_cache[tmu][c].base == addr &&
-                    voodoo->texture_cache[tmu][c].tLOD == (params->tLOD[tmu] & 0xf00fff) &&
-                    voodoo->texture_cache[tmu][c].palette_checksum == palette_checksum)
+                best = -1;
+                if (voodoo->texture_entries[tmu] >= voodoo->texture_cache_size)
                 {
-                        params->tex_entry[tmu] = c;
-                        voodoo->texture_cache[tmu][c].refcount++;
-                        return;
+                        for (c = 0; c < voodoo->texture_entries[tmu]; c++)
+                        {
+                                tex = &voodoo->texture_cache[tmu][c];
+                                if (!TEX_IDLE(voodoo, tex))
+                                        continue;
+                                if (tex->base == -1)
+                                {
+                                        best = c;
+                                        break;
+                                }
+                                if (best == -1 || (int32_t)(tex->last_used - voodoo->texture_cache[tmu][best].last_used) < 0)
+                                        best = c;
+                        }
                 }
-        }
-        
-        /*Texture not found, search for unused texture*/
-        do
-        {
-                for (c = 0; c < TEX_CACHE_MAX; c++)
+                if (best == -1 && voodoo->texture_entries[tmu] < voodoo->texture_cache_size + TEX_CACHE_SPARE)
                 {
-                        voodoo->texture_last_removed++;
-                        voodoo->texture_last_removed &= (TEX_CACHE_MAX-1);
-                        if (voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount == voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount_r[0] &&
-                            (voodoo->render_threads == 1 || voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount == voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount_r[1]))
-                                break;
+                        best = voodoo->texture_entries[tmu]++;
+                        voodoo->texture_cache[tmu][best].data = (uint32_t *)mem_alloc(TEX_DATA_SIZE);
                 }
-                if (c == TEX_CACHE_MAX)
-                        wait_for_render_thread_idle(voodoo);
-        } while (c == TEX_CACHE_MAX);
-        if (c == TEX_CACHE_MAX)
-                fatal("Texture cache full!\n");
+                if (best != -1)
+                        break;
 
-        c = voodoo->texture_last_removed;
-        
+                wait_for_render_thread_idle(voodoo);
+        }
 
-        if ((voodoo->params.tLOD[tmu] & LOD_SPLIT) && (voodoo->params.tLOD[tmu] & LOD_ODD) && (voodoo->params.tLOD[tmu] & LOD_TMULTIBASEADDR))
-                voodoo->texture_cache[tmu][c].base = params->texBaseAddr1[tmu];
-        else
-                voodoo->texture_cache[tmu][c].base = params->texBaseAddr[tmu];
-        voodoo->texture_cache[tmu][c].tLOD = params->tLOD[tmu] & 0xf00fff;
+        if (voodoo->texture_cache[tmu][best].base != -1)
+                tex_unlink(voodoo, tmu, best);
+
+        return best;
+}
+
+/*Decode a texture into its cache entry, on the texture thread.*/
+static void tex_decode(voodoo_t *voodoo, tex_job_t *job)
+{
+        voodoo_params_t *params = &job->params;
+        int tmu = job->tmu;
+        texture_t *tex = &voodoo->texture_cache[tmu][job->entry];
+        int lod, lod_min, lod_max;
+
+        lod_min = MIN((params->tLOD[tmu] >> 2) & 15, 8);
+        lod_max = MIN((params->tLOD[tmu] >> 8) & 15, 8);
 
-        lod_min = (params->tLOD[tmu] >> 2) & 15;
-        lod_max = (params->tLOD[tmu] >> 8) & 15;
-//        DEBUG("  add new texture to %i tformat=%i %08x LOD=%i-%i tmu=%i\n", c, voodoo->params.tformat[tmu], params->texBaseAddr[tmu], lod_min, lod_max, tmu);
-        
-        lod_min = MIN(lod_min, 8);
-        lod_max = MIN(lod_max, 8);
         for (lod = lod_min; lod <= lod_max; lod++)
         {
-                uint32_t *base = &voodoo->texture_cache[tmu][c].data[texture_offset[lod]];
+                uint32_t *base = &tex->data[texture_offset[lod]];
                 uint32_t tex_addr = params->tex_base[tmu][lod] & voodoo->texture_mask;
                 int x, y;
                 int shift = 8 - params->tex_lod[tmu][lod];
                 rgba_u *pal;
                 
-                //DEBUG("  LOD %i : %08x - %08x %i %i,%i\n", lod, params->tex_base[tmu][lod] & voodoo->texture_mask, addr, voodoo->params.tformat[tmu], voodoo->params.tex_w_mask[tmu][lod],voodoo->params.tex_h_mask[tmu][lod]);
+                //DEBUG("  LOD %i : %08x - %08x %i %i,%i\n", lod, params->tex_base[tmu][lod] & voodoo->texture_mask, addr, params->tformat[tmu], params->tex_w_mask[tmu][lod],params->tex_h_mask[tmu][lod]);
 
                 
                 switch (params->tformat[tmu])
                 {
                         case TEX_RGB332:
-                        for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod]+1; y++)
+                        for (y = 0; y < params->tex_h_mask[tmu][lod]+1; y++)
                         {
-                                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod]+1; x++)
+                                for (x = 0; x < params->tex_w_mask[tmu][lod]+1; x++)
                                 {
                                         uint8_t dat = voodoo->tex_mem[tmu][(tex_addr+x) & voodoo->texture_mask];
 
                                         base[x] = makergba(rgb332[dat].r, rgb332[dat].g, rgb332[dat].b, 0xff);
                                 }
-                                tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
+                                tex_addr += (1 << params->tex_shift[tmu][lod]);
                                 base += (1 << shift);
                         }
                         break;
 
                         case TEX_Y4I2Q2:
-                        pal = voodoo->ncc_lookup[tmu][(voodoo->params.textureMode[tmu] & TEXTUREMODE_NCC_SEL) ? 1 : 0];
-                        for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod]+1; y++)
+                        pal = job->pal;
+                        for (y = 0; y < params->tex_h_mask[tmu][lod]+1; y++)
                         {
-                                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod]+1; x++)
+                                for (x = 0; x < params->tex_w_mask[tmu][lod]+1; x++)
                                 {
                                         uint8_t dat = voodoo->tex_mem[tmu][(tex_addr+x) & voodoo->texture_mask];
 
                                         base[x] = makergba(pal[dat].rgba.r, pal[dat].rgba.g, pal[dat].rgba.b, 0xff);
                                 }
-                                tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
+                                tex_addr += (1 << params->tex_shift[tmu][lod]);
                                 base += (1 << shift);
                         }
                         break;
                         
                         case TEX_A8:
-                        for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod]+1; y++)
+                        for (y = 0; y < params->tex_h_mask[tmu][lod]+1; y++)
                         {
-                                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod]+1; x++)
+                                for (x = 0; x < params->tex_w_mask[tmu][lod]+1; x++)
                                 {
                                         uint8_t dat = voodoo->tex_mem[tmu][(tex_addr+x) & voodoo->texture_mask];
 
                                         base[x] = makergba(dat, dat, dat, dat);
                                 }
-                                tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
+                                tex_addr += (1 << params->tex_shift[tmu][lod]);
                                 base += (1 << shift);
                         }
                         break;
 
                         case TEX_I8:
-                        for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod]+1; y++)
+                        for (y = 0; y < params->tex_h_mask[tmu][lod]+1; y++)
                         {
-                                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod]+1; x++)
+                                for (x = 0; x < params->tex_w_mask[tmu][lod]+1; x++)
                                 {
                                         uint8_t dat = voodoo->tex_mem[tmu][(tex_addr+x) & voodoo->texture_mask];
 
                                         base[x] = makergba(dat, dat, dat, 0xff);
                                 }
-                                tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
+                                tex_addr += (1 << params->tex_shift[tmu][lod]);
                                 base += (1 << shift);
                         }
                         break;
 
                         case TEX_AI8:
-                        for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod]+1; y++)
+                        for (y = 0; y < params->tex_h_mask[tmu][lod]+1; y++)
                         {
-                                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod]+1; x++)
+                                for (x = 0; x < params->tex_w_mask[tmu][lod]+1; x++)
                                 {
                                         uint8_t dat = voodoo->tex_mem[tmu][(tex_addr+x) & voodoo->texture_mask];
 
                                         base[x] = makergba((dat & 0x0f) | ((dat << 4) & 0xf0), (dat & 0x0f) | ((dat << 4) & 0xf0), (dat & 0x0f) | ((dat << 4) & 0xf0), (dat & 0xf0) | ((dat >> 4) & 0x0f));
                                 }
-                                tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
+                                tex_addr += (1 << params->tex_shift[tmu][lod]);
                                 base += (1 << shift);
                         }
                         break;
 
                         case TEX_PAL8:
-                        pal = voodoo->palette[tmu];
-                        for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod]+1; y++)
+                        pal = job->pal;
+                        for (y = 0; y < params->tex_h_mask[tmu][lod]+1; y++)
                         {
-                                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod]+1; x++)
+                                for (x = 0; x < params->tex_w_mask[tmu][lod]+1; x++)
                                 {
                                         uint8_t dat = voodoo->tex_mem[tmu][(tex_addr+x) & voodoo->texture_mask];
 
                                         base[x] = makergba(pal[dat].rgba.r, pal[dat].rgba.g, pal[dat].rgba.b, 0xff);
                                 }
-                                tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
+                                tex_addr += (1 << params->tex_shift[tmu][lod]);
                                 base += (1 << shift);
                         }
                         break;
 
                         case TEX_APAL8:
-                        pal = voodoo->palette[tmu];
-                        for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod]+1; y++)
+                        pal = job->pal;
+                        for (y = 0; y < params->tex_h_mask[tmu][lod]+1; y++)
                         {
-                                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod]+1; x++)
+                                for (x = 0; x < params->tex_w_mask[tmu][lod]+1; x++)
                                 {
                                         uint8_t dat = voodoo->tex_mem[tmu][(tex_addr+x) & voodoo->texture_mask];
                                         
@@ -1493,107 +1527,107 @@ static void use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
                                         
                                         base[x] = makergba(r, g, b, a);
                                 }
-                                tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
+                                tex_addr += (1 << params->tex_shift[tmu][lod]);
                                 base += (1 << shift);
                         }
                         break;
 
                         case TEX_ARGB8332:
-                        for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod]+1; y++)
+                        for (y = 0; y < params->tex_h_mask[tmu][lod]+1; y++)
                         {
-                                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod]+1; x++)
+                                for (x = 0; x < params->tex_w_mask[tmu][lod]+1; x++)
                                 {
                                         uint16_t dat = *(uint16_t *)&voodoo->tex_mem[tmu][(tex_addr + x*2) & voodoo->texture_mask];
 
                                         base[x] = makergba(rgb332[dat & 0xff].r, rgb332[dat & 0xff].g, rgb332[dat & 0xff].b, dat >> 8);
                                 }
-                                tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod]+1));
+                                tex_addr += (1 << (params->tex_shift[tmu][lod]+1));
                                 base += (1 << shift);
                         }
                         break;
 
                         case TEX_A8Y4I2Q2:
-                        pal = voodoo->ncc_lookup[tmu][(voodoo->params.textureMode[tmu] & TEXTUREMODE_NCC_SEL) ? 1 : 0];
-                        for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod]+1; y++)
+                        pal = job->pal;
+                        for (y = 0; y < params->tex_h_mask[tmu][lod]+1; y++)
                         {
-                                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod]+1; x++)
+                                for (x = 0; x < params->tex_w_mask[tmu][lod]+1; x++)
                                 {
                                         uint16_t dat = *(uint16_t *)&voodoo->tex_mem[tmu][(tex_addr + x*2) & voodoo->texture_mask];
 
                                         base[x] = makergba(pal[dat & 0xff].rgba.r, pal[dat & 0xff].rgba.g, pal[dat & 0xff].rgba.b, dat >> 8);
                                 }
-                                tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod]+1));
+                                tex_addr += (1 << (params->tex_shift[tmu][lod]+1));
                                 base += (1 << shift);
                         }
                         break;
                                                         
                         case TEX_R5G6B5:
-                        for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod]+1; y++)
+                        for (y = 0; y < params->tex_h_mask[tmu][lod]+1; y++)
                         {
-                                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod]+1; x++)
+                                for (x = 0; x < params->tex_w_mask[tmu][lod]+1; x++)
                                 {
                                         uint16_t dat = *(uint16_t *)&voodoo->tex_mem[tmu][(tex_addr + x*2) & voodoo->texture_mask];
 
                                         base[x] = makergba(rgb565[dat].r, rgb565[dat].g, rgb565[dat].b, 0xff);
                                 }
-                                tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod]+1));
+                                tex_addr += (1 << (params->tex_shift[tmu][lod]+1));
                                 base += (1 << shift);
                         }
                         break;
 
                         case TEX_ARGB1555:
-                        for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod]+1; y++)
+                        for (y = 0; y < params->tex_h_mask[tmu][lod]+1; y++)
                         {
-                                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod]+1; x++)
+                                for (x = 0; x < params->tex_w_mask[tmu][lod]+1; x++)
                                 {
                                         uint16_t dat = *(uint16_t *)&voodoo->tex_mem[tmu][(tex_addr + x*2) & voodoo->texture_mask];
 
                                         base[x] = makergba(argb1555[dat].r, argb1555[dat].g, argb1555[dat].b, argb1555[dat].a);
                                 }
-                                tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod]+1));
+                                tex_addr += (1 << (params->tex_shift[tmu][lod]+1));
                                 base += (1 << shift);
                         }
                         break;
 
                         case TEX_ARGB4444:
-                        for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod]+1; y++)
+                        for (y = 0; y < params->tex_h_mask[tmu][lod]+1; y++)
                         {
-                                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod]+1; x++)
+                                for (x = 0; x < params->tex_w_mask[tmu][lod]+1; x++)
                                 {
                                         uint16_t dat = *(uint16_t *)&voodoo->tex_mem[tmu][(tex_addr + x*2) & voodoo->texture_mask];
 
                                         base[x] = makergba(argb4444[dat].r, argb4444[dat].g, argb4444[dat].b, argb4444[dat].a);
                                 }
-                                tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod]+1));
+                                tex_addr += (1 << (params->tex_shift[tmu][lod]+1));
                                 base += (1 << shift);
                         }
                         break;
 
                         case TEX_A8I8:
-                        for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod]+1; y++)
+                        for (y = 0; y < params->tex_h_mask[tmu][lod]+1; y++)
                         {
-                                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod]+1; x++)
+                                for (x = 0; x < params->tex_w_mask[tmu][lod]+1; x++)
                                 {
                                         uint16_t dat = *(uint16_t *)&voodoo->tex_mem[tmu][(tex_addr + x*2) & voodoo->texture_mask];
 
                                         base[x] = makergba(dat & 0xff, dat & 0xff, dat & 0xff, dat >> 8);
                                 }
-                                tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod]+1));
+                                tex_addr += (1 << (params->tex_shift[tmu][lod]+1));
                                 base += (1 << shift);
                         }
                         break;
 
                         case TEX_APAL88:
-                        pal = voodoo->palette[tmu];
-                        for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod]+1; y++)
+                        pal = job->pal;
+                        for (y = 0; y < params->tex_h_mask[tmu][lod]+1; y++)
                         {
-                                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod]+1; x++)
+                                for (x = 0; x < params->tex_w_mask[tmu][lod]+1; x++)
                                 {
                                         uint16_t dat = *(uint16_t *)&voodoo->tex_mem[tmu][(tex_addr + x*2) & voodoo->texture_mask];
 
                                         base[x] = makergba(pal[dat & 0xff].rgba.r, pal[dat & 0xff].rgba.g, pal[dat & 0xff].rgba.b, dat >> 8);
                                 }
-                                tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod]+1));
+                                tex_addr += (1 << (params->tex_shift[tmu][lod]+1));
                                 base += (1 << shift);
                         }
                         break;
@@ -1603,50 +1637,146 @@ static void use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
                 }
         }
 
-        voodoo->texture_cache[tmu][c].is16 = voodoo->params.tformat[tmu] & 8;
+        tex->ready = 1;
+}
+
+static void tex_thread(void *param)
+{
+        voodoo_t *voodoo = (voodoo_t *)param;
+
+        while (1)
+        {
+                thread_wait_event(voodoo->wake_tex_thread, -1);
+                thread_reset_event(voodoo->wake_tex_thread);
+
+                while (voodoo->tex_job_read != voodoo->tex_job_write)
+                {
+                        tex_decode(voodoo, &voodoo->tex_jobs[voodoo->tex_job_read & TEX_JOBS_MASK]);
+                        voodoo->tex_job_read++;
+
+                        thread_set_event(voodoo->tex_done_event);
+                        thread_set_event(voodoo->tex_ready_event[0]);
+                        thread_set_event(voodoo->tex_ready_event[1]);
+                }
+        }
+}
+
+/*Wait until no more than the given number of textures are left to decode.*/
+static void wait_for_tex_thread(voodoo_t *voodoo, int pending)
+{
+        while ((voodoo->tex_job_write - voodoo->tex_job_read) > pending)
+        {
+                thread_reset_event(voodoo->tex_done_event);
+                if ((voodoo->tex_job_write - voodoo->tex_job_read) <= pending)
+                        break;
+                thread_wait_event(voodoo->tex_done_event, 1);
+        }
+}
 
+static void use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
+{
+        texture_t *tex;
+        tex_job_t *job;
+        int c, d;
+        int lod_min, lod_max;
+        uint32_t addr = 0, addr_end;
+        uint32_t tLOD;
+        uint32_t palette_checksum;
+
+        lod_min = (params->tLOD[tmu] >> 2) & 15;
+        lod_max = (params->tLOD[tmu] >> 8) & 15;
+        
         if (params->tformat[tmu] == TEX_PAL8 || params->tformat[tmu] == TEX_APAL8 || params->tformat[tmu] == TEX_APAL88)
-                voodoo->texture_cache[tmu][c].palette_checksum = palette_checksum;
+        {
+                if (voodoo->palette_dirty[tmu])
+                {
+                        palette_checksum = 0;
+                        
+                        for (c = 0; c < 256; c++)
+                                palette_checksum ^= voodoo->palette[tmu][c].u;
+                
+                        voodoo->palette_checksum[tmu] = palette_checksum;
+                        voodoo->palette_dirty[tmu] = 0;
+                }
+                else
+                        palette_checksum = voodoo->palette_checksum[tmu];
+        }
+        else
+                palette_checksum = 0;
+
+        if ((params->tLOD[tmu] & LOD_SPLIT) && (params->tLOD[tmu] & LOD_ODD) && (params->tLOD[tmu] & LOD_TMULTIBASEADDR))
+                addr = params->texBaseAddr1[tmu];
         else
-                voodoo->texture_cache[tmu][c].palette_checksum = 0;
+                addr = params->texBaseAddr[tmu];
+        tLOD = params->tLOD[tmu] & 0xf00fff;
+
+        /*Try to find texture in cache*/
+        for (c = voodoo->texture_hash[tmu][tex_hash(addr, tLOD, palette_checksum)]; c != -1; c = voodoo->texture_cache[tmu][c].next)
+        {
+                tex = &voodoo->texture_cache[tmu][c];
+                if (tex->base == addr && tex->tLOD == tLOD && tex->palette_checksum == palette_checksum)
+                {
+                        params->tex_entry[tmu] = c;
+                        tex->last_used = voodoo->texture_stamp++;
+                        tex->refcount++;
+                        return;
+                }
+        }
+        
+        /*Texture not found, replace the least recently used one*/
+        c = tex_alloc(voodoo, tmu);
+        tex = &voodoo->texture_cache[tmu][c];
+
+        tex->base = addr;
+        tex->tLOD = tLOD;
+        tex->palette_checksum = palette_checksum;
+        tex->hash = tex_hash(addr, tLOD, palette_checksum);
+        tex->next = voodoo->texture_hash[tmu][tex->hash];
+        voodoo->texture_hash[tmu][tex->hash] = c;
+//        DEBUG("  add new texture to %i tformat=%i %08x LOD=%i-%i tmu=%i\n", c, params->tformat[tmu], params->texBaseAddr[tmu], lod_min, lod_max, tmu);
+        
+        lod_min = MIN(lod_min, 8);
+        lod_max = MIN(lod_max, 8);
+
+        tex->is16 = params->tformat[tmu] & 8;
 
         if (lod_min == 0)
         {
-                voodoo->texture_cache[tmu][c].addr_start[0] = voodoo->params.tex_base[tmu][0];
-                voodoo->texture_cache[tmu][c].addr_end[0] = voodoo->params.tex_end[tmu][0];
+                tex->addr_start[0] = params->tex_base[tmu][0];
+                tex->addr_end[0] = params->tex_end[tmu][0];
         }
         else        
-                voodoo->texture_cache[tmu][c].addr_start[0] = voodoo->texture_cache[tmu][c].addr_end[0] = 0;
+                tex->addr_start[0] = tex->addr_end[0] = 0;
 
         if (lod_min <= 1 && lod_max >= 1)
         {
-                voodoo->texture_cache[tmu][c].addr_start[1] = voodoo->params.tex_base[tmu][1];
-                voodoo->texture_cache[tmu][c].addr_end[1] = voodoo->params.tex_end[tmu][1];
+                tex->addr_start[1] = params->tex_base[tmu][1];
+                tex->addr_end[1] = params->tex_end[tmu][1];
         }
         else        
-                voodoo->texture_cache[tmu][c].addr_start[1] = voodoo->texture_cache[tmu][c].addr_end[1] = 0;
+                tex->addr_start[1] = tex->addr_end[1] = 0;
 
         if (lod_min <= 2 && lod_max >= 2)
         {
-                voodoo->texture_cache[tmu][c].addr_start[2] = voodoo->params.tex_base[tmu][2];
-                voodoo->texture_cache[tmu][c].addr_end[2] = voodoo->params.tex_end[tmu][2];
+                tex->addr_start[2] = params->tex_base[tmu][2];
+                tex->addr_end[2] = params->tex_end[tmu][2];
         }
         else        
-                voodoo->texture_cache[tmu][c].addr_start[2] = voodoo->texture_cache[tmu][c].addr_end[2] = 0;
+                tex->addr_start[2] = tex->addr_end[2] = 0;
 
         if (lod_max >= 3)
         {
-                voodoo->texture_cache[tmu][c].addr_start[3] = voodoo->params.tex_base[tmu][(lod_min > 3) ? lod_min : 3];
-                voodoo->texture_cache[tmu][c].addr_end[3] = voodoo->params.tex_end[tmu][(lod_max < 8) ? lod_max : 8];
+                tex->addr_start[3] = params->tex_base[tmu][(lod_min > 3) ? lod_min : 3];
+                tex->addr_end[3] = params->tex_end[tmu][(lod_max < 8) ? lod_max : 8];
         }
         else        
-                voodoo->texture_cache[tmu][c].addr_start[3] = voodoo->texture_cache[tmu][c].addr_end[3] = 0;
+                tex->addr_start[3] = tex->addr_end[3] = 0;
 
 
         for (d = 0; d < 4; d++)
         {
-                addr = voodoo->texture_cache[tmu][c].addr_start[d];
-                addr_end = voodoo->texture_cache[tmu][c].addr_end[d];
+                addr = tex->addr_start[d];
+                addr_end = tex->addr_end[d];
 
                 if (addr_end != 0)
                 {
@@ -1654,19 +1784,39 @@ static void use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
                                 voodoo->texture_present[tmu][(addr & voodoo->texture_mask) >> TEX_DIRTY_SHIFT] = 1;
                 }
         }
+
+        /*Hand it to the texture thread, with everything the decode needs. The
+          render threads wait for it to be ready.*/
+        wait_for_tex_thread(voodoo, TEX_JOBS - 1);
+        job = &voodoo->tex_jobs[voodoo->tex_job_write & TEX_JOBS_MASK];
+        job->tmu = tmu;
+        job->entry = c;
+        memcpy(&job->params, params, sizeof(voodoo_params_t));
+        if (params->tformat[tmu] == TEX_Y4I2Q2 || params->tformat[tmu] == TEX_A8Y4I2Q2)
+                memcpy(job->pal, voodoo->ncc_lookup[tmu][(params->textureMode[tmu] & TEXTUREMODE_NCC_SEL) ? 1 : 0], sizeof(job->pal));
+        else if (params->tformat[tmu] == TEX_PAL8 || params->tformat[tmu] == TEX_APAL8 || params->tformat[tmu] == TEX_APAL88)
+                memcpy(job->pal, voodoo->palette[tmu], sizeof(job->pal));
+        tex->ready = 0;
+        voodoo->tex_job_write++;
+        thread_set_event(voodoo->wake_tex_thread);
        
         params->tex_entry[tmu] = c;
-        voodoo->texture_cache[tmu][c].refcount++;
+        tex->last_used = voodoo->texture_stamp++;
+        tex->refcount++;
 }
 
 static void flush_texture_cache(voodoo_t *voodoo, uint32_t dirty_addr, int tmu)
 {
-        int wait_for_idle = 0;
         int c;
         
+        /*Texture memory is about to change, let pending decodes finish with it.
+          Evicted textures are only unlinked, and get reused once the render
+          threads are done with them.*/
+        wait_for_tex_thread(voodoo, 0);
+
         memset(voodoo->texture_present[tmu], 0, sizeof(voodoo->texture_present[0]));
 //        DEBUG("Evict %08x %i\n", dirty_addr, sizeof(voodoo->texture_present));
-        for (c = 0; c < TEX_CACHE_MAX; c++)
+        for (c = 0; c < voodoo->texture_entries[tmu]; c++)
         {
                 if (voodoo->texture_cache[tmu][c].base != -1)
                 {
@@ -1688,11 +1838,8 @@ static void flush_texture_cache(voodoo_t *voodoo, uint32_t dirty_addr, int tmu)
                                         {
 //                                DEBUG("  Evict texture %i %08x\n", c, voodoo->texture_cache[tmu][c].base);
 
-                                                if (voodoo->texture_cache[tmu][c].refcount != voodoo->texture_cache[tmu][c].refcount_r[0] ||
-                                                    (voodoo->render_threads == 2 && voodoo->texture_cache[tmu][c].refcount != voodoo->texture_cache[tmu][c].refcount_r[1]))
-                                                        wait_for_idle = 1;
-                                        
-                                                voodoo->texture_cache[tmu][c].base = -1;
+                                                tex_unlink(voodoo, tmu, c);
+                                                break;
                                         }
                                         else
                                         {
@@ -1703,8 +1850,6 @@ static void flush_texture_cache(voodoo_t *voodoo, uint32_t dirty_addr, int tmu)
                         }
                 }
         }
-        if (wait_for_idle)
-                wait_for_render_thread_idle(voodoo);
 }
 
 typedef struct voodoo_state_t
@@ -3600,6 +3745,18 @@ static inline void wait_for_render_thread_idle(voodoo_t *voodoo)
         }
 }
 
+/*The textures of a triangle may still be in the texture thread.*/
+static inline void wait_for_texture(voodoo_t *voodoo, voodoo_params_t *params, int odd_even)
+{
+        while (!voodoo->texture_cache[0][params->tex_entry[0]].ready || !voodoo->texture_cache[1][params->tex_entry[1]].ready)
+        {
+                thread_reset_event(voodoo->tex_ready_event[odd_even]);
+                if (voodoo->texture_cache[0][params->tex_entry[0]].ready && voodoo->texture_cache[1][params->tex_entry[1]].ready)
+                        break;
+                thread_wait_event(voodoo->tex_ready_event[odd_even], 1);
+        }
+}
+
 static void render_thread(void *param, int odd_even)
 {
         voodoo_t *voodoo = (voodoo_t *)param;
@@ -3617,6 +3774,7 @@ static void render_thread(void *param, int odd_even)
                         uint64_t end_time;
                         voodoo_params_t *params = &voodoo->params_buffer[voodoo->params_read_idx[odd_even] & PARAM_MASK];
                         
+                        wait_for_texture(voodoo, params, odd_even);
                         voodoo_triangle(voodoo, params, odd_even);
 
                         voodoo->params_read_idx[odd_even]++;                                                
@@ -7414,10 +7572,10 @@ void voodoo_callback(void *priv)
                                 if (voodoo->line < voodoo->dirty_line_low)
                                 {
                                         voodoo->dirty_line_low = voodoo->line;
-                                        video_blit_wait_buffer();
                                 }
                                 if (voodoo->line > voodoo->dirty_line_high)
                                         voodoo->dirty_line_high = voodoo->line;
+                                video_damage(32 + x_add, voodoo->line + y_add, voodoo->h_disp, 1);
                                 
                                 if (voodoo->scrfilter && voodoo->scrfilterEnabled)
                                 {
@@ -7569,6 +7727,9 @@ void *voodoo_card_init()
         voodoo->fb_size = device_get_config_int("framebuffer_memory");
         voodoo->fb_mask = (voodoo->fb_size << 20) - 1;
         voodoo->render_threads = device_get_config_int("render_threads");
+        voodoo->texture_cache_size = device_get_config_int("texture_cache");
+        if (voodoo->texture_cache_size > TEX_CACHE_MAX - TEX_CACHE_SPARE)
+                voodoo->texture_cache_size = TEX_CACHE_MAX - TEX_CACHE_SPARE;
         voodoo->odd_even_mask = voodoo->render_threads - 1;
 #ifndef NO_CODEGEN
         voodoo->use_recompiler = device_get_config_int("recompiler");
@@ -7603,18 +7764,15 @@ void *voodoo_card_init()
         voodoo->tex_mem_w[0] = (uint16_t *)voodoo->tex_mem[0];
         voodoo->tex_mem_w[1] = (uint16_t *)voodoo->tex_mem[1];
         
+        /*Cache entries get their data when first used.*/
         for (c = 0; c < TEX_CACHE_MAX; c++)
         {
-                voodoo->texture_cache[0][c].data = (uint32_t *)mem_alloc((256*256 + 256*256 + 128*128 + 64*64 + 32*32 + 16*16 + 8*8 + 4*4 + 2*2) * 4);
                 voodoo->texture_cache[0][c].base = -1; /*invalid*/
-                voodoo->texture_cache[0][c].refcount = 0;
-                if (voodoo->dual_tmus)
-                {
-                        voodoo->texture_cache[1][c].data = (uint32_t *)mem_alloc((256*256 + 256*256 + 128*128 + 64*64 + 32*32 + 16*16 + 8*8 + 4*4 + 2*2) * 4);
-                        voodoo->texture_cache[1][c].base = -1; /*invalid*/
-                        voodoo->texture_cache[1][c].refcount = 0;
-                }
+                voodoo->texture_cache[0][c].ready = 1;
+                voodoo->texture_cache[1][c].base = -1; /*invalid*/
+                voodoo->texture_cache[1][c].ready = 1;
         }
+        memset(voodoo->texture_hash, 0xff, sizeof(voodoo->texture_hash));
 
         timer_add(voodoo_callback, voodoo,
 		  &voodoo->timer_count, TIMER_ALWAYS_ENABLED);
@@ -7629,10 +7787,15 @@ void *voodoo_card_init()
         voodoo->fifo_not_full_event = thread_create_event();
         voodoo->render_not_full_event[0] = thread_create_event();
         voodoo->render_not_full_event[1] = thread_create_event();
+        voodoo->wake_tex_thread = thread_create_event();
+        voodoo->tex_done_event = thread_create_event();
+        voodoo->tex_ready_event[0] = thread_create_event();
+        voodoo->tex_ready_event[1] = thread_create_event();
         voodoo->fifo_thread = thread_create(fifo_thread, voodoo);
         voodoo->render_thread[0] = thread_create(render_thread_1, voodoo);
         if (voodoo->render_threads == 2)
                 voodoo->render_thread[1] = thread_create(render_thread_2, voodoo);
+        voodoo->tex_thread = thread_create(tex_thread, voodoo);
 
         timer_add(voodoo_wake_timer, voodoo,
 		  &voodoo->wake_timer, &voodoo->wake_timer);
@@ -7793,6 +7956,7 @@ voodoo_card_close(voodoo_t *voodoo)
         thread_kill(voodoo->render_thread[0]);
         if (voodoo->render_threads == 2)
                 thread_kill(voodoo->render_thread[1]);
+        thread_kill(voodoo->tex_thread);
         thread_destroy_event(voodoo->fifo_not_full_event);
         thread_destroy_event(voodoo->wake_main_thread);
         thread_destroy_event(voodoo->wake_fifo_thread);
@@ -7800,13 +7964,15 @@ voodoo_card_close(voodoo_t *voodoo)
         thread_destroy_event(voodoo->wake_render_thread[1]);
         thread_destroy_event(voodoo->render_not_full_event[0]);
         thread_destroy_event(voodoo->render_not_full_event[1]);
+        thread_destroy_event(voodoo->wake_tex_thread);
+        thread_destroy_event(voodoo->tex_done_event);
+        thread_destroy_event(voodoo->tex_ready_event[0]);
+        thread_destroy_event(voodoo->tex_ready_event[1]);
 
-        for (c = 0; c < TEX_CACHE_MAX; c++)
-        {
-                if (voodoo->dual_tmus)
-                        free(voodoo->texture_cache[1][c].data);
+        for (c = 0; c < voodoo->texture_entries[0]; c++)
                 free(voodoo->texture_cache[0][c].data);
-        }
+        for (c = 0; c < voodoo->texture_entries[1]; c++)
+                free(voodoo->texture_cache[1][c].data);
 #ifndef NO_CODEGEN
         voodoo_codegen_close(voodoo);
 #endif
@@ -7905,6 +8071,23 @@ static const device_config_t voodoo_config[] =
                         }
                 },
         },
+        {
+                "texture_cache","Texture cache size",CONFIG_SELECTION,"",64,
+                {
+                        {
+                                "64 textures",64
+                        },
+                        {
+                                "128 textures",128
+                        },
+                        {
+                                "256 textures",256
+                        },
+                        {
+                                NULL
+                        }
+                },
+        },
         {
                 "sli","SLI",CONFIG_BINARY,"",0
         },
@@ -53,7 +53,7 @@
  *		What doesn't work, is untested or not well understood:
  *		  - Cursor detach (commands 4 and 5)
  *
- * Version:	@(#)vid_wy700.c	1.0.14	2019/05/17
+ * Version:	@(#)vid_wy700.c	1.0.15	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -760,9 +760,6 @@ wy700_poll(priv_t priv)
 	dev->mda_stat |= 1;
 	dev->linepos = 1;
 	if (dev->dispon) {
-		if (dev->displine == 0)
-			video_blit_wait_buffer();
-	
 		if (dev->wy700_mode & 0x80) 
 			mode = dev->wy700_mode & 0xF0;
 		else
@@ -8,7 +8,7 @@
  *
  *		Main video-rendering module.
  *
- * Version:	@(#)video.c	1.0.31	2019/05/05
+ * Version:	@(#)video.c	1.0.38	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -56,8 +56,16 @@
 #include "../../timer.h"
 #include "../../plat.h"
 #include "video.h"
+#include "../../capture.h"
+#ifdef USE_LIBPNG
+# include "../../png.h"
+#endif
 #include "vid_mda.h"
 #include "vid_svga.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+# include <emmintrin.h>
+# define VIDEO_SSE2	1
+#endif
 
 
 #ifdef ENABLE_VIDEO_LOG
@@ -379,41 +387,258 @@ static const uint32_t	shade[5][256] = {
 };
 static uint32_t	cga_2_table[16];
 static uint8_t	rotatevga[8][256];
+static uint32_t	text_masks[256][8];	/* font byte expanded to pel masks */
 static int	video_force_resize;
 static int	video_card_type;
 static const video_timings_t *video_timing;
 
 
+/*
+ * The card draws into one buffer, while the renderer shows another
+ * one. A finished frame waits in the third buffer if the renderer
+ * is still busy, and is replaced by a newer one if it is still busy
+ * then, so the emulator never has to wait for the renderer.
+ */
+#define BLIT_BUFFERS	3
+
+typedef struct {
+    bitmap_t	*bmp;
+    int		x, y, y1, y2, w, h;	/* frame held in it */
+    uint64_t	stamp;			/* capture clock when finished */
+    damage_t	damage;			/* changes since the frame before */
+    damage_t	stale;			/* what it is behind on the card */
+} blitbuf_t;
+
 static struct blitter {
-    int		x, y, y1, y2, w, h;
+    blitbuf_t	buf[BLIT_BUFFERS];
+    int		draw;			/* buffer being drawn by the card */
+    int		queued;			/* buffer waiting to be shown */
+    int		shown;			/* buffer being shown */
+    int		last;			/* buffer with the latest frame */
+    mutex_t	*lock;
 
     volatile int busy;
     event_t	*busy_ev;
 
-    volatile int inuse;
-    event_t	*inuse_ev;
-
     thread_t	*thread;
     event_t	*wake_ev;
 
-    void	(*func)(bitmap_t *,int x, int y, int y1, int y2, int w, int h);
+    void	(*func)(bitmap_t *,int x, int y, int y1, int y2, int w, int h,
+			const damage_t *dmg);
+
+    /* Requests for the latest frame, handled by the blitter. */
+    wchar_t	snap_fn[1024];		/* screenshot to take */
+    int		hash_on,		/* frame hash is being polled */
+		hash_want;		/* hash the latest frame again */
+    uint64_t	hash;
+    uint32_t	hash_seq;
 }		video_blit;
 
+static damage_t	damage;			/* damage map being built */
+static int	damage_tracked;
+static volatile int text_gen;		/* bumped to forget all text caches */
+
+/*
+ * The frame hash is a multiply-accumulate hash in the style of
+ * XXH3, on two 64-bit lanes, so SSE2 can do a whole group of four
+ * pels at once. The plain C version gives the exact same result.
+ */
+#define HASH_KEYS	16
+#define HASH_PRIME32	0x9e3779b1U
+#define HASH_PRIME64	0x9e3779b185ebca87ULL
+
+static uint64_t	hash_key[HASH_KEYS][2];
+
+
+#ifndef VIDEO_SSE2
+/* Mix up the accumulators, at the end of every 16 groups of pels. */
+static void
+hash_scramble(uint64_t *acc)
+{
+    acc[0] = (acc[0] ^ (acc[0] >> 47) ^ hash_key[0][0]) * HASH_PRIME32;
+    acc[1] = (acc[1] ^ (acc[1] >> 47) ^ hash_key[0][1]) * HASH_PRIME32;
+}
+#endif
+
+
+/* Calculate the fingerprint of the visible area of a frame. */
+static uint64_t
+frame_hash(const blitbuf_t *b)
+{
+#ifdef VIDEO_SSE2
+    const __m128i mask = _mm_set1_epi32(0x00ffffff);
+    const __m128i prime = _mm_set1_epi32(HASH_PRIME32);
+    const __m128i skey = _mm_loadu_si128((const __m128i *)hash_key[0]);
+    __m128i vacc, d, k, lo, hi;
+#else
+    uint64_t d0, d1, t0, t1;
+#endif
+    uint64_t acc[2], h;
+    uint32_t p[4];
+    const pel_t *pel;
+    int g, i, xx, yy;
+
+    acc[0] = (uint64_t)b->w * HASH_PRIME64;
+    acc[1] = (uint64_t)b->h * HASH_PRIME64;
+
+#ifdef VIDEO_SSE2
+    vacc = _mm_loadu_si128((const __m128i *)acc);
+    for (yy = 0; yy < b->h; yy++) {
+	pel = &b->bmp->line[b->y + yy][b->x];
+	for (xx = 0, g = 0; xx < b->w; xx += 4, g++) {
+		if ((b->w - xx) >= 4) {
+			d = _mm_loadu_si128((const __m128i *)&pel[xx]);
+		} else {
+			for (i = 0; i < 4; i++)
+				p[i] = ((xx + i) < b->w) ? pel[xx + i].val : 0;
+			d = _mm_loadu_si128((const __m128i *)p);
+		}
+		d = _mm_and_si128(d, mask);
+
+		/* acc += swapped data + lo32(data ^ key) * hi32(data ^ key) */
+		k = _mm_xor_si128(d, _mm_loadu_si128((const __m128i *)hash_key[g & (HASH_KEYS - 1)]));
+		vacc = _mm_add_epi64(vacc, _mm_shuffle_epi32(d, _MM_SHUFFLE(1,0,3,2)));
+		vacc = _mm_add_epi64(vacc, _mm_mul_epu32(k, _mm_srli_epi64(k, 32)));
+
+		if (((g & (HASH_KEYS - 1)) == (HASH_KEYS - 1)) ||
+		    ((xx + 4) >= b->w)) {
+			vacc = _mm_xor_si128(vacc, _mm_srli_epi64(vacc, 47));
+			vacc = _mm_xor_si128(vacc, skey);
+			lo = _mm_mul_epu32(vacc, prime);
+			hi = _mm_mul_epu32(_mm_srli_epi64(vacc, 32), prime);
+			vacc = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+		}
+	}
+    }
+    _mm_storeu_si128((__m128i *)acc, vacc);
+#else
+    for (yy = 0; yy < b->h; yy++) {
+	pel = &b->bmp->line[b->y + yy][b->x];
+	for (xx = 0, g = 0; xx < b->w; xx += 4, g++) {
+		for (i = 0; i < 4; i++)
+			p[i] = ((xx + i) < b->w) ? (pel[xx + i].val & 0x00ffffff) : 0;
+		d0 = p[0] | ((uint64_t)p[1] << 32);
+		d1 = p[2] | ((uint64_t)p[3] << 32);
+
+		t0 = d0 ^ hash_key[g & (HASH_KEYS - 1)][0];
+		t1 = d1 ^ hash_key[g & (HASH_KEYS - 1)][1];
+		acc[0] += d1 + (t0 & 0xffffffff) * (t0 >> 32);
+		acc[1] += d0 + (t1 & 0xffffffff) * (t1 >> 32);
+
+		if (((g & (HASH_KEYS - 1)) == (HASH_KEYS - 1)) ||
+		    ((xx + 4) >= b->w))
+			hash_scramble(acc);
+	}
+    }
+#endif
+
+    /* Fold the lanes, and let every bit affect every other bit. */
+    h = acc[0] ^ (acc[1] * HASH_PRIME64);
+    h ^= h >> 33;
+    h *= 0xc2b2ae3d27d4eb4fULL;
+    h ^= h >> 29;
+    h *= 0x165667b19e3779f9ULL;
+    h ^= h >> 32;
+
+    return(h);
+}
+
+
+/* Save the visible area of a frame as a PNG image. */
+static void
+frame_snap(const blitbuf_t *b, const wchar_t *fn)
+{
+#ifdef USE_LIBPNG
+    uint32_t *pix, *p;
+    int xx, yy;
+
+    if ((b->w <= 0) || (b->h <= 0)) return;
+
+    /*
+     * Copy the frame bottom-up, as a "flipped" (BMP-style) image
+     * is what png_write_rgb() takes in our pel format.
+     */
+    pix = (uint32_t *)mem_alloc(b->w * b->h * sizeof(uint32_t));
+    p = pix;
+    for (yy = b->h - 1; yy >= 0; yy--) {
+	for (xx = 0; xx < b->w; xx++)
+		*p++ = b->bmp->line[b->y + yy][b->x + xx].val & 0x00ffffff;
+    }
+
+    /* The PNG module takes it from here, and frees the buffer. */
+    if (! png_queue_rgb(fn, 1, (uint8_t *)pix,
+			(int16_t)b->w, (int16_t)b->h))
+	ERRLOG("VIDEO: unable to save screenshot '%ls'\n", fn);
+#else
+    ERRLOG("VIDEO: no PNG support, screenshot '%ls' not saved\n", fn);
+#endif
+}
+
 
 static void
 blit_thread(void *param)
 {
     struct blitter *blit = (struct blitter *)param;
+    wchar_t fn[1024];
+    blitbuf_t *b;
+    uint64_t h;
+    int fresh, hash;
 
     for (;;) {
 	thread_wait_event(blit->wake_ev, -1);
 	thread_reset_event(blit->wake_ev);
 
-	if (blit->func != NULL)
-		blit->func(screen, blit->x, blit->y,
-			   blit->y1, blit->y2, blit->w, blit->h);
+	for (;;) {
+		/*
+		 * Take the next frame, if there is one. If not, we may
+		 * still have been asked for something from the latest.
+		 */
+		thread_wait_mutex(blit->lock);
+		fresh = (blit->queued >= 0);
+		if (fresh) {
+			blit->shown = blit->last = blit->queued;
+			blit->queued = -1;
+		} else if ((blit->last < 0) ||
+			   ((blit->snap_fn[0] == L'\0') && !blit->hash_want)) {
+			blit->busy = 0;
+			thread_release_mutex(blit->lock);
+			break;
+		}
+		hash = blit->hash_on && (fresh || blit->hash_want);
+		blit->hash_want = 0;
+		wcscpy(fn, blit->snap_fn);
+		blit->snap_fn[0] = L'\0';
+		thread_release_mutex(blit->lock);
+
+		/* The card does not touch this until we take the next. */
+		b = &blit->buf[blit->last];
+
+		if (hash) {
+			h = frame_hash(b);
+
+			thread_wait_mutex(blit->lock);
+			blit->hash = h;
+			blit->hash_seq++;
+			thread_release_mutex(blit->lock);
+		}
+
+		if (fn[0] != L'\0')
+			frame_snap(b, fn);
+
+		if (! fresh) continue;
+
+		/* Recorder first, the renderer may let go of it early. */
+		if (capture_active)
+			capture_video(b->bmp, b->x, b->y, b->w, b->h, b->stamp);
+
+		if (blit->func != NULL)
+			blit->func(b->bmp, b->x, b->y,
+				   b->y1, b->y2, b->w, b->h, &b->damage);
+
+		/* In case the renderer did not say so. */
+		video_blit_done();
+	}
 
-	blit->busy = 0;
 	thread_set_event(blit->busy_ev);
     }
 }
@@ -421,39 +646,88 @@ blit_thread(void *param)
 
 /* Set address of renderer blit function. */
 void
-video_blit_set(void(*blit)(bitmap_t *,int,int,int,int,int,int))
+video_blit_set(void(*blit)(bitmap_t *,int,int,int,int,int,int,const damage_t *))
 {
     video_blit.func = blit;
+
+    /* A new renderer has nothing on its screen yet. */
+    damage.all = 1;
 }
 
 
-/* Renderer blit function is done. */
-void
-video_blit_done(void)
+/*
+ * Save the current emulated screen as a PNG image. The frame is
+ * copied by the blitter, and written by the PNG worker thread, so
+ * this returns right away. Only one screenshot can be pending, so
+ * if the last one has not been taken yet, we return 0.
+ */
+int
+video_screenshot(const wchar_t *fn)
 {
-    video_blit.inuse = 0;
+    int ret = 0;
+
+    thread_wait_mutex(video_blit.lock);
+    if (video_blit.snap_fn[0] == L'\0') {
+	wcsncpy(video_blit.snap_fn, fn, sizeof_w(video_blit.snap_fn) - 1);
+	ret = 1;
+    }
+    thread_release_mutex(video_blit.lock);
+
+    if (ret)
+	thread_set_event(video_blit.wake_ev);
 
-    thread_set_event(video_blit.inuse_ev);
+    return(ret);
 }
 
 
-void
-video_blit_wait(void)
+/*
+ * Get the fingerprint of the latest frame, and the number of frames
+ * hashed so far, so the caller can tell whether something changed
+ * without looking at the pels. The first call turns on hashing,
+ * and returns 0 until the first frame has been hashed.
+ */
+uint64_t
+video_frame_hash(uint32_t *seq)
 {
-    while (video_blit.busy)
-	thread_wait_event(video_blit.busy_ev, -1);
+    uint64_t h;
+    int wake = 0;
+
+    thread_wait_mutex(video_blit.lock);
+    if (! video_blit.hash_on) {
+	video_blit.hash_on = 1;
+	video_blit.hash_want = 1;
+	wake = 1;
+    }
+    h = video_blit.hash;
+    if (seq != NULL)
+	*seq = video_blit.hash_seq;
+    thread_release_mutex(video_blit.lock);
 
-    thread_reset_event(video_blit.busy_ev);
+    if (wake)
+	thread_set_event(video_blit.wake_ev);
+
+    return(h);
 }
 
 
+/* Renderer is done with the pels of the frame it is showing. */
 void
-video_blit_wait_buffer(void)
+video_blit_done(void)
 {
-    while (video_blit.inuse)
-	thread_wait_event(video_blit.inuse_ev, -1);
+    thread_wait_mutex(video_blit.lock);
+    video_blit.shown = -1;
+    thread_release_mutex(video_blit.lock);
+}
+
 
-    thread_reset_event(video_blit.inuse_ev);
+/* Wait until the renderer has shown all frames given to it. */
+void
+video_blit_wait(void)
+{
+    while (video_blit.busy)
+	thread_wait_event(video_blit.busy_ev, -1);
+
+    thread_reset_event(video_blit.busy_ev);
 }
 
 
@@ -520,44 +794,341 @@ video_blend(int x, int y)
 }
 
 
-/* Set up the blitter, and then wake it up to process the screen buffer. */
+/*
+ * Return the cache of text cells drawn on a screen line, growing
+ * the cache if needed. Anything drawn at another horizontal offset
+ * (overscan on or off) is no longer where we think it is.
+ */
+textcell_t *
+video_text_line(textcache_t *tc, int line, int cols, int xoff)
+{
+    if ((line >= tc->lines) || (cols > tc->cols)) {
+	if (tc->cells != NULL)
+		free(tc->cells);
+	if (line >= tc->lines)
+		tc->lines = (line + 64) & ~63;
+	if (cols > tc->cols)
+		tc->cols = cols;
+	tc->cells = (textcell_t *)mem_alloc(tc->lines * tc->cols * sizeof(textcell_t));
+	video_text_invalidate(tc, -1);
+    }
+
+    if ((xoff != tc->xoff) || (tc->gen != text_gen)) {
+	video_text_invalidate(tc, -1);
+	tc->xoff = xoff;
+	tc->gen = text_gen;
+    }
+
+    return(&tc->cells[line * tc->cols]);
+}
+
+
+/*
+ * Forget what was drawn on a line, or on all of them. With no cache
+ * given, all caches are forgotten, the next time their card draws.
+ */
+void
+video_text_invalidate(textcache_t *tc, int line)
+{
+    if (tc == NULL) {
+	text_gen++;
+	return;
+    }
+
+    if (tc->cells == NULL) return;
+
+    if (line < 0)
+	memset(tc->cells, 0xff, tc->lines * tc->cols * sizeof(textcell_t));
+    else if (line < tc->lines)
+	memset(&tc->cells[line * tc->cols], 0xff, tc->cols * sizeof(textcell_t));
+}
+
+
+void
+video_text_close(textcache_t *tc)
+{
+    if (tc->cells != NULL)
+	free(tc->cells);
+    memset(tc, 0x00, sizeof(textcache_t));
+}
+
+
+static void
+damage_rect(damage_t *dmg, int x, int y, int w, int h)
+{
+    uint32_t mask;
+    int x2, y2;
+
+    if (x < 0) {
+	w += x;
+	x = 0;
+    }
+    if (y < 0) {
+	h += y;
+	y = 0;
+    }
+    if ((w <= 0) || (h <= 0) || (x >= 2048) || (y >= 2048)) return;
+
+    x2 = (x + w - 1) / DAMAGE_TILE_W;
+    if (x2 > 31)
+	x2 = 31;
+    mask = (0xffffffff >> (31 - x2)) & (0xffffffff << (x / DAMAGE_TILE_W));
+
+    y2 = (y + h - 1) / DAMAGE_TILE_H;
+    if (y2 >= DAMAGE_ROWS)
+	y2 = DAMAGE_ROWS - 1;
+    for (y /= DAMAGE_TILE_H; y <= y2; y++)
+	dmg->rows[y] |= mask;
+}
+
+
+/*
+ * Mark an area of the screen buffer as changed since the last blit.
+ *
+ * Cards that report all their changes call video_damage_track() on
+ * every frame, and the blitters then only have to update the tiles
+ * marked here. For all other cards, the whole blit is damaged.
+ */
+void
+video_damage(int x, int y, int w, int h)
+{
+    damage_rect(&damage, x, y, w, h);
+}
+
+
+/*
+ * Find the next run of damaged tiles on a row, starting at *pos, and
+ * return it as a rectangle relative to the blit's x and y, clipped to
+ * its w and y1..y2. Returns 0 when there are no more.
+ */
+int
+video_damage_next(const damage_t *dmg, int *pos, int x, int y, int y1, int y2,
+		  int w, int *rx, int *ry, int *rw, int *rh)
+{
+    uint32_t bits;
+    int tx, ty, x2, yy2;
+
+    while (*pos < (DAMAGE_ROWS * 32)) {
+	ty = *pos >> 5;
+	tx = *pos & 31;
+	bits = dmg->rows[ty] >> tx;
+
+	*ry = (ty * DAMAGE_TILE_H) - y;
+	yy2 = *ry + DAMAGE_TILE_H;
+	if (!bits || (yy2 <= y1) || (*ry >= y2)) {
+		*pos = (ty + 1) << 5;
+		continue;
+	}
+
+	/* Skip to the start of the run, and then to its end. */
+	while (! (bits & 1)) {
+		bits >>= 1;
+		tx++;
+	}
+	*rx = (tx * DAMAGE_TILE_W) - x;
+	while (bits & 1) {
+		bits >>= 1;
+		tx++;
+	}
+	x2 = (tx * DAMAGE_TILE_W) - x;
+	*pos = (ty << 5) + tx;
+
+	if (*rx < 0)
+		*rx = 0;
+	if (x2 > w)
+		x2 = w;
+	if (*rx >= x2) continue;
+	*rw = x2 - *rx;
+
+	if (*ry < y1)
+		*ry = y1;
+	if (yy2 > y2)
+		yy2 = y2;
+	*rh = yy2 - *ry;
+
+	return(1);
+    }
+
+    return(0);
+}
+
+
+/* Something changed that we cannot say where it is. */
+void
+video_damage_all(void)
+{
+    damage.all = 1;
+}
+
+
+/* The card has reported all its damage for the next blit. */
+void
+video_damage_track(void)
+{
+    damage_tracked = 1;
+}
+
+
+/*
+ * Draw one scanline of a text cell, unless exactly that is already
+ * on the screen. Text screens hardly change between frames, so most
+ * cells are skipped, and the others are expanded with masks. Returns
+ * 1 if the pels were changed.
+ */
+int
+video_text_draw(pel_t *p, textcell_t *cell, uint32_t glyph, uint32_t fg, uint32_t bg)
+{
+    const uint32_t *mask;
+    uint32_t diff;
+    int xx;
+
+    if ((cell->glyph == glyph) && (cell->fg == fg) && (cell->bg == bg))
+	return(0);
+    cell->glyph = glyph;
+    cell->fg = fg;
+    cell->bg = bg;
+
+    mask = text_masks[glyph & 0xff];
+    diff = fg ^ bg;
+
+    if (glyph & TEXT_WIDE) {
+	for (xx = 0; xx < 8; xx++)
+		p[xx << 1].val = p[(xx << 1) + 1].val = bg ^ (diff & mask[xx]);
+	p += 16;
+    } else {
+#ifdef VIDEO_SSE2
+	__m128i d = _mm_set1_epi32(diff);
+	__m128i b = _mm_set1_epi32(bg);
+
+	_mm_storeu_si128((__m128i *)&p[0],
+			 _mm_xor_si128(b, _mm_and_si128(d, _mm_loadu_si128((const __m128i *)&mask[0]))));
+	_mm_storeu_si128((__m128i *)&p[4],
+			 _mm_xor_si128(b, _mm_and_si128(d, _mm_loadu_si128((const __m128i *)&mask[4]))));
+#else
+	for (xx = 0; xx < 8; xx++)
+		p[xx].val = bg ^ (diff & mask[xx]);
+#endif
+	p += 8;
+    }
+
+    if (glyph & TEXT_9DOT) {
+	p[0].val = (glyph & TEXT_DOT9) ? fg : bg;
+	if (glyph & TEXT_WIDE)
+		p[1].val = p[0].val;
+    }
+
+    return(1);
+}
+
+
+/* Bring a buffer up to date with the frame the card just finished. */
+static void
+blit_sync(blitbuf_t *to, const blitbuf_t *from)
+{
+    int pos, x, y, w, h, yy;
+
+    pos = 0;
+    while (video_damage_next(&to->stale, &pos, 0, 0, 0, 2048, 2048,
+			     &x, &y, &w, &h)) {
+	for (yy = y; yy < (y + h); yy++)
+		memcpy(&to->bmp->line[yy][x], &from->bmp->line[yy][x],
+		       w * sizeof(pel_t));
+    }
+
+    memset(&to->stale, 0x00, sizeof(damage_t));
+}
+
+
+/*
+ * The card has finished a frame. Queue it for the renderer, and
+ * give the card another buffer to draw the next one in.
+ */
 void
 video_blit_start(int pal, int x, int y, int y1, int y2, int w, int h)
 {
-    int yy, xx;
-    uint32_t val;
+    blitbuf_t *b, *q;
+    int i, yy, xx;
     pel_t *p;
 
     if (h <= 0) return;
 
+    /* Empty frames have nothing to show, keep their damage for later. */
+    if (y1 >= y2) {
+	damage_tracked = 0;
+	return;
+    }
+
     if (pal) {
-	/* In palette mode, first convert the values. */
+	/* In palette mode, first convert the values, one line at a time. */
 	for (yy = 0; yy < h; yy++) {
-		if ((y + yy) >= 0 && (y + yy) < screen->h) {
-			for (xx = 0; xx < w; xx++) {
-				p = &screen->line[y + yy][x + xx];
-				val = pal_lookup[p->pal];
-				p->val = val;
-			}
-		}
+		if ((y + yy) < 0 || (y + yy) >= screen->h) continue;
+
+		p = &screen->line[y + yy][x];
+		for (xx = 0; xx < w; xx++)
+			p[xx].val = pal_lookup[p[xx].pal];
 	}
     }
 
-    /* Wait for access to the blitter. */
-    video_blit_wait();
+    b = &video_blit.buf[video_blit.draw];
+    b->x = x;
+    b->y = y;
+    b->y1 = y1;
+    b->y2 = y2;
+    b->w = w;
+    b->h = h;
+    b->stamp = capture_clock;
+
+    /* Hand over the damage map, and start a new one. */
+    if (damage_tracked && !damage.all) {
+	memcpy(&b->damage, &damage, sizeof(damage_t));
+    } else {
+	memset(&b->damage, 0x00, sizeof(damage_t));
+	b->damage.all = 1;
+    }
+    memset(&damage, 0x00, sizeof(damage_t));
+    damage_tracked = 0;
+
+    /* The other buffers now miss whatever changed in this one. */
+    for (i = 0; i < BLIT_BUFFERS; i++) {
+	if (i == video_blit.draw) continue;
+
+	if (b->damage.all) {
+		damage_rect(&video_blit.buf[i].stale, x, y + y1, w, y2 - y1);
+	} else for (yy = 0; yy < DAMAGE_ROWS; yy++)
+		video_blit.buf[i].stale.rows[yy] |= b->damage.rows[yy];
+    }
 
+    thread_wait_mutex(video_blit.lock);
+
+    if (video_blit.queued >= 0) {
+	/* The renderer never got to the last one, so replace it. */
+	q = &video_blit.buf[video_blit.queued];
+	if (q->damage.all || b->damage.all) {
+		b->damage.all = 1;
+	} else for (yy = 0; yy < DAMAGE_ROWS; yy++)
+		b->damage.rows[yy] |= q->damage.rows[yy];
+	if (q->y1 < b->y1)
+		b->y1 = q->y1;
+	if (q->y2 > b->y2)
+		b->y2 = q->y2;
+    }
+    video_blit.queued = video_blit.draw;
     video_blit.busy = 1;
-    video_blit.inuse = 1;
 
-    video_blit.x = x;
-    video_blit.y = y;
-    video_blit.y1 = y1;
-    video_blit.y2 = y2;
-    video_blit.w = w;
-    video_blit.h = h;
+    for (i = 0; i < BLIT_BUFFERS; i++) {
+	if ((i != video_blit.queued) && (i != video_blit.shown) &&
+	    (i != video_blit.last)) break;
+    }
+    video_blit.draw = i;
+
+    thread_release_mutex(video_blit.lock);
 
     /* Wake up the blitter. */
     thread_set_event(video_blit.wake_ev);
+
+    /* Catch up the new buffer, and let the card draw into that. */
+    blit_sync(&video_blit.buf[video_blit.draw], b);
+    screen = video_blit.buf[video_blit.draw].bmp;
 }
 
 
@@ -721,6 +1292,7 @@ void
 video_init(void)
 {
     uint8_t total[2] = { 0, 1 };
+    uint64_t h, k;
     int c, d, e;
 
     /* Initialize video type and timing. */
@@ -755,6 +1327,11 @@ video_init(void)
 	}
     }
 
+    for (c = 0; c < 256; c++) {
+	for (d = 0; d < 8; d++)
+		text_masks[c][d] = (c & (0x80 >> d)) ? 0xffffffff : 0x00000000;
+    }
+
     for (c = 0; c < 4; c++) {
 	for (d = 0; d < 4; d++) {
 		edatlookup[c][d] = 0;
@@ -776,12 +1353,31 @@ video_init(void)
     for (c = 0; c < 65536; c++)
 	video_16to32[c] = calc_16to32(c);
 
-    /* Create the screen buffer. */
-    screen = create_bitmap(2048, 2048);
+    /* Create the screen buffers. */
+    for (c = 0; c < BLIT_BUFFERS; c++) {
+	video_blit.buf[c].bmp = create_bitmap(2048, 2048);
+	memset(video_blit.buf[c].bmp->pels, 0x00, 2048 * 2048 * sizeof(pel_t));
+	memset(&video_blit.buf[c].stale, 0x00, sizeof(damage_t));
+    }
+    video_blit.draw = 0;
+    video_blit.queued = -1;
+    video_blit.shown = -1;
+    video_blit.last = -1;
+    screen = video_blit.buf[0].bmp;
+
+    /* Set up the keys for the frame hash. */
+    h = HASH_PRIME64;
+    for (c = 0; c < HASH_KEYS * 2; c++) {
+	h += 0x9e3779b97f4a7c15ULL;
+	k = h;
+	k = (k ^ (k >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	k = (k ^ (k >> 27)) * 0x94d049bb133111ebULL;
+	hash_key[c >> 1][c & 1] = k ^ (k >> 31);
+    }
 
+    video_blit.lock = thread_create_mutex(NULL);
     video_blit.wake_ev = thread_create_event();
     video_blit.busy_ev = thread_create_event();
-    video_blit.inuse_ev = thread_create_event();
     video_blit.thread = thread_create(blit_thread, &video_blit);
 }
 
@@ -789,16 +1385,20 @@ video_init(void)
 void
 video_close(void)
 {
+    int c;
+
     thread_kill(video_blit.thread);
-    thread_destroy_event(video_blit.inuse_ev);
     thread_destroy_event(video_blit.busy_ev);
     thread_destroy_event(video_blit.wake_ev);
+    thread_close_mutex(video_blit.lock);
 
     free(video_6to8);
     free(video_15to32);
     free(video_16to32);
 
-    destroy_bitmap(screen);
+    for (c = 0; c < BLIT_BUFFERS; c++)
+	destroy_bitmap(video_blit.buf[c].bmp);
+    screen = NULL;
 
     video_reset_font();
 
@@ -8,7 +8,7 @@
  *
  *		Definitions for the video controller module.
  *
- * Version:	@(#)video.h	1.0.37	2019/06/05
+ * Version:	@(#)video.h	1.0.41	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -110,6 +110,37 @@ typedef struct {
 
 typedef rgb_t PALETTE[256];
 
+/* A text mode character cell, as last drawn into the screen buffer. */
+typedef struct {
+    uint32_t	glyph;			/* font bits and cell format */
+    uint32_t	fg, bg;
+} textcell_t;
+
+#define TEXT_DOT9	0x0100		/* 9th column drawn in foreground */
+#define TEXT_9DOT	0x0200		/* cell is 9 pixels wide */
+#define TEXT_WIDE	0x0400		/* pixels are doubled */
+#define TEXT_INVALID	0xffffffff
+
+typedef struct {
+    int		cols, lines;
+    int		xoff;
+    int		gen;			/* last global invalidation seen */
+    textcell_t	*cells;
+} textcache_t;
+
+/* Damaged parts of the screen buffer, in tiles, for the blitters. */
+#define DAMAGE_TILE_W	64
+#define DAMAGE_TILE_H	16
+#define DAMAGE_ROWS	(2048 / DAMAGE_TILE_H)
+
+typedef struct {
+    int		all;			/* no map, assume all of it */
+    uint32_t	rows[DAMAGE_ROWS];	/* one bit per column of tiles */
+} damage_t;
+
+#define DAMAGE_LINE(d,y) \
+	((d)->all || (d)->rows[((y) / DAMAGE_TILE_H) & (DAMAGE_ROWS - 1)])
+
 typedef struct {
     uint8_t	chr[32];
 } dbcs_font_t;
@@ -344,13 +375,27 @@ extern int		video_card_has_config(int card);
 extern const device_t	*video_card_getdevice(int card);
 #endif
 
-extern void		video_blit_set(void(*)(bitmap_t *,int,int,int,int,int,int));
+extern void		video_blit_set(void(*)(bitmap_t *,int,int,int,int,int,int,
+					       const damage_t *));
 extern void		video_blit_done(void);
 extern void		video_blit_wait(void);
-extern void		video_blit_wait_buffer(void);
 extern void		video_blit_start(int pal, int x, int y,
 					 int y1, int y2, int w, int h);
+extern int		video_screenshot(const wchar_t *fn);
+extern uint64_t		video_frame_hash(uint32_t *seq);
 extern void		video_blend(int x, int y);
+extern textcell_t	*video_text_line(textcache_t *tc, int line,
+					 int cols, int xoff);
+extern void		video_text_invalidate(textcache_t *tc, int line);
+extern void		video_text_close(textcache_t *tc);
+extern void		video_damage(int x, int y, int w, int h);
+extern void		video_damage_all(void);
+extern void		video_damage_track(void);
+extern int		video_damage_next(const damage_t *dmg, int *pos,
+					  int x, int y, int y1, int y2, int w,
+					  int *rx, int *ry, int *rw, int *rh);
+extern int		video_text_draw(pel_t *p, textcell_t *cell,
+					uint32_t glyph, uint32_t fg, uint32_t bg);
 extern void		video_palette_rebuild(void);
 
 extern void		video_log(int level, const char *fmt, ...);
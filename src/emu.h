@@ -8,7 +8,7 @@
  *
  *		Main include file for the application.
  *
- * Version:	@(#)emu.h	1.0.36	2019/05/13
+ * Version:	@(#)emu.h	1.0.39	2019/07/03
  *
  * Author:	Fred N. van Kempen, <decwiz@yahoo.com>
  *
@@ -67,6 +67,7 @@
 # define PRINTERS_PATH	L"printer"
 # define PFONTS_PATH	L"fonts"
 #define SCREENSHOT_PATH L"screenshots"
+#define CAPTURE_PATH	L"captures"
 #define PRINTER_PATH	L"printer"
 
 /* Pre-defined file names and extensions. */
@@ -175,6 +176,8 @@ extern int	config_ro;			/* (O) dont modify cfg file */
 extern int	settings_only;			/* (O) only the settings dlg */
 extern int	log_level;			/* (O) global logging level */
 extern wchar_t	log_path[1024];			/* (O) full path of logfile */
+extern wchar_t	bench_path[1024];		/* (O) run CPU benchmarks */
+extern wchar_t	hash_path[1024];		/* (O) log of frame hashes */
 
 /* Global variables. */
 extern char	emu_title[64];			/* full name of application */
@@ -25,7 +25,7 @@
  *		 by the ROS.
  *  PPC:	MDA Monitor results in half-screen, half-cell-height display??
  *
- * Version:	@(#)m_amstrad_vid.c	1.0.6	2019/05/17
+ * Version:	@(#)m_amstrad_vid.c	1.0.8	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -340,7 +340,6 @@ pc1512_poll(priv_t priv)
 	if (dev->dispon) {
 		if (dev->displine < dev->firstline) {
 			dev->firstline = dev->displine;
-			video_blit_wait_buffer();
 		}
 		dev->lastline = dev->displine;
 
@@ -991,7 +990,6 @@ lcd_poll_mda(vid_t *dev)
 	if (mda->dispon) {
 		if (mda->displine < mda->firstline) {
 			mda->firstline = mda->displine;
-			video_blit_wait_buffer();
 		}
 		mda->lastline = mda->displine;
 
@@ -1135,7 +1133,6 @@ lcd_poll_cga(vid_t *dev)
 	if (cga->cgadispon) {
 		if (cga->displine < cga->firstline) {
 			cga->firstline = cga->displine;
-			video_blit_wait_buffer();
 		}
 		cga->lastline = cga->displine;
 
@@ -1360,7 +1357,7 @@ ida_out(uint16_t addr, uint8_t val, priv_t priv)
 			dev->crtc_index = 0x20 | (mda->crtcreg & 0x1f);
 			if (dev->opctrl & 0x80) { 
 				DEBUG("IDA: NMI (CRTC access: reg=0x%02x val=0x%02x) nmi_mask=%i\n", mda->crtcreg & 0x1f, val, nmi_mask);
-				nmi = 1;
+				nmi_set(1);
 			}        
 			dev->reg_3df = val;
 			return;
@@ -1387,7 +1384,7 @@ ida_out(uint16_t addr, uint8_t val, priv_t priv)
 		dev->crtc_index |= 0x80;
 		if (dev->opctrl & 0x80) {
 			DEBUG("IDA: NMI (mode control access: val=0x%02x) nmi_mask=%i\n", val, nmi_mask);
-			nmi = 1;
+			nmi_set(1);
 		}
 		return;
 
@@ -1400,7 +1397,7 @@ ida_out(uint16_t addr, uint8_t val, priv_t priv)
 			dev->crtc_index = 0x20 | (cga->crtcreg & 0x1f);
                         if (dev->opctrl & 0x80) { 
 				DEBUG("IDA: NMI (CRTC access: reg=0x%02x val=0x%02x) nmi_mask=%i\n", cga->crtcreg & 0x1F, val, nmi_mask);
-				nmi = 1;
+				nmi_set(1);
 			}        
 			dev->reg_3df = val;
 			return;
@@ -1428,7 +1425,7 @@ ida_out(uint16_t addr, uint8_t val, priv_t priv)
 		dev->crtc_index |= 0x80;
 		if (dev->opctrl & 0x80) {
 			DEBUG("IDA: NMI (mode ctrl access: val=0x%02x) nmi_mask=%i\n", val, nmi_mask);
-			nmi = 1;
+			nmi_set(1);
 		} else
 			set_lcd_cols(dev, val);
 		return;
@@ -1448,7 +1445,7 @@ ida_out(uint16_t addr, uint8_t val, priv_t priv)
 			DEBUG("IDA: NMI (opctrl access: val=0x%02x) nmi_mask=%i\n", val, nmi_mask);
 			dev->opctrl = val;
 			dev->crtc_index |= 0x40;
-			nmi = 1;
+			nmi_set(1);
 			return;
 		}
 		dev->opctrl = val;
@@ -1531,7 +1528,7 @@ ida_in(uint16_t addr, priv_t priv)
 	case 0x03dd:
 		temp = dev->crtc_index;		/* read NMI reason */
 		dev->crtc_index &= 0x1f;	/* reset NMI reason */
-		nmi = 0;			/* and reset NMI flag */
+		nmi_set(0);			/* and reset NMI flag */
 		return(temp);
 
 	case 0x03de:
@@ -19,7 +19,7 @@
  *		plasma display. The code for this was taken from the code
  *		for the Toshiba 3100e machine, which used a similar display.
  *
- * Version:	@(#)m_compaq_vid.c	1.0.4	2019/05/17
+ * Version:	@(#)m_compaq_vid.c	1.0.5	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -273,7 +273,6 @@ vid_poll_plasma(priv_t priv)
 	if (dev->dispon) {
                 if (cga->displine < cga->firstline) {
                         cga->firstline = cga->displine;
-                        video_blit_wait_buffer();
                 }
                 cga->lastline = cga->displine;
 
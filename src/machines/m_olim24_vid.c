@@ -8,7 +8,7 @@
  *
  *		Emulation of the Olivetti M24 built-in video controller.
  *
- * Version:	@(#)m_olim24_vid.c	1.0.6	2019/05/17
+ * Version:	@(#)m_olim24_vid.c	1.0.7	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -234,7 +234,6 @@ vid_poll(priv_t priv)
 	if (dev->dispon) {
 		if (dev->displine < dev->firstline) {
 			dev->firstline = dev->displine;
-                        video_blit_wait_buffer();
 		}
 		dev->lastline = dev->displine;
 		for (c = 0; c < 8; c++) {
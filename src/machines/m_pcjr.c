@@ -8,7 +8,7 @@
  *
  *		Emulation of the IBM PCjr.
  *
- * Version:	@(#)m_pcjr.c	1.0.23	2019/05/17
+ * Version:	@(#)m_pcjr.c	1.0.25	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -284,7 +284,6 @@ vid_poll(priv_t priv)
 
 		if (dev->displine < dev->firstline) {
 			dev->firstline = dev->displine;
-			video_blit_wait_buffer();
 		}
 		dev->lastline = dev->displine;
 		cols[0] = (dev->array[2] & 0xf) + 16;
@@ -704,7 +703,7 @@ kbd_poll(priv_t priv)
 
     if (dev->serial_pos) {
 	dev->data = dev->serial_data[dev->serial_pos - 1];
-	nmi = dev->data;
+	nmi_set(dev->data);
 	dev->serial_pos++;
 	if (dev->serial_pos == 42+1)
 		dev->serial_pos = 0;
@@ -9,7 +9,7 @@
  *		Implementation of the Toshiba T1000 plasma display, which
  *		has a fixed resolution of 640x200 pixels.
  *
- * Version:	@(#)m_tosh1x00_vid.c	1.0.13	2019/05/17
+ * Version:	@(#)m_tosh1x00_vid.c	1.0.14	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -380,10 +380,6 @@ vid_poll(priv_t priv)
 	dev->cga.cgastat |= 1;
 	dev->linepos = 1;
 	if (dev->dispon) {
-		if (dev->displine == 0) {
-			video_blit_wait_buffer();
-		}
-
 		if (dev->cga.cgamode & 0x02) {
 			/* Graphics */
 			if (dev->cga.cgamode & 0x10)
@@ -17,7 +17,7 @@
  *		done on implementing other parts of the Yamaha V6355 chip
  *		that implements the video controller.
  *
- * Version:	@(#)m_zenith_vid.c	1.0.5	2019/05/17
+ * Version:	@(#)m_zenith_vid.c	1.0.6	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *              John Elliott, <jce@seasip.info>
@@ -351,10 +351,6 @@ vid_poll(priv_t priv)
 	dev->linepos = 1;
 
 	if (dev->dispon) {
-		if (dev->displine == 0) {
-			video_blit_wait_buffer();
-		}
-
 		if (dev->cga.cgamode & 0x02) {
 			/* Graphics */
 			if (dev->cga.cgamode & 0x10)
@@ -12,7 +12,7 @@
  *		The Port92 stuff should be moved to devices/system/memctl.c
  *		 as a standard device.
  *
- * Version:	@(#)mem.c	1.0.37	2019/05/15
+ * Version:	@(#)mem.c	1.0.41	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -148,6 +148,8 @@ resetreadlookup(void)
     readlnext = 0;
     writelnext = 0;
     pccache = 0xffffffff;
+
+    x86seg_cache_flush();
 }
 
 
@@ -167,6 +169,8 @@ flushmmucache(void)
 		writelookup[c] = 0xffffffff;
 	}
     }
+
+    x86seg_cache_flush();
     mmuflush++;
 
     pccache = (uint32_t)0xffffffff;
@@ -198,6 +202,8 @@ flushmmucache_nopc(void)
 		writelookup[c] = 0xffffffff;
 	}
     }
+
+    x86seg_cache_flush();
 }
 
 
@@ -217,6 +223,8 @@ flushmmucache_cr3(void)
 		writelookup[c] = 0xffffffff;
 	}
     }
+
+    x86seg_cache_flush();
 }
 
 
@@ -240,6 +248,33 @@ mem_flush_write_page(uint32_t addr, uint32_t virt)
 }
 
 
+/*
+ * Mark (or unmark) a RAM page as watched. Writes to a watched page
+ * always go through its write_x handlers, so we must also drop any
+ * direct write mappings of it we may already have handed out.
+ */
+void
+mem_watch_page(uint32_t addr, int watch)
+{
+    uintptr_t target = (uintptr_t)&ram[addr & ~0xfff];
+    int c;
+
+    if ((addr >> 12) >= pages_sz) return;
+
+    pages[addr >> 12].watched = watch;
+    if (! watch) return;
+
+    for (c = 0; c < 256; c++) {
+	if (writelookup[c] != (int)0xffffffff &&
+	    writelookup2[writelookup[c]] != (uintptr_t)-1 &&
+	    (writelookup2[writelookup[c]] + ((uintptr_t)writelookup[c] << 12)) == target) {
+		writelookup2[writelookup[c]] = -1;
+		writelookup[c] = 0xffffffff;
+	}
+    }
+}
+
+
 #define mmutranslate_read(addr) mmutranslatereal(addr,0)
 #define mmutranslate_write(addr) mmutranslatereal(addr,1)
 #define rammap(x)	((uint32_t *)(_mem_exec[(x) >> 14]))[((x) >> 2) & 0xfff]
@@ -366,12 +401,13 @@ mem_addr_translate(uint32_t addr, uint32_t chunk_start, uint32_t len)
 }
 
 
-void
-addreadlookup(uint32_t virt, uint32_t phys)
+/* Add a read TLB entry, returns 0 if there already was one. */
+static int
+readlookup_add(uint32_t virt, uint32_t phys)
 {
-    if (virt == 0xffffffff) return;
+    if (virt == 0xffffffff) return(0);
 
-    if (readlookup2[virt>>12] != (uintptr_t)-1) return;
+    if (readlookup2[virt>>12] != (uintptr_t)-1) return(0);
 
     if (readlookup[readlnext] != (int)0xffffffff)
 	readlookup2[readlookup[readlnext]] = -1;
@@ -382,7 +418,15 @@ addreadlookup(uint32_t virt, uint32_t phys)
     readlookup[readlnext++] = virt >> 12;
     readlnext &= (cachesize-1);
 
-    cycles -= 9;
+    return(1);
+}
+
+
+void
+addreadlookup(uint32_t virt, uint32_t phys)
+{
+    if (readlookup_add(virt, phys))
+	cycles -= 9;
 }
 
 
@@ -399,9 +443,9 @@ addwritelookup(uint32_t virt, uint32_t phys)
     }
 
 #ifdef USE_DYNAREC
-    if (pages[phys >> 12].block[0] || pages[phys >> 12].block[1] || pages[phys >> 12].block[2] || pages[phys >> 12].block[3] || (phys & ~0xfff) == recomp_page)
+    if (pages[phys >> 12].block[0] || pages[phys >> 12].block[1] || pages[phys >> 12].block[2] || pages[phys >> 12].block[3] || (phys & ~0xfff) == recomp_page || pages[phys >> 12].watched)
 #else
-    if (pages[phys >> 12].block[0] || pages[phys >> 12].block[1] || pages[phys >> 12].block[2] || pages[phys >> 12].block[3])
+    if (pages[phys >> 12].block[0] || pages[phys >> 12].block[1] || pages[phys >> 12].block[2] || pages[phys >> 12].block[3] || pages[phys >> 12].watched)
 #endif
 	page_lookup[virt >> 12] = &pages[phys >> 12];
       else
@@ -430,9 +474,30 @@ getpccache(uint32_t a)
     a2 = a;
 
     if (cr0 >> 31) {
+	/*
+	 * If the data side already has a translation for this
+	 * page, use that, so we do not walk the page tables on
+	 * every jump, call or return into another code page.
+	 * Those entries are only made for RAM, so also set up the
+	 * prefetch timing for RAM, just like the slow path would.
+	 */
+	if (readlookup2[a2 >> 12] != (uintptr_t)-1) {
+		if (is286)
+			cpu_prefetch_cycles = cpu_mem_prefetch_cycles;
+		return((uint8_t *)readlookup2[a2 >> 12]);
+	}
+
 	a = mmutranslate_read(a);
 
 	if (a == 0xffffffff) return ram;
+
+	/*
+	 * If the code lives in RAM, remember the translation. Code
+	 * fetches were never charged for the page walk, so unlike a
+	 * data access, this does not take any cycles.
+	 */
+	if (mem_addr_is_ram(a & rammask))
+		(void)readlookup_add(a2, a & rammask);
     }
     a &= rammask;
 
@@ -947,6 +1012,10 @@ mem_writeb_phys(uint32_t addr, uint8_t val)
 {
     mem_map_t *map = write_mapping[addr >> 14];
 
+    /* DMA does not go through the page handlers. */
+    if (((addr >> 12) < pages_sz) && pages[addr >> 12].watched)
+	x86seg_cache_flush();
+
     if (_mem_exec[addr >> 14])
 	_mem_exec[addr >> 14][addr & 0x3fff] = val;
     else if (map && map->write_b)
@@ -991,6 +1060,8 @@ mem_write_ramb_page(uint32_t addr, uint8_t val, page_t *p)
 #endif
 	uint64_t mask = (uint64_t)1 << ((addr >> PAGE_MASK_SHIFT) & PAGE_MASK_MASK);
 	p->dirty_mask[(addr >> PAGE_MASK_INDEX_SHIFT) & PAGE_MASK_INDEX_MASK] |= mask;
+	if (p->watched)
+		x86seg_cache_flush();
 	p->mem[addr & 0xfff] = val;
     }
 }
@@ -1008,6 +1079,8 @@ mem_write_ramw_page(uint32_t addr, uint16_t val, page_t *p)
 	if ((addr & 0xf) == 0xf)
 		mask |= (mask << 1);
 	p->dirty_mask[(addr >> PAGE_MASK_INDEX_SHIFT) & PAGE_MASK_INDEX_MASK] |= mask;
+	if (p->watched)
+		x86seg_cache_flush();
 	*(uint16_t *)&p->mem[addr & 0xfff] = val;
     }
 }
@@ -1025,6 +1098,8 @@ mem_write_raml_page(uint32_t addr, uint32_t val, page_t *p)
 	if ((addr & 0xf) >= 0xd)
 		mask |= (mask << 1);
 	p->dirty_mask[(addr >> PAGE_MASK_INDEX_SHIFT) & PAGE_MASK_INDEX_MASK] |= mask;
+	if (p->watched)
+		x86seg_cache_flush();
 	*(uint32_t *)&p->mem[addr & 0xfff] = val;
     }
 }
@@ -1439,13 +1514,14 @@ mem_reset(void)
     /*
      * Make sure the configured amount of RAM does not
      * exceed the physical limit of the machine to avoid
-     * nasty crashes all over the place.
+     * nasty crashes all over the place. If we have no
+     * machine (as with the benchmarks), there is no limit.
      */
     m = mem_size;
     c = machine_get_maxmem();
     if (AT)
 	c <<= 10;	/* make KB */
-    if (m > c) {
+    if ((c > 0) && (m > c)) {
 	INFO("MEM: %luKB exceeds machine limit (%luKB), adjusted!\n", m, c);
 	mem_size = c;
     }
@@ -8,7 +8,7 @@
  *
  *		Definitions for the memory interface.
  *
- * Version:	@(#)mem.h	1.0.18	2019/05/15
+ * Version:	@(#)mem.h	1.0.19	2019/06/19
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Sarah Walker, <tommowalker@tommowalker.co.uk>
@@ -96,6 +96,8 @@ typedef struct _page_ {
 
     /*Head of codeblock tree associated with this page*/
     struct codeblock_t *head;
+
+    int		watched;		/* writes must go through write_x */
 } page_t;
 
 
@@ -226,6 +228,7 @@ extern void	mem_write_ramb_page(uint32_t addr, uint8_t val, page_t *p);
 extern void	mem_write_ramw_page(uint32_t addr, uint16_t val, page_t *p);
 extern void	mem_write_raml_page(uint32_t addr, uint32_t val, page_t *p);
 extern void	mem_flush_write_page(uint32_t addr, uint32_t virt);
+extern void	mem_watch_page(uint32_t addr, int watch);
 
 extern void	mem_reset_page_blocks(void);
 
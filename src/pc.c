@@ -8,7 +8,7 @@
  *
  *		Main emulator module where most things are controlled.
  *
- * Version:	@(#)pc.c	1.0.77	2019/05/20
+ * Version:	@(#)pc.c	1.0.82	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -88,6 +88,10 @@
 #include "devices/misc/isartc.h"
 #include "ui/ui.h"
 #include "plat.h"
+#include "capture.h"
+#ifdef USE_LIBPNG
+# include "png.h"
+#endif
 
 
 #define PCLOG_BUFF_SIZE	1024			/* buffer for one line */
@@ -107,6 +111,8 @@ int		settings_only = 0;		/* (O) only the settings dlg */
 int		config_ro = 0;			/* (O) dont modify cfg file */
 int		log_level = LOG_INFO;		/* (O) global logging level */
 wchar_t 	log_path[1024] = { L'\0'};	/* (O) full path of logfile */
+wchar_t		bench_path[1024] = { L'\0'};	/* (O) run CPU benchmarks */
+wchar_t		hash_path[1024] = { L'\0'};	/* (O) log of frame hashes */
 
 /* Configuration values. */
 config_t	config;				/* (C) active configuration */
@@ -138,6 +144,9 @@ static int	unscaled_size_x = SCREEN_RES_X,	/* current unscaled size X */
 		unscaled_size_y = SCREEN_RES_Y,	/* current unscaled size Y */
 		efscrnsz_y = SCREEN_RES_Y;
 
+static FILE	*hashfp = NULL;			/* frame hash log */
+static uint64_t	hash_last;
+
 static FILE	*logfp = NULL;			/* logging variables */
 static char	logbuff[PCLOG_BUFF_SIZE];
 static int	logseen = 0;
@@ -511,9 +520,11 @@ usage:
 		printf("\nUsage: %ls [options] [cfg-file]\n\n", p);
 		printf("Valid options are:\n\n");
 		printf("  -? or --help         - show this information\n");
+		printf("  -B or --bench path   - run CPU benchmarks, results to 'path'\n");
 		printf("  -C or --dumpcfg      - dump config file after loading\n");
 		printf("  -D or --debug        - force debug logging\n");
 		printf("  -F or --fullscreen   - start in fullscreen mode\n");
+		printf("  -H or --hashlog path - log screen changes to 'path'\n");
 		printf("  -L or --logfile path - set 'path' to be the logfile\n");
 		printf("  -P or --vmpath path  - set 'path' to be root for vm\n");
 		printf("  -q or --quiet        - set logging level to QUIET\n");
@@ -524,6 +535,13 @@ usage:
 		printf("  -W or --readonly     - do not modify the config file\n");
 		printf("\nA config file can be specified. If none is, the default file will be used.\n");
 		return(ret);
+	} else if (!wcscasecmp(argv[c], L"--bench") ||
+		   !wcscasecmp(argv[c], L"-B")) {
+		if ((c+1) == argc) {
+			ret = -1;
+			goto usage;
+		}
+		wcscpy(bench_path, argv[++c]);
 	} else if (!wcscasecmp(argv[c], L"--dumpcfg") ||
 		   !wcscasecmp(argv[c], L"-C")) {
 		do_dump_config = 1;
@@ -536,6 +554,13 @@ usage:
 	} else if (!wcscasecmp(argv[c], L"--fullscreen") ||
 		   !wcscasecmp(argv[c], L"-F")) {
 		start_in_fullscreen = 1;
+	} else if (!wcscasecmp(argv[c], L"--hashlog") ||
+		   !wcscasecmp(argv[c], L"-H")) {
+		if ((c+1) == argc) {
+			ret = -1;
+			goto usage;
+		}
+		wcscpy(hash_path, argv[++c]);
 	} else if (!wcscasecmp(argv[c], L"--logfile") ||
 		   !wcscasecmp(argv[c], L"-L")) {
 		if ((c+1) == argc) {
@@ -832,6 +857,8 @@ pc_close(thread_t *ptr)
 
     ui_mouse_capture(0);
 
+    capture_stop();
+
     zip_close();
 
     scsi_disk_close();
@@ -846,11 +873,21 @@ pc_close(thread_t *ptr)
 
     video_close();
 
+#ifdef USE_LIBPNG
+    /* Finish any screenshots still being written. */
+    png_unload();
+#endif
+
     network_close();
 
     sound_close();
 
     cdrom_close();
+
+    if (hashfp != NULL) {
+	fclose(hashfp);
+	hashfp = NULL;
+    }
 }
 
 
@@ -1052,6 +1089,35 @@ pc_reload(const wchar_t *fn)
 }
 
 
+/*
+ * Log the hash of the screen when it has changed, so that a test
+ * driver can tell what the machine is doing without screenshots.
+ */
+static void
+hash_log(void)
+{
+    uint64_t h;
+    uint32_t seq;
+
+    if (hashfp == NULL) {
+	hashfp = plat_fopen(hash_path, L"w");
+	if (hashfp == NULL) {
+		ERRLOG("PC: unable to create hash log '%ls'\n", hash_path);
+		hash_path[0] = L'\0';
+		return;
+	}
+    }
+
+    h = video_frame_hash(&seq);
+    if ((seq == 0) || (h == hash_last)) return;
+    hash_last = h;
+
+    fprintf(hashfp, "%lu %016llx\n",
+	    (unsigned long)plat_get_ticks(), (unsigned long long)h);
+    fflush(hashfp);
+}
+
+
 /*
  * The main thread runs the actual emulator code.
  *
@@ -1121,6 +1187,9 @@ pc_thread(void *param)
 				 machine_get_name(), cpu_get_name());
 			ui_window_title(temp);
 
+			if (hash_path[0] != L'\0')
+				hash_log();
+
 			title_update = 0;
 		}
 
@@ -1137,6 +1206,13 @@ pc_thread(void *param)
 
 		end_time = plat_timer_read();
 		main_time += (end_time - start_time);
+	} else if (! dopause) {
+		/*
+		 * We are ahead of real time, so sleep until the next
+		 * frame is due. With an idle (halted) guest, this is
+		 * where we spend most of our time.
+		 */
+		plat_delay_ms(1 - drawits);
 	} else {
 		/* Just so we dont overload the host OS. */
 		plat_delay_ms(1);
@@ -1162,6 +1238,11 @@ pc_onesec(void)
     framecount = 0;
 
     title_update = 1;
+
+#ifdef USE_LIBPNG
+    /* Report any screenshots the PNG worker could not write. */
+    png_report();
+#endif
 }
 
 
@@ -8,7 +8,7 @@
  *
  *		Define the various platform support functions.
  *
- * Version:	@(#)plat.h	1.0.25	2019/04/29
+ * Version:	@(#)plat.h	1.0.26	2019/06/11
  *
  * Author:	Fred N. van Kempen, <decwiz@yahoo.com>
  *
@@ -158,6 +158,7 @@ extern int	plat_path_abs(const wchar_t *path);
 extern int	plat_dir_check(const wchar_t *path);
 extern int	plat_dir_create(const wchar_t *path);
 extern uint64_t	plat_timer_read(void);
+extern uint64_t	plat_timer_freq(void);
 extern uint32_t	plat_get_ticks(void);
 extern void	plat_delay_ms(uint32_t count);
 extern void	plat_mouse_capture(int on);
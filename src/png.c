@@ -8,7 +8,11 @@
  *
  *		Provide centralized access to the PNG image handler.
  *
- * Version:	@(#)png.c	1.0.7	2019/05/03
+ *		Screenshots can also be queued, in which case they are
+ *		written by a worker thread, so whoever took them does not
+ *		have to wait for the (slow) compression.
+ *
+ * Version:	@(#)png.c	1.0.9	2019/07/03
  *
  * Author:	Fred N. van Kempen, <decwiz@yahoo.com>
  *
@@ -66,9 +70,28 @@
 # define PATH_PNG_DLL		"libpng16.so"
 #endif
 #define USE_CUSTOM_IO		1
+#define PNG_QUEUE_MAX		32	/* max queued screenshots */
+
+
+typedef struct _pngjob_ {
+    struct _pngjob_ *next;
+
+    wchar_t	fn[1024];
+    int		flip;
+    uint8_t	*pix;
+    int16_t	w, h;
+} pngjob_t;
 
 
 static void			*png_handle = NULL;	/* handle to DLL */
+static mutex_t			*job_lock = NULL;
+static event_t			*job_ev = NULL;
+static thread_t			*job_thread = NULL;
+static volatile int		job_run = 0;
+static pngjob_t			*job_head = NULL,
+				*job_tail = NULL;
+static int			job_count = 0;
+static wchar_t			job_failed[1024];	/* not written */
 #if USE_LIBPNG == 1
 # define PNGFUNC(x)		png_ ## x
 #else
@@ -133,6 +156,8 @@ static void		(*PNG_set_compression_method)(png_structrp png_ptr,
 						      int method);
 static void		(*PNG_set_compression_buffer_size)(png_structrp png_ptr,
 							   png_size_t size);
+static void		(*PNG_set_filter)(png_structrp png_ptr, int method,
+					  int filters);
 
 
 static const dllimp_t png_imports[] = {
@@ -161,6 +186,7 @@ static const dllimp_t png_imports[] = {
   { "png_set_compression_window_bits",	&PNG_set_compression_window_bits},
   { "png_set_compression_method",	&PNG_set_compression_method	},
   { "png_set_compression_buffer_size",	&PNG_set_compression_buffer_size},
+  { "png_set_filter",			&PNG_set_filter			},
   { NULL,				NULL				}
 };
 #endif
@@ -238,6 +264,19 @@ png_load(void)
 void
 png_unload(void)
 {
+    /* Let the worker finish what it has queued. */
+    if (job_thread != NULL) {
+	job_run = 0;
+	thread_set_event(job_ev);
+	thread_wait(job_thread, -1);
+	job_thread = NULL;
+
+	thread_destroy_event(job_ev);
+	job_ev = NULL;
+	thread_close_mutex(job_lock);
+	job_lock = NULL;
+    }
+
 #if USE_LIBPNG == 2
     /* Unload the DLL if possible. */
     if (png_handle != NULL)
@@ -364,10 +403,11 @@ png_write_rgb(const wchar_t *fn, int flip, uint8_t *pix, int16_t w, int16_t h)
     png_structp png = NULL;
     png_infop info = NULL;
     png_bytepp rows;
+    png_size_t len;
     uint8_t *r, *b;
     uint32_t *rgb;
     FILE *fp;
-    int y, x;
+    int y, x, xform;
 
     /* Load the DLL if needed, give up if that fails. */
     if (! png_load()) return(0);
@@ -411,7 +451,14 @@ error:
 #else
     PNGFUNC(init_io)(png, fp);
 #endif
-    PNGFUNC(set_compression_level)(png, 9);
+    PNGFUNC(set_compression_level)(png, 6);
+
+    /*
+     * Screen images are mostly flat areas of color, for which the
+     * "Sub" filter does as well as the adaptive default, which has
+     * to try all five filters on every row.
+     */
+    PNGFUNC(set_filter)(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
 
     /* Set other "zlib" parameters. */
     PNGFUNC(set_compression_mem_level)(png, 8);
@@ -426,20 +473,25 @@ error:
 
     PNGFUNC(write_info)(png, info);
 
-    /* Create a buffer for scanlines of pixels. */
+    /*
+     * Create buffers for all scanlines of pixels first, as a
+     * flipped image fills them from the bottom up.
+     */
     rows = (png_bytepp)mem_alloc(sizeof(png_bytep) * h);
+    len = PNGFUNC(get_rowbytes)(png, info);
+    for (y = 0; y < h; y++)
+	rows[y] = (png_bytep)mem_alloc(len);
+
+    xform = (config.vid_grayscale || config.invert_display);
 
     /* Process all scanlines in the image. */
     for (y = 0; y < h; y++) {
-	/* Create a buffer for this scanline. */
-	rows[y] = (png_bytep)mem_alloc(PNGFUNC(get_rowbytes)(png, info));
-
 	/* Process all pixels on this line */
 	for (x = 0; x < w; x++) {
                	b = &pix[((y * w) + x) * 4];
 
 		/* Transform if needed. */
-		if (config.vid_grayscale || config.invert_display) {
+		if (xform) {
 			rgb = (uint32_t *)b;
 			*rgb = video_color_transform(*rgb);
 		}
@@ -587,3 +639,121 @@ error:
 
     return(1);
 }
+
+
+static void
+png_thread(void *param)
+{
+    pngjob_t *job;
+
+    for (;;) {
+	thread_wait_mutex(job_lock);
+	job = job_head;
+	if (job != NULL) {
+		job_head = job->next;
+		if (job_head == NULL)
+			job_tail = NULL;
+		job_count--;
+	}
+	thread_release_mutex(job_lock);
+
+	if (job == NULL) {
+		/* Nothing left to do, so quit if we were told to. */
+		if (! job_run) break;
+
+		thread_wait_event(job_ev, -1);
+		thread_reset_event(job_ev);
+		continue;
+	}
+
+	/* We cannot bother the user from here, see png_report(). */
+	if (! png_write_rgb(job->fn, job->flip, job->pix, job->w, job->h)) {
+		thread_wait_mutex(job_lock);
+		wcscpy(job_failed, job->fn);
+		thread_release_mutex(job_lock);
+	}
+
+	free(job->pix);
+	free(job);
+    }
+}
+
+
+/* Tell the user about a queued image that could not be written (UI thread.) */
+void
+png_report(void)
+{
+    wchar_t temp[512];
+    wchar_t fn[1024];
+
+    if (job_lock == NULL) return;
+
+    thread_wait_mutex(job_lock);
+    wcscpy(fn, job_failed);
+    job_failed[0] = L'\0';
+    thread_release_mutex(job_lock);
+
+    if (fn[0] == L'\0') return;
+
+    swprintf(temp, sizeof_w(temp), get_string(IDS_ERR_SCRSHOT), fn);
+    ui_msgbox(MBX_ERROR, temp);
+}
+
+
+/*
+ * Queue an image for png_write_rgb(), which then happens on the
+ * worker thread. The pixel buffer must have been allocated with
+ * mem_alloc(), and is always freed by us. If the queue is full,
+ * the image is written right away.
+ */
+int
+png_queue_rgb(const wchar_t *fn, int flip, uint8_t *pix, int16_t w, int16_t h)
+{
+    pngjob_t *job;
+    int i;
+
+    /* Load the DLL if needed, give up if that fails. */
+    if (! png_load()) {
+	free(pix);
+	return(0);
+    }
+
+    if (job_thread == NULL) {
+	job_lock = thread_create_mutex(NULL);
+	job_ev = thread_create_event();
+	job_run = 1;
+	job_thread = thread_create(png_thread, NULL);
+    }
+
+    job = (pngjob_t *)mem_alloc(sizeof(pngjob_t));
+    memset(job, 0x00, sizeof(pngjob_t));
+    wcsncpy(job->fn, fn, sizeof_w(job->fn) - 1);
+    job->flip = flip;
+    job->pix = pix;
+    job->w = w;
+    job->h = h;
+
+    thread_wait_mutex(job_lock);
+    if (job_count < PNG_QUEUE_MAX) {
+	if (job_tail != NULL)
+		job_tail->next = job;
+	  else
+		job_head = job;
+	job_tail = job;
+	job_count++;
+	job = NULL;
+    }
+    thread_release_mutex(job_lock);
+
+    if (job != NULL) {
+	/* The worker is way behind, so do this one ourselves. */
+	i = png_write_rgb(job->fn, flip, pix, w, h);
+	free(pix);
+	free(job);
+	return(i);
+    }
+
+    thread_set_event(job_ev);
+
+    return(1);
+}
@@ -8,7 +8,7 @@
  *
  *		Definitions for the centralized PNG image handler.
  *
- * Version:	@(#)png.h	1.0.3	2019/04/27
+ * Version:	@(#)png.h	1.0.5	2019/07/03
  *
  * Author:	Fred N. van Kempen, <decwiz@yahoo.com>
  *
@@ -60,6 +60,9 @@ extern int	png_write_gray(const wchar_t *path, int invert,
 
 extern int	png_write_rgb(const wchar_t *fn, int flip, uint8_t *pix,
 			      int16_t w, int16_t h);
+extern int	png_queue_rgb(const wchar_t *fn, int flip, uint8_t *pix,
+			      int16_t w, int16_t h);
+extern void	png_report(void);
 
 #ifdef EMU_VIDEO_H
 extern int	png_write_pal(const wchar_t *fn, uint8_t *pix,
@@ -11,7 +11,7 @@
  *		This code is called by the UI frontend modules, and, also,
  *		depends on those same modules for lower-level functions.
  *
- * Version:	@(#)ui_main.c	1.0.24	2019/05/17
+ * Version:	@(#)ui_main.c	1.0.25	2019/06/26
  *
  * Author:	Fred N. van Kempen, <decwiz@yahoo.com>
  *
@@ -56,6 +56,7 @@
 #include "../config.h"
 #include "../device.h"
 #include "../plat.h"
+#include "../capture.h"
 #include "../devices/input/keyboard.h"
 #include "../devices/input/mouse.h"
 #include "../devices/video/video.h"
@@ -325,6 +326,8 @@ main_reset_all(void)
 
     menu_set_item(IDM_CGA_CONTR, config.vid_cga_contrast);
 
+    menu_set_item(IDM_RECORD, capture_active);
+
 #ifdef _LOGGING
     for (i = IDM_LOG_BEGIN; i < IDM_LOG_END; i++) {
 	set_logging_item(i, -3);
@@ -606,6 +609,14 @@ ui_menu_command(int idm)
 		vidapi_screenshot();
 		break;
 
+	case IDM_RECORD:			/* TOOLS menu */
+		if (capture_active)
+			capture_stop();
+		else
+			(void)capture_start();
+		menu_set_item(idm, capture_active);
+		break;
+
 	case IDM_ABOUT:				/* HELP menu */
 		pc_pause(1);
 		dlg_about();
@@ -12,7 +12,7 @@
  *		those are not used by the platform code. This is easier to
  *		maintain.
  *
- * Version:	@(#)ui_resource.h	1.0.21	2019/05/17
+ * Version:	@(#)ui_resource.h	1.0.22	2019/06/26
  *
  * Author:	Fred N. van Kempen, <decwiz@yahoo.com>
  *
@@ -150,7 +150,8 @@
 #define IDM_LOAD		(IDM_TOOLS+90)
 #define IDM_SAVE		(IDM_TOOLS+91)
 #define IDM_SCREENSHOT		(IDM_TOOLS+92)
-#define IDM_TOOLS_END		(IDM_SCREENSHOT+1)
+#define IDM_RECORD		(IDM_TOOLS+93)
+#define IDM_TOOLS_END		(IDM_RECORD+1)
 
 /* HELP menu. */
 #define IDM_HELP		(IDM_BASE+400)
@@ -579,6 +580,7 @@
 #define IDS_4086	4086		/* "Load &configuration" */
 #define IDS_4087	4087		/* "S&ave configuration" */
 #define IDS_4088	4088		/* "&Take screenshot\tCtrl+Home" */
+#define IDS_4089	4089		/* "&Record video\tCtrl+End" */
 
 
 /* UI menu: Help (4090.) */
@@ -10,7 +10,7 @@
  *
  * TODO:	Implement screenshots, and Audio Redirection.
  *
- * Version:	@(#)vnc.c	1.0.12	2019/05/03
+ * Version:	@(#)vnc.c	1.0.14	2019/06/27
  *
  * Author:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Based on raw code by RichardG, <richardg867@gmail.com>
@@ -257,29 +257,54 @@ vnc_display(rfbClientPtr cl)
 }
 
 
+/* Copy part of the screen buffer into the VNC framebuffer. */
 static void
-vnc_blit(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h)
+vnc_copy(bitmap_t *scr, int x, int y, int fx, int fy, int w, int h)
 {
     uint32_t *p;
     int yy;
 
+    for (yy = fy; yy < (fy + h); yy++) {
+	if ((y+yy) < 0 || (y+yy) >= VNC_MAX_Y) continue;
+
+	p = &(((uint32_t *)rfb->frameBuffer)[yy*VNC_MAX_X + fx]);
+	if (config.vid_grayscale || config.invert_display)
+		video_transform_copy(p, &scr->line[y+yy][x+fx], w);
+	  else
+		memcpy(p, &scr->line[y+yy][x+fx], w*4);
+    }
+}
+
+
+static void
+vnc_blit(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h, const damage_t *dmg)
+{
+    int pos, rx, ry, rw, rh;
+
 INFO("VNC: blit(%i,%i, %i,%i, %i,%i)\n", x,y, y1,y2, w,h);
 
-    for (yy = y1; yy < y2; yy++) {
-	p = (uint32_t *)&(((uint32_t *)rfb->frameBuffer)[yy*VNC_MAX_X]);
+    if (dmg->all) {
+	vnc_copy(scr, x, y, 0, y1, w, y2 - y1);
 
-	if ((y+yy) >= 0 && (y+yy) < VNC_MAX_Y) {
-		if (config.vid_grayscale || config.invert_display)
-			video_transform_copy(p, &scr->line[y+yy][x], w);
-		  else
-			memcpy(p, &scr->line[y+yy][x], w*4);
-	}
+	video_blit_done();
+
+	if (! updatingSize)
+		DLLFUNC(MarkRectAsModified)(rfb, 0,y1, allowedX,y2);
+	return;
     }
- 
+
+    /* Only copy the damaged tiles, and tell the clients about those. */
+    pos = 0;
+    while (video_damage_next(dmg, &pos, x, y, y1, y2, w, &rx, &ry, &rw, &rh))
+	vnc_copy(scr, x, y, rx, ry, rw, rh);
+
     video_blit_done();
 
-    if (! updatingSize)
-	DLLFUNC(MarkRectAsModified)(rfb, 0,0, allowedX,allowedY);
+    if (updatingSize) return;
+
+    pos = 0;
+    while (video_damage_next(dmg, &pos, x, y, y1, y2, w, &rx, &ry, &rw, &rh))
+	DLLFUNC(MarkRectAsModified)(rfb, rx,ry, rx+rw,ry+rh);
 }
 
 
@@ -438,6 +463,10 @@ static void
 vnc_screenshot(const wchar_t *fn)
 {
     vnc_dbglog("take_screenshot\n");
+
+    /* We have no window of our own, so save the emulated screen. */
+    if (! video_screenshot(fn))
+	ERRLOG("VNC: screenshot '%ls' not taken, one is pending\n", fn);
 }
 
 
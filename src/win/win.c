@@ -8,7 +8,7 @@
  *
  *		Platform main support module for Windows.
  *
- * Version:	@(#)win.c	1.0.31	2019/05/17
+ * Version:	@(#)win.c	1.0.32	2019/06/11
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -54,6 +54,7 @@
 #include "../device.h"
 #include "../ui/ui.h"
 #include "../plat.h"
+#include "../bench.h"
 #ifdef USE_SDL
 # include "win_sdl.h"
 #endif
@@ -242,6 +243,14 @@ WinMain(HINSTANCE hInst, HINSTANCE hPrev, LPSTR lpszArg, int nCmdShow)
 	return(1);
     }
 
+    /* If requested, run the benchmark suite instead. */
+    if (bench_path[0] != L'\0') {
+	plat_console(1);
+	i = bench_run(bench_path);
+	plat_console(0);
+	return(i ? 0 : 1);
+    }
+
     /* Cleanup: we may no longer need the console. */
     if (! force_debug)
 	plat_console(0);
@@ -558,6 +567,17 @@ plat_timer_read(void)
 }
 
 
+uint64_t
+plat_timer_freq(void)
+{
+    LARGE_INTEGER li;
+
+    QueryPerformanceFrequency(&li);
+
+    return(li.QuadPart);
+}
+
+
 uint32_t
 plat_get_ticks(void)
 {
@@ -8,7 +8,7 @@
  *
  *		Rendering module for Microsoft Direct2D.
  *
- * Version:	@(#)win_d2d.cpp	1.0.9	2019/05/17
+ * Version:	@(#)win_d2d.cpp	1.0.11	2019/06/27
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		David Hrdlicka, <hrdlickadavid@outlook.com>
@@ -157,7 +157,7 @@ d2d_stretch(float *w, float *h, float *x, float *y)
 
 
 static void
-d2d_blit(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h)
+d2d_blit(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h, UNUSED(const damage_t *dmg))
 {
     ID2D1Bitmap *fs_bitmap = 0;
     ID2D1RenderTarget *RT;
@@ -419,9 +419,12 @@ static void
 d2d_screenshot(const wchar_t *fn)
 {
     // Saving a screenshot of a Direct2D render target is harder than
-    // one would think. Keeping this stubbed for the moment
+    // one would think, so we save the emulated screen instead.
     //	-ryu
     INFO("D2D: screenshot(%ls)\n", fn);
+
+    if (! video_screenshot(fn))
+	ERRLOG("D2D: screenshot '%ls' not taken, one is pending\n", fn);
 }
 
 
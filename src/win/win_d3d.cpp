@@ -8,7 +8,7 @@
  *
  *		Rendering module for Microsoft Direct3D 9.
  *
- * Version:	@(#)win_d3d.cpp	1.0.20	2019/05/19
+ * Version:	@(#)win_d3d.cpp	1.0.23	2019/06/27
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -170,7 +170,7 @@ d3d_size(RECT w_rect, double *l, double *t, double *r, double *b, int w, int h)
 
 
 static void
-d3d_blit_fs(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h)
+d3d_blit_fs(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h, const damage_t *dmg)
 {
     HRESULT hr = D3D_OK;
     HRESULT hbsr = D3D_OK;
@@ -200,8 +200,9 @@ d3d_blit_fs(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h)
 
 	hr = d3dTexture->LockRect(0, &dr, &lock_rect, 0);
 	if (hr == D3D_OK) {
+		/* The texture keeps its contents, so skip the clean lines. */
 		for (yy = y1; yy < y2; yy++) {
-			if (scr) {
+			if (scr && DAMAGE_LINE(dmg, y + yy)) {
 				if (config.vid_grayscale || config.invert_display)
 					video_transform_copy((uint32_t *)((uintptr_t)dr.pBits + ((yy - y1) * dr.Pitch)), &scr->line[yy + y][x], w);
 				else
@@ -289,7 +290,7 @@ d3d_blit_fs(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h)
 
 
 static void
-d3d_blit(bitmap_t *b, int x, int y, int y1, int y2, int w, int h)
+d3d_blit(bitmap_t *b, int x, int y, int y1, int y2, int w, int h, const damage_t *dmg)
 {
     HRESULT hr = D3D_OK;
     HRESULT hbsr = D3D_OK;
@@ -315,9 +316,10 @@ d3d_blit(bitmap_t *b, int x, int y, int y1, int y2, int w, int h)
 
     hr = d3dTexture->LockRect(0, &dr, &r, 0);
     if (hr == D3D_OK) {	
+	/* The texture keeps its contents, so skip the clean lines. */
 	for (yy = y1; yy < y2; yy++) {
-		if (b) {
-			if ((y + yy) >= 0 && (y + yy) < screen->h) {
+		if (b && DAMAGE_LINE(dmg, y + yy)) {
+			if ((y + yy) >= 0 && (y + yy) < b->h) {
 				if (config.vid_grayscale || config.invert_display)
 					video_transform_copy((uint32_t *)((uintptr_t)dr.pBits + ((yy - y1) * dr.Pitch)), &b->line[yy + y][x], w);
 				else
@@ -695,8 +697,10 @@ d3d_screenshot(const wchar_t *fn)
     is_enabled = old;
 
 #if USE_LIBPNG
-    i = png_write_rgb(fn, 0, pixels,
+    /* Save the screenshot, using PNG. This also frees the pixels. */
+    i = png_queue_rgb(fn, 0, pixels,
 		      (int16_t)desc.Width, (int16_t)desc.Height);
+    pixels = NULL;
 
     /* Show error message if needed. */
     if (i == 0) {
@@ -709,7 +713,8 @@ d3d_screenshot(const wchar_t *fn)
 #endif
 
     /* Release the linear buffer. */
-    free(pixels);
+    if (pixels != NULL)
+	free(pixels);
 }
 
 
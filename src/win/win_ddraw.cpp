@@ -8,7 +8,7 @@
  *
  *		Rendering module for Microsoft DirectDraw 9.
  *
- * Version:	@(#)win_ddraw.cpp	1.0.23	2019/05/17
+ * Version:	@(#)win_ddraw.cpp	1.0.26	2019/07/03
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -229,7 +229,7 @@ ddraw_fs_size(RECT w_rect, RECT *r_dest, int w, int h)
 
 
 static void
-ddraw_blit_fs(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h)
+ddraw_blit_fs(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h, const damage_t *dmg)
 {
     DDSURFACEDESC2 ddsd;
     RECT r_src, r_dest, w_rect;
@@ -257,14 +257,18 @@ ddraw_blit_fs(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h)
 	lpdds_back->Lock(NULL, &ddsd,
 			 DDLOCK_SURFACEMEMORYPTR | DDLOCK_WAIT, NULL);
 	device_force_redraw();
+
+	/* The contents are gone, so this frame has to go in whole. */
+	dmg = NULL;
     }
     if (! ddsd.lpSurface) {
 	video_blit_done();
 	return;
     }
 
+    /* The back buffer keeps its contents, so skip the clean lines. */
     for (yy = y1; yy < y2; yy++) {
-	if (scr) {
+	if (scr && (dmg == NULL || DAMAGE_LINE(dmg, y + yy))) {
 		if (config.vid_grayscale || config.invert_display)
 			video_transform_copy((uint32_t *)((uintptr_t)ddsd.lpSurface + (yy * ddsd.lPitch)), &scr->line[y + yy][x], w);
 		else
@@ -308,7 +312,7 @@ ddraw_blit_fs(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h)
 
 
 static void
-ddraw_blit(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h)
+ddraw_blit(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h, const damage_t *dmg)
 {
     DDSURFACEDESC2 ddsd;
     RECT r_src, r_dest;
@@ -336,6 +340,9 @@ ddraw_blit(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h)
 	lpdds_back->Lock(NULL, &ddsd,
 			 DDLOCK_SURFACEMEMORYPTR | DDLOCK_WAIT, NULL);
 	device_force_redraw();
+
+	/* The contents are gone, so this frame has to go in whole. */
+	dmg = NULL;
     }
 
     if (! ddsd.lpSurface) {
@@ -343,8 +350,9 @@ ddraw_blit(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h)
 	return;
     }
 
+    /* The back buffer keeps its contents, so skip the clean lines. */
     for (yy = y1; yy < y2; yy++) {
-	if (scr) {
+	if (scr && (dmg == NULL || DAMAGE_LINE(dmg, y + yy))) {
 		if ((y + yy) >= 0 && (y + yy) < scr->h) {
 			if (config.vid_grayscale || config.invert_display)
 				video_transform_copy((uint32_t *) &(((uint8_t *) ddsd.lpSurface)[yy * ddsd.lPitch]), &scr->line[y + yy][x], w);
@@ -728,10 +736,13 @@ ddraw_screenshot(const wchar_t *fn)
 
 #ifdef USE_LIBPNG
     /* Save the screenshot, using PNG if available. */
-    i = png_write_rgb(path, 1, pixels,
-		      (int16_t)bmi.bmiHeader.biWidth,
-		      (int16_t)abs(bmi.bmiHeader.biHeight));
-    if (i == 0) {
+    if (png_load()) {
+	/* This also frees the pixels. */
+	i = png_queue_rgb(path, 1, pixels,
+			  (int16_t)bmi.bmiHeader.biWidth,
+			  (int16_t)abs(bmi.bmiHeader.biHeight));
+	pixels = NULL;
+    } else {
 #endif
 	/* Use BMP, so fix the file name. */
 	path[wcslen(path)-3] = L'b';
@@ -743,7 +754,8 @@ ddraw_screenshot(const wchar_t *fn)
 #endif
 
     /* Release pixel buffer. */
-    free(pixels);
+    if (pixels != NULL)
+	free(pixels);
 
     /* Show error message if needed. */
     if (i == 0) {
@@ -12,7 +12,7 @@
  *		we will not use that, but, instead, use a new window which
  *		coverrs the entire desktop.
  *
- * Version:	@(#)win_sdl.c  	1.0.12	2019/05/17
+ * Version:	@(#)win_sdl.c  	1.0.14	2019/06/27
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Michael Dring, <michael@drueing.de>
@@ -234,7 +234,7 @@ sdl_resize(int x, int y)
 
 
 static void
-sdl_blit(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h)
+sdl_blit(bitmap_t *scr, int x, int y, int y1, int y2, int w, int h, UNUSED(const damage_t *dmg))
 {
     SDL_Rect r_src;
     void *pixeldata;
@@ -498,8 +498,9 @@ sdl_screenshot(const wchar_t *fn)
     }
 
 #ifdef USE_LIBPNG
-    /* Save the screenshot, using PNG. */
-    i = png_write_rgb(fn, 0, pixels, (int16_t)width, (int16_t)height);
+    /* Save the screenshot, using PNG. This also frees the pixels. */
+    i = png_queue_rgb(fn, 0, pixels, (int16_t)width, (int16_t)height);
+    pixels = NULL;
 #endif
 
     if (pixels)
@@ -8,7 +8,7 @@
  *
  *		Implementation of the Settings dialog.
  *
- * Version:	@(#)win_settings_disk.h	1.0.20	2019/05/28
+ * Version:	@(#)win_settings_disk.h	1.0.21	2019/06/08
  *
  * Authors:	Fred N. van Kempen, <decwiz@yahoo.com>
  *		Miran Grca, <mgrca8@gmail.com>
@@ -1005,7 +1005,15 @@ disk_add_proc(HWND hdlg, UINT message, WPARAM wParam, LPARAM lParam)
 
 				sector_size = 512;
 
-				if (!(existing & 1) && (wcslen(hd_file_name) > 0)) {
+				if (!(existing & 1) && image_is_hdz(hd_file_name, 0)) {
+					/* Compressed images start out empty. */
+					if (! hdz_create(hd_file_name, NULL, 0, spt, hpc, tracks)) {
+						settings_msgbox(MBX_ERROR, (wchar_t *)IDS_OPEN_WRITE);
+						return TRUE;
+					}
+
+					settings_msgbox(MBX_INFO, (wchar_t *)IDS_3537);
+				} else if (!(existing & 1) && (wcslen(hd_file_name) > 0)) {
 					f = _wfopen(hd_file_name, L"wb");
 
 					if (image_is_hdi(hd_file_name)) {
@@ -1159,7 +1167,8 @@ hdd_add_file_open_error:
 					return TRUE;
 				}
 				if (existing & 1) {
-					if (image_is_hdi(temp_path) || image_is_hdx(temp_path, 1)) {
+					if (image_is_hdi(temp_path) || image_is_hdx(temp_path, 1) ||
+					    image_is_hdz(temp_path, 1)) {
 						fseeko64(f, 0x10, SEEK_SET);
 						fread(&sector_size, 1, 4, f);
 						if (sector_size != 512) {